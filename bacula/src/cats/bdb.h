@@ -58,6 +58,53 @@ typedef enum
 /* Turn the num to a bit field */
 #define DB_ACL_BIT(x) (1<<x)
 
+/*
+ * Queries executed with server side prepared statements when the
+ *  driver supports it, the SQL is in prepared_queries[] (sql_cmds.c)
+ */
+typedef enum
+{
+   SQL_PREP_JOBMEDIA_MAX_INDEX = 0,
+   SQL_PREP_INSERT_JOBMEDIA,
+   SQL_PREP_UPDATE_MEDIA_END,
+   SQL_PREP_GET_MEDIA_BY_ID,
+   SQL_PREP_GET_MEDIA_BY_NAME,
+   SQL_PREP_UPDATE_MEDIA,
+   SQL_PREP_INSERT_FILE,
+   SQL_PREP_LAST                /* Keep last */
+} SQL_PREP_t;
+
+#define SQL_PARAMS_MAX 40
+
+/*
+ * Parameters of a prepared statement ($1, $2, ...), the strings
+ *  are given as they are, they are escaped only when needed.
+ */
+class SQL_PARAMS {
+public:
+   int count;
+   const char *values[SQL_PARAMS_MAX];
+   bool is_string[SQL_PARAMS_MAX];
+   char buf[SQL_PARAMS_MAX][30];
+
+   SQL_PARAMS(): count(0) {};
+   void add_int(int64_t val) {
+      ASSERT(count < SQL_PARAMS_MAX);
+      values[count] = edit_int64(val, buf[count]);
+      is_string[count++] = false;
+   };
+   void add_uint(uint64_t val) {
+      ASSERT(count < SQL_PARAMS_MAX);
+      values[count] = edit_uint64(val, buf[count]);
+      is_string[count++] = false;
+   };
+   void add_str(const char *val) {
+      ASSERT(count < SQL_PARAMS_MAX);
+      values[count] = val;
+      is_string[count++] = true;
+   };
+};
+
 class BDB: public SMARTALLOC {
 public:
    dlink m_link;                      /* queue control */
@@ -84,6 +131,10 @@ public:
    bool m_use_fatal_jmsg;             /* use Jmsg(M_FATAL) after bad queries? */
    bool m_connected;                  /* connection made to db */
    bool m_have_batch_insert;          /* have batch insert support ? */
+   bool m_file_partitioned;           /* File and FileMedia partitioned by JobId */
+   bool m_pooled;                     /* connection managed by the pool (cats.c) */
+   JobId_t m_pool_jobid;              /* last job that used the pooled connection */
+   utime_t m_pool_time;               /* time of the release in the pool */
 
    /* Cats Internal */
    int m_status;                      /* status */
@@ -126,6 +177,7 @@ public:
    const bool is_dedicated(void) { return m_dedicated; };
    bool use_fatal_jmsg(void) { return m_use_fatal_jmsg; };
    const bool batch_insert_available(void) { return m_have_batch_insert; };
+   const bool is_file_partitioned(void) { return m_file_partitioned; };
    void set_use_fatal_jmsg(bool val) { m_use_fatal_jmsg = val; };
    void increment_refcount(void) { m_ref_count++; };
    const int bdb_get_type_index(void) { return m_db_type; };
@@ -143,6 +195,10 @@ public:
    bool UpdateDB(JCR *jcr, char *cmd, bool can_be_empty, const char *file=__FILE__, int line=__LINE__);
    bool InsertDB(JCR *jcr, char *cmd, const char *file=__FILE__, int line=__LINE__);
    bool QueryDB(JCR *jcr, char *cmd, const char *file=__FILE__, int line=__LINE__);
+   bool UpdateDB(JCR *jcr, SQL_PREP_t stmt, SQL_PARAMS &params, bool can_be_empty, const char *file=__FILE__, int line=__LINE__);
+   bool InsertDB(JCR *jcr, SQL_PREP_t stmt, SQL_PARAMS &params, const char *file=__FILE__, int line=__LINE__);
+   bool QueryDB(JCR *jcr, SQL_PREP_t stmt, SQL_PARAMS &params, const char *file=__FILE__, int line=__LINE__);
+   void bdb_expand_prepared(JCR *jcr, SQL_PREP_t stmt, SQL_PARAMS &params);
    int  DeleteDB(JCR *jcr, char *cmd, const char *file=__FILE__, int line=__LINE__);
    char *bdb_strerror() { return errmsg; };
    bool bdb_check_version(JCR *jcr);
@@ -200,6 +256,7 @@ public:
    bool bdb_create_fileset_record(JCR *jcr, FILESET_DBR *fsr);
    bool bdb_create_pool_record(JCR *jcr, POOL_DBR *pool_dbr);
    bool bdb_create_jobmedia_record(JCR *jcr, JOBMEDIA_DBR *jr);
+   bool bdb_create_jobmedia_records(JCR *jcr, JOBMEDIA_DBR *jr, int nb);
    bool bdb_create_filemedia_record(JCR *jcr, FILEMEDIA_DBR *fr);
    int bdb_create_counter_record(JCR *jcr, COUNTER_DBR *cr);
    bool bdb_create_device_record(JCR *jcr, DEVICE_DBR *dr);
@@ -245,7 +302,8 @@ public:
    bool bdb_get_query_dbids(JCR *jcr, POOL_MEM &query, dbid_list &ids);
    bool bdb_get_file_list(JCR *jcr, char *jobids,
             int opts,
-            DB_RESULT_HANDLER *result_handler, void *ctx);
+            DB_RESULT_HANDLER *result_handler, void *ctx,
+            const char *PathIds=NULL);
    bool bdb_get_base_jobid(JCR *jcr, JOB_DBR *jr, JobId_t *jobid);
    bool bdb_get_accurate_jobids(JCR *jcr, JOB_DBR *jr, uint32_t from_jobid, db_list_ctx *jobids);
    bool bdb_get_used_base_jobids(JCR *jcr, POOLMEM *jobids, db_list_ctx *result);
@@ -313,6 +371,9 @@ public:
       return bdb_sql_query(query, result_handler, ctx);
    };
 
+   /* Used by the pool to check an idle connection before to reuse it */
+   virtual bool bdb_is_alive(void) { return m_connected; };
+
    /* Cats Internal */
 #ifdef CATS_PRIVATE_DBI
    int sql_num_rows(void) { return m_num_rows; };
@@ -331,7 +392,30 @@ public:
    virtual bool sql_batch_start(JCR *jcr) = 0;
    virtual bool sql_batch_end(JCR *jcr, const char *error) = 0;
    virtual bool sql_batch_insert(JCR *jcr, ATTR_DBR *ar) = 0;
+
+   /*
+    * By default, the statement is expanded in cmd by bdb_expand_prepared()
+    *  and sent as a plain query. The drivers with server side prepared
+    *  statements leave cmd untouched, the callers expand it only to
+    *  report an error.
+    */
+   virtual bool sql_query_prepared(JCR *jcr, SQL_PREP_t stmt, SQL_PARAMS &params,
+                                   int flags=0) {
+      bdb_expand_prepared(jcr, stmt, params);
+      return sql_query(cmd, flags);
+   };
+   virtual uint64_t sql_insert_autokey_prepared(JCR *jcr, SQL_PREP_t stmt, SQL_PARAMS &params,
+                                                const char *table_name) {
+      bdb_expand_prepared(jcr, stmt, params);
+      return sql_insert_autokey_record(cmd, table_name);
+   };
 #endif
+
+private:
+   bool check_query_result(JCR *jcr, const char *query, bool ok, const char *file, int line);
+   bool check_insert_result(JCR *jcr, const char *query, bool ok, const char *file, int line);
+   bool check_update_result(JCR *jcr, const char *query, bool ok, bool can_be_empty,
+                            const char *file, int line);
 };
 
 #endif /* __Bbdb_H_ */
@@ -26,6 +26,10 @@ private:
    PGconn *m_db_handle;
    PGresult *m_result;
    POOLMEM *m_buf;                /* Buffer to manipulate queries */
+   bool m_prepared[SQL_PREP_LAST]; /* Statements prepared on this connection */
+
+   bool pgsql_check_result(const char *query);
+   uint64_t pgsql_get_autokey(const char *table_name);
 
 public:
    BDB_POSTGRESQL();
@@ -59,6 +63,10 @@ public:
    bool sql_batch_start(JCR *jcr);
    bool sql_batch_end(JCR *jcr, const char *error);
    bool sql_batch_insert(JCR *jcr, ATTR_DBR *ar);
+   bool sql_query_prepared(JCR *jcr, SQL_PREP_t stmt, SQL_PARAMS &params, int flags=0);
+   uint64_t sql_insert_autokey_prepared(JCR *jcr, SQL_PREP_t stmt, SQL_PARAMS &params,
+                                        const char *table_name);
+   bool bdb_is_alive(void);
 };
 
 #endif /* __BDB_POSTGRESQL_H_ */
@@ -417,6 +417,243 @@ bail_out:
    mdb->fnl = 0;
 }
 
+/*
+ * List of the directories seen in the attribute stream of a Backup job.
+ *  At each batch insert, the new directories are sent to the catalog
+ *  to create the PathHierarchy and PathVisibility records, so the bvfs
+ *  cache is ready when the job terminates and the first browse doesn't
+ *  have to compute it with update_path_hierarchy_cache().
+ */
+struct path_hierarchy_item {
+   hlink link;
+   char path[1];
+};
+
+class path_hierarchy_list: public SMARTALLOC {
+public:
+   JobId_t JobId;
+   htable *dirs;                /* all directories (and parents) of the job */
+   alist *pending;              /* directories not yet sent to the catalog */
+   POOLMEM *last;               /* last directory added */
+   bool flushed;                /* PathVisibility records were created */
+   bool error;                  /* catalog update failed, use the SQL way */
+   bool committed;              /* Job.HasCache was set */
+
+   path_hierarchy_list(JobId_t id) {
+      path_hierarchy_item *item = NULL;
+      JobId = id;
+      dirs = New(htable(item, &item->link, NITEMS));
+      pending = New(alist(1000, not_owned_by_alist));
+      last = get_pool_memory(PM_FNAME);
+      *last = 0;
+      flushed = error = committed = false;
+   };
+
+   ~path_hierarchy_list() {
+      delete dirs;
+      delete pending;
+      free_pool_memory(last);
+   };
+
+   /* Add a directory and all its parents that are not yet in the list */
+   void add(const char *path) {
+      POOL_MEM dir(PM_FNAME);
+      path_hierarchy_item *item;
+      int len;
+
+      /* Files are sent by directory, avoid the lookup most of the time */
+      if (strcmp(last, path) == 0) {
+         return;
+      }
+      pm_strcpy(&last, path);
+      pm_strcpy(dir, path);
+
+      for (;;) {
+         if (dirs->lookup(dir.c_str())) {
+            break;              /* Parents are already in the list */
+         }
+         len = strlen(dir.c_str());
+         item = (path_hierarchy_item *)dirs->hash_malloc(sizeof(path_hierarchy_item) + len);
+         memcpy(item->path, dir.c_str(), len + 1);
+         dirs->insert(item->path, item);
+         pending->append(item->path);
+         if (len == 0) {
+            break;              /* "" is the parent of the root directories */
+         }
+         bvfs_parent_dir(dir.c_str());
+      }
+   };
+private:
+   path_hierarchy_list(const path_hierarchy_list &);
+   path_hierarchy_list &operator= (const path_hierarchy_list &);
+};
+
+/*
+ * Called for each file attribute inserted with the batch mode
+ */
+void bvfs_path_hierarchy_add(JCR *jcr, ATTR_DBR *ar, const char *path)
+{
+   /* Only Backup jobs are in the bvfs cache, Base jobs need BaseFiles.
+    *  The batch of bscan is shared by many jobs.
+    */
+   if (jcr->getJobType() != JT_BACKUP || jcr->HasBase ||
+       jcr->JobId == 0 || ar->JobId != jcr->JobId)
+   {
+      return;
+   }
+   if (ar->FileIndex <= 0) {
+      return;                   /* Deleted file, not visible */
+   }
+   if (!jcr->path_hierarchy) {
+      jcr->path_hierarchy = New(path_hierarchy_list(jcr->JobId));
+   }
+   if (!jcr->path_hierarchy->error) {
+      jcr->path_hierarchy->add(path);
+   }
+}
+
+/* Send a list of (Path, PPath) values to the bvfs_path temporary table */
+static bool send_path_hierarchy_values(JCR *jcr, BDB *mdb, POOL_MEM &values)
+{
+   POOL_MEM query;
+   if (*values.c_str() == 0) {
+      return true;
+   }
+   Mmsg(query, "INSERT INTO bvfs_path (Path, PPath) VALUES %s", values.c_str());
+   pm_strcpy(values, "");
+   return mdb->bdb_sql_query(query.c_str(), NULL, NULL);
+}
+
+/*
+ * Create the PathHierarchy and PathVisibility records for the directories
+ *  received since the last call. The Path records of the files must exist.
+ */
+bool bvfs_path_hierarchy_flush(JCR *jcr, BDB *mdb)
+{
+   path_hierarchy_list *lst = jcr->path_hierarchy;
+   POOL_MEM values, esc, esc_parent, parent, tmp;
+   char *dir, ed1[50];
+   int nb = 0, len;
+   bool ret = false;
+
+   if (!lst || lst->error || lst->pending->size() == 0) {
+      return true;
+   }
+   Dmsg2(dbglevel, "Sending %d directories of JobId=%d to the bvfs cache\n",
+         lst->pending->size(), lst->JobId);
+
+   mdb->bdb_sql_query("DROP TABLE IF EXISTS bvfs_path", NULL, NULL);
+   if (!mdb->bdb_sql_query(create_temp_bvfs_path[mdb->bdb_get_type_index()], NULL, NULL)) {
+      goto bail_out;
+   }
+
+   foreach_alist(dir, lst->pending) {
+      len = strlen(dir);
+      esc.check_size(len*2+1);
+      mdb->bdb_escape_string(jcr, esc.c_str(), dir, len);
+      if (len > 0) {
+         pm_strcpy(parent, dir);
+         bvfs_parent_dir(parent.c_str());
+         len = strlen(parent.c_str());
+         esc_parent.check_size(len*2+1);
+         mdb->bdb_escape_string(jcr, esc_parent.c_str(), parent.c_str(), len);
+         Mmsg(tmp, "%s('%s','%s')", nb ? "," : "", esc.c_str(), esc_parent.c_str());
+      } else {
+         Mmsg(tmp, "%s('%s',NULL)", nb ? "," : "", esc.c_str());
+      }
+      pm_strcat(values, tmp.c_str());
+      if (++nb >= 1000) {
+         if (!send_path_hierarchy_values(jcr, mdb, values)) {
+            goto bail_out;
+         }
+         nb = 0;
+      }
+   }
+   if (!send_path_hierarchy_values(jcr, mdb, values)) {
+      goto bail_out;
+   }
+
+   /* Parent directories may be new in the Path table */
+   if (!mdb->bdb_sql_query(bvfs_lock_path_hierarchy_query[mdb->bdb_get_type_index()], NULL, NULL)) {
+      goto bail_out;
+   }
+   if (!mdb->bdb_sql_query(bvfs_fill_path_query[mdb->bdb_get_type_index()], NULL, NULL) ||
+       !mdb->bdb_sql_query(
+          "INSERT INTO PathHierarchy (PathId, PPathId) "
+           "SELECT p.PathId, pp.PathId "
+             "FROM bvfs_path AS b "
+             "JOIN Path AS p ON (p.Path = b.Path) "
+             "JOIN Path AS pp ON (pp.Path = b.PPath) "
+            "WHERE NOT EXISTS (SELECT 1 FROM PathHierarchy AS h "
+                               "WHERE h.PathId = p.PathId)", NULL, NULL))
+   {
+      mdb->bdb_sql_query(batch_unlock_tables_query[mdb->bdb_get_type_index()], NULL, NULL);
+      goto bail_out;
+   }
+   if (!mdb->bdb_sql_query(batch_unlock_tables_query[mdb->bdb_get_type_index()], NULL, NULL)) {
+      goto bail_out;
+   }
+
+   /* Directories are sent only once per job, no duplicate here */
+   Mmsg(tmp,
+        "INSERT INTO PathVisibility (PathId, JobId) "
+         "SELECT p.PathId, %s FROM bvfs_path AS b JOIN Path AS p ON (p.Path = b.Path)",
+        edit_uint64(lst->JobId, ed1));
+   lst->flushed = true;
+   if (!mdb->bdb_sql_query(tmp.c_str(), NULL, NULL)) {
+      goto bail_out;
+   }
+   lst->pending->destroy();
+   ret = true;
+
+bail_out:
+   if (!ret) {
+      Dmsg1(dbglevel, "Unable to update the bvfs cache. ERR=%s", mdb->bdb_strerror());
+      lst->error = true;
+   }
+   mdb->bdb_sql_query("DROP TABLE IF EXISTS bvfs_path", NULL, NULL);
+   return ret;
+}
+
+/*
+ * The job is done, if all directories were sent to the catalog, the cache
+ *  is complete for this job
+ */
+void bvfs_path_hierarchy_commit(JCR *jcr, BDB *mdb)
+{
+   path_hierarchy_list *lst = jcr->path_hierarchy;
+   char ed1[50];
+
+   if (!lst || lst->error || !lst->flushed || lst->pending->size() > 0) {
+      return;
+   }
+   Mmsg(mdb->cmd, "UPDATE Job SET HasCache=1 WHERE JobId=%s",
+        edit_uint64(lst->JobId, ed1));
+   lst->committed = mdb->bdb_sql_query(mdb->cmd, NULL, NULL);
+   Dmsg2(dbglevel, "bvfs cache for JobId=%d committed=%d\n", lst->JobId, lst->committed);
+}
+
+/*
+ * Release the directory list, a partial PathVisibility is removed to let
+ *  update_path_hierarchy_cache() compute the cache the usual way.
+ */
+void bvfs_path_hierarchy_free(JCR *jcr, BDB *mdb)
+{
+   path_hierarchy_list *lst = jcr->path_hierarchy;
+   char ed1[50];
+
+   if (!lst) {
+      return;
+   }
+   if (mdb && lst->flushed && !lst->committed) {
+      Mmsg(mdb->cmd, "DELETE FROM PathVisibility WHERE JobId=%s",
+           edit_uint64(lst->JobId, ed1));
+      mdb->bdb_sql_query(mdb->cmd, NULL, NULL);
+   }
+   delete lst;
+   jcr->path_hierarchy = NULL;
+}
+
 /*
  * Internal function to update path_hierarchy cache with a shared pathid cache
  * return Error 0
@@ -930,7 +1167,7 @@ void Bvfs::get_all_file_versions(DBId_t pathid, FileId_t fnid, alist *clients)
         ,fname.c_str(), edit_uint64(pathid, ed2), eclients, q.c_str(),
         limit, offset);
    Dmsg1(dbglevel_sql, "q=%s\n", query.c_str());
-   db->bdb_sql_query(query.c_str(), list_entries, user_data);
+   db->bdb_big_sql_query(query.c_str(), list_entries, user_data);
 }
 
 /*
@@ -1200,7 +1437,7 @@ bool Bvfs::ls_dirs()
    Dmsg1(dbglevel_sql, "q=%s\n", query.c_str());
 
    db->bdb_lock();
-   db->bdb_sql_query(query.c_str(), path_handler, this);
+   db->bdb_big_sql_query(query.c_str(), path_handler, this);
    nb_record = db->sql_num_rows();
    db->bdb_unlock();
 
@@ -1234,7 +1471,7 @@ bool Bvfs::ls_all_files()
    Dmsg1(dbglevel_sql, "q=%s\n", query.c_str());
 
    db->bdb_lock();
-   db->bdb_sql_query(query.c_str(), list_entries, user_data);
+   db->bdb_big_sql_query(query.c_str(), list_entries, user_data);
    nb_record = db->sql_num_rows();
    db->bdb_unlock();
 
@@ -1293,7 +1530,7 @@ bool Bvfs::ls_files()
    Dmsg1(dbglevel_sql, "q=%s\n", query.c_str());
 
    db->bdb_lock();
-   db->bdb_sql_query(query.c_str(), list_entries, user_data);
+   db->bdb_big_sql_query(query.c_str(), list_entries, user_data);
    nb_record = db->sql_num_rows();
    db->bdb_unlock();
 
@@ -90,6 +90,241 @@ BDB *BDB::bdb_clone_database_connection(JCR *jcr, bool mult_db_connections)
              true, mdb->m_disabled_batch_insert);
 }
 
+/*
+ * Director wide pool of dedicated catalog connections.
+ *
+ * When enabled with db_pool_set_max(), the connections opened with
+ *  mult_db_connections (one per job, per batch insert or per bvfs console)
+ *  are not closed by db_close_database() but kept in an idle list, the
+ *  next db_init_database() with the same parameters will reuse one of them,
+ *  preferably the one that was used by the same JobId. An idle connection
+ *  keeps its reference count of 1, it is owned by the pool. The number of
+ *  connections is bounded, a caller waits for a connection to be released,
+ *  but a job may already hold a connection and ask for a second one (batch
+ *  mode), so after a while we open a connection over the limit instead of
+ *  waiting forever.
+ */
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_cond = PTHREAD_COND_INITIALIZER;
+static alist *pool_idle = NULL;         /* Idle connections, oldest first */
+static DB_POOL_STATS pool_stats;        /* Protected by pool_mutex */
+static const int pool_wait_timeout = 30;      /* Wait before overflowing the pool */
+static const int pool_idle_timeout = 5 * 60;  /* Close connections idle for too long */
+
+static bool pool_match(BDB *mdb, const char *db_driver, const char *db_name,
+                       const char *db_user, const char *db_address, int db_port)
+{
+   return (!db_driver || strcasecmp(mdb->m_db_driver, db_driver) == 0) &&
+      bstrcmp(mdb->m_db_name, db_name) &&
+      bstrcmp(mdb->m_db_user, db_user) &&
+      bstrcmp(mdb->m_db_address, db_address) &&
+      mdb->m_db_port == db_port;
+}
+
+/* Remove idle connections from the pool, must be called with the pool_mutex */
+static void pool_prune_idle(alist *to_close, bool all)
+{
+   BDB *mdb;
+   time_t now = time(NULL);
+
+   while (pool_idle && pool_idle->size() > 0) {
+      mdb = (BDB *)pool_idle->first();
+      if (!all && (now - mdb->m_pool_time) < pool_idle_timeout) {
+         break;                 /* The list is ordered by release time */
+      }
+      pool_idle->remove(0);
+      pool_stats.idle--;
+      pool_stats.open--;
+      to_close->append(mdb);
+   }
+}
+
+static void pool_close_list(alist *to_close)
+{
+   BDB *mdb;
+   foreach_alist(mdb, to_close) {
+      mdb->bdb_close_database(NULL);
+   }
+}
+
+/* Set the maximum number of pooled connections, 0 disables the pool */
+void db_pool_set_max(int max_connections)
+{
+   alist to_close(10, not_owned_by_alist);
+
+   P(pool_mutex);
+   if (!pool_idle) {
+      pool_idle = New(alist(10, not_owned_by_alist));
+   }
+   pool_stats.max = max_connections;
+   if (max_connections == 0) {
+      pool_prune_idle(&to_close, true);
+   }
+   pthread_cond_broadcast(&pool_cond);
+   V(pool_mutex);
+   pool_close_list(&to_close);
+}
+
+/* Close all idle connections and disable the pool */
+void db_pool_term()
+{
+   db_pool_set_max(0);
+   P(pool_mutex);
+   if (pool_idle) {
+      delete pool_idle;
+      pool_idle = NULL;
+   }
+   V(pool_mutex);
+}
+
+void db_pool_get_stats(DB_POOL_STATS *stats)
+{
+   P(pool_mutex);
+   *stats = pool_stats;
+   V(pool_mutex);
+}
+
+/*
+ * Called by the driver db_init_database() for a dedicated connection.
+ *  Return an idle connection from the pool, or NULL if the caller must
+ *  open a new one, in that case *pooled tells if the new connection is
+ *  accounted in the pool.
+ */
+BDB *db_pool_lease(JCR *jcr, const char *db_driver, const char *db_name,
+                   const char *db_user, const char *db_address, int db_port,
+                   bool *pooled)
+{
+   BDB *mdb, *found;
+   int i, idx;
+   bool waited = false;
+   struct timespec timeout;
+   alist to_close(10, not_owned_by_alist);
+   JobId_t jobid = jcr ? jcr->JobId : 0;
+
+   *pooled = false;
+   P(pool_mutex);
+   for ( ;; ) {
+      if (pool_stats.max == 0) {
+         break;                 /* No pool */
+      }
+      pool_prune_idle(&to_close, false);
+
+      /* Take the most recent matching connection, or the one of our job */
+      found = NULL;
+      idx = -1;
+      foreach_alist_index(i, mdb, pool_idle) {
+         if (pool_match(mdb, db_driver, db_name, db_user, db_address, db_port)) {
+            found = mdb;
+            idx = i;
+            if (jobid > 0 && mdb->m_pool_jobid == jobid) {
+               break;
+            }
+         }
+      }
+      if (found) {
+         pool_idle->remove(idx);
+         pool_stats.idle--;
+         if (!found->bdb_is_alive()) {
+            Dmsg1(dbglvl, "Drop dead pooled connection %p\n", found);
+            pool_stats.open--;
+            to_close.append(found);
+            continue;
+         }
+         if (jobid > 0 && found->m_pool_jobid == jobid) {
+            pool_stats.affinity_hits++;
+         }
+         pool_stats.leases++;
+         Dmsg2(dbglvl, "Lease pooled connection %p JobId=%d\n", found, jobid);
+         V(pool_mutex);
+         pool_close_list(&to_close);
+         return found;
+      }
+
+      /* Make room by closing an idle connection to another catalog */
+      if (pool_stats.open >= pool_stats.max && pool_idle->size() > 0) {
+         to_close.append(pool_idle->first());
+         pool_idle->remove(0);
+         pool_stats.idle--;
+         pool_stats.open--;
+      }
+      if (pool_stats.open < pool_stats.max) {
+         break;
+      }
+      if (waited) {
+         pool_stats.overflows++;
+         Dmsg1(dbglvl, "Catalog connection pool full, opening connection %d\n",
+               pool_stats.open + 1);
+         break;
+      }
+      /* Wait for a connection to be released */
+      pool_stats.waits++;
+      waited = true;
+      timeout.tv_sec = time(NULL) + pool_wait_timeout;
+      timeout.tv_nsec = 0;
+      while (pool_stats.open >= pool_stats.max && pool_stats.max > 0) {
+         if (pthread_cond_timedwait(&pool_cond, &pool_mutex, &timeout) == ETIMEDOUT) {
+            break;
+         }
+      }
+   }
+   if (pool_stats.max > 0) {
+      pool_stats.open++;
+      pool_stats.created++;
+      pool_stats.leases++;
+      *pooled = true;
+   }
+   V(pool_mutex);
+   pool_close_list(&to_close);
+   return NULL;
+}
+
+/*
+ * Release a catalog connection. A pooled connection that is still usable
+ *  is kept in the idle list, the other ones are closed.
+ */
+void db_pool_release(JCR *jcr, BDB *mdb)
+{
+   alist to_close(10, not_owned_by_alist);
+
+   if (!mdb->m_pooled || mdb->m_ref_count > 1) {
+      mdb->bdb_close_database(jcr);
+      return;
+   }
+   if (mdb->bdb_is_alive()) {
+      mdb->bdb_end_transaction(jcr);
+      if (jcr && jcr->db_batch == mdb) {
+         /* Do not leave the temporary table to the next user */
+         mdb->bdb_sql_query("DROP TABLE IF EXISTS batch", NULL, NULL);
+      }
+   }
+
+   P(pool_mutex);
+   if (pool_stats.max > 0 && mdb->bdb_is_alive()) {
+      mdb->bdb_lock();
+      mdb->sql_free_result();
+      mdb->bdb_unlock();
+      mdb->m_pool_time = time(NULL);
+      if (jcr && jcr->JobId > 0) {
+         mdb->m_pool_jobid = jcr->JobId;
+      }
+      pool_idle->append(mdb);
+      pool_stats.idle++;
+      pool_prune_idle(&to_close, false);
+      mdb = NULL;
+
+   } else {
+      pool_stats.open--;
+   }
+   pthread_cond_signal(&pool_cond);
+   V(pool_mutex);
+
+   if (mdb) {
+      mdb->m_pooled = false;
+      mdb->bdb_close_database(jcr);
+   }
+   pool_close_list(&to_close);
+}
+
 const char *BDB::bdb_get_engine_name(void)
 {
    BDB *mdb = this;
@@ -99,11 +99,20 @@ BDB *db_init_database(JCR *jcr, const char *db_driver, const char *db_name, cons
                        bool mult_db_connections, bool disable_batch_insert) 
 { 
    BDB_MYSQL *mdb = NULL; 
+   bool pooled = false;
  
    if (!db_user) { 
       Jmsg(jcr, M_FATAL, 0, _("A user name for MySQL must be supplied.\n")); 
       return NULL; 
    } 
+   if (mult_db_connections) {
+      /* Reuse an idle dedicated connection if the pool is enabled */
+      mdb = (BDB_MYSQL *)db_pool_lease(jcr, db_driver, db_name, db_user,
+                                       db_address, db_port, &pooled);
+      if (mdb) {
+         return mdb;
+      }
+   }
    P(mutex);                          /* lock DB queue */ 
  
    /* 
@@ -183,6 +192,7 @@ BDB *db_init_database(JCR *jcr, const char *db_driver, const char *db_name, cons
     * the creation function to add this parameter. 
     */ 
    mdb->m_dedicated = mult_db_connections; 
+   mdb->m_pooled = pooled;
  
 get_out: 
    V(mutex); 
@@ -117,11 +117,20 @@ BDB *db_init_database(JCR *jcr, const char *db_driver, const char *db_name,
                        bool mult_db_connections, bool disable_batch_insert)
 {
    BDB_POSTGRESQL *mdb = NULL;
+   bool pooled = false;
 
    if (!db_user) {
       Jmsg(jcr, M_FATAL, 0, _("A user name for PostgreSQL must be supplied.\n"));
       return NULL;
    }
+   if (mult_db_connections) {
+      /* Reuse an idle dedicated connection if the pool is enabled */
+      mdb = (BDB_POSTGRESQL *)db_pool_lease(jcr, db_driver, db_name, db_user,
+                                            db_address, db_port, &pooled);
+      if (mdb) {
+         return mdb;
+      }
+   }
    P(mutex);                          /* lock DB queue */
    if (db_list && !mult_db_connections) {
       /*
@@ -197,6 +206,7 @@ BDB *db_init_database(JCR *jcr, const char *db_driver, const char *db_name,
     * the creation function to add this parameter.
     */
    mdb->m_dedicated = mult_db_connections;
+   mdb->m_pooled = pooled;
 
 get_out:
    V(mutex);
@@ -340,6 +350,7 @@ bool BDB_POSTGRESQL::bdb_open_database(JCR *jcr)
    }
 
    mdb->m_connected = true;
+   memset(mdb->m_prepared, 0, sizeof(mdb->m_prepared));
    if (!bdb_check_version(jcr)) {
       print_msg = M_FATAL;
       goto get_out;
@@ -357,6 +368,13 @@ bool BDB_POSTGRESQL::bdb_open_database(JCR *jcr)
  
    /* Check that encoding is SQL_ASCII */
    print_msg = pgsql_check_database_encoding(jcr, mdb);
+
+   /* See if the catalog was created with a JobId partitioned File table */
+   if (sql_query(check_file_partitioning)) {
+      mdb->m_file_partitioned = (mdb->m_num_rows > 0);
+      sql_free_result();
+   }
+   Dmsg1(dbglvl_info, "File table partitioned=%d\n", mdb->m_file_partitioned);
    retval = true; 
 
 get_out:
@@ -575,9 +593,44 @@ void BDB_POSTGRESQL::bdb_end_transaction(JCR *jcr)
 }
 
 
+/*
+ * Number of rows that libpq hands us per PGresult when the chunked rows
+ *  mode is available, and upper bound of the FETCH size when we must use
+ *  a cursor.
+ */
+#define BIG_QUERY_CHUNK_SIZE  1000
+#define BIG_QUERY_FETCH_MIN   100
+#define BIG_QUERY_FETCH_MAX   10000
+
+/*
+ * Abort the query that is currently running on the connection, used
+ *  when the result_handler does not want more rows.
+ */
+static void pgsql_cancel_query(PGconn *handle)
+{
+   char errbuf[256];
+   PGcancel *cancel = PQgetCancel(handle);
+   if (cancel) {
+      if (!PQcancel(cancel, errbuf, sizeof(errbuf))) {
+         Dmsg1(dbglvl_err, "Unable to cancel query. ERR=%s\n", errbuf);
+      }
+      PQfreeCancel(cancel);
+   }
+}
+
 /*
  * Submit a general SQL command, and for each row returned,
  *  the result_handler is called with the ctx.
+ *
+ * The rows are streamed to the result_handler with the libpq single
+ *  row mode (or the chunked rows mode with libpq 17 and later), so we
+ *  never store the whole result in memory and we do not pay one
+ *  network round-trip per FETCH. Old libpq versions use a cursor with
+ *  an adaptive fetch size.
+ *
+ * The result_handler must not use the same connection to run other
+ *  queries. At the end, sql_num_rows() returns the number of rows that
+ *  were sent to the result_handler.
  */
 bool BDB_POSTGRESQL::bdb_big_sql_query(const char *query,
                                        DB_RESULT_HANDLER *result_handler,
@@ -586,7 +639,8 @@ bool BDB_POSTGRESQL::bdb_big_sql_query(const char *query,
    BDB_POSTGRESQL *mdb = this;
    SQL_ROW row; 
    bool retval = false; 
-   bool in_transaction = mdb->m_transaction;
+   bool stop = false;
+   int nb_rows = 0;
 
    Dmsg1(dbglvl_info, "db_sql_query starts with '%s'\n", query);
 
@@ -602,44 +656,126 @@ bool BDB_POSTGRESQL::bdb_big_sql_query(const char *query,
 
    bdb_lock();
 
-   if (!in_transaction) {       /* CURSOR needs transaction */
-      sql_query("BEGIN");
-   }
+#if PG_VERSION_NUM >= 90200
+   {
+      PGresult *res;
+      bool failed = false;
 
-   Mmsg(m_buf, "DECLARE _bac_cursor CURSOR FOR %s", query);
-
-   if (!sql_query(mdb->m_buf)) {
-      Mmsg(mdb->errmsg, _("Query failed: %s: ERR=%s\n"), mdb->m_buf, sql_strerror());
-      Dmsg1(dbglvl_err, "%s\n", mdb->errmsg);
-      goto get_out;
-   }
+      if (mdb->m_result) {
+         PQclear(mdb->m_result);
+         mdb->m_result = NULL;
+      }
 
-   do {
-      if (!sql_query("FETCH 100 FROM _bac_cursor")) {
-         Mmsg(mdb->errmsg, _("Fetch failed: ERR=%s\n"), sql_strerror());
+      if (!PQsendQuery(mdb->m_db_handle, query)) {
+         Mmsg(mdb->errmsg, _("Query failed: %s: ERR=%s\n"), query, sql_strerror());
          Dmsg1(dbglvl_err, "%s\n", mdb->errmsg);
-         goto get_out;
+         failed = true;
+
+#if PG_VERSION_NUM >= 170000
+      } else if (!PQsetChunkedRowsMode(mdb->m_db_handle, BIG_QUERY_CHUNK_SIZE)) {
+#else
+      } else if (!PQsetSingleRowMode(mdb->m_db_handle)) {
+#endif
+         /* The query still works, but the result will be stored */
+         Dmsg0(dbglvl_err, "Unable to switch to the row streaming mode\n");
       }
-      while ((row = sql_fetch_row()) != NULL) {
-         Dmsg1(dbglvl_info, "Fetching %d rows\n", mdb->m_num_rows);
-         if (result_handler(ctx, mdb->m_num_fields, row))
+
+      while ((res = PQgetResult(mdb->m_db_handle)) != NULL) {
+         mdb->m_result = res;
+         switch (PQresultStatus(res)) {
+         case PGRES_SINGLE_TUPLE:
+#if PG_VERSION_NUM >= 170000
+         case PGRES_TUPLES_CHUNK:
+#endif
+         case PGRES_TUPLES_OK:
+            mdb->m_num_fields = (int)PQnfields(res);
+            mdb->m_num_rows = PQntuples(res);
+            mdb->m_row_number = 0;
+            while (!stop && (row = sql_fetch_row()) != NULL) {
+               nb_rows++;
+               if (result_handler(ctx, mdb->m_num_fields, row)) {
+                  /* Discard what is left on the server side, a cancel
+                   * inside a transaction would abort it, so in this
+                   * case the remaining rows are just skipped.
+                   */
+                  if (!mdb->m_transaction) {
+                     pgsql_cancel_query(mdb->m_db_handle);
+                  }
+                  stop = true;
+               }
+            }
+            break;
+         default:
+            /* An error after a cancel is expected */
+            if (!stop && !failed) {
+               Mmsg(mdb->errmsg, _("Query failed: %s: ERR=%s\n"), query,
+                    PQresultErrorMessage(res));
+               Dmsg1(dbglvl_err, "%s\n", mdb->errmsg);
+               failed = true;
+            }
             break;
+         }
+         PQclear(res);
+         mdb->m_result = NULL;
       }
-      PQclear(mdb->m_result);
-      m_result = NULL;
+      retval = !failed;
+   }
+#else
+   {
+      bool in_transaction = mdb->m_transaction;
+      int fetch_size = BIG_QUERY_FETCH_MIN;
 
-   } while (m_num_rows > 0);    /* TODO: Can probably test against 100 */
+      if (!in_transaction) {       /* CURSOR needs transaction */
+         sql_query("BEGIN");
+      }
 
-   sql_query("CLOSE _bac_cursor");
+      Mmsg(m_buf, "DECLARE _bac_cursor CURSOR FOR %s", query);
 
-   Dmsg0(dbglvl_info, "db_big_sql_query finished\n");
-   sql_free_result();
-   retval = true;
+      if (!sql_query(mdb->m_buf)) {
+         Mmsg(mdb->errmsg, _("Query failed: %s: ERR=%s\n"), mdb->m_buf, sql_strerror());
+         Dmsg1(dbglvl_err, "%s\n", mdb->errmsg);
+      } else {
+         do {
+            Mmsg(mdb->m_buf, "FETCH %d FROM _bac_cursor", fetch_size);
+            if (!sql_query(mdb->m_buf)) {
+               Mmsg(mdb->errmsg, _("Fetch failed: ERR=%s\n"), sql_strerror());
+               Dmsg1(dbglvl_err, "%s\n", mdb->errmsg);
+               break;
+            }
+            Dmsg1(dbglvl_info, "Fetching %d rows\n", mdb->m_num_rows);
+            while (!stop && (row = sql_fetch_row()) != NULL) {
+               nb_rows++;
+               if (result_handler(ctx, mdb->m_num_fields, row)) {
+                  stop = true;
+               }
+            }
+            PQclear(mdb->m_result);
+            m_result = NULL;
+
+            /* Full batches, the result is big, ask for more next time */
+            if (m_num_rows == fetch_size && fetch_size < BIG_QUERY_FETCH_MAX) {
+               fetch_size = MIN(fetch_size * 2, BIG_QUERY_FETCH_MAX);
+            }
+         } while (!stop && m_num_rows > 0);
+
+         if (stop || m_num_rows == 0) {
+            retval = true;
+         }
+         sql_query("CLOSE _bac_cursor");
+      }
 
-get_out:
-   if (!in_transaction) {
-      sql_query("COMMIT");  /* end transaction */
+      if (!in_transaction) {
+         sql_query("COMMIT");  /* end transaction */
+      }
    }
+#endif
+
+   Dmsg1(dbglvl_info, "db_big_sql_query finished with %d rows\n", nb_rows);
+   sql_free_result();
+
+   /* Let the caller know how many rows were processed */
+   mdb->m_num_rows = nb_rows;
+   mdb->m_status = retval ? 0 : 1;
 
    bdb_unlock();
    return retval;
@@ -697,7 +833,6 @@ get_out:
 bool BDB_POSTGRESQL::sql_query(const char *query, int flags)
 {
    int i; 
-   bool retval = false; 
    BDB_POSTGRESQL *mdb = this;
 
    Dmsg1(dbglvl_info, "sql_query starts with '%s'\n", query);
@@ -719,6 +854,61 @@ bool BDB_POSTGRESQL::sql_query(const char *query, int flags)
       }
       bmicrosleep(5, 0);
    }
+   return pgsql_check_result(query);
+}
+
+/* Verify that the server connection is still usable */
+bool BDB_POSTGRESQL::bdb_is_alive(void)
+{
+   return m_connected && m_db_handle && PQstatus(m_db_handle) == CONNECTION_OK;
+}
+
+/*
+ * Execute a query with a statement prepared the first time it is used
+ *  on this connection, the planning is done only once.
+ */
+bool BDB_POSTGRESQL::sql_query_prepared(JCR *jcr, SQL_PREP_t stmt, SQL_PARAMS &params,
+                                        int flags)
+{
+   BDB_POSTGRESQL *mdb = this;
+   PGresult *res;
+   char name[30];
+
+   bsnprintf(name, sizeof(name), "bacula_prep_%d", (int)stmt);
+   if (!mdb->m_prepared[stmt]) {
+      res = PQprepare(mdb->m_db_handle, name, prepared_queries[stmt], 0, NULL);
+      if (!res || PQresultStatus(res) != PGRES_COMMAND_OK) {
+         /* Send the query with the values in the SQL text */
+         Dmsg2(dbglvl_err, "Unable to prepare %s: %s\n", name,
+               PQerrorMessage(mdb->m_db_handle));
+         PQclear(res);
+         bdb_expand_prepared(jcr, stmt, params);
+         return sql_query(mdb->cmd, flags);
+      }
+      PQclear(res);
+      mdb->m_prepared[stmt] = true;
+   }
+
+   Dmsg1(dbglvl_info, "sql_query_prepared starts with '%s'\n", prepared_queries[stmt]);
+   mdb->m_num_rows     = -1;
+   mdb->m_row_number   = -1;
+   mdb->m_field_number = -1;
+
+   if (mdb->m_result) {
+      PQclear(mdb->m_result);
+      mdb->m_result = NULL;
+   }
+   mdb->m_result = PQexecPrepared(mdb->m_db_handle, name, params.count,
+                                  params.values, NULL, NULL, 0);
+   return pgsql_check_result(prepared_queries[stmt]);
+}
+
+/* Check the result of the last query and prepare the rows to be fetched */
+bool BDB_POSTGRESQL::pgsql_check_result(const char *query)
+{
+   bool retval = false;
+   BDB_POSTGRESQL *mdb = this;
+
    if (!mdb->m_result) {
       Dmsg1(dbglvl_err, "Query failed: %s\n", query);
       goto get_out;
@@ -843,17 +1033,32 @@ int BDB_POSTGRESQL::sql_affected_rows(void)
  
 uint64_t BDB_POSTGRESQL::sql_insert_autokey_record(const char *query, const char *table_name)
 { 
+   /* First execute the insert query and then retrieve the currval. */
+   if (!sql_query(query)) { 
+      return 0; 
+   } 
+   return pgsql_get_autokey(table_name);
+}
+
+uint64_t BDB_POSTGRESQL::sql_insert_autokey_prepared(JCR *jcr, SQL_PREP_t stmt,
+                                                     SQL_PARAMS &params,
+                                                     const char *table_name)
+{
+   if (!sql_query_prepared(jcr, stmt, params)) {
+      return 0;
+   }
+   return pgsql_get_autokey(table_name);
+}
+
+/* Check the insert and get the value of the primary key */
+uint64_t BDB_POSTGRESQL::pgsql_get_autokey(const char *table_name)
+{
    uint64_t id = 0; 
    char sequence[NAMEDATALEN-1]; 
    char getkeyval_query[NAMEDATALEN+50]; 
    PGresult *p_result;
    BDB_POSTGRESQL *mdb = this;
 
-   /* First execute the insert query and then retrieve the currval. */
-   if (!sql_query(query)) { 
-      return 0; 
-   } 
-
    mdb->m_num_rows = sql_affected_rows();
    if (mdb->m_num_rows != 1) {
       return 0; 
@@ -51,6 +51,26 @@ BDB *db_init_database(JCR *jcr, const char *db_driver, const char *db_name,
         const char *db_ssl_capath, const char *db_ssl_cipher,
         bool mult_db_connections, bool disable_batch_insert);
 
+/* cats.c connection pool */
+struct DB_POOL_STATS {
+   int max;                     /* Maximum number of pooled connections, 0 = no pool */
+   int open;                    /* Pooled connections currently open */
+   int idle;                    /* Open connections not leased */
+   uint64_t leases;             /* Number of connections given to a caller */
+   uint64_t created;            /* Number of connections opened by the pool */
+   uint64_t affinity_hits;      /* Leases that got back the connection of their JobId */
+   uint64_t waits;              /* Number of times a caller waited for a connection */
+   uint64_t overflows;          /* Connections opened over the limit after a wait */
+};
+
+void db_pool_set_max(int max_connections);
+void db_pool_term();
+void db_pool_get_stats(DB_POOL_STATS *stats);
+BDB *db_pool_lease(JCR *jcr, const char *db_driver, const char *db_name,
+        const char *db_user, const char *db_address, int db_port,
+        bool *pooled);
+void db_pool_release(JCR *jcr, BDB *mdb);
+
 /* Database prototypes and defines */
 
 /* Misc */
@@ -70,13 +90,15 @@ BDB *db_init_database(JCR *jcr, const char *db_driver, const char *db_name,
 #define db_open_database(jcr, mdb) \
            mdb->bdb_open_database(jcr)
 #define db_close_database(jcr, mdb) \
-           mdb->bdb_close_database(jcr)
+           db_pool_release(jcr, mdb)
 #define db_start_transaction(jcr, mdb) \
            mdb->bdb_start_transaction(jcr)
 #define db_end_transaction(jcr, mdb) \
         if (mdb) mdb->bdb_end_transaction(jcr)
 #define db_sql_query(mdb, query, result_handler, ctx) \
            mdb->bdb_sql_query(query, result_handler, ctx)
+#define db_big_sql_query(mdb, query, result_handler, ctx) \
+           mdb->bdb_big_sql_query(query, result_handler, ctx)
 #define db_thread_cleanup(mdb) \
         if (mdb)  mdb->bdb_thread_cleanup()
 
@@ -101,8 +123,14 @@ void db_free_restoreobject_record(JCR *jcr, ROBJECT_DBR *rr);
 #define db_check_max_connections(jcr, mdb, maxc) \
            mdb->bdb_check_max_connections(jcr, maxc)
 
+/* bvfs.c */
+void bvfs_path_hierarchy_add(JCR *jcr, ATTR_DBR *ar, const char *path);
+bool bvfs_path_hierarchy_flush(JCR *jcr, BDB *mdb);
+void bvfs_path_hierarchy_commit(JCR *jcr, BDB *mdb);
+void bvfs_path_hierarchy_free(JCR *jcr, BDB *mdb);
+
 /* sql_create.c */
-bool bdb_write_batch_file_records(JCR *jcr);
+bool bdb_write_batch_file_records(JCR *jcr, bool running=false);
 void bdb_disable_batch_insert(bool disable);
 
 /* sql_get.c */
@@ -136,6 +164,8 @@ void bdb_free_restoreobject_record(JCR *jcr, ROBJECT_DBR *rr);
            mdb->bdb_create_pool_record(jcr, pool_dbr)
 #define db_create_jobmedia_record(jcr, mdb, jr) \
            mdb->bdb_create_jobmedia_record(jcr, jr)
+#define db_create_jobmedia_records(jcr, mdb, jr, nb) \
+           mdb->bdb_create_jobmedia_records(jcr, jr, nb)
 #define db_create_filemedia_record(jcr, mdb, fr) \
            mdb->bdb_create_filemedia_record(jcr, fr)
 #define db_create_counter_record(jcr, mdb, cr) \
@@ -148,6 +178,8 @@ void bdb_free_restoreobject_record(JCR *jcr, ROBJECT_DBR *rr);
            mdb->bdb_create_mediatype_record(jcr, mr)
 #define db_write_batch_file_records(jcr) \
            bdb_write_batch_file_records(jcr)
+#define db_write_running_batch_file_records(jcr) \
+           bdb_write_batch_file_records(jcr, true)
 #define db_create_attributes_record(jcr, mdb, ar) \
            mdb->bdb_create_attributes_record(jcr, ar)
 #define db_create_restore_object_record(jcr, mdb, ar) \
@@ -242,6 +274,8 @@ void bdb_free_restoreobject_record(JCR *jcr, ROBJECT_DBR *rr);
            mdb->bdb_get_query_dbids(jcr, query, ids)
 #define db_get_file_list(jcr, mdb, jobids, opts, result_handler, ctx) \
            mdb->bdb_get_file_list(jcr, jobids, opts, result_handler, ctx)
+#define db_get_dir_file_list(jcr, mdb, jobids, opts, result_handler, ctx, pathids) \
+           mdb->bdb_get_file_list(jcr, jobids, opts, result_handler, ctx, pathids)
 #define db_get_base_jobid(jcr, mdb, jr, jobid) \
            mdb->bdb_get_base_jobid(jcr, jr, jobid)
 #define db_get_accurate_jobids(jcr, mdb, jr, jobids) \
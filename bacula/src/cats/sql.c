@@ -613,6 +613,50 @@ bool BDB::bdb_check_version(JCR *jcr)
    return true; 
 } 
  
+static int append_sql(POOLMEM **buf, int pos, const char *str, int len)
+{
+   *buf = check_pool_memory_size(*buf, pos + len + 1);
+   memcpy(*buf + pos, str, len);
+   (*buf)[pos + len] = 0;
+   return pos + len;
+}
+
+/*
+ * Build in cmd the SQL text of a prepared statement with the values of
+ *  the parameters. It is used by the drivers without prepared statements
+ *  and in the error messages. The strings are escaped here, so it must
+ *  not be called for each query when the statement is really prepared.
+ */
+void BDB::bdb_expand_prepared(JCR *jcr, SQL_PREP_t stmt, SQL_PARAMS &params)
+{
+   const char *p, *q;
+   char *end;
+   int n, len, pos = 0;
+   POOL_MEM esc;
+
+   *cmd = 0;
+   for (p = prepared_queries[stmt]; (q = strchr(p, '$')) != NULL; p = end) {
+      pos = append_sql(&cmd, pos, p, q - p);
+      n = strtol(q + 1, &end, 10);
+      if (end == q + 1) {             /* Not a parameter */
+         pos = append_sql(&cmd, pos, "$", 1);
+         continue;
+      }
+      ASSERT(n > 0 && n <= params.count);
+      if (params.is_string[n-1]) {
+         len = strlen(params.values[n-1]);
+         esc.check_size(2 * len + 1);
+         bdb_escape_string(jcr, esc.c_str(), (char *)params.values[n-1], len);
+         pos = append_sql(&cmd, pos, "'", 1);
+         pos = append_sql(&cmd, pos, esc.c_str(), strlen(esc.c_str()));
+         pos = append_sql(&cmd, pos, "'", 1);
+      } else {
+         pos = append_sql(&cmd, pos, params.values[n-1], strlen(params.values[n-1]));
+      }
+   }
+   append_sql(&cmd, pos, p, strlen(p));
+}
+
 /* 
  * Utility routine for queries. The database MUST be locked before calling here. 
  * Returns: 0 on failure 
@@ -621,7 +665,27 @@ bool BDB::bdb_check_version(JCR *jcr)
 bool BDB::QueryDB(JCR *jcr, char *cmd, const char *file, int line) 
 { 
    sql_free_result(); 
-   if (!sql_query(cmd, QF_STORE_RESULT)) {
+   return check_query_result(jcr, cmd, sql_query(cmd, QF_STORE_RESULT), file, line);
+}
+
+/* Same with a prepared statement */
+bool BDB::QueryDB(JCR *jcr, SQL_PREP_t stmt, SQL_PARAMS &params,
+                  const char *file, int line)
+{
+   bool ok;
+
+   sql_free_result();
+   ok = sql_query_prepared(jcr, stmt, params, QF_STORE_RESULT);
+   if (!ok) {
+      bdb_expand_prepared(jcr, stmt, params);     /* For the error message */
+   }
+   return check_query_result(jcr, cmd, ok, file, line);
+}
+
+bool BDB::check_query_result(JCR *jcr, const char *cmd, bool ok,
+                             const char *file, int line)
+{
+   if (!ok) {
       if (use_acls) {
          Dmsg2(DT_SQL, "query %s failed:\n%s\n", cmd, sql_strerror()); 
 
@@ -651,7 +715,24 @@ bool BDB::QueryDB(JCR *jcr, char *cmd, const char *file, int line)
  */ 
 bool BDB::InsertDB(JCR *jcr, char *cmd, const char *file, int line) 
 { 
-   if (!sql_query(cmd)) { 
+   return check_insert_result(jcr, cmd, sql_query(cmd), file, line);
+}
+
+/* Same with a prepared statement */
+bool BDB::InsertDB(JCR *jcr, SQL_PREP_t stmt, SQL_PARAMS &params,
+                   const char *file, int line)
+{
+   bool ok = sql_query_prepared(jcr, stmt, params);
+   if (!ok || sql_affected_rows() != 1) {
+      bdb_expand_prepared(jcr, stmt, params);     /* For the error message */
+   }
+   return check_insert_result(jcr, cmd, ok, file, line);
+}
+
+bool BDB::check_insert_result(JCR *jcr, const char *cmd, bool ok,
+                              const char *file, int line)
+{
+   if (!ok) {
       if (use_acls) {
          Dmsg2(DT_SQL,  _("insert %s failed:\n%s\n"), cmd, sql_strerror());
          m_msg(file, line, &errmsg, _("insert failed\n"));
@@ -691,7 +772,24 @@ bool BDB::InsertDB(JCR *jcr, char *cmd, const char *file, int line)
 bool BDB::UpdateDB(JCR *jcr, char *cmd, bool can_be_empty,
                    const char *file, int line) 
 { 
-   if (!sql_query(cmd)) {
+   return check_update_result(jcr, cmd, sql_query(cmd), can_be_empty, file, line);
+}
+
+/* Same with a prepared statement */
+bool BDB::UpdateDB(JCR *jcr, SQL_PREP_t stmt, SQL_PARAMS &params,
+                   bool can_be_empty, const char *file, int line)
+{
+   bool ok = sql_query_prepared(jcr, stmt, params);
+   if (!ok || sql_affected_rows() <= 0) {
+      bdb_expand_prepared(jcr, stmt, params);     /* For the error message */
+   }
+   return check_update_result(jcr, cmd, ok, can_be_empty, file, line);
+}
+
+bool BDB::check_update_result(JCR *jcr, const char *cmd, bool ok,
+                              bool can_be_empty, const char *file, int line)
+{
+   if (!ok) {
       if (use_acls) {
          Dmsg2(DT_SQL, _("update %s failed:\n%s\n"), cmd, sql_strerror());
          m_msg(file, line, &errmsg, _("update failed:\n")); 
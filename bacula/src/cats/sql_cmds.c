@@ -258,13 +258,13 @@ static const char *select_recent_version_with_basejob_default =
       "FROM ( "
         "SELECT JobTDate, PathId, Filename "   /* Get all normal files */
           "FROM File JOIN Job USING (JobId) "    /* from selected backup */
-         "WHERE File.JobId IN (%s) "
+         "WHERE File.JobId IN (%s) %s "
           "UNION ALL "
         "SELECT JobTDate, PathId, Filename "   /* Get all files from */
           "FROM BaseFiles "                      /* BaseJob */
                "JOIN File USING (FileId) "
                "JOIN Job  ON    (BaseJobId = Job.JobId) "
-         "WHERE BaseFiles.JobId IN (%s) "        /* Use Max(JobTDate) to find */
+         "WHERE BaseFiles.JobId IN (%s) %s "        /* Use Max(JobTDate) to find */
        ") AS tmp "
        "GROUP BY PathId, Filename "            /* the latest file version */
     ") AS T1 "
@@ -286,12 +286,12 @@ const char *select_recent_version_with_basejob[] =
          "FileIndex, PathId, Filename, LStat, MD5, DeltaSeq "
    "FROM "
      "(SELECT FileId, JobId, PathId, Filename, FileIndex, LStat, MD5, DeltaSeq "
-         "FROM File WHERE JobId IN (%s) "
+         "FROM File WHERE JobId IN (%s) %s "
         "UNION ALL "
        "SELECT File.FileId, File.JobId, PathId, Filename, "
               "File.FileIndex, LStat, MD5, DeltaSeq "
          "FROM BaseFiles JOIN File USING (FileId) "
-        "WHERE BaseFiles.JobId IN (%s) "
+        "WHERE BaseFiles.JobId IN (%s) %s "
        ") AS T JOIN Job USING (JobId) "
    "ORDER BY Filename, PathId, JobTDate DESC ",
 
@@ -322,13 +322,13 @@ static const char *select_recent_version_with_basejob_and_delta_default =
       "FROM ("
        "SELECT JobTDate, PathId, Filename, DeltaSeq " /*Get all normal files*/
          "FROM File JOIN Job USING (JobId) "          /* from selected backup */
-        "WHERE File.JobId IN (%s) "
+        "WHERE File.JobId IN (%s) %s "
          "UNION ALL "
        "SELECT JobTDate, PathId, Filename, DeltaSeq " /*Get all files from */
          "FROM BaseFiles "                            /* BaseJob */
               "JOIN File USING (FileId) "
               "JOIN Job  ON    (BaseJobId = Job.JobId) "
-        "WHERE BaseFiles.JobId IN (%s) "        /* Use Max(JobTDate) to find */
+        "WHERE BaseFiles.JobId IN (%s) %s "        /* Use Max(JobTDate) to find */
        ") AS tmp "
        "GROUP BY PathId, Filename, DeltaSeq "    /* the latest file version */
     ") AS T1"
@@ -350,12 +350,12 @@ const char *select_recent_version_with_basejob_and_delta[] =
          "FileIndex, PathId, Filename, LStat, MD5, DeltaSeq "
    "FROM "
     "(SELECT FileId, JobId, PathId, Filename, FileIndex, LStat, MD5,DeltaSeq "
-         "FROM File WHERE JobId IN (%s) "
+         "FROM File WHERE JobId IN (%s) %s "
         "UNION ALL "
        "SELECT File.FileId, File.JobId, PathId, Filename, "
               "File.FileIndex, LStat, MD5, DeltaSeq "
          "FROM BaseFiles JOIN File USING (FileId) "
-        "WHERE BaseFiles.JobId IN (%s) "
+        "WHERE BaseFiles.JobId IN (%s) %s "
        ") AS T JOIN Job USING (JobId) "
    "ORDER BY Filename, PathId, DeltaSeq, JobTDate DESC ",
 
@@ -901,6 +901,49 @@ const char *batch_fill_path_query[] =
       "EXCEPT SELECT Path FROM Path"
 }; 
  
+/* Directories of a job sent to the bvfs cache, see bvfs_path_hierarchy_flush() */
+const char *create_temp_bvfs_path[] =
+{
+   /* MySQL */
+   "CREATE TEMPORARY TABLE bvfs_path (Path BLOB, PPath BLOB)",
+   /* PostgreSQL */
+   "CREATE TEMPORARY TABLE bvfs_path (Path TEXT, PPath TEXT)",
+   /* SQLite */
+   "CREATE TEMPORARY TABLE bvfs_path (Path TEXT, PPath TEXT)"
+};
+
+const char *bvfs_lock_path_hierarchy_query[] =
+{
+   /* MySQL */
+   "LOCK TABLES Path write,Path AS p write,Path AS pp write,"
+               "PathHierarchy write,PathHierarchy AS h write",
+   /* PostgreSQL */
+   "BEGIN; LOCK TABLE Path IN SHARE ROW EXCLUSIVE MODE; "
+          "LOCK TABLE PathHierarchy IN SHARE ROW EXCLUSIVE MODE ",
+   /* SQLite */
+   "BEGIN "
+};
+
+const char *bvfs_fill_path_query[] =
+{
+   /* MySQL */
+   "INSERT INTO Path (Path)"
+      "SELECT a.Path FROM "
+         "(SELECT DISTINCT Path FROM bvfs_path) AS a WHERE NOT EXISTS "
+         "(SELECT Path FROM Path AS p WHERE p.Path = a.Path)",
+
+   /* PostgreSQL */
+   "INSERT INTO Path (Path)"
+      "SELECT a.Path FROM "
+         "(SELECT DISTINCT Path FROM bvfs_path) AS a "
+       "WHERE NOT EXISTS (SELECT Path FROM Path WHERE Path = a.Path) ",
+
+   /* SQLite */
+   "INSERT INTO Path (Path)"
+      "SELECT DISTINCT Path FROM bvfs_path "
+      "EXCEPT SELECT Path FROM Path"
+};
+
 const char *match_query[] =
 {
    /* MySQL */
@@ -1032,6 +1075,16 @@ const char *poolbytes[] = {
    "COALESCE((SELECT SUM(VolBytes+VolABytes) FROM Media WHERE Media.PoolId=Pool.PoolId), 0)"
 };
 
+/* File and FileMedia partitioned by JobId, see make_postgresql_tables */
+const char *check_file_partitioning =
+   "SELECT 1 FROM pg_proc WHERE proname = 'bacula_file_partition'";
+const char *create_file_partition =
+   "SELECT bacula_file_partition(%s)";
+const char *batch_file_partitions =
+   "SELECT bacula_file_partition(JobId) FROM (SELECT DISTINCT JobId FROM batch) AS B";
+const char *purge_file_partitions =
+   "SELECT bacula_purge_file_partitions(ARRAY[%s]::integer[])";
+
 const char *count_all_jobs = "SELECT COUNT(1) FROM Job";
 const char *count_success_jobs = "SELECT COUNT(1) FROM Job WHERE JobStatus IN ('T', 'I') AND JobErrors=0";
 const char *count_success_jobids = "SELECT COUNT(1) FROM Job WHERE JobStatus IN ('T', 'I') AND JobErrors=0 and JobId in (%s)";
@@ -1072,3 +1125,57 @@ const char *regexp_value[] = {
    /* SQLite */
    regexp_value_default
 };
+
+/*
+ * Queries executed with prepared statements, indexed by SQL_PREP_t (bdb.h).
+ *  The parameters are written $1, $2, ... and are expanded by
+ *  bdb_expand_prepared() for the drivers that do not prepare them.
+ */
+#define MEDIA_COLUMNS \
+   "SELECT MediaId,VolumeName,VolJobs,VolFiles," \
+   "VolBlocks,VolBytes,VolABytes,VolHoleBytes,VolHoles,VolMounts," \
+   "VolErrors,VolWrites,Media.MaxVolBytes,Media.VolCapacityBytes," \
+   "MediaType,VolStatus,Media.PoolId,Media.VolRetention,Media.VolUseDuration,Media.MaxVolJobs," \
+   "Media.MaxVolFiles,Media.Recycle,Slot,FirstWritten,LastWritten,InChanger," \
+   "EndFile,EndBlock,VolType,VolParts,VolCloudParts,LastPartBytes," \
+   "Media.LabelType,LabelDate,StorageId," \
+   "Media.Enabled,LocationId,RecycleCount,InitialWrite," \
+   "Media.ScratchPoolId,Media.RecyclePoolId,VolReadTime,VolWriteTime,Media.ActionOnPurge," \
+   "Media.CacheRetention,Pool.Name " \
+   "FROM Media JOIN Pool USING (PoolId) "
+
+const char *prepared_queries[] = {
+   /* SQL_PREP_JOBMEDIA_MAX_INDEX */
+   "SELECT MAX(VolIndex) FROM JobMedia WHERE JobId=$1",
+
+   /* SQL_PREP_INSERT_JOBMEDIA */
+   "INSERT INTO JobMedia (JobId,MediaId,FirstIndex,LastIndex,"
+   "StartFile,EndFile,StartBlock,EndBlock,VolIndex) "
+   "VALUES ($1,$2,$3,$4,$5,$6,$7,$8,$9)",
+
+   /* SQL_PREP_UPDATE_MEDIA_END */
+   "UPDATE Media SET EndFile=$1, EndBlock=$2 WHERE MediaId=$3",
+
+   /* SQL_PREP_GET_MEDIA_BY_ID */
+   MEDIA_COLUMNS "WHERE MediaId=$1",
+
+   /* SQL_PREP_GET_MEDIA_BY_NAME */
+   MEDIA_COLUMNS "WHERE VolumeName=$1",
+
+   /* SQL_PREP_UPDATE_MEDIA */
+   "UPDATE Media SET VolJobs=$1,"
+   "VolFiles=$2,VolBlocks=$3,VolBytes=$4,VolABytes=$5,"
+   "VolHoleBytes=$6,VolHoles=$7,VolMounts=$8,VolErrors=$9,"
+   "VolWrites=$10,MaxVolBytes=$11,VolStatus=$12,"
+   "Slot=$13,InChanger=$14,VolReadTime=$15,VolWriteTime=$16,VolType=$17,"
+   "VolParts=$18,VolCloudParts=$19,LastPartBytes=$20,"
+   "LabelType=$21,StorageId=$22,PoolId=$23,VolRetention=$24,VolUseDuration=$25,"
+   "MaxVolJobs=$26,MaxVolFiles=$27,Enabled=$28,LocationId=$29,"
+   "ScratchPoolId=$30,RecyclePoolId=$31,RecycleCount=$32,Recycle=$33,"
+   "ActionOnPurge=$34,CacheRetention=$35,EndBlock=$36"
+   " WHERE VolumeName=$37",
+
+   /* SQL_PREP_INSERT_FILE */
+   "INSERT INTO File (FileIndex,JobId,PathId,Filename,"
+   "LStat,MD5,DeltaSeq) VALUES ($1,$2,$3,$4,$5,$6,$7)"
+};
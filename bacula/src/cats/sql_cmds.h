@@ -51,6 +51,9 @@ extern const char CATS_IMP_EXP *fill_jobhisto;
 extern const char CATS_IMP_EXP *get_restore_objects;
 extern const char CATS_IMP_EXP *insert_counter_values[];
 extern const char CATS_IMP_EXP *list_pool;
+extern const char CATS_IMP_EXP *create_temp_bvfs_path[];
+extern const char CATS_IMP_EXP *bvfs_lock_path_hierarchy_query[];
+extern const char CATS_IMP_EXP *bvfs_fill_path_query[];
 extern const char CATS_IMP_EXP *match_query[];
 extern const char CATS_IMP_EXP *select_counter_values[];
 extern const char CATS_IMP_EXP *select_recent_version[];
@@ -93,6 +96,10 @@ extern const char CATS_IMP_EXP *expires_in[];
 extern const char CATS_IMP_EXP *prune_cache[];
 extern const char CATS_IMP_EXP *strip_restore[];
 extern const char CATS_IMP_EXP *poolbytes[];
+extern const char CATS_IMP_EXP *check_file_partitioning;
+extern const char CATS_IMP_EXP *create_file_partition;
+extern const char CATS_IMP_EXP *batch_file_partitions;
+extern const char CATS_IMP_EXP *purge_file_partitions;
 extern const char CATS_IMP_EXP *count_all_jobs;
 extern const char CATS_IMP_EXP *count_success_jobs;
 extern const char CATS_IMP_EXP *count_success_jobids;
@@ -113,3 +120,4 @@ extern const char CATS_IMP_EXP *sum_volumes_bytes;
 extern const char CATS_IMP_EXP *get_volume_size;
 extern const char CATS_IMP_EXP *escape_char_value[];
 extern const char CATS_IMP_EXP *regexp_value[];
+extern const char CATS_IMP_EXP *prepared_queries[];
@@ -91,6 +91,18 @@ bool BDB::bdb_create_job_record(JCR *jcr, JOB_DBR *jr)
    } else {
       ok = true;
    }
+
+   /* FileMedia records can come before the batch insert, so the partitions
+    * for this Job must exist from now
+    */
+   if (ok && m_file_partitioned) {
+      Mmsg(cmd, create_file_partition, edit_int64(jr->JobId, ed1));
+      if (!bdb_sql_query(cmd, NULL, NULL)) {
+         Mmsg2(&errmsg, _("Create File partition for JobId=%s failed. ERR=%s\n"),
+               ed1, sql_strerror());
+         ok = false;
+      }
+   }
    bdb_unlock();
    return ok;
 }
@@ -101,50 +113,76 @@ bool BDB::bdb_create_job_record(JCR *jcr, JOB_DBR *jr)
  *          true  on success
  */
 bool BDB::bdb_create_jobmedia_record(JCR *jcr, JOBMEDIA_DBR *jm)
+{
+   return bdb_create_jobmedia_records(jcr, jm, 1);
+}
+
+/** Create a batch of JobMedia records of the same job sent at once by
+ *  the Storage daemon. The VolIndex is computed once for the batch and
+ *  the Media EndFile/EndBlock is updated once for each run of records
+ *  on the same Media, the last record of the run gives the final value.
+ *  Returns: false on failure
+ *          true  on success
+ */
+bool BDB::bdb_create_jobmedia_records(JCR *jcr, JOBMEDIA_DBR *jm, int nb)
 {
    bool ok = true;
-   int count;
-   char ed1[50], ed2[50];
+   int count = 0;
+   int i;
+   SQL_ROW row;
+   SQL_PARAMS max;
 
+   if (nb <= 0) {
+      return true;
+   }
    bdb_lock();
 
    /* Now get count for VolIndex */
-   Mmsg(cmd, "SELECT MAX(VolIndex) from JobMedia WHERE JobId=%s",
-        edit_int64(jm->JobId, ed1));
-   count = get_sql_record_max(jcr, this);
-
+   max.add_uint(jm[0].JobId);
+   if (QueryDB(jcr, SQL_PREP_JOBMEDIA_MAX_INDEX, max)) {
+      if ((row = sql_fetch_row()) != NULL) {
+         count = str_to_int64(row[0]);
+      }
+      sql_free_result();
+   }
    if (count < 0) {
       count = 0;
    }
-   count++;
-
-   Mmsg(cmd,
-        "INSERT INTO JobMedia (JobId,MediaId,FirstIndex,LastIndex,"
-        "StartFile,EndFile,StartBlock,EndBlock,VolIndex) "
-        "VALUES (%s,%s,%u,%u,%u,%u,%u,%u,%u)",
-        edit_int64(jm->JobId, ed1),
-        edit_int64(jm->MediaId, ed2),
-        jm->FirstIndex, jm->LastIndex,
-        jm->StartFile, jm->EndFile, jm->StartBlock, jm->EndBlock,count);
 
-   Dmsg0(300, cmd);
-   if (!InsertDB(jcr, cmd)) {
-      Mmsg2(&errmsg, _("Create JobMedia record %s failed: ERR=%s\n"), cmd,
-         sql_strerror());
-      ok = false;
-   } else {
+   for (i = 0; ok && i < nb; i++) {
+      SQL_PARAMS ins, upd;
+      count++;
+      ins.add_uint(jm[i].JobId);
+      ins.add_uint(jm[i].MediaId);
+      ins.add_uint(jm[i].FirstIndex);
+      ins.add_uint(jm[i].LastIndex);
+      ins.add_uint(jm[i].StartFile);
+      ins.add_uint(jm[i].EndFile);
+      ins.add_uint(jm[i].StartBlock);
+      ins.add_uint(jm[i].EndBlock);
+      ins.add_int(count);
+
+      if (!InsertDB(jcr, SQL_PREP_INSERT_JOBMEDIA, ins)) {
+         Mmsg2(&errmsg, _("Create JobMedia record %s failed: ERR=%s\n"), cmd,
+            sql_strerror());
+         ok = false;
+         break;
+      }
+      if (i + 1 < nb && jm[i + 1].MediaId == jm[i].MediaId) {
+         continue;               /* updated with the last record of the run */
+      }
       /* Worked, now update the Media record with the EndFile and EndBlock */
-      Mmsg(cmd,
-           "UPDATE Media SET EndFile=%lu, EndBlock=%lu WHERE MediaId=%lu",
-           jm->EndFile, jm->EndBlock, jm->MediaId);
-      if (!UpdateDB(jcr, cmd, false)) {
+      upd.add_uint(jm[i].EndFile);
+      upd.add_uint(jm[i].EndBlock);
+      upd.add_uint(jm[i].MediaId);
+      if (!UpdateDB(jcr, SQL_PREP_UPDATE_MEDIA_END, upd, false)) {
          Mmsg2(&errmsg, _("Update Media record %s failed: ERR=%s\n"), cmd,
               sql_strerror());
          ok = false;
       }
    }
    bdb_unlock();
-   Dmsg0(300, "Return from JobMedia\n");
+   Dmsg1(300, "Return from JobMedia nb=%d\n", nb);
    return ok;
 }
 
@@ -829,13 +867,17 @@ void bdb_disable_batch_insert(bool enabled)
  */
 
 /*
+ *  When running is set, the Job is still running (the attributes are
+ *   despooled while the data is written), the JobStatus is not changed.
+ *
  *  Returns true if OK
  *          false if failed
  */
-bool bdb_write_batch_file_records(JCR *jcr)
+bool bdb_write_batch_file_records(JCR *jcr, bool running)
 {
    bool retval = false; 
    int JobStatus = jcr->JobStatus;
+   POOL_MEM query, table;
 
    if (!jcr->batch_started) {         /* no files to backup ? */
       Dmsg0(50,"db_write_batch_file_records: no files\n");
@@ -846,7 +888,9 @@ bool bdb_write_batch_file_records(JCR *jcr)
       goto bail_out; 
    }
 
-   jcr->JobStatus = JS_AttrInserting;
+   if (!running) {
+      jcr->JobStatus = JS_AttrInserting;
+   }
 
    /* Check if batch mode is on hold */
    while (!batch_mode_enabled) {
@@ -859,6 +903,7 @@ bool bdb_write_batch_file_records(JCR *jcr)
    }
 
    Dmsg1(50,"db_write_batch_file_records changes=%u\n",jcr->db_batch->changes);
+   pm_strcpy(table, "File");
 
    if (!jcr->db_batch->sql_batch_end(jcr, NULL)) {
       Jmsg1(jcr, M_FATAL, 0, "Batch end %s\n", jcr->db_batch->errmsg);
@@ -885,17 +930,37 @@ bool bdb_write_batch_file_records(JCR *jcr)
       goto bail_out; 
    }
 
-   if (!jcr->db_batch->bdb_sql_query(
-"INSERT INTO File (FileIndex, JobId, PathId, Filename, LStat, MD5, DeltaSeq) "
+   /* With a partitioned File table, when the batch holds only one Job
+    * (not the case with bscan), the records go directly to its partition
+    */
+   if (jcr->db_batch->is_file_partitioned()) {
+      db_list_ctx parts;
+      if (!jcr->db_batch->bdb_sql_query(batch_file_partitions, db_list_handler, &parts)) {
+         Jmsg1(jcr, M_FATAL, 0, "Create File partition %s\n", jcr->db_batch->errmsg);
+         goto bail_out;
+      }
+      if (parts.count == 1) {
+         pm_strcpy(table, parts.list);
+      }
+   }
+
+   Mmsg(query,
+"INSERT INTO %s (FileIndex, JobId, PathId, Filename, LStat, MD5, DeltaSeq) "
     "SELECT batch.FileIndex, batch.JobId, Path.PathId, "
            "batch.Name, batch.LStat, batch.MD5, batch.DeltaSeq "
-      "FROM batch JOIN Path ON (batch.Path = Path.Path) ", NULL, NULL))
-   {
+      "FROM batch JOIN Path ON (batch.Path = Path.Path) ", table.c_str());
+
+   if (!jcr->db_batch->bdb_sql_query(query.c_str(), NULL, NULL)) {
       Jmsg1(jcr, M_FATAL, 0, "Fill File table %s\n", jcr->db_batch->errmsg);
       goto bail_out; 
    }
 
-   jcr->JobStatus = JobStatus;    /* reset entry status */
+   /* Not fatal, the bvfs cache can be computed later */
+   bvfs_path_hierarchy_flush(jcr, jcr->db_batch);
+
+   if (!running) {
+      jcr->JobStatus = JobStatus;    /* reset entry status */
+   }
    retval = true; 
  
 bail_out: 
@@ -924,7 +989,7 @@ bool BDB::bdb_create_batch_file_attributes_record(JCR *jcr, ATTR_DBR *ar)
    Dmsg0(dbglevel, "put_file_into_catalog\n");
 
    if (jcr->batch_started && jcr->db_batch->changes > 500000) {
-      bdb_write_batch_file_records(jcr);
+      bdb_write_batch_file_records(jcr, true);
       jcr->db_batch->changes = 0;
    }
 
@@ -943,6 +1008,7 @@ bool BDB::bdb_create_batch_file_attributes_record(JCR *jcr, ATTR_DBR *ar)
    }
 
    split_path_and_file(jcr, jcr->db_batch, ar->fname);
+   bvfs_path_hierarchy_add(jcr, ar, jcr->db_batch->path);
 
    return jcr->db_batch->sql_batch_insert(jcr, ar);
 }
@@ -968,9 +1034,8 @@ bool BDB::bdb_create_file_attributes_record(JCR *jcr, ATTR_DBR *ar)
    }
    Dmsg1(dbglevel, "db_create_path_record: %s\n", esc_name);
 
-   esc_name = check_pool_memory_size(esc_name, 2*fnl+2);
-   bdb_escape_string(jcr, esc_name, fname, fnl);
-   ar->Filename = esc_name;
+   /* The File record is inserted with a prepared statement, no escape */
+   ar->Filename = fname;
 
    /* Now create master File record */
    if (!bdb_create_file_record(jcr, ar)) {
@@ -995,6 +1060,7 @@ int BDB::bdb_create_file_record(JCR *jcr, ATTR_DBR *ar)
    int stat;
    static const char *no_digest = "0";
    const char *digest;
+   SQL_PARAMS params;
 
    ASSERT(ar->JobId);
    ASSERT(ar->PathId);
@@ -1007,13 +1073,17 @@ int BDB::bdb_create_file_record(JCR *jcr, ATTR_DBR *ar)
    }
 
    /* Must create it */
-   Mmsg(cmd,
-        "INSERT INTO File (FileIndex,JobId,PathId,Filename,"
-        "LStat,MD5,DeltaSeq) VALUES (%d,%u,%u,'%s','%s','%s',%u)",
-        ar->FileIndex, ar->JobId, ar->PathId, ar->Filename,
-        ar->attr, digest, ar->DeltaSeq);
-
-   if ((ar->FileId = sql_insert_autokey_record(cmd, NT_("File"))) == 0) {
+   params.add_int(ar->FileIndex);
+   params.add_uint(ar->JobId);
+   params.add_uint(ar->PathId);
+   params.add_str(ar->Filename);
+   params.add_str(ar->attr);
+   params.add_str(digest);
+   params.add_uint(ar->DeltaSeq);
+
+   if ((ar->FileId = sql_insert_autokey_prepared(jcr, SQL_PREP_INSERT_FILE, params,
+                                                 NT_("File"))) == 0) {
+      bdb_expand_prepared(jcr, SQL_PREP_INSERT_FILE, params);
       Mmsg2(&errmsg, _("Create db File record %s failed. ERR=%s"),
          cmd, sql_strerror());
       Jmsg(jcr, M_FATAL, 0, "%s", errmsg);
@@ -1340,10 +1340,9 @@ bool BDB::bdb_get_query_dbids(JCR *jcr, POOL_MEM &query, dbid_list &ids)
 bool BDB::bdb_get_media_record(JCR *jcr, MEDIA_DBR *mr)
 {
    SQL_ROW row;
-   char ed1[50];
    bool ok = false;
-   char esc[MAX_ESCAPE_NAME_LENGTH];
-   POOL_MEM filter;
+   SQL_PREP_t stmt;
+   SQL_PARAMS params;
 
    bdb_lock();
    if (mr->MediaId == 0 && mr->VolumeName[0] == 0) {
@@ -1353,25 +1352,14 @@ bool BDB::bdb_get_media_record(JCR *jcr, MEDIA_DBR *mr)
       return true;
    }
    if (mr->MediaId != 0) {               /* find by id */
-      Mmsg(filter, "WHERE MediaId=%s", edit_int64(mr->MediaId, ed1));
+      stmt = SQL_PREP_GET_MEDIA_BY_ID;
+      params.add_uint(mr->MediaId);
    } else {                           /* find by name */
-      bdb_escape_string(jcr, esc, mr->VolumeName, strlen(mr->VolumeName));
-      Mmsg(filter, "WHERE VolumeName='%s'", esc);
+      stmt = SQL_PREP_GET_MEDIA_BY_NAME;
+      params.add_str(mr->VolumeName);
    }
 
-   Mmsg(cmd, "SELECT MediaId,VolumeName,VolJobs,VolFiles,"
-      "VolBlocks,VolBytes,VolABytes,VolHoleBytes,VolHoles,VolMounts,"
-      "VolErrors,VolWrites,Media.MaxVolBytes,Media.VolCapacityBytes,"
-      "MediaType,VolStatus,Media.PoolId,Media.VolRetention,Media.VolUseDuration,Media.MaxVolJobs,"
-      "Media.MaxVolFiles,Media.Recycle,Slot,FirstWritten,LastWritten,InChanger,"
-      "EndFile,EndBlock,VolType,VolParts,VolCloudParts,LastPartBytes,"
-      "Media.LabelType,LabelDate,StorageId,"
-      "Media.Enabled,LocationId,RecycleCount,InitialWrite,"
-      "Media.ScratchPoolId,Media.RecyclePoolId,VolReadTime,VolWriteTime,Media.ActionOnPurge,"
-      "Media.CacheRetention,Pool.Name "
-      "FROM Media JOIN Pool USING (PoolId) %s", filter.c_str());
-
-   if (QueryDB(jcr, cmd)) {
+   if (QueryDB(jcr, stmt, params)) {
       char ed1[50];
       if (sql_num_rows() > 1) {
          Mmsg1(errmsg, _("More than one Volume!: %s\n"),
@@ -1476,10 +1464,15 @@ static void strip_md5(char *q)
  *    is ok
  * 3) Join the result to file table to get fileindex, jobid and lstat information
  *
+ * When PathIds is set, only the files of these directories and the
+ * directory entries of their subdirectories are returned. It is used
+ * to load the restore tree one directory at a time.
+ *
  * TODO: See if we can do the SORT only if needed (as an argument)
  */
 bool BDB::bdb_get_file_list(JCR *jcr, char *jobids, int opts,
-                      DB_RESULT_HANDLER *result_handler, void *ctx)
+                      DB_RESULT_HANDLER *result_handler, void *ctx,
+                      const char *PathIds)
 {
    const char *type;
 
@@ -1500,13 +1493,19 @@ bool BDB::bdb_get_file_list(JCR *jcr, char *jobids, int opts,
    }
    POOL_MEM buf(PM_MESSAGE);
    POOL_MEM buf2(PM_MESSAGE);
+   POOL_MEM filter;
+   if (PathIds && *PathIds) {
+      Mmsg(filter, "AND (File.PathId IN (%s) OR (File.Filename = '' AND "
+           "File.PathId IN (SELECT PathId FROM PathHierarchy WHERE PPathId IN (%s))))",
+           PathIds, PathIds);
+   }
    if (opts & DBL_USE_DELTA) {
       Mmsg(buf2, select_recent_version_with_basejob_and_delta[bdb_get_type_index()],
-           jobids, jobids, jobids, jobids);
+           jobids, filter.c_str(), jobids, filter.c_str(), jobids, jobids);
 
    } else {
       Mmsg(buf2, select_recent_version_with_basejob[bdb_get_type_index()],
-           jobids, jobids, jobids, jobids);
+           jobids, filter.c_str(), jobids, filter.c_str(), jobids, jobids);
    }
 
    /* bsr code is optimized for JobId sorted, with Delta, we need to get
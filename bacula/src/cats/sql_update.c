@@ -315,17 +315,12 @@ int BDB::bdb_update_media_record(JCR *jcr, MEDIA_DBR *mr)
    time_t ttime;
    struct tm tm;
    int stat;
-   char ed1[50], ed2[50],  ed3[50],  ed4[50];
-   char ed5[50], ed6[50],  ed7[50],  ed8[50];
-   char ed9[50], ed10[50], ed11[50], ed12[50];
-   char ed13[50], ed14[50], ed15[50], ed16[50];
    char esc_name[MAX_ESCAPE_NAME_LENGTH];
-   char esc_status[MAX_ESCAPE_NAME_LENGTH];
+   SQL_PARAMS params;
 
    Dmsg1(dbglevel1, "update_media: FirstWritten=%d\n", mr->FirstWritten);
    bdb_lock();
    bdb_escape_string(jcr, esc_name, mr->VolumeName, strlen(mr->VolumeName));
-   bdb_escape_string(jcr, esc_status, mr->VolStatus, strlen(mr->VolStatus));
 
    if (mr->set_first_written) {
       Dmsg1(dbglevel2, "Set FirstWritten Vol=%s\n", mr->VolumeName);
@@ -368,49 +363,47 @@ int BDB::bdb_update_media_record(JCR *jcr, MEDIA_DBR *mr)
       mr->VolWriteTime = 0;
    }
 
-   Mmsg(cmd, "UPDATE Media SET VolJobs=%u,"
-        "VolFiles=%u,VolBlocks=%u,VolBytes=%s,VolABytes=%s,"
-        "VolHoleBytes=%s,VolHoles=%u,VolMounts=%u,VolErrors=%u,"
-        "VolWrites=%s,MaxVolBytes=%s,VolStatus='%s',"
-        "Slot=%d,InChanger=%d,VolReadTime=%s,VolWriteTime=%s,VolType=%d,"
-        "VolParts=%d,VolCloudParts=%d,LastPartBytes=%s,"
-        "LabelType=%d,StorageId=%s,PoolId=%s,VolRetention=%s,VolUseDuration=%s,"
-        "MaxVolJobs=%d,MaxVolFiles=%d,Enabled=%d,LocationId=%s,"
-        "ScratchPoolId=%s,RecyclePoolId=%s,RecycleCount=%d,Recycle=%d,"
-        "ActionOnPurge=%d,CacheRetention=%s,EndBlock=%u"
-        " WHERE VolumeName='%s'",
-        mr->VolJobs, mr->VolFiles, mr->VolBlocks,
-        edit_uint64(mr->VolBytes, ed1),
-        edit_uint64(mr->VolABytes, ed2),
-        edit_uint64(mr->VolHoleBytes, ed3),
-        mr->VolHoles, mr->VolMounts, mr->VolErrors,
-        edit_uint64(mr->VolWrites, ed4),
-        edit_uint64(mr->MaxVolBytes, ed5),
-        esc_status, mr->Slot, mr->InChanger,
-        edit_int64(mr->VolReadTime, ed6),
-        edit_int64(mr->VolWriteTime, ed7),
-        mr->VolType,
-        mr->VolParts,
-        mr->VolCloudParts,
-        edit_uint64(mr->LastPartBytes, ed8),
-        mr->LabelType,
-        edit_int64(mr->StorageId, ed9),
-        edit_int64(mr->PoolId, ed10),
-        edit_uint64(mr->VolRetention, ed11),
-        edit_uint64(mr->VolUseDuration, ed12),
-        mr->MaxVolJobs, mr->MaxVolFiles,
-        mr->Enabled, edit_uint64(mr->LocationId, ed13),
-        edit_uint64(mr->ScratchPoolId, ed14),
-        edit_uint64(mr->RecyclePoolId, ed15),
-        mr->RecycleCount,mr->Recycle, mr->ActionOnPurge,
-        edit_uint64(mr->CacheRetention, ed16),
-        mr->EndBlock,
-        esc_name);
-
+   params.add_uint(mr->VolJobs);
+   params.add_uint(mr->VolFiles);
+   params.add_uint(mr->VolBlocks);
+   params.add_uint(mr->VolBytes);
+   params.add_uint(mr->VolABytes);
+   params.add_uint(mr->VolHoleBytes);
+   params.add_uint(mr->VolHoles);
+   params.add_uint(mr->VolMounts);
+   params.add_uint(mr->VolErrors);
+   params.add_uint(mr->VolWrites);
+   params.add_uint(mr->MaxVolBytes);
+   params.add_str(mr->VolStatus);
+   params.add_int(mr->Slot);
+   params.add_int(mr->InChanger);
+   params.add_int(mr->VolReadTime);
+   params.add_int(mr->VolWriteTime);
+   params.add_int(mr->VolType);
+   params.add_int(mr->VolParts);
+   params.add_int(mr->VolCloudParts);
+   params.add_uint(mr->LastPartBytes);
+   params.add_int(mr->LabelType);
+   params.add_int(mr->StorageId);
+   params.add_int(mr->PoolId);
+   params.add_uint(mr->VolRetention);
+   params.add_uint(mr->VolUseDuration);
+   params.add_int(mr->MaxVolJobs);
+   params.add_int(mr->MaxVolFiles);
+   params.add_int(mr->Enabled);
+   params.add_uint(mr->LocationId);
+   params.add_uint(mr->ScratchPoolId);
+   params.add_uint(mr->RecyclePoolId);
+   params.add_int(mr->RecycleCount);
+   params.add_int(mr->Recycle);
+   params.add_int(mr->ActionOnPurge);
+   params.add_uint(mr->CacheRetention);
+   params.add_uint(mr->EndBlock);
+   params.add_str(mr->VolumeName);
+
+   stat = UpdateDB(jcr, SQL_PREP_UPDATE_MEDIA, params, false);
    Dmsg1(dbglevel1, "%s\n", cmd);
 
-   stat = UpdateDB(jcr, cmd, false);
-
    /* Make sure InChanger is 0 for any record having the same Slot */
    db_make_inchanger_unique(jcr, this, mr);
 
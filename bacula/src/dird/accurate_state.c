@@ -0,0 +1,454 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+*/
+/*
+ *   Bacula Director -- Accurate state cache
+ *
+ *   The list of files sent to the File daemon for an Accurate
+ *   Incremental or Differential is the latest version of each file
+ *   of the previous Jobs. Computing it from the File table is the
+ *   most expensive query of the catalog, so the Director can keep
+ *   the result on disk for each Client and FileSet, and update it
+ *   at the end of each Job with the files of this Job only.
+ *
+ *   The file is in the WorkingDirectory, and is named
+ *     <director>.<ClientId>.<FileSetId>.accurate
+ *
+ *   It starts with a header line
+ *     BaculaAccurateState <version> <JobIds>\n
+ *   The JobIds are the list given by db_get_accurate_jobids(), the
+ *   file is used only if the list of the new Job is identical.
+ *   Each file is then written as a record
+ *     <length (32 bits, network order)>
+ *     Path+Filename\0FileIndex\0JobId\0LStat\0DeltaSeq\0MD5\0
+ */
+
+#include "bacula.h"
+#include "dird.h"
+
+static const int dbglvl = 100;
+
+static const char state_magic[] = "BaculaAccurateState";
+static const int state_version = 1;
+
+#define STATE_FIELDS 6
+
+/* A file of the Job being merged into the accurate state */
+struct state_item {
+   hlink link;
+   int32_t FileIndex;
+   uint32_t len;
+   char *rec;                         /* record, starts with the name */
+};
+
+/* Context used to write the files of a Job into a state file */
+struct state_ctx {
+   JCR *jcr;
+   FILE *fp;
+   htable *files;
+   POOLMEM *rec;
+   bool error;
+};
+
+static void make_state_name(JCR *jcr, POOLMEM *&fname)
+{
+   char ed1[50], ed2[50];
+   Mmsg(fname, "%s/%s.%s.%s.accurate", director->working_directory, my_name,
+        edit_uint64(jcr->jr.ClientId, ed1), edit_uint64(jcr->jr.FileSetId, ed2));
+}
+
+static bool use_accurate_state(JCR *jcr)
+{
+   return director->AccurateStateCache && jcr->accurate &&
+      !jcr->HasBase && !jcr->rerunning && jcr->getJobType() == JT_BACKUP &&
+      (jcr->is_JobLevel(L_FULL) || jcr->is_JobLevel(L_INCREMENTAL) ||
+       jcr->is_JobLevel(L_DIFFERENTIAL));
+}
+
+static void add_field(POOLMEM *&rec, uint32_t *len, const char *field)
+{
+   uint32_t flen = strlen(field) + 1;
+   rec = check_pool_memory_size(rec, *len + flen);
+   memcpy(rec + *len, field, flen);
+   *len += flen;
+}
+
+/*
+ * Serialize a row of the accurate query
+ *   row[0]=Path, row[1]=Filename, row[2]=FileIndex
+ *   row[3]=JobId row[4]=LStat row[5]=DeltaSeq row[6]=MD5
+ */
+static uint32_t make_record(POOLMEM *&rec, int num_fields, char **row)
+{
+   uint32_t len;
+
+   Mmsg(rec, "%s%s", row[0], row[1]);
+   len = strlen(rec) + 1;
+   add_field(rec, &len, row[2]);
+   add_field(rec, &len, row[3]);
+   add_field(rec, &len, row[4]);
+   add_field(rec, &len, row[5]);
+   add_field(rec, &len, num_fields > 6 ? row[6] : "0");
+   return len;
+}
+
+static bool write_record(FILE *fp, const char *rec, uint32_t len)
+{
+   uint32_t nlen = htonl(len);
+   return fwrite(&nlen, sizeof(nlen), 1, fp) == 1 &&
+          fwrite(rec, len, 1, fp) == 1;
+}
+
+/*
+ * Read the next record, returns 1 when a record is read, 0 at the
+ *  end of the file and -1 on error.
+ */
+static int read_record(FILE *fp, POOLMEM *&rec, uint32_t *len)
+{
+   uint32_t nlen;
+
+   if (fread(&nlen, sizeof(nlen), 1, fp) != 1) {
+      return feof(fp) ? 0 : -1;
+   }
+   *len = ntohl(nlen);
+   rec = check_pool_memory_size(rec, *len + 1);
+   if (*len == 0 || fread(rec, *len, 1, fp) != 1) {
+      return -1;
+   }
+   rec[*len] = 0;
+   return 1;
+}
+
+/* Cut a record into its fields, returns false if it is truncated */
+static bool split_record(char *rec, uint32_t len, char **fields)
+{
+   char *p = rec;
+   for (int i=0; i < STATE_FIELDS; i++) {
+      if (p >= rec + len) {
+         return false;
+      }
+      fields[i] = p;
+      p += strlen(p) + 1;
+   }
+   return true;
+}
+
+/*
+ * Read the header of a state file, and check that it contains
+ *  the state of the given JobIds.
+ */
+static bool check_header(FILE *fp, const char *jobids)
+{
+   POOL_MEM line, expected;
+   int len;
+
+   if (!bfgets(line.addr(), fp)) {
+      return false;
+   }
+   Mmsg(expected, "%s %d %s\n", state_magic, state_version, jobids);
+   len = strlen(expected.c_str());
+   return strncmp(line.c_str(), expected.c_str(), len) == 0 && line.c_str()[len] == 0;
+}
+
+static bool write_header(FILE *fp, const char *jobids)
+{
+   return fprintf(fp, "%s %d %s\n", state_magic, state_version, jobids) > 0;
+}
+
+/*
+ * Prepare the accurate state of an Incremental or Differential Job.
+ *  Returns true if the state of the JobIds is in the cache. Then the
+ *  list can be sent with send_accurate_state(). Otherwise, the list
+ *  must be sent from the catalog with accurate_state_handler() that
+ *  keeps a copy of the state for the update at the end of the Job.
+ */
+bool open_accurate_state(JCR *jcr, char *jobids)
+{
+   POOL_MEM fname, query;
+   db_int64_ctx nb;
+   FILE *fp;
+
+   if (!use_accurate_state(jcr) || jcr->is_JobLevel(L_FULL)) {
+      return false;
+   }
+   free_accurate_state(jcr);
+   jcr->accurate_jobids = get_pool_memory(PM_FNAME);
+   pm_strcpy(jcr->accurate_jobids, jobids);
+
+   /* The catalog has no longer all the files of these Jobs */
+   Mmsg(query, "SELECT COUNT(1) FROM Job WHERE JobId IN (%s) AND PurgedFiles <> 0",
+        jobids);
+   if (!db_sql_query(jcr->db, query.c_str(), db_int64_handler, &nb)) {
+      nb.value = 1;
+   }
+
+   make_state_name(jcr, fname.addr());
+   if (nb.value == 0 && (fp = bfopen(fname.c_str(), "rb")) != NULL) {
+      if (check_header(fp, jobids)) {
+         Dmsg2(dbglvl, "Using accurate state %s for JobIds %s\n", fname.c_str(), jobids);
+         jcr->accurate_base = fp;
+         return true;
+      }
+      fclose(fp);
+   }
+
+   /* Keep a copy of the state sent from the catalog */
+   Mmsg(fname, "%s/%s.%s.accurate.tmp", director->working_directory, my_name, jcr->Job);
+   if ((fp = bfopen(fname.c_str(), "w+b")) == NULL) {
+      berrno be;
+      Jmsg(jcr, M_WARNING, 0, _("Could not create accurate state file %s. ERR=%s\n"),
+           fname.c_str(), be.bstrerror());
+      return false;
+   }
+   unlink(fname.c_str());        /* the file is removed when closed */
+   if (!write_header(fp, jobids)) {
+      fclose(fp);
+      return false;
+   }
+   jcr->accurate_base = fp;
+   return false;
+}
+
+/*
+ * Send to the File daemon the list of files of the accurate state
+ */
+bool send_accurate_state(JCR *jcr)
+{
+   POOLMEM *rec = get_pool_memory(PM_MESSAGE);
+   char *fields[STATE_FIELDS];
+   char *row[7];
+   char empty[1] = "";
+   uint32_t len;
+   int stat;
+   int64_t count = 0;
+
+   Jmsg(jcr, M_INFO, 0, _("Using the accurate state of JobIds %s from the cache.\n"),
+        jcr->accurate_jobids);
+
+   while ((stat = read_record(jcr->accurate_base, rec, &len)) > 0) {
+      if (!split_record(rec, len, fields)) {
+         stat = -1;
+         break;
+      }
+      row[0] = fields[0];
+      row[1] = empty;
+      row[2] = fields[1];           /* FileIndex */
+      row[3] = fields[2];           /* JobId */
+      row[4] = fields[3];           /* LStat */
+      row[5] = fields[4];           /* DeltaSeq */
+      row[6] = fields[5];           /* MD5 */
+      if (accurate_list_handler(jcr, 7, row) != 0) {
+         break;                     /* Job canceled */
+      }
+      count++;
+   }
+   free_pool_memory(rec);
+   if (stat < 0) {
+      Jmsg(jcr, M_FATAL, 0, _("Error reading the accurate state of JobIds %s\n"),
+           jcr->accurate_jobids);
+      return false;
+   }
+   Dmsg1(dbglvl, "Sent %lld files from the accurate state\n", count);
+   return true;
+}
+
+/*
+ * Send the files of the catalog to the File daemon, and keep
+ *  a copy into the accurate state of the Job.
+ */
+int accurate_state_handler(void *ctx, int num_fields, char **row)
+{
+   JCR *jcr = (JCR *)ctx;
+
+   if (jcr->accurate_base) {
+      POOL_MEM rec(PM_MESSAGE);
+      uint32_t len = make_record(rec.addr(), num_fields, row);
+      if (!write_record(jcr->accurate_base, rec.c_str(), len)) {
+         berrno be;
+         Jmsg(jcr, M_WARNING, 0, _("Error writing the accurate state. ERR=%s\n"),
+              be.bstrerror());
+         fclose(jcr->accurate_base);
+         jcr->accurate_base = NULL;
+      }
+   }
+   return accurate_list_handler(ctx, num_fields, row);
+}
+
+/*
+ * Called for each file of the Job. With a Full, the file goes directly
+ *  into the new state, otherwise it is kept to be merged with the
+ *  previous state.
+ */
+static int job_files_handler(void *ctx, int num_fields, char **row)
+{
+   state_ctx *sctx = (state_ctx *)ctx;
+   state_item *item;
+   int32_t FileIndex = str_to_int64(row[2]);
+   uint32_t len;
+
+   if (sctx->error) {
+      return 1;
+   }
+   len = make_record(sctx->rec, num_fields, row);
+   if (!sctx->files) {
+      if (FileIndex > 0 && !write_record(sctx->fp, sctx->rec, len)) {
+         sctx->error = true;
+      }
+      return 0;
+   }
+   item = (state_item *)sctx->files->lookup(sctx->rec);
+   if (!item) {
+      item = (state_item *)sctx->files->hash_malloc(sizeof(state_item));
+      item->rec = sctx->files->hash_malloc(len);
+      memcpy(item->rec, sctx->rec, len);
+      sctx->files->insert(item->rec, item);
+   } else {
+      /* The same file is twice in the Job, keep the last one */
+      item->rec = sctx->files->hash_malloc(len);
+      memcpy(item->rec, sctx->rec, len);
+   }
+   item->FileIndex = FileIndex;
+   item->len = len;
+   return 0;
+}
+
+/*
+ * At the end of a successful Job, compute the new accurate state from
+ *  the previous one and the files of this Job. The deleted files of an
+ *  Accurate Job have a negative FileIndex and are removed.
+ */
+void update_accurate_state(JCR *jcr)
+{
+   POOL_MEM fname, tmpname, query, jobids;
+   state_ctx sctx;
+   state_item *item = NULL;
+   char *fields[STATE_FIELDS];
+   char ed1[50];
+   uint32_t len;
+   int stat;
+
+   if (!use_accurate_state(jcr)) {
+      return;
+   }
+   if (!jcr->is_JobLevel(L_FULL) && !jcr->accurate_base) {
+      return;                   /* No state to start from */
+   }
+   edit_uint64(jcr->JobId, ed1);
+   if (jcr->is_JobLevel(L_FULL)) {
+      pm_strcpy(jobids, ed1);
+   } else {
+      Mmsg(jobids, "%s,%s", jcr->accurate_jobids, ed1);
+   }
+
+   memset(&sctx, 0, sizeof(sctx));
+   sctx.jcr = jcr;
+   sctx.rec = get_pool_memory(PM_MESSAGE);
+   make_state_name(jcr, fname.addr());
+   Mmsg(tmpname, "%s.%s.tmp", fname.c_str(), ed1);
+   if ((sctx.fp = bfopen(tmpname.c_str(), "wb")) == NULL) {
+      berrno be;
+      Jmsg(jcr, M_WARNING, 0, _("Could not create accurate state file %s. ERR=%s\n"),
+           tmpname.c_str(), be.bstrerror());
+      goto bail_out;
+   }
+   if (!write_header(sctx.fp, jobids.c_str())) {
+      sctx.error = true;
+      goto bail_out;
+   }
+   if (!jcr->is_JobLevel(L_FULL)) {
+      sctx.files = New(htable(item, &item->link));
+   }
+
+   Mmsg(query,
+"SELECT Path.Path, File.Filename, File.FileIndex, File.JobId, File.LStat, "
+       "File.DeltaSeq, File.MD5 "
+  "FROM File JOIN Path USING (PathId) WHERE File.JobId = %s", ed1);
+   if (!db_big_sql_query(jcr->db, query.c_str(), job_files_handler, &sctx)) {
+      Jmsg(jcr, M_WARNING, 0, _("Could not get the files of the Job for the accurate state. ERR=%s\n"),
+           db_strerror(jcr->db));
+      sctx.error = true;
+   }
+   if (sctx.error || !sctx.files) {
+      goto bail_out;
+   }
+
+   /* Copy the previous state, except the files of this Job */
+   fseeko(jcr->accurate_base, 0, SEEK_SET);
+   if (!check_header(jcr->accurate_base, jcr->accurate_jobids)) {
+      sctx.error = true;
+      goto bail_out;
+   }
+   while ((stat = read_record(jcr->accurate_base, sctx.rec, &len)) > 0) {
+      if (!split_record(sctx.rec, len, fields)) {
+         stat = -1;
+         break;
+      }
+      if (sctx.files->lookup(fields[0])) {
+         continue;
+      }
+      if (!write_record(sctx.fp, sctx.rec, len)) {
+         stat = -1;
+         break;
+      }
+   }
+   if (stat < 0) {
+      sctx.error = true;
+      goto bail_out;
+   }
+   foreach_htable(item, sctx.files) {
+      if (item->FileIndex > 0 && !write_record(sctx.fp, item->rec, item->len)) {
+         sctx.error = true;
+         break;
+      }
+   }
+
+bail_out:
+   if (sctx.files) {
+      delete sctx.files;
+   }
+   free_pool_memory(sctx.rec);
+   if (sctx.fp) {
+      if (fclose(sctx.fp) != 0) {
+         sctx.error = true;
+      }
+      if (sctx.error) {
+         Jmsg(jcr, M_WARNING, 0, _("Could not update the accurate state file %s\n"),
+              fname.c_str());
+         unlink(tmpname.c_str());
+
+      } else if (rename(tmpname.c_str(), fname.c_str()) != 0) {
+         berrno be;
+         Jmsg(jcr, M_WARNING, 0, _("Could not rename %s to %s. ERR=%s\n"),
+              tmpname.c_str(), fname.c_str(), be.bstrerror());
+         unlink(tmpname.c_str());
+
+      } else {
+         Dmsg2(dbglvl, "Accurate state %s is now for JobIds %s\n",
+               fname.c_str(), jobids.c_str());
+      }
+   }
+}
+
+void free_accurate_state(JCR *jcr)
+{
+   if (jcr->accurate_base) {
+      fclose(jcr->accurate_base);
+      jcr->accurate_base = NULL;
+   }
+   free_and_null_pool_memory(jcr->accurate_jobids);
+}
@@ -42,8 +42,10 @@ extern DIRRES *director;
  *     102 04Jun15 - added jobmedia change
  *     103 14Feb17 - added comm line compression
  *   10002 04Jun15 - added jobmedia batching (from queue in SD)
+ *   10003 19Oct26 - added file attributes batching (FileAttrBatch from SD)
+ *   10004 19Oct26 - added attribute spool checkpoints (BlastAttr ... Size=)
  */
-#define DIR_VERSION 10002
+#define DIR_VERSION 10004
 
 
 /* Command sent to SD */
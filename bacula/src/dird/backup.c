@@ -160,7 +160,7 @@ static bool get_base_jobids(JCR *jcr, db_list_ctx *jobids)
  *      row[0]=Path, row[1]=Filename, row[2]=FileIndex
  *      row[3]=JobId row[4]=LStat row[5]=DeltaSeq row[6]=MD5
  */
-static int accurate_list_handler(void *ctx, int num_fields, char **row)
+int accurate_list_handler(void *ctx, int num_fields, char **row)
 {
    JCR *jcr = (JCR *)ctx;
 
@@ -332,11 +332,23 @@ bool send_accurate_current_files(JCR *jcr)
          return false;
       }
 
+   } else if (open_accurate_state(jcr, jobids.list)) {
+      /* The state of these jobs is in the cache */
+      if (!send_accurate_state(jcr)) {
+         return false;
+      }
+
    } else {
       int opts = jcr->use_accurate_chksum ? DBL_USE_MD5 : DBL_NONE;
+      DB_RESULT_HANDLER *handler = accurate_list_handler;
+      if (jcr->accurate_base) {
+         /* Keep a copy of the state, with the checksums */
+         opts = DBL_USE_MD5;
+         handler = accurate_state_handler;
+      }
       if (!db_get_file_list(jcr, jcr->db_batch,
                        jobids.list, opts,
-                       accurate_list_handler, (void *)jcr)) {
+                       handler, (void *)jcr)) {
          Jmsg1(jcr, M_FATAL, 0, "%s", db_strerror(jcr->db_batch));
          return false;
       }
@@ -749,6 +761,7 @@ bool do_backup(JCR *jcr)
    }
 
    if (!jcr->is_canceled() && stat == JS_Terminated) {
+      update_accurate_state(jcr);
       backup_cleanup(jcr, stat);
       return true;
    }
@@ -31,6 +31,10 @@
 #include "bacula.h"
 #include "dird.h"
 #include "findlib/find.h"
+#ifdef HAVE_DIRENT_H
+#include <dirent.h>
+#endif
+int breaddir(DIR *dirp, POOLMEM *&d_name);
 
 /*
  * Handle catalog request
@@ -136,6 +140,9 @@ void catalog_request(JCR *jcr, BSOCK *bs)
    int can_create=0;
    int Enabled, Recycle;
    JobId_t JobId = 0;
+   btime_t start;
+   JOBMEDIA_DBR *jms = NULL;          /* JobMedia batch */
+   int nb_jm = 0, max_jm = 0;
    STORE *wstore = jcr->store_mngr->get_wstore();
 
    bmemset(&sdmr, 0, sizeof(sdmr));
@@ -382,8 +389,7 @@ void catalog_request(JCR *jcr, BSOCK *bs)
          jm.JobId = jcr->JobId;
       }
       ok = true;
-      db_lock(jcr->db);
-      db_start_transaction(jcr, jcr->db);
+      /* Read the whole batch, then insert it at once */
       while (bs->recv() >= 0) {
          if (ok && sscanf(bs->msg, "%u %u %u %u %u %u %lld\n",
              &jm.FirstIndex, &jm.LastIndex, &jm.StartFile, &jm.EndFile,
@@ -397,18 +403,32 @@ void catalog_request(JCR *jcr, BSOCK *bs)
             jm.MediaId = MediaId;
             Dmsg6(400, "create_jobmedia JobId=%ld MediaId=%lu SF=%lu EF=%lu FI=%lu LI=%lu\n",
               jm.JobId, jm.MediaId, jm.StartFile, jm.EndFile, jm.FirstIndex, jm.LastIndex);
-            ok = db_create_jobmedia_record(jcr, jcr->db, &jm);
-            if (!ok) {
-               Jmsg(jcr, M_FATAL, 0, _("Catalog error creating JobMedia record. %s"),
-                  db_strerror(jcr->db));
+            if (nb_jm == max_jm) {
+               max_jm = max_jm ? max_jm * 2 : 64;
+               jms = (JOBMEDIA_DBR *)realloc(jms, max_jm * sizeof(JOBMEDIA_DBR));
             }
+            jms[nb_jm++] = jm;
             if (jm.FirstIndex == 0 && jm.LastIndex == 0) {
                jcr->dummy_jobmedia = true;
             }
          }
       }
-      db_end_transaction(jcr, jcr->db);
-      db_unlock(jcr->db);
+      if (ok && nb_jm > 0) {
+         db_lock(jcr->db);
+         db_start_transaction(jcr, jcr->db);
+         start = bhist_start();
+         ok = db_create_jobmedia_records(jcr, jcr->db, jms, nb_jm);
+         bhist_record(jcr, dirstatmetrics.hist_jobmedia, start);
+         if (!ok) {
+            Jmsg(jcr, M_FATAL, 0, _("Catalog error creating JobMedia record. %s"),
+               db_strerror(jcr->db));
+         }
+         db_end_transaction(jcr, jcr->db);
+         db_unlock(jcr->db);
+      }
+      if (jms) {
+         free(jms);
+      }
       if (!ok) {
          bs->fsend(_("1992 Create JobMedia error\n"));
          goto ok_out;
@@ -486,26 +506,38 @@ ok_out:
    return;
 }
 
+/*
+ * Fields of an attribute record from the Storage daemon. decode_attribute()
+ *  only reads the message, so the records of a spool file can be decoded
+ *  by several threads and stored in order by store_attribute().
+ */
+struct ATTR_REC {
+   int32_t FileIndex;
+   int32_t Stream;
+   uint32_t VolSessionId;
+   uint32_t VolSessionTime;
+   uint32_t reclen;
+   int32_t raw;                       /* offset of the raw record */
+   /* File attributes */
+   int32_t FileType;
+   int32_t fname;                     /* offset of the file name */
+   int32_t attr;                      /* offset of the encoded attributes */
+   int32_t DeltaSeq;
+   /* Digest */
+   int DigestType;
+   char digest[BASE64_SIZE(CRYPTO_DIGEST_MAX_SIZE)];
+};
+
 /*
  * Note, we receive the whole attribute record, but we select out only the stat
  * packet, VolSessionId, VolSessionTime, FileIndex, file type, and file name to
  * store in the catalog.
  */
-static void update_attribute(JCR *jcr, char *msg, int32_t msglen)
+static void decode_attribute(char *msg, int32_t msglen, ATTR_REC *rec)
 {
    unser_declare;
-   uint32_t VolSessionId, VolSessionTime;
-   int32_t Stream;
-   int32_t FileIndex;
-   char *p;
+   char *p, *fname, *attr;
    int len;
-   char *fname, *attr;
-   ATTR_DBR *ar = NULL;
-   uint32_t reclen;
-
-   /* Start transaction allocates jcr->attr and jcr->ar if needed */
-   db_start_transaction(jcr, jcr->db); /* start transaction if not already open */
-   ar = jcr->ar;
 
    /*
     * Start by scanning directly in the message buffer to get Stream
@@ -521,12 +553,13 @@ static void update_attribute(JCR *jcr, char *msg, int32_t msglen)
    p += 1;
    /* The following "SD header" fields are serialized */
    unser_begin(p, 0);
-   unser_uint32(VolSessionId);        /* VolSessionId */
-   unser_uint32(VolSessionTime);      /* VolSessionTime */
-   unser_int32(FileIndex);            /* FileIndex */
-   unser_int32(Stream);               /* Stream */
-   unser_uint32(reclen);              /* Record length */
+   unser_uint32(rec->VolSessionId);   /* VolSessionId */
+   unser_uint32(rec->VolSessionTime); /* VolSessionTime */
+   unser_int32(rec->FileIndex);       /* FileIndex */
+   unser_int32(rec->Stream);          /* Stream */
+   unser_uint32(rec->reclen);         /* Record length */
    p += unser_length(p);              /* Raw record follows */
+   rec->raw = p - msg;
 
    /**
     * At this point p points to the raw record, which varies according
@@ -569,45 +602,99 @@ static void update_attribute(JCR *jcr, char *msg, int32_t msglen)
     *   Object_size
     *
     */
+   if (rec->Stream == STREAM_UNIX_ATTRIBUTES ||
+       rec->Stream == STREAM_UNIX_ATTRIBUTES_EX ||
+       rec->Stream == STREAM_UNIX_ATTRIBUTE_UPDATE) {
+      skip_nonspaces(&p);         /* skip FileIndex */
+      skip_spaces(&p);
+      rec->FileType = str_to_int32(p);
+      skip_nonspaces(&p);         /* skip FileType */
+      skip_spaces(&p);
+      fname = p;
+      len = strlen(fname);        /* length before attributes */
+      attr = &fname[len+1];
+      rec->fname = fname - msg;
+      rec->attr = attr - msg;
+      rec->DeltaSeq = 0;
+      if (rec->FileType == FT_REG) {
+         p = attr + strlen(attr) + 1;  /* point to link */
+         p = p + strlen(p) + 1;        /* point to extended attributes */
+         p = p + strlen(p) + 1;        /* point to delta sequence */
+         /*
+          * Older FDs don't have a delta sequence, so check if it is there
+          */
+         if (p - msg < msglen) {
+            rec->DeltaSeq = str_to_int32(p); /* delta_seq */
+         }
+      }
+
+   } else if (crypto_digest_stream_type(rec->Stream) != CRYPTO_DIGEST_NONE) {
+      len = 0;
+      rec->DigestType = CRYPTO_DIGEST_NONE;
+      switch(rec->Stream) {
+      case STREAM_MD5_DIGEST:
+         len = CRYPTO_DIGEST_MD5_SIZE;
+         rec->DigestType = CRYPTO_DIGEST_MD5;
+         break;
+      case STREAM_SHA1_DIGEST:
+         len = CRYPTO_DIGEST_SHA1_SIZE;
+         rec->DigestType = CRYPTO_DIGEST_SHA1;
+         break;
+      case STREAM_SHA256_DIGEST:
+         len = CRYPTO_DIGEST_SHA256_SIZE;
+         rec->DigestType = CRYPTO_DIGEST_SHA256;
+         break;
+      case STREAM_SHA512_DIGEST:
+         len = CRYPTO_DIGEST_SHA512_SIZE;
+         rec->DigestType = CRYPTO_DIGEST_SHA512;
+         break;
+      default:
+         break;                   /* reported by store_attribute() */
+      }
+      if (len != 0) {
+         bin_to_base64(rec->digest, sizeof(rec->digest), p, len, true);
+      } else {
+         rec->digest[0] = 0;
+      }
+   }
+}
+
+static void store_attribute(JCR *jcr, char *msg, int32_t msglen, ATTR_REC *rec)
+{
+   int32_t Stream = rec->Stream;
+   int32_t FileIndex = rec->FileIndex;
+   char *p = msg + rec->raw;
+   char *fname, *attr;
+   ATTR_DBR *ar = NULL;
+   btime_t start;
+
+   /* Start transaction allocates jcr->attr and jcr->ar if needed */
+   db_start_transaction(jcr, jcr->db); /* start transaction if not already open */
+   ar = jcr->ar;
 
    Dmsg1(400, "UpdCat msg=%s\n", msg);
    Dmsg5(400, "UpdCat VolSessId=%d VolSessT=%d FI=%d Strm=%d reclen=%d\n",
-      VolSessionId, VolSessionTime, FileIndex, Stream, reclen);
+      rec->VolSessionId, rec->VolSessionTime, FileIndex, Stream, rec->reclen);
 
    if (Stream == STREAM_UNIX_ATTRIBUTES ||
        Stream == STREAM_UNIX_ATTRIBUTES_EX ||
        Stream == STREAM_UNIX_ATTRIBUTE_UPDATE) {
       if (jcr->cached_attribute) {
          Dmsg2(400, "Cached attr. Stream=%d fname=%s\n", ar->Stream, ar->fname);
+         start = bhist_start();
          if (!db_create_attributes_record(jcr, jcr->db, ar)) {
             Jmsg1(jcr, M_FATAL, 0, _("Attribute create error: ERR=%s"), db_strerror(jcr->db));
          }
+         bhist_record(jcr, dirstatmetrics.hist_catalog_insert, start);
          jcr->cached_attribute = false;
       }
       /* Any cached attr is flushed so we can reuse jcr->attr and jcr->ar */
       jcr->attr = check_pool_memory_size(jcr->attr, msglen);
       memcpy(jcr->attr, msg, msglen);
-      p = jcr->attr - msg + p;    /* point p into jcr->attr */
-      skip_nonspaces(&p);         /* skip FileIndex */
-      skip_spaces(&p);
-      ar->FileType = str_to_int32(p);
-      skip_nonspaces(&p);         /* skip FileType */
-      skip_spaces(&p);
-      fname = p;
-      len = strlen(fname);        /* length before attributes */
-      attr = &fname[len+1];
-      ar->DeltaSeq = 0;
-      if (ar->FileType == FT_REG) {
-         p = attr + strlen(attr) + 1;  /* point to link */
-         p = p + strlen(p) + 1;        /* point to extended attributes */
-         p = p + strlen(p) + 1;        /* point to delta sequence */
-         /*
-          * Older FDs don't have a delta sequence, so check if it is there
-          */
-         if (p - jcr->attr < msglen) {
-            ar->DeltaSeq = str_to_int32(p); /* delta_seq */
-         }
-      }
+      fname = jcr->attr + rec->fname; /* point into jcr->attr */
+      attr = jcr->attr + rec->attr;
+      ar->FileType = rec->FileType;
+      ar->DeltaSeq = rec->DeltaSeq;
 
       Dmsg2(400, "dird<stored: stream=%d %s\n", Stream, fname);
       Dmsg1(400, "dird<stored: attr=%s\n", attr);
@@ -681,41 +768,17 @@ static void update_attribute(JCR *jcr, char *msg, int32_t msglen)
       }
 
    } else if (crypto_digest_stream_type(Stream) != CRYPTO_DIGEST_NONE) {
-      fname = p;
-      char digestbuf[BASE64_SIZE(CRYPTO_DIGEST_MAX_SIZE)];
-      int len = 0;
-      int type = CRYPTO_DIGEST_NONE;
+      char *digestbuf = rec->digest;
+      int type = rec->DigestType;
       if (ar->FileIndex < 0) FileIndex = -FileIndex;
 
-      switch(Stream) {
-      case STREAM_MD5_DIGEST:
-         len = CRYPTO_DIGEST_MD5_SIZE;
-         type = CRYPTO_DIGEST_MD5;
-         break;
-      case STREAM_SHA1_DIGEST:
-         len = CRYPTO_DIGEST_SHA1_SIZE;
-         type = CRYPTO_DIGEST_SHA1;
-         break;
-      case STREAM_SHA256_DIGEST:
-         len = CRYPTO_DIGEST_SHA256_SIZE;
-         type = CRYPTO_DIGEST_SHA256;
-         break;
-      case STREAM_SHA512_DIGEST:
-         len = CRYPTO_DIGEST_SHA512_SIZE;
-         type = CRYPTO_DIGEST_SHA512;
-         break;
-      default:
+      if (type == CRYPTO_DIGEST_NONE) {
          /* Never reached ... */
          Jmsg(jcr, M_ERROR, 0, _("Catalog error updating file digest. Unsupported digest stream type: %d"),
               Stream);
-      }
-
-      if (len != 0) {
-         bin_to_base64(digestbuf, sizeof(digestbuf), fname, len, true);
+      } else {
          Dmsg3(400, "DigestLen=%d Digest=%s type=%d\n", strlen(digestbuf),
                digestbuf, Stream);
-      } else {
-         digestbuf[0] = 0;
       }
 
       if (ar->FileIndex != FileIndex) {
@@ -732,10 +795,12 @@ static void update_attribute(JCR *jcr, char *msg, int32_t msglen)
                   ar->Stream, ar->fname);
 
             /* Update BaseFile table */
+            start = bhist_start();
             if (!db_create_attributes_record(jcr, jcr->db, ar)) {
                Jmsg1(jcr, M_FATAL, 0, _("attribute create error. ERR=%s"),
                         db_strerror(jcr->db));
             }
+            bhist_record(jcr, dirstatmetrics.hist_catalog_insert, start);
             jcr->cached_attribute = false;
          } else {
             if (!db_add_digest_to_file_record(jcr, jcr->db, ar->FileId, digestbuf, type)) {
@@ -747,12 +812,77 @@ static void update_attribute(JCR *jcr, char *msg, int32_t msglen)
    }
 }
 
+static void update_attribute(JCR *jcr, char *msg, int32_t msglen)
+{
+   ATTR_REC rec;
+
+   decode_attribute(msg, msglen, &rec);
+   store_attribute(jcr, msg, msglen, &rec);
+}
+
+/*
+ * Update the File Attributes of a batch of files sent in a single
+ *  message by the Storage daemon:
+ *
+ *   UpdCat JobId=nnn FileAttrBatch <count> <records>
+ *
+ *  Each record is serialized as in the FileAttributes message, so it is
+ *  given to update_attribute() with a FileAttributes header.
+ */
+static void update_attribute_batch(JCR *jcr, char *msg, int32_t msglen)
+{
+   unser_declare;
+   uint32_t reclen;
+   int32_t count, len, hdrlen, i;
+   char *p, *end = msg + msglen;
+   POOLMEM *rec;
+
+   p = msg;
+   skip_nonspaces(&p);                /* UpdCat */
+   skip_spaces(&p);
+   skip_nonspaces(&p);                /* Job=nnn */
+   skip_spaces(&p);
+   skip_nonspaces(&p);                /* "FileAttrBatch" */
+   skip_spaces(&p);
+   count = str_to_int32(p);
+   skip_nonspaces(&p);                /* count */
+   p += 1;
+
+   rec = get_pool_memory(PM_MESSAGE);
+   Mmsg(rec, "UpdCat JobId=%ld FileAttributes ", jcr->JobId);
+   hdrlen = strlen(rec);
+   for (i = 0; i < count && !jcr->is_job_canceled(); i++) {
+      /* VolSessionId, VolSessionTime, FileIndex, Stream then the length */
+      if (p + 5 * sizeof(int32_t) > end) {
+         break;
+      }
+      unser_begin(p + 4 * sizeof(int32_t), 0);
+      unser_uint32(reclen);
+      len = 5 * sizeof(int32_t) + reclen;
+      if (p + len > end) {
+         break;
+      }
+      rec = check_pool_memory_size(rec, hdrlen + len + 1);
+      memcpy(rec + hdrlen, p, len);
+      rec[hdrlen + len] = 0;
+      update_attribute(jcr, rec, hdrlen + len);
+      p += len;
+   }
+   if (i < count && !jcr->is_job_canceled()) {
+      Jmsg(jcr, M_FATAL, 0, _("Malformed attributes batch from the Storage daemon. Got %d/%d records.\n"),
+           i, count);
+   }
+   free_pool_memory(rec);
+}
+
 /*
  * Update File Attributes in the catalog with data
  *  sent by the Storage daemon.
  */
 void catalog_update(JCR *jcr, BSOCK *bs)
 {
+   char *p;
+
    if (!jcr->pool->catalog_files) {
       return;                         /* user disabled cataloging */
    }
@@ -767,7 +897,17 @@ void catalog_update(JCR *jcr, BSOCK *bs)
       free_memory(omsg);
       goto bail_out;
    }
-   update_attribute(jcr, bs->msg, bs->msglen);
+   /* UpdCat JobId=nnn FileAttrBatch ... */
+   p = bs->msg;
+   skip_nonspaces(&p);
+   skip_spaces(&p);
+   skip_nonspaces(&p);
+   skip_spaces(&p);
+   if (strncmp(p, "FileAttrBatch ", 14) == 0) {
+      update_attribute_batch(jcr, bs->msg, bs->msglen);
+   } else {
+      update_attribute(jcr, bs->msg, bs->msglen);
+   }
 
 bail_out:
    if (jcr->is_job_canceled()) {
@@ -777,36 +917,175 @@ bail_out:
 }
 
 /*
- * Update File Attributes in the catalog with data read from
- * the storage daemon spool file. We receive the filename and
- * we try to read it.
+ * Despooling of the attribute spool file of the Storage daemon.
+ *
+ *  The records are read in chunks. With AttributeDespoolThreads above
+ *  one, the chunks are decoded by worker threads while the thread of
+ *  the caller stores the previous chunks in the catalog, in order.
  */
-bool despool_attributes_from_file(JCR *jcr, const char *file)
+#define DESPOOL_CHUNK_RECS 1000          /* records in a chunk */
+#define DESPOOL_CHUNK_SIZE (1024 * 1024) /* bytes in a chunk */
+
+struct DESPOOL_CHUNK {
+   dlink link;
+   POOLMEM *buf;                      /* messages, each one followed by a nul */
+   int32_t len;                       /* bytes used in buf */
+   int32_t count;                     /* records in the chunk */
+   int32_t msg[DESPOOL_CHUNK_RECS];   /* offset of each message in buf */
+   int32_t msglen[DESPOOL_CHUNK_RECS];
+   ATTR_REC rec[DESPOOL_CHUNK_RECS];
+   bool decoded;
+};
+
+struct DESPOOL_WORKERS {
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;               /* work queued or chunk decoded */
+   dlist *todo;                       /* chunks to decode */
+   pthread_t *tid;
+   int nthreads;
+   bool quit;
+};
+
+static void decode_chunk(DESPOOL_CHUNK *chunk)
 {
-   bool ret=false;
-   int32_t pktsiz;
-   size_t nbytes;
-   ssize_t size = 0;
-   int32_t msglen;                    /* message length */
-   POOLMEM *msg = get_pool_memory(PM_MESSAGE);
-   FILE *spool_fd=NULL;
+   for (int i = 0; i < chunk->count; i++) {
+      decode_attribute(chunk->buf + chunk->msg[i], chunk->msglen[i], &chunk->rec[i]);
+   }
+}
 
-   Dmsg1(100, "Begin despool_attributes_from_file\n", file);
+extern "C" void *despool_worker(void *arg)
+{
+   DESPOOL_WORKERS *w = (DESPOOL_WORKERS *)arg;
+   DESPOOL_CHUNK *chunk;
 
-   if (jcr->is_job_canceled() || !jcr->pool->catalog_files || !jcr->db) {
-      goto bail_out;                  /* user disabled cataloging */
+   P(w->mutex);
+   for ( ;; ) {
+      while (!w->quit && w->todo->empty()) {
+         pthread_cond_wait(&w->cond, &w->mutex);
+      }
+      if (w->quit) {
+         break;
+      }
+      chunk = (DESPOOL_CHUNK *)w->todo->first();
+      w->todo->remove(chunk);
+      V(w->mutex);
+      decode_chunk(chunk);
+      P(w->mutex);
+      chunk->decoded = true;
+      pthread_cond_broadcast(&w->cond);
    }
+   V(w->mutex);
+   return NULL;
+}
 
-   spool_fd = bfopen(file, "rb");
-   if (!spool_fd) {
-      Dmsg0(100, "cancel despool_attributes_from_file\n");
-      /* send an error message */
-      goto bail_out;
+/*
+ * Read the next records of the spool file, up to the offset end when it
+ *  is not zero. Returns false on error, the chunk is empty at the end.
+ */
+static bool read_chunk(JCR *jcr, FILE *fd, boffset_t *rpos, boffset_t end,
+                       DESPOOL_CHUNK *chunk)
+{
+   int32_t pktsiz, msglen;
+
+   chunk->len = chunk->count = 0;
+   chunk->decoded = false;
+   while (chunk->count < DESPOOL_CHUNK_RECS && chunk->len < DESPOOL_CHUNK_SIZE) {
+      if (end > 0 && *rpos + (boffset_t)sizeof(int32_t) > end) {
+         break;
+      }
+      if (fread((char *)&pktsiz, 1, sizeof(int32_t), fd) != sizeof(int32_t)) {
+         break;
+      }
+      msglen = ntohl(pktsiz);
+      if (msglen > 10000000) {
+         Qmsg1(jcr, M_FATAL, 0, _("fread attr spool error. Wanted %ld bytes, maximum permitted 10000000 bytes\n"), msglen);
+         return false;
+      }
+      if (msglen < 0) {
+         msglen = 0;
+      }
+      chunk->buf = check_pool_memory_size(chunk->buf, chunk->len + msglen + 1);
+      if (msglen > 0 && fread(chunk->buf + chunk->len, 1, msglen, fd) != (size_t)msglen) {
+         berrno be;
+         Qmsg1(jcr, M_FATAL, 0, _("fread attr spool error. ERR=%s\n"),
+               be.bstrerror());
+         return false;
+      }
+      chunk->buf[chunk->len + msglen] = '\0';
+      chunk->msg[chunk->count] = chunk->len;
+      chunk->msglen[chunk->count] = msglen;
+      chunk->count++;
+      chunk->len += msglen + 1;
+      *rpos += sizeof(int32_t) + msglen;
+   }
+   if (ferror(fd)) {
+      berrno be;
+      Qmsg1(jcr, M_FATAL, 0, _("fread attr spool error. ERR=%s\n"),
+            be.bstrerror());
+      return false;
+   }
+   return true;
+}
+
+static DESPOOL_CHUNK *new_despool_chunk()
+{
+   DESPOOL_CHUNK *chunk = (DESPOOL_CHUNK *)malloc(sizeof(DESPOOL_CHUNK));
+   bmemzero(chunk, sizeof(DESPOOL_CHUNK));
+   chunk->buf = get_pool_memory(PM_MESSAGE);
+   return chunk;
+}
+
+static void free_despool_chunk(DESPOOL_CHUNK *chunk)
+{
+   free_pool_memory(chunk->buf);
+   free(chunk);
+}
+
+/*
+ * Store the records of the spool file found between *pos and end (the end
+ *  of the file when end is zero) until a record of a file with a FileIndex
+ *  of index or more (no limit when index is zero). *pos is set to the
+ *  first record that was not stored.
+ */
+static bool despool_attribute_records(JCR *jcr, const char *file,
+                                      boffset_t *pos, boffset_t end, int32_t index)
+{
+   DESPOOL_WORKERS w;
+   DESPOOL_CHUNK *chunk = NULL, *next;
+   dlist inflight(chunk, &chunk->link);
+   boffset_t rpos = *pos;
+   int max_inflight;
+   bool ok = true, eof = false, stop = false;
+   FILE *fd;
+
+   fd = bfopen(file, "rb");
+   if (!fd) {
+      Dmsg1(100, "Cannot open attribute spool %s\n", file);
+      return false;
+   }
+   if (fseeko(fd, *pos, SEEK_SET) != 0) {
+      berrno be;
+      Qmsg1(jcr, M_FATAL, 0, _("fseek attr spool error. ERR=%s\n"), be.bstrerror());
+      fclose(fd);
+      return false;
    }
 #if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_WILLNEED)
-   posix_fadvise(fileno(spool_fd), 0, 0, POSIX_FADV_WILLNEED);
+   posix_fadvise(fileno(fd), *pos, 0, POSIX_FADV_WILLNEED);
 #endif
 
+   bmemzero(&w, sizeof(w));
+   w.nthreads = director->AttrDespoolThreads > 1 ? director->AttrDespoolThreads : 0;
+   max_inflight = w.nthreads > 0 ? 2 * w.nthreads : 1;
+   if (w.nthreads > 0) {
+      pthread_mutex_init(&w.mutex, NULL);
+      pthread_cond_init(&w.cond, NULL);
+      w.todo = New(dlist(chunk, &chunk->link));
+      w.tid = (pthread_t *)malloc(w.nthreads * sizeof(pthread_t));
+      for (int i = 0; i < w.nthreads; i++) {
+         pthread_create(&w.tid[i], NULL, despool_worker, &w);
+      }
+   }
+
    /*
     * We read the attributes file or stream from the SD.  It should
     * be in the following format:
@@ -814,56 +1093,432 @@ bool despool_attributes_from_file(JCR *jcr, const char *file)
     * 1. 4 bytes representing the record length
     * 2. An attribute  string starting with: UpdCat Job=nnn FileAttributes ...
     */
-   while (fread((char *)&pktsiz, 1, sizeof(int32_t), spool_fd) ==
-          sizeof(int32_t)) {
-      size += sizeof(int32_t);
-      msglen = ntohl(pktsiz);
-      if (msglen > 10000000) {
-         Qmsg1(jcr, M_FATAL, 0, _("fread attr spool error. Wanted %ld bytes, maximum permitted 10000000 bytes\n"), msglen);
-         goto bail_out;
-      }
-      if (msglen > 0) {
-         if (msglen >= (int32_t) sizeof_pool_memory(msg)) {
-            msg = realloc_pool_memory(msg, msglen + 1);
+   while (!stop) {
+      while (!eof && inflight.size() < max_inflight) {
+         chunk = new_despool_chunk();
+         if (!read_chunk(jcr, fd, &rpos, end, chunk)) {
+            ok = false;
+            stop = eof = true;
+            free_despool_chunk(chunk);
+            break;
          }
-         nbytes = fread(msg, 1, msglen, spool_fd);
-         if (nbytes != (size_t) msglen) {
-            berrno be;
-            Dmsg2(400, "nbytes=%d msglen=%d\n", nbytes, msglen);
-            Qmsg1(jcr, M_FATAL, 0, _("fread attr spool error. ERR=%s\n"),
-                  be.bstrerror());
-            goto bail_out;
+         if (chunk->count == 0) {
+            eof = true;
+            free_despool_chunk(chunk);
+            break;
          }
-         msg[msglen]='\0';      /* We have an extra byte free */
-         size += nbytes;
+         inflight.append(chunk);
+         if (w.nthreads > 0) {
+            P(w.mutex);
+            w.todo->append(chunk);
+            pthread_cond_signal(&w.cond);
+            V(w.mutex);
+         }
+      }
+      chunk = (DESPOOL_CHUNK *)inflight.first();
+      if (!chunk) {
+         break;
       }
-      if (!jcr->is_job_canceled()) {
-         update_attribute(jcr, msg, msglen);
+      if (w.nthreads > 0) {
+         P(w.mutex);
+         while (!chunk->decoded) {
+            pthread_cond_wait(&w.cond, &w.mutex);
+         }
+         V(w.mutex);
+      } else {
+         decode_chunk(chunk);
+      }
+      /* The despool thread shares jcr->ar and the batch with the message thread */
+      db_lock(jcr->db);
+      for (int i = 0; i < chunk->count; i++) {
+         if (index > 0 && chunk->rec[i].FileIndex >= index) {
+            stop = true;
+            break;
+         }
+         store_attribute(jcr, chunk->buf + chunk->msg[i], chunk->msglen[i], &chunk->rec[i]);
+         *pos += sizeof(int32_t) + chunk->msglen[i];
          if (jcr->is_job_canceled() || (jcr->wjcr && jcr->wjcr->is_job_canceled())) {
-            goto bail_out;
+            ok = false;
+            stop = true;
+            break;
+         }
+      }
+      db_unlock(jcr->db);
+      inflight.remove(chunk);
+      free_despool_chunk(chunk);
+   }
+
+   /* The chunks read ahead must be decoded before they are released */
+   for (chunk = (DESPOOL_CHUNK *)inflight.first(); chunk; chunk = next) {
+      next = (DESPOOL_CHUNK *)inflight.next(chunk);
+      if (w.nthreads > 0) {
+         P(w.mutex);
+         while (!chunk->decoded) {
+            pthread_cond_wait(&w.cond, &w.mutex);
          }
+         V(w.mutex);
+      }
+      inflight.remove(chunk);
+      free_despool_chunk(chunk);
+   }
+   if (w.nthreads > 0) {
+      P(w.mutex);
+      w.quit = true;
+      pthread_cond_broadcast(&w.cond);
+      V(w.mutex);
+      for (int i = 0; i < w.nthreads; i++) {
+         pthread_join(w.tid[i], NULL);
       }
+      free(w.tid);
+      delete w.todo;
+      pthread_cond_destroy(&w.cond);
+      pthread_mutex_destroy(&w.mutex);
    }
-   if (ferror(spool_fd)) {
+   fclose(fd);
+   return ok;
+}
+
+/*
+ * Attributes despooled while the Job is running. When the data of the
+ *  files before Index is on the Volume, the Storage daemon sends
+ *
+ *   BlastAttr JobId=nn File=<spool> Size=nn Index=nn
+ *
+ *  without waiting for an answer. A despool thread stores the records
+ *  up to Size and writes the batch to the File table, then saves its
+ *  position in a checkpoint file of the working directory. The final
+ *  BlastAttr continues from there. A Director restarted while a Job was
+ *  despooling finishes the work from the checkpoint, see
+ *  resume_attribute_despool().
+ *
+ *  The despool thread uses jcr->db, jcr->ar and the cached attribute of
+ *  the Job like the message thread, both do it under the db lock. When
+ *  the records cannot be stored, the answer to the final BlastAttr gives
+ *  the position of the first record that was not stored, the Storage
+ *  daemon sends the records from there over the network.
+ */
+struct ATTR_DESPOOL {
+   pthread_t tid;
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;
+   POOLMEM *file;                     /* spool file of the Storage daemon */
+   POOLMEM *checkpoint;               /* our checkpoint file */
+   boffset_t pos;                     /* records before pos are stored */
+   boffset_t size;                    /* records up to size ... */
+   int32_t index;                     /* ... and below this FileIndex are on the Volume */
+   boffset_t done_size;               /* last size and index handled by the thread */
+   int32_t done_index;
+   bool running;                      /* despool thread started */
+   bool busy;                         /* despool thread working */
+   bool quit;
+   bool error;                        /* the final BlastAttr will get an error */
+};
+
+/*
+ * Write the despooled records to the File table, the attributes of
+ *  the last file are complete.
+ */
+static bool commit_despooled_records(JCR *jcr)
+{
+   if (jcr->cached_attribute) {
+      if (!db_create_attributes_record(jcr, jcr->db, jcr->ar)) {
+         Jmsg1(jcr, M_FATAL, 0, _("Attribute create error. %s"), jcr->db->bdb_strerror());
+      }
+      jcr->cached_attribute = false;
+   }
+   return db_write_running_batch_file_records(jcr);
+}
+
+static const char Checkpoint[] = "Catalog=%127s JobId=%ld Job=%127s Pos=%lld Size=%lld Index=%ld File=";
+
+/* Called with ad->mutex held */
+static void write_despool_checkpoint(JCR *jcr, ATTR_DESPOOL *ad)
+{
+   POOL_MEM tmp(PM_FNAME);
+   char cat[MAX_NAME_LENGTH], job[MAX_NAME_LENGTH];
+   char ed1[50], ed2[50], ed3[50];
+   FILE *fp;
+
+   Mmsg(tmp, "%s.new", ad->checkpoint);
+   fp = bfopen(tmp.c_str(), "w");
+   if (!fp) {
       berrno be;
-      Qmsg1(jcr, M_FATAL, 0, _("fread attr spool error. ERR=%s\n"),
-            be.bstrerror());
-      Dmsg1(050, "fread attr spool error. ERR=%s\n", be.bstrerror());
-      goto bail_out;
+      Dmsg2(50, "Cannot create %s ERR=%s\n", tmp.c_str(), be.bstrerror());
+      return;
+   }
+   bstrncpy(cat, jcr->catalog->name(), sizeof(cat));
+   bash_spaces(cat);
+   bstrncpy(job, jcr->Job, sizeof(job));
+   bash_spaces(job);
+   fprintf(fp, "Catalog=%s JobId=%s Job=%s Pos=%s Size=%s Index=%d File=%s\n",
+           cat, edit_uint64(jcr->JobId, ed1), job,
+           edit_int64(ad->pos, ed2), edit_int64(ad->size, ed3), ad->index, ad->file);
+   if (fclose(fp) != 0 || rename(tmp.c_str(), ad->checkpoint) != 0) {
+      berrno be;
+      Dmsg2(50, "Cannot write %s ERR=%s\n", ad->checkpoint, be.bstrerror());
+      unlink(tmp.c_str());
    }
-   ret = true;
+}
 
-bail_out:
-   if (spool_fd) {
-      fclose(spool_fd);
+extern "C" void *attr_despool_thread(void *arg)
+{
+   JCR *jcr = (JCR *)arg;
+   ATTR_DESPOOL *ad = jcr->attr_despool;
+   boffset_t pos, size;
+   int32_t index;
+   bool ok;
+
+   P(ad->mutex);
+   while (!ad->quit) {
+      if (ad->error || (ad->size == ad->done_size && ad->index == ad->done_index)) {
+         pthread_cond_wait(&ad->cond, &ad->mutex);
+         continue;
+      }
+      pos = ad->pos;
+      size = ad->done_size = ad->size;
+      index = ad->done_index = ad->index;
+      ad->busy = true;
+      V(ad->mutex);
+
+      Dmsg3(100, "Despool attributes from %lld to %lld FI<%d\n", pos, size, index);
+      ok = despool_attribute_records(jcr, ad->file, &pos, size, index);
+      if (ok) {
+         db_lock(jcr->db);
+         ok = commit_despooled_records(jcr);
+         db_unlock(jcr->db);
+      }
+
+      P(ad->mutex);
+      ad->pos = pos;                  /* must not be sent again */
+      if (ok) {
+         write_despool_checkpoint(jcr, ad);
+      } else {
+         ad->error = true;
+      }
+      ad->busy = false;
+      pthread_cond_broadcast(&ad->cond);
+   }
+   V(ad->mutex);
+   return NULL;
+}
+
+/*
+ * Checkpoint sent by the Storage daemon while the Job is running. The
+ *  Storage daemon does not wait for an answer.
+ */
+void checkpoint_attributes_from_file(JCR *jcr, const char *file, boffset_t size,
+                                     int32_t index)
+{
+   ATTR_DESPOOL *ad = jcr->attr_despool;
+
+   if (jcr->is_job_canceled() || !jcr->pool->catalog_files || !jcr->db) {
+      return;
+   }
+   if (!ad) {
+      ad = (ATTR_DESPOOL *)malloc(sizeof(ATTR_DESPOOL));
+      bmemzero(ad, sizeof(ATTR_DESPOOL));
+      pthread_mutex_init(&ad->mutex, NULL);
+      pthread_cond_init(&ad->cond, NULL);
+      ad->file = get_pool_memory(PM_FNAME);
+      pm_strcpy(ad->file, file);
+      ad->checkpoint = get_pool_memory(PM_FNAME);
+      Mmsg(ad->checkpoint, "%s/%s.%s.despool", director->working_directory,
+           director->name(), jcr->Job);
+      jcr->attr_despool = ad;
+   }
+   P(ad->mutex);
+   if (strcmp(ad->file, file) != 0) {
+      Jmsg(jcr, M_ERROR, 0, _("Unexpected attribute spool file %s, expected %s\n"),
+           file, ad->file);
+      ad->error = true;
+   }
+   if (!ad->error) {
+      ad->size = size;
+      ad->index = index;
+      write_despool_checkpoint(jcr, ad);
+      if (!ad->running) {
+         ad->running = true;
+         pthread_create(&ad->tid, NULL, attr_despool_thread, (void *)jcr);
+      }
+      pthread_cond_broadcast(&ad->cond);
+   }
+   V(ad->mutex);
+}
+
+/*
+ * The catalog requests of the message thread use jcr->ar and the
+ *  batch of the Job like the despool thread, they are serialized
+ *  with the db lock while the thread exists.
+ */
+bool lock_attribute_despool(JCR *jcr)
+{
+   if (!jcr->attr_despool || !jcr->db) {
+      return false;
+   }
+   db_lock(jcr->db);
+   return true;
+}
+
+void unlock_attribute_despool(JCR *jcr, bool locked)
+{
+   if (locked) {
+      db_unlock(jcr->db);
+   }
+}
+
+/*
+ * Stop the despool thread of the Job, it must be done before the
+ *  batch of the Job is written at the end of the Job.
+ */
+void stop_attribute_despool(JCR *jcr)
+{
+   ATTR_DESPOOL *ad = jcr->attr_despool;
+
+   if (!ad) {
+      return;
    }
+   P(ad->mutex);
+   ad->quit = true;
+   pthread_cond_broadcast(&ad->cond);
+   V(ad->mutex);
+   if (ad->running) {
+      pthread_join(ad->tid, NULL);
+   }
+   unlink(ad->checkpoint);
+   free_pool_memory(ad->file);
+   free_pool_memory(ad->checkpoint);
+   pthread_cond_destroy(&ad->cond);
+   pthread_mutex_destroy(&ad->mutex);
+   free(ad);
+   jcr->attr_despool = NULL;
+}
+
+/*
+ * Update File Attributes in the catalog with data read from
+ * the storage daemon spool file. We receive the filename and
+ * we try to read it. The records already stored after the
+ * checkpoints of the Storage daemon are skipped. On error, *pos
+ * is the offset of the first record that was not stored.
+ */
+bool despool_attributes_from_file(JCR *jcr, const char *file, boffset_t *pos)
+{
+   ATTR_DESPOOL *ad = jcr->attr_despool;
+   bool ret=false;
+
+   *pos = 0;
 
+   Dmsg1(100, "Begin despool_attributes_from_file %s\n", file);
+
+   if (jcr->is_job_canceled() || !jcr->pool->catalog_files || !jcr->db) {
+      goto bail_out;                  /* user disabled cataloging */
+   }
+   if (ad) {
+      P(ad->mutex);
+      while (ad->busy) {
+         pthread_cond_wait(&ad->cond, &ad->mutex);
+      }
+      ad->quit = true;                /* nothing more to do for the thread */
+      pthread_cond_broadcast(&ad->cond);
+      *pos = ad->pos;
+      if (ad->error) {
+         V(ad->mutex);
+         goto bail_out;
+      }
+      V(ad->mutex);
+   }
+   ret = despool_attribute_records(jcr, file, pos, 0, 0);
+
+bail_out:
    if (jcr->is_job_canceled()) {
       jcr->cached_attribute = false;
       cancel_storage_daemon_job(jcr);
    }
 
-   free_pool_memory(msg);
    Dmsg1(100, "End despool_attributes_from_file ret=%i\n", ret);
    return ret;
 }
+
+/*
+ * Called at startup, the Director may have been stopped while it was
+ *  despooling the attributes of a Job. The Storage daemon keeps the
+ *  spool file when it loses the connection, the records that it declared
+ *  to be on the Volume are stored from the checkpoint. The Job is then
+ *  marked Incomplete so that it can be resumed. If the records cannot be
+ *  stored, the checkpoint is kept to try again at the next start.
+ */
+void resume_attribute_despool(BDB *db, CAT *catalog)
+{
+   POOL_MEM dname(PM_FNAME), path(PM_FNAME), line(PM_MESSAGE), query;
+   char cat[MAX_NAME_LENGTH], job[MAX_NAME_LENGTH], ed1[50];
+   int64_t pos, size;
+   int32_t index;
+   JobId_t JobId;
+   JCR *jcr;
+   FILE *fp;
+   DIR *dp;
+   char *p;
+   int len = strlen(director->name());
+   bool ok, keep;
+
+   /* Called before my_name_is() */
+   if (!(dp = opendir(director->working_directory))) {
+      return;
+   }
+   while (breaddir(dp, dname.addr()) == 0) {
+      if (strncmp(dname.c_str(), director->name(), len) != 0 || dname.c_str()[len] != '.' ||
+          !bstrcmp(dname.c_str() + MAX(0, (int)strlen(dname.c_str()) - 8), ".despool")) {
+         continue;
+      }
+      Mmsg(path, "%s/%s", director->working_directory, dname.c_str());
+      fp = bfopen(path.c_str(), "r");
+      if (!fp) {
+         continue;
+      }
+      ok = bfgets(line.addr(), fp) != NULL &&
+         sscanf(line.c_str(), Checkpoint, cat, &JobId, job, &pos, &size, &index) == 6;
+      fclose(fp);
+      if (!ok || (p = strstr(line.c_str(), " File=")) == NULL) {
+         Dmsg1(50, "Malformed checkpoint %s\n", path.c_str());
+         unlink(path.c_str());
+         continue;
+      }
+      unbash_spaces(cat);
+      unbash_spaces(job);
+      if (!bstrcmp(cat, catalog->name())) {
+         continue;                    /* done with the other catalog */
+      }
+      p += 6;
+      strip_trailing_newline(p);
+
+      jcr = new_control_jcr("*DespoolResume*", JT_SYSTEM);
+      jcr->JobId = JobId;
+      bstrncpy(jcr->Job, job, sizeof(jcr->Job));
+      jcr->db = db;
+      keep = false;
+      ok = true;                      /* pos == size, all records are stored */
+      if (pos < size) {
+         ok = despool_attribute_records(jcr, p, &pos, size, index) &&
+            commit_despooled_records(jcr);
+      }
+      if (ok) {
+         Mmsg(query, "UPDATE Job SET JobStatus='%c', "
+              "JobFiles=(SELECT COUNT(*) FROM File WHERE JobId=%s) "
+              "WHERE JobId=%s AND JobStatus='%c'", JS_Incomplete,
+              edit_uint64(JobId, ed1), ed1, JS_FatalError);
+         db_sql_query(db, query.c_str(), NULL, NULL);
+         Jmsg(NULL, M_INFO, 0, _("Attributes of JobId %s despooled from the last checkpoint, Job %s is now Incomplete.\n"),
+              ed1, job);
+         unlink(p);                   /* Kept by the Storage daemon for us */
+      } else {
+         Dmsg2(50, "Cannot resume the despooling of JobId=%d from %s\n", JobId, p);
+         /* Keep the checkpoint to retry at the next start if we can */
+         keep = access(p, R_OK) == 0;
+      }
+      jcr->db = NULL;                 /* not ours */
+      free_jcr(jcr);
+      if (!keep) {
+         unlink(path.c_str());
+      }
+   }
+   closedir(dp);
+}
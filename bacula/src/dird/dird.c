@@ -466,6 +466,7 @@ int main (int argc, char *argv[])
    init_jcr_subsystem();              /* start JCR watchdogs etc. */
 
    init_job_server(director->MaxConcurrentJobs);
+   db_pool_set_max(director->MaxCatalogConnections);
 
    dbg_jcr_add_hook(dir_debug_print); /* used to director variables */
    dbg_jcr_add_hook(bdb_debug_print);     /* used to debug B_DB connection after fatal signal */
@@ -787,6 +788,7 @@ void reload_config(int sig)
 
    FDConnectTimeout = director->FDConnectTimeout;
    SDConnectTimeout = director->SDConnectTimeout;
+   db_pool_set_max(director->MaxCatalogConnections);
    Dmsg0(10, "Director's configuration file reread.\n");
 
    /* populate statistics data */
@@ -838,6 +840,7 @@ void terminate_dird(int sig)
    }
    term_scheduler();
    term_job_server();
+   db_pool_term();
    if (runjob) {
       free(runjob);
    }
@@ -888,6 +891,7 @@ void terminate_dird(int sig)
       // statcollector->dump();
       delete(statcollector);
    }
+   bhist_term();
    SCHED_GLOBALS *schg;
    foreach_dlist(schg, &sched_globals) {
       free(schg->name);
@@ -1337,6 +1341,14 @@ static bool check_resources()
                OK = false;
             }
             break;
+         case COLLECTOR_BACKEND_Prometheus:
+            /* the listening port is required */
+            if (!collect->port){
+               Jmsg(NULL, M_FATAL, 0, _("Port parameter required in Collector Prometheus resource \"%s\".\n"),
+                     collect->hdr.name);
+               OK = false;
+            }
+            break;
       }
    }
 
@@ -1686,6 +1698,7 @@ static bool check_catalog(cat_op mode)
          db_sql_query(db, get_created_running_job, log_cleanup, &events);
          db_sql_query(db, cleanup_created_job, NULL, NULL);
          db_sql_query(db, cleanup_running_job, NULL, NULL);
+         resume_attribute_despool(db, catalog);
          foreach_alist(p, &events) {
             events_send_msg(NULL, "DD0003", EVENTS_TYPE_DAEMON, "*Director*",
                             (intptr_t)get_first_port_host_order(director->DIRaddrs),
@@ -104,6 +104,9 @@ typedef struct {
    int bacula_volumes_errors_all;
    int bacula_volumes_full_all;
    int bacula_volumes_used_all;
+   /* latency histograms, see bhistogram.h */
+   int hist_catalog_insert;
+   int hist_jobmedia;
 } dirdstatmetrics_t;
 
 void free_plugin_config_item(plugin_config_item *lst);
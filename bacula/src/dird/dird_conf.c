@@ -382,11 +382,14 @@ static RES_ITEM dir_items[] = {
    {"MaximumConcurrentJobs", store_pint32, ITEM(res_dir.MaxConcurrentJobs), 0, ITEM_DEFAULT, 20},
    {"MaximumReloadRequests", store_pint32, ITEM(res_dir.MaxReload), 0, ITEM_DEFAULT, 32},
    {"MaximumConsoleConnections", store_pint32, ITEM(res_dir.MaxConsoleConnect), 0, ITEM_DEFAULT, 20},
+   {"MaximumCatalogConnections", store_pint32, ITEM(res_dir.MaxCatalogConnections), 0, ITEM_DEFAULT, 0},
+   {"AttributeDespoolThreads", store_pint32, ITEM(res_dir.AttrDespoolThreads), 0, ITEM_DEFAULT, 2},
    {"Password",    store_password, ITEM(res_dir.password), 0, ITEM_REQUIRED, 0},
    {"FdConnectTimeout", store_time,ITEM(res_dir.FDConnectTimeout), 0, ITEM_DEFAULT, 3 * 60},
    {"SdConnectTimeout", store_time,ITEM(res_dir.SDConnectTimeout), 0, ITEM_DEFAULT, 30 * 60},
    {"HeartbeatInterval", store_time, ITEM(res_dir.heartbeat_interval), 0, ITEM_DEFAULT, 5 * 60},
    {"AutoPrune", store_bool, ITEM(res_dir.AutoPrune), 0, ITEM_DEFAULT, true},
+   {"AccurateStateCache", store_bool, ITEM(res_dir.AccurateStateCache), 0, ITEM_DEFAULT, false},
 #if BEEF
    {"FipsRequire", store_bool, ITEM(res_dir.require_fips), 0, 0, 0},
 #endif
@@ -107,6 +107,8 @@ public:
    uint32_t MaxConcurrentJobs;        /* Max concurrent jobs for whole director */
    uint32_t MaxSpawnedJobs;           /* Max Jobs that can be started by Migration/Copy */
    uint32_t MaxConsoleConnect;        /* Max concurrent console session */
+   uint32_t MaxCatalogConnections;    /* Max pooled dedicated catalog connections */
+   uint32_t AttrDespoolThreads;       /* Threads decoding the spooled attributes */
    uint32_t MaxReload;                /* Maximum reload requests */
    utime_t FDConnectTimeout;          /* timeout for connect in seconds */
    utime_t SDConnectTimeout;          /* timeout in seconds */
@@ -122,6 +124,7 @@ public:
    utime_t stats_retention;           /* Stats retention period in seconds */
    bool comm_compression;             /* Enable comm line compression */
    bool AutoPrune;                    /* Global autoprune flag */
+   bool AccurateStateCache;           /* Keep the accurate state of the Jobs on disk */
    bool require_fips;                  /* Check for FIPS module */
    bool tls_authenticate;             /* Authenticated with TLS */
    bool tls_enable;                   /* Enable TLS */
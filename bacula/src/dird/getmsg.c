@@ -147,6 +147,7 @@ int bget_dirmsg(JCR *jcr, BSOCK *bs, BSOCK_CLIENT_TYPE role)
    int type;
    utime_t mtime;                     /* message time */
    char *msg;
+   bool locked;
 
    for ( ; !bs->is_stop() && !bs->is_timed_out(); ) {
       n = bs->recv();
@@ -265,7 +266,9 @@ int bget_dirmsg(JCR *jcr, BSOCK *bs, BSOCK_CLIENT_TYPE role)
        */
       if (role==BSOCK_TYPE_SD && bs->msg[0] == 'C') {        /* Catalog request */
          Dmsg2(900, "Catalog req jcr=%p: %s", jcr, bs->msg);
+         locked = lock_attribute_despool(jcr);
          catalog_request(jcr, bs);
+         unlock_attribute_despool(jcr, locked);
          continue;
       }
       /* Only the Snapshot commands are authorized for the FD */
@@ -275,22 +278,35 @@ int bget_dirmsg(JCR *jcr, BSOCK *bs, BSOCK_CLIENT_TYPE role)
       }
       if (role==BSOCK_TYPE_SD && bs->msg[0] == 'U') {        /* SD sending attributes */
          Dmsg2(900, "Catalog upd jcr=%p: %s", jcr, bs->msg);
+         locked = lock_attribute_despool(jcr);
          catalog_update(jcr, bs);
+         unlock_attribute_despool(jcr, locked);
          continue;
       }
       if (role==BSOCK_TYPE_SD && bs->msg[0] == 'B') {        /* SD sending file spool attributes */
          Dmsg2(100, "Blast attributes jcr=%p: %s", jcr, bs->msg);
-         char filename[256];
+         char filename[256], ed1[50];
+         int64_t size;
+         int32_t index;
+         boffset_t pos;
+         /* Checkpoint sent while the Job is running, no answer is expected */
+         if (sscanf(bs->msg, "BlastAttr JobId=%ld File=%255s Size=%lld Index=%ld",
+                    &JobId, filename, &size, &index) == 4) {
+            unbash_spaces(filename);
+            checkpoint_attributes_from_file(jcr, filename, size, index);
+            continue;
+         }
          if (sscanf(bs->msg, "BlastAttr JobId=%ld File=%255s",
                     &JobId, filename) != 2) {
             Jmsg1(jcr, M_ERROR, 0, _("Malformed message: %s\n"), bs->msg);
             continue;
          }
          unbash_spaces(filename);
-         if (despool_attributes_from_file(jcr, filename)) {
+         if (despool_attributes_from_file(jcr, filename, &pos)) {
             bs->fsend("1000 OK BlastAttr\n");
          } else {
-            bs->fsend("1990 ERROR BlastAttr\n");
+            /* The records before pos are stored, the SD sends the others */
+            bs->fsend("1990 ERROR BlastAttr Pos=%s\n", edit_int64(pos, ed1));
          }
          continue;
       }
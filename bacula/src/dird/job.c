@@ -1571,6 +1571,9 @@ void dird_free_jcr(JCR *jcr)
       pthread_cond_destroy(&jcr->term_wait);
       jcr->term_wait_inited = false;
    }
+   stop_attribute_despool(jcr);
+   free_accurate_state(jcr);
+   bvfs_path_hierarchy_free(jcr, jcr->db);
    if (jcr->db_batch) {
       db_close_database(jcr, jcr->db_batch);
       jcr->db_batch = NULL;
@@ -1944,13 +1947,21 @@ bool run_console_command(JCR *jcr, const char *cmd)
 
 bool flush_file_records(JCR *jcr)
 {
+   stop_attribute_despool(jcr);
    if (jcr->cached_attribute) {
       Dmsg0(400, "Flush last cached attribute.\n");
+      btime_t start = bhist_start();
       if (!db_create_attributes_record(jcr, jcr->db, jcr->ar)) {
          Jmsg1(jcr, M_FATAL, 0, _("Attribute create error. %s"), jcr->db->bdb_strerror());
       }
+      bhist_record(jcr, dirstatmetrics.hist_catalog_insert, start);
       jcr->cached_attribute = false;
    }
 
-   return db_write_batch_file_records(jcr);    /* used by bulk batch file insert */
+   if (!db_write_batch_file_records(jcr)) {    /* used by bulk batch file insert */
+      return false;
+   }
+   /* Directories were sent to the bvfs cache with the batch inserts */
+   bvfs_path_hierarchy_commit(jcr, jcr->db);
+   return true;
 }
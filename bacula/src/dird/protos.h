@@ -31,6 +31,13 @@ extern bool authenticate_storage_daemon(JCR *jcr, STORE *store);
 extern int authenticate_file_daemon(JCR *jcr);
 extern int authenticate_user_agent(UAContext *ua);
 
+/* accurate_state.c */
+extern bool open_accurate_state(JCR *jcr, char *jobids);
+extern bool send_accurate_state(JCR *jcr);
+extern int accurate_state_handler(void *ctx, int num_fields, char **row);
+extern void update_accurate_state(JCR *jcr);
+extern void free_accurate_state(JCR *jcr);
+
 /* autoprune.c */
 extern void do_autoprune(JCR *jcr);
 extern void prune_volumes(JCR *jcr, bool InChanger, MEDIA_DBR *mr,
@@ -51,6 +58,7 @@ extern bool do_backup(JCR *jcr);
 extern void backup_cleanup(JCR *jcr, int TermCode);
 extern void update_bootstrap_file(JCR *jcr);
 extern bool send_accurate_current_files(JCR *jcr);
+extern int accurate_list_handler(void *ctx, int num_fields, char **row);
 extern char *get_storage_address(CLIENT *cli, STORE *store);
 extern bool run_storage_and_start_message_thread(JCR *jcr, BSOCK *sd);
 extern bool send_client_addr_to_sd(JCR *jcr);
@@ -81,7 +89,12 @@ void scan_bsr(JCR *jcr);
 /* catreq.c */
 extern void catalog_request(JCR *jcr, BSOCK *bs);
 extern void catalog_update(JCR *jcr, BSOCK *bs);
-extern bool despool_attributes_from_file(JCR *jcr, const char *file);
+extern bool despool_attributes_from_file(JCR *jcr, const char *file, boffset_t *pos);
+extern void checkpoint_attributes_from_file(JCR *jcr, const char *file, boffset_t size, int32_t index);
+extern void stop_attribute_despool(JCR *jcr);
+extern bool lock_attribute_despool(JCR *jcr);
+extern void unlock_attribute_despool(JCR *jcr, bool locked);
+extern void resume_attribute_despool(BDB *db, CAT *catalog);
 extern void remove_dummy_jobmedia_records(JCR *jcr);
 
 /* dird_conf.c */
@@ -323,6 +336,9 @@ bool user_select_files_from_tree(TREE_CTX *tree);
 bool user_select_files_from_tree_plugin_obj(TREE_CTX *tree);
 int insert_tree_handler(void *ctx, int num_fields, char **row);
 bool check_directory_acl(char **last_dir, alist *dir_acl, const char *path);
+bool tree_setup_lazy_load(TREE_CTX *tree);
+bool tree_get_lazy_restore_list(TREE_CTX *tree, POOLMEM *&table);
+void tree_drop_lazy_restore_list(TREE_CTX *tree, char *table);
 
 /* ua_prune.c */
 int prune_files(UAContext *ua, CLIENT *client, POOL *pool);
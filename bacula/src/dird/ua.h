@@ -96,6 +96,9 @@ struct TREE_CTX {
    alist *gid_acl;                    /* GID allowed in the tree */
    alist *dir_acl;                    /* Directories that can be displayed */
    char  *last_dir_acl;               /* Last directory from the DirectoryACL list */
+   bool lazy;                         /* Directories are loaded on demand */
+   char *jobids;                      /* JobIds used to load directories */
+   char *path_jobids;                 /* JobIds with Base Jobs for PathVisibility */
 };
 
 struct NAME_LIST {
@@ -144,6 +147,7 @@ struct RESTORE_CTX {
    bool hardlinks_in_mem;             /* keep hard links in memory */
    bool fdcalled;                     /* True if we should reuse the FD socket */
    bool no_auto_parent;               /* Select or not parent directories */
+   bool lazy_tree;                    /* Load the restore tree on demand */
    NAME_LIST name_list;
    POOLMEM *component_fname;
    FILE *component_fd;
@@ -168,7 +168,7 @@ static struct cmdstruct commands[] = {                                      /* C
    NT_("where=</path> client=<client> storage=<storage> bootstrap=<file> "
        "restorejob=<job> restoreclient=<cli> noautoparent"
        "\n\tcomment=<text> jobid=<jobid> jobuser=<user> jobgroup=<grp> copies done select all"
-       "\n\tobjectid=<objid>"), false},
+       "\n\tobjectid=<objid> lazy"), false},
 
  { NT_("relabel"),    relabel_cmd,   _("Relabel a tape"),
    NT_("storage=<storage-name> oldvolume=<old-volume-name>\n\tvolume=<newvolume-name> pool=<pool>"), false},
@@ -199,7 +199,7 @@ static struct cmdstruct commands[] = {                                      /* C
    NT_("level=<nn> trace=0/1 options=<0tTc> tags=<tags> | client=<client-name> | dir | storage=<storage-name> | all"), true},
 
  { NT_("setbandwidth"),   setbwlimit_cmd,  _("Sets bandwidth"),
-   NT_("limit=<speed> client=<client-name> jobid=<number> job=<job-name> ujobid=<unique-jobid>"), true},
+   NT_("limit=<speed> client=<client-name> jobid=<number> job=<job-name> ujobid=<unique-jobid> storage=<storage-name>"), true},
 
  { NT_("snapshot"),   snapshot_cmd,  _("Handle snapshots"),
    NT_("[client=<client-name> | job=<job-name> | jobid=<jobid>] [delete | list | listclient | prune | sync | update]"), true},
@@ -780,6 +780,74 @@ bail_out:
    return 1;
 }
 
+/*
+ * Set the bandwidth shared by the jobs on the Storage daemon,
+ *  for the whole daemon, for a Client or for a running Job.
+ */
+static int setbwlimit_storage(UAContext *ua, int64_t limit)
+{
+   USTORE ustore;
+   POOL_MEM buf, name;
+   JCR *jcr;
+   BSOCK *sd;
+   char ed1[50];
+   int i;
+
+   if (!get_storage_resource(ua, &ustore, false/*no default*/, true/*unique*/)) {
+      return 1;
+   }
+
+   if ((i = find_arg_with_value(ua, "jobid")) >= 0) {
+      if (!(jcr = get_jcr_by_id(str_to_int64(ua->argv[i])))) {
+         ua->error_msg(_("JobId %s is not running.\n"), ua->argv[i]);
+         return 1;
+      }
+      Mmsg(buf, "setbandwidth=%lld Job=%s\n", limit, jcr->Job);
+      free_jcr(jcr);
+
+   } else if ((i = find_arg_with_value(ua, "ujobid")) >= 0) {
+      Mmsg(buf, "setbandwidth=%lld Job=%s\n", limit, ua->argv[i]);
+
+   } else if ((i = find_arg_with_value(ua, "client")) >= 0) {
+      if (!acl_access_client_ok(ua, ua->argv[i], JT_BACKUP_RESTORE)) {
+         ua->error_msg(_("No authorization for Client \"%s\"\n"), ua->argv[i]);
+         return 1;
+      }
+      pm_strcpy(name, ua->argv[i]);
+      bash_spaces(name);
+      Mmsg(buf, "setbandwidth=%lld Client=%s\n", limit, name.c_str());
+
+   } else {
+      Mmsg(buf, "setbandwidth=%lld\n", limit);
+   }
+
+   ua->jcr->store_mngr->set_wstorage(ustore.store, _("unknown source"));
+   /* Try connecting for up to 15 seconds */
+   ua->send_msg(_("Connecting to Storage daemon %s at %s:%d\n"),
+      ustore.store->name(), ustore.store->address, ustore.store->SDport);
+   if (!connect_to_storage_daemon(ua->jcr, 1, 15, 0)) {
+      ua->error_msg(_("Failed to connect to Storage daemon.\n"));
+      return 1;
+   }
+   sd = ua->jcr->store_bsock;
+   sd->fsend("%s", buf.c_str());
+   if (sd->recv() >= 0) {
+      if (strncmp(sd->msg, "2000 OK Bandwidth", 17) != 0) {
+         ua->error_msg("%s", sd->msg);
+
+      } else if (limit) {
+         ua->info_msg(_("2000 Limiting bandwidth to %sB/s on Storage %s\n"),
+                      edit_uint64_with_suffix(limit, ed1), ustore.store->name());
+      } else {
+         ua->info_msg(_("2000 Bandwidth set to unlimited on Storage %s\n"),
+                      ustore.store->name());
+      }
+   }
+   sd->signal(BNET_TERMINATE);
+   free_bsock(ua->jcr->store_bsock);
+   return 1;
+}
+
 static int setbwlimit_cmd(UAContext *ua, const char *cmd)
 {
    int action = -1;
@@ -790,7 +858,7 @@ static int setbwlimit_cmd(UAContext *ua, const char *cmd)
    JCR *jcr = NULL;
    int i;
 
-   const char *lst_all[] = { "job", "jobid", "jobname", "client", NULL };
+   const char *lst_all[] = { "job", "jobid", "jobname", "client", "storage", "sd", NULL };
    if (find_arg_keyword(ua, lst_all) < 0) {
        start_prompt(ua, _("Set Bandwidth choice:\n"));
        add_prompt(ua, _("Running Job")); /* 0 */
@@ -818,6 +886,12 @@ static int setbwlimit_cmd(UAContext *ua, const char *cmd)
       }
    }
 
+   /* Bandwidth shared by the jobs on a Storage daemon */
+   const char *lst_sd[] = { "storage", "sd", NULL };
+   if (find_arg_keyword(ua, lst_sd) >= 0) {
+      return setbwlimit_storage(ua, limit);
+   }
+
    const char *lst[] = { "job", "jobid", "jobname", NULL };
    if (action == 0 || find_arg_keyword(ua, lst) > 0) {
       alist *jcrs = New(alist(10, not_owned_by_alist));
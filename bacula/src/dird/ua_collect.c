@@ -249,6 +249,9 @@ void initialize_statcollector()
    dirstatmetrics.bacula_dir_memory_smbytes =
          statcollector->registration("bacula.dir.memory.smbytes", METRIC_INT, METRIC_UNIT_BYTE,
             "The allocated memory size.");
+   /* latency histograms */
+   dirstatmetrics.hist_catalog_insert = bhist_register("dir_catalog_insert", "The latency of inserting a file attributes record into the catalog.");
+   dirstatmetrics.hist_jobmedia = bhist_register("dir_jobmedia", "The latency of creating a batch of JobMedia records in the catalog.");
    // statcollector->dump();
 };
 
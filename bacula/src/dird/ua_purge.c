@@ -365,13 +365,21 @@ void purge_files_from_jobs(UAContext *ua, char *jobs)
    db_sql_query(ua->db, query.c_str(), NULL, (void *)NULL);
    Dmsg1(050, "Delete TagJob sql=%s\n", query.c_str());
 
-   Mmsg(query, "DELETE FROM File WHERE JobId IN (%s)", jobs);
-   db_sql_query(ua->db, query.c_str(), NULL, (void *)NULL);
-   Dmsg1(050, "Delete File sql=%s\n", query.c_str());
+   if (ua->db->is_file_partitioned()) {
+      /* Unused JobId partitions are dropped, others are cleaned */
+      Mmsg(query, purge_file_partitions, jobs);
+      db_sql_query(ua->db, query.c_str(), NULL, (void *)NULL);
+      Dmsg1(050, "Purge File partitions sql=%s\n", query.c_str());
 
-   Mmsg(query, "DELETE FROM FileMedia WHERE JobId IN (%s)", jobs);
-   db_sql_query(ua->db, query.c_str(), NULL, (void *)NULL);
-   Dmsg1(050, "Delete FileMedia sql=%s\n", query.c_str());
+   } else {
+      Mmsg(query, "DELETE FROM File WHERE JobId IN (%s)", jobs);
+      db_sql_query(ua->db, query.c_str(), NULL, (void *)NULL);
+      Dmsg1(050, "Delete File sql=%s\n", query.c_str());
+
+      Mmsg(query, "DELETE FROM FileMedia WHERE JobId IN (%s)", jobs);
+      db_sql_query(ua->db, query.c_str(), NULL, (void *)NULL);
+      Dmsg1(050, "Delete FileMedia sql=%s\n", query.c_str());
+   }
 
    Mmsg(query, "DELETE FROM BaseFiles WHERE JobId IN (%s)", jobs);
    db_sql_query(ua->db, query.c_str(), NULL, (void *)NULL);
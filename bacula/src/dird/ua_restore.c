@@ -32,6 +32,7 @@
 
 #include "bacula.h"
 #include "dird.h"
+#include "findlib/find.h"
 
 /* Imported functions */
 extern void print_bsr(UAContext *ua, RBSR *bsr);
@@ -152,6 +153,9 @@ int restore_cmd(UAContext *ua, const char *cmd)
 
       } else if (strcasecmp(ua->argk[i], "noautoparent") == 0) {
          rx.no_auto_parent = true;
+
+      } else if (strcasecmp(ua->argk[i], "lazy") == 0) {
+         rx.lazy_tree = true;
       }
       if (!ua->argv[i]) {
          continue;           /* skip if no value given */
@@ -712,6 +716,7 @@ static int user_select_jobids_or_files(UAContext *ua, RESTORE_CTX *rx)
       "jobuser",       /* 28 */
       "jobgroup",      /* 29 */
       "objectid",      /* 30 */
+      "lazy",          /* 31 */
       NULL
    };
 
@@ -1629,6 +1634,28 @@ static bool write_component_file(UAContext *ua, RESTORE_CTX *rx, char *fname)
    return true;
 }
 
+/*
+ * With a lazy tree, the file pointed by a hard link may be in a
+ *  directory that is not loaded, add it directly to the bootstrap.
+ */
+static void add_lazy_hardlink_findex(UAContext *ua, RESTORE_CTX *rx, TREE_NODE *node)
+{
+   FILE_DBR fdbr;
+   struct stat statp;
+   char cwd[2000];
+   int32_t LinkFI;
+
+   tree_getpath(node, cwd, sizeof(cwd));
+   fdbr.FileId = 0;
+   fdbr.JobId = node->JobId;
+   if (db_get_file_attributes_record(ua->jcr, ua->db, cwd, NULL, &fdbr)) {
+      decode_stat(fdbr.LStat, &statp, sizeof(statp), &LinkFI);
+      if (LinkFI > 0) {
+         add_findex(rx->bsr_list, node->JobId, LinkFI);
+      }
+   }
+}
+
 static bool build_directory_tree(UAContext *ua, RESTORE_CTX *rx)
 {
    TREE_CTX tree;
@@ -1636,6 +1663,7 @@ static bool build_directory_tree(UAContext *ua, RESTORE_CTX *rx)
    char *p;
    bool OK = true;
    char ed1[50];
+   POOL_MEM jobids, path_jobids;
 
    memset(&tree, 0, sizeof(TREE_CTX));
    /*
@@ -1673,9 +1701,28 @@ static bool build_directory_tree(UAContext *ua, RESTORE_CTX *rx)
 
 #define new_get_file_list
 #ifdef new_get_file_list
-   if (!db_get_file_list(ua->jcr, ua->db,
-                         rx->JobIds, DBL_USE_DELTA,
-                         insert_tree_handler, (void *)&tree))
+   if (rx->lazy_tree) {
+      /* Only the first level is loaded, other directories on demand */
+      pm_strcpy(jobids, rx->JobIds);
+      pm_strcpy(path_jobids, rx->JobIds);
+      if (*rx->BaseJobIds) {
+         pm_strcat(path_jobids, ",");
+         pm_strcat(path_jobids, rx->BaseJobIds);
+      }
+      tree.jobids = jobids.c_str();
+      tree.path_jobids = path_jobids.c_str();
+      tree.DeltaCount = 0;
+      if (!tree_setup_lazy_load(&tree)) {
+         ua->error_msg("%s", db_strerror(ua->db));
+      }
+      /* The first level may contain only directories */
+      if (tree.FileCount == 0 && tree_node_has_child((TREE_NODE *)tree.root)) {
+         tree.FileCount = 1;
+      }
+
+   } else if (!db_get_file_list(ua->jcr, ua->db,
+                                rx->JobIds, DBL_USE_DELTA,
+                                insert_tree_handler, (void *)&tree))
    {
       ua->error_msg("%s", db_strerror(ua->db));
    }
@@ -1695,7 +1742,7 @@ static bool build_directory_tree(UAContext *ua, RESTORE_CTX *rx)
        * Find files for this JobId and insert them in the tree
        */
       Mmsg(rx->query, uar_sel_files, edit_int64(JobId, ed1));
-      if (!db_sql_query(ua->db, rx->query, insert_tree_handler, (void *)&tree)) {
+      if (!db_big_sql_query(ua->db, rx->query, insert_tree_handler, (void *)&tree)) {
          ua->error_msg("%s", db_strerror(ua->db));
       }
    }
@@ -1736,7 +1783,9 @@ static bool build_directory_tree(UAContext *ua, RESTORE_CTX *rx)
       }
    } else {
       char ec1[50];
-      if (tree.all) {
+      if (tree.lazy) {
+         ua->info_msg(_("\nDirectories will be loaded into the tree on demand.\n"));
+      } else if (tree.all) {
          ua->info_msg(_("\n%s files inserted into the tree and marked for extraction.\n"),
                       edit_uint64_with_commas(tree.FileCount, ec1));
       } else {
@@ -1777,9 +1826,25 @@ static bool build_directory_tree(UAContext *ua, RESTORE_CTX *rx)
                if (node->extract && node->type != TN_NEWDIR) {
                   rx->selected_files++;  /* count only saved files */
                }
+               if (tree.lazy && node->extract && node->hard_link && node->type == TN_FILE) {
+                  add_lazy_hardlink_findex(ua, rx, node);
+               }
             }
          }
       }
+      /*
+       * With a lazy tree, the content of the marked directories that
+       *  were never loaded is computed with SQL.
+       */
+      if (OK && tree.lazy) {
+         POOL_MEM table, JobIds;
+         if (tree_get_lazy_restore_list(&tree, table.addr())) {
+            pm_strcpy(JobIds, rx->JobIds);      /* keep the list without duplicates */
+            OK = insert_table_into_findex_list(ua, rx, table.c_str());
+            pm_strcpy(rx->JobIds, JobIds);
+            tree_drop_lazy_restore_list(&tree, table.c_str());
+         }
+      }
    }
    if (tree.uid_acl) {
       delete tree.uid_acl;
@@ -35,6 +35,8 @@ static void llist_scheduled_jobs(UAContext *ua);
 static void list_running_jobs(UAContext *ua);
 static void list_terminated_jobs(UAContext *ua);
 static void list_collectors_status(UAContext *ua);
+static void list_dir_memory_status(UAContext *ua);
+static void ua_sendit(const char *msg, int len, void *ctx);
 static void api_collectors_status(UAContext *ua, char *collname);
 static void do_storage_status(UAContext *ua, STORE *store, char *cmd);
 static void do_client_status(UAContext *ua, CLIENT *client, char *cmd);
@@ -94,6 +96,14 @@ bool dot_status_cmd(UAContext *ua, const char *cmd)
           list_terminated_jobs(ua);
       } else if (strcasecmp(ua->argk[2], "statistics") == 0) {
           list_collectors_status(ua);
+      } else if (strcasecmp(ua->argk[2], "memory") == 0) {
+          list_dir_memory_status(ua);
+      } else if (strcasecmp(ua->argk[2], "lockmgr") == 0 ||
+                 strcasecmp(ua->argk[2], "lockmgrandzerostats") == 0) {
+          lmgr_stats_report(ua_sendit, ua, 0);
+          if (strcasecmp(ua->argk[2], "lockmgrandzerostats") == 0) {
+             lmgr_stats_reset();
+          }
       } else {
          ua->send_msg("1900 Bad .status command, wrong argument.\n");
          return false;
@@ -437,7 +447,9 @@ static void do_all_status(UAContext *ua)
 static void api_list_dir_status_header(UAContext *ua)
 {
    alist tlist(10, not_owned_by_alist);
+   DB_POOL_STATS pstats;
    OutputWriter wt(ua->api_opts);
+   db_pool_get_stats(&pstats);
    wt.start_group("header");
    wt.get_output(
       OT_STRING, "name",        my_name,
@@ -460,11 +472,35 @@ static void api_list_dir_status_header(UAContext *ua)
       OT_INT64,  "debug",       debug_level,
       OT_INT,    "trace",       get_trace(),
       OT_ALIST_STR, "tags",     debug_get_tags_list(&tlist, debug_level_tags),
+      OT_INT,    "dbpool_max",  pstats.max,
+      OT_INT,    "dbpool_open", pstats.open,
+      OT_INT,    "dbpool_idle", pstats.idle,
+      OT_INT64,  "dbpool_leases", pstats.leases,
+      OT_INT64,  "dbpool_created", pstats.created,
+      OT_INT64,  "dbpool_affinity", pstats.affinity_hits,
+      OT_INT64,  "dbpool_waits", pstats.waits,
+      OT_INT64,  "dbpool_overflows", pstats.overflows,
       OT_END);
 
    ua->send_msg("%s", wt.end_group());
 }
 
+/* sendit() for the lib reporting functions */
+static void ua_sendit(const char *msg, int len, void *ctx)
+{
+   ((UAContext *)ctx)->send_msg("%s", msg);
+}
+
+/* Live memory per call site */
+static void list_dir_memory_status(UAContext *ua)
+{
+#ifdef SAMPLEDALLOC
+   sa_report(ua_sendit, ua, 0);
+#else
+   ua->send_msg(_("Sampled allocation tracking not enabled.\n"));
+#endif
+}
+
 void list_dir_status_header(UAContext *ua)
 {
    char dt[MAX_TIME_LENGTH], dt1[MAX_TIME_LENGTH];
@@ -507,6 +543,18 @@ void list_dir_status_header(UAContext *ua)
       ((rblist *)res_head[R_FILESET-r_first]->res_list)->size(),
       ((rblist *)res_head[R_SCHEDULE-r_first]->res_list)->size());
 
+   DB_POOL_STATS pstats;
+   db_pool_get_stats(&pstats);
+   if (pstats.max > 0) {
+      ua->send_msg(_(" Catalog pool: max=%d open=%d idle=%d leases=%s created=%s"
+                     " affinity=%s waits=%s overflows=%s\n"),
+         pstats.max, pstats.open, pstats.idle,
+         edit_uint64_with_commas(pstats.leases, b1),
+         edit_uint64_with_commas(pstats.created, b2),
+         edit_uint64_with_commas(pstats.affinity_hits, b3),
+         edit_uint64_with_commas(pstats.waits, b4),
+         edit_uint64_with_commas(pstats.overflows, b5));
+   }
 
    /* TODO: use this function once for all daemons */
    if (b_plugin_list && b_plugin_list->size() > 0) {
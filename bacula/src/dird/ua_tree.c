@@ -34,6 +34,9 @@
 #include "lib/fnmatch.h"
 #endif
 #include "findlib/find.h"
+#include "cats/bvfs.h"
+
+extern void bvfs_set_acl(UAContext *ua, Bvfs *bvfs);
 
 
 /* Forward referenced commands */
@@ -312,6 +315,222 @@ int insert_tree_handler(void *ctx, int num_fields, char **row)
    return 0;
 }
 
+/*
+ * Lazy restore tree. Instead of loading all the files of the selected
+ *  Jobs, we load the content of a directory only when the user enters
+ *  it or marks something inside. The subdirectories are found with
+ *  the bvfs PathHierarchy and PathVisibility tables, the files and the
+ *  directory entries are found with the regular accurate query limited
+ *  to the given directory.
+ *
+ * A directory that is marked but not loaded is restored with all its
+ *  content, the list of files is computed in SQL when the user is done.
+ */
+
+/*
+ * Get the PathIds of a directory node as a comma separated list.
+ *  The root of the tree is the parent of "/" and of the Win32 drives.
+ */
+static bool get_node_pathids(TREE_CTX *tree, TREE_NODE *node, db_list_ctx *ids)
+{
+   UAContext *ua = tree->ua;
+   POOL_MEM query, esc;
+   char cwd[2000];
+   int len;
+
+   ids->reset();
+   if (node == (TREE_NODE *)tree->root) {
+      Mmsg(query, "SELECT PathId FROM Path WHERE Path IN ('', '/')");
+   } else {
+      tree_getpath(node, cwd, sizeof(cwd));
+      len = strlen(cwd);
+      esc.check_size(len*2+1);
+      db_escape_string(ua->jcr, ua->db, esc.c_str(), cwd, len);
+      Mmsg(query, "SELECT PathId FROM Path WHERE Path = '%s'", esc.c_str());
+   }
+   if (!db_sql_query(ua->db, query.c_str(), db_list_handler, ids)) {
+      ua->error_msg("%s", db_strerror(ua->db));
+      return false;
+   }
+   return ids->count > 0;
+}
+
+/*
+ * Called for each subdirectory of the directory being loaded
+ *   row[0]=Path
+ */
+static int lazy_subdir_handler(void *ctx, int num_fields, char **row)
+{
+   TREE_CTX *tree = (TREE_CTX *)ctx;
+   POOL_MEM path;
+   int len;
+
+   pm_strcpy(path, row[0]);
+   len = strlen(path.c_str());
+   if (len > 0 && IsPathSeparator(path.c_str()[len-1])) {
+      path.c_str()[len-1] = 0;          /* strip trailing slash */
+   }
+   make_tree_path(path.c_str(), tree->root);
+   return 0;
+}
+
+/*
+ * Load the subdirectories and the files of a directory into the tree.
+ *  Called by the tree routines the first time we look into the node.
+ */
+static bool lazy_load_dir(TREE_ROOT *root, TREE_NODE *node)
+{
+   TREE_CTX *tree = (TREE_CTX *)root->load_ctx;
+   UAContext *ua = tree->ua;
+   db_list_ctx pathids;
+   POOL_MEM query;
+   TREE_NODE *child;
+   bool all, ok = true;
+
+   node->loaded = true;            /* Do not try again, even on error */
+   if (!get_node_pathids(tree, node, &pathids)) {
+      return false;
+   }
+   Dmsg2(100, "Loading %s PathIds=%s\n", node->fname, pathids.list);
+
+   Mmsg(query,
+        "SELECT DISTINCT Path.Path FROM PathHierarchy "
+          "JOIN PathVisibility ON (PathHierarchy.PathId = PathVisibility.PathId) "
+          "JOIN Path ON (PathHierarchy.PathId = Path.PathId) "
+         "WHERE PathHierarchy.PPathId IN (%s) AND PathVisibility.JobId IN (%s)",
+        pathids.list, tree->path_jobids);
+   if (!db_sql_query(ua->db, query.c_str(), lazy_subdir_handler, tree)) {
+      ua->error_msg("%s", db_strerror(ua->db));
+      ok = false;
+   }
+
+   /* The marks are inherited from the directory, not from the "all" flag */
+   all = tree->all;
+   tree->all = false;
+   if (!db_get_dir_file_list(ua->jcr, ua->db, tree->jobids, DBL_USE_DELTA,
+                             insert_tree_handler, (void *)tree, pathids.list)) {
+      ua->error_msg("%s", db_strerror(ua->db));
+      ok = false;
+   }
+   tree->all = all;
+
+   /* The entry of the "/" directory itself has nothing to load */
+   foreach_child(child, node) {
+      if (child->fname[0] == 0) {
+         child->loaded = true;
+      }
+   }
+
+   /* The directory was marked before we knew its content */
+   if (node->extract) {
+      foreach_child(child, node) {
+         set_extract(ua, child, tree, true);
+      }
+   }
+   return ok;
+}
+
+/*
+ * Setup the tree to load the directories on demand, and load the
+ *  first level of the tree.
+ */
+bool tree_setup_lazy_load(TREE_CTX *tree)
+{
+   TREE_NODE *child;
+
+   tree->lazy = true;
+   tree->root->load_dir = lazy_load_dir;
+   tree->root->load_ctx = (void *)tree;
+
+   /* The PathHierarchy must be computed for our jobs */
+   if (!bvfs_update_path_hierarchy_cache(tree->ua->jcr, tree->ua->db,
+                                         tree->path_jobids)) {
+      tree->ua->error_msg(_("Unable to update the Bvfs cache for JobIds %s\n"),
+                          tree->path_jobids);
+      return false;
+   }
+   if (!tree_load_dir(tree->root, (TREE_NODE *)tree->root)) {
+      return false;
+   }
+   if (tree->all) {
+      foreach_child(child, (TREE_NODE *)tree->root) {
+         set_extract(tree->ua, child, tree, true);
+      }
+   }
+   return true;
+}
+
+/*
+ * Compute in a bvfs table the JobId/FileIndex of all the files below
+ *  the directories that are marked but not loaded. Returns false if
+ *  there is nothing in the table. The table must be dropped with
+ *  tree_drop_lazy_restore_list().
+ */
+bool tree_get_lazy_restore_list(TREE_CTX *tree, POOLMEM *&table)
+{
+   static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+   static int seq = 0;
+   db_list_ctx dirids, pathids;
+   int num;
+
+   if (!tree->lazy) {
+      return false;
+   }
+   for (TREE_NODE *node=first_tree_node(tree->root); node; node=next_tree_node(node)) {
+      if (node->extract && !node->loaded && node->type != TN_FILE) {
+         if (get_node_pathids(tree, node, &pathids)) {
+            dirids.add(pathids);
+         }
+      }
+   }
+   if (dirids.count == 0) {
+      return false;
+   }
+   P(mutex);
+   num = ++seq;
+   V(mutex);
+   Mmsg(table, "b2%d%d", (int)getpid(), num);
+
+   Bvfs fs(tree->ua->jcr, tree->ua->db);
+   bvfs_set_acl(tree->ua, &fs);
+   fs.set_jobids(tree->path_jobids);
+   return fs.compute_restore_list((char *)"", dirids.list, table);
+}
+
+void tree_drop_lazy_restore_list(TREE_CTX *tree, char *table)
+{
+   Bvfs fs(tree->ua->jcr, tree->ua->db);
+   fs.drop_restore_list(table);
+}
+
+/*
+ * Count the files below the directories that are marked but not loaded
+ */
+static int64_t count_lazy_marked_files(UAContext *ua, TREE_CTX *tree)
+{
+   POOL_MEM table, query;
+   db_int64_ctx nb;
+
+   if (!tree_get_lazy_restore_list(tree, table.addr())) {
+      return 0;
+   }
+   Mmsg(query, "SELECT COUNT(1) FROM %s", table.c_str());
+   if (!db_sql_query(ua->db, query.c_str(), db_int64_handler, &nb)) {
+      ua->error_msg("%s", db_strerror(ua->db));
+   }
+   tree_drop_lazy_restore_list(tree, table.c_str());
+   return nb.value;
+}
+
+/*
+ * With a lazy tree, a directory that is not loaded has no children yet
+ */
+static bool node_is_dir(TREE_CTX *tree, TREE_NODE *node)
+{
+   return tree_node_has_child(node) ||
+      (tree->lazy && !node->loaded && node->type != TN_FILE);
+}
+
 /*
  * Set extract to value passed. We recursively walk
  *  down the tree setting all children if the
@@ -484,6 +703,11 @@ static int countcmd(UAContext *ua, TREE_CTX *tree)
          }
       }
    }
+   if (tree->lazy) {
+      int64_t lazy_count = count_lazy_marked_files(ua, tree);
+      total += lazy_count;
+      num_extract += lazy_count;
+   }
    ua->send_msg(_("%s total files/dirs. %s marked to be restored.\n"),
             edit_uint64_with_commas(total, ec1),
             edit_uint64_with_commas(num_extract, ec2));
@@ -515,6 +739,9 @@ static int findcmd(UAContext *ua, TREE_CTX *tree)
          }
       }
    }
+   if (tree->lazy) {
+      ua->send_msg(_("Only the directories already visited were searched.\n"));
+   }
    return 1;
 }
 
@@ -528,7 +755,7 @@ static int dot_lsdircmd(UAContext *ua, TREE_CTX *tree)
 
    foreach_child(node, tree->node) {
       if (ua->argc == 1 || fnmatch(ua->argk[1], node->fname, 0) == 0) {
-         if (tree_node_has_child(node)) {
+         if (node_is_dir(tree, node)) {
             ua->send_msg("%s/\n", node->fname);
          }
       }
@@ -558,7 +785,7 @@ static int dot_lscmd(UAContext *ua, TREE_CTX *tree)
 
    foreach_child(node, tree->node) {
       if (ua->argc == 1 || fnmatch(ua->argk[1], node->fname, 0) == 0) {
-         ua->send_msg("%s%s\n", node->fname, tree_node_has_child(node)?"/":"");
+         ua->send_msg("%s%s\n", node->fname, node_is_dir(tree, node)?"/":"");
       }
    }
 
@@ -607,9 +834,9 @@ static int list_files(UAContext *ua, TREE_CTX *tree, bool du)
             char ed1[30];
             uint64_t size = sum_tree_level(node);
             edit_uint64_with_suffix(size, ed1);
-            ua->send_msg("%-7s   %s%s%s\n", ed1, tag, node->fname, tree_node_has_child(node)?"/":"");
+            ua->send_msg("%-7s   %s%s%s\n", ed1, tag, node->fname, node_is_dir(tree, node)?"/":"");
          } else {
-            ua->send_msg("%s%s%s\n", tag, node->fname, tree_node_has_child(node)?"/":"");
+            ua->send_msg("%s%s%s\n", tag, node->fname, node_is_dir(tree, node)?"/":"");
          }
       }
    }
@@ -847,6 +1074,12 @@ static int estimatecmd(UAContext *ua, TREE_CTX *tree)
          }
       }
    }
+   if (tree->lazy) {
+      /* The size of the files in marked directories is not computed */
+      int64_t lazy_count = count_lazy_marked_files(ua, tree);
+      total += lazy_count;
+      num_extract += lazy_count;
+   }
    ua->send_msg(_("%d total files; %d marked to be restored; %s bytes.\n"),
             total, num_extract, edit_uint64_with_commas(total_bytes, ec1));
    return 1;
@@ -900,6 +1133,7 @@ static int cdcmd(UAContext *ua, TREE_CTX *tree)
    if (node) {
       if (node->can_access) {
          tree->node = node;
+         tree_load_dir(tree->root, node);
       } else {
          ua->warning_msg(_("Invalid path given. Permission denied.\n"));
       }
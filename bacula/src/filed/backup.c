@@ -152,6 +152,7 @@ bool blast_data_to_storage_daemon(JCR *jcr, char *addr)
 
    set_find_options(jcr->ff, jcr->incremental, jcr->mtime);
    set_find_snapshot_function(jcr->ff, snapshot_convert_path);
+   jcr->ff->stat_hist = fdstatmetrics.hist_file_stat;
 
    /** in accurate mode, we overload the find_one check function */
    if (jcr->accurate) {
@@ -169,6 +170,8 @@ bool blast_data_to_storage_daemon(JCR *jcr, char *addr)
    if (!dedup_init_storage_bsock(jcr, sd)) {
       return false;
    }
+   /* Coalesce the small messages (attributes, headers) sent for each file */
+   sd->set_buffered(jcr->buf_size, BNET_SETBUF_WRITE);
 
    /** Subroutine save_file() is called for each file */
    if (!find_files(jcr, (FF_PKT *)jcr->ff, save_file, plugin_save)) {
@@ -195,6 +198,7 @@ bool blast_data_to_storage_daemon(JCR *jcr, char *addr)
    accurate_finish(jcr);              /* send deleted or base file list to SD */
 
    dedup_release_storage_bsock(jcr, sd);
+   sd->clear_buffered(BNET_SETBUF_WRITE);
 
    stop_heartbeat_monitor(jcr);
    sd->signal(BNET_EOD);            /* end of sending data */
@@ -332,6 +336,11 @@ int save_file(JCR *jcr, FF_PKT *ff_pkt, bool top_level)
    bctx.ff_pkt = ff_pkt;
    bctx.jcr = jcr;
 
+   /* The walk can skip many files, do not keep the previous ones waiting */
+   if (!sd->flush_stale()) {
+      return 0;
+   }
+
 
    time_t now = time(NULL);
    if (jcr->last_stat_time == 0) {
@@ -573,6 +582,7 @@ int save_file(JCR *jcr, FF_PKT *ff_pkt, bool top_level)
    Dmsg2(150, "type=%d do_read=%d\n", ff_pkt->type, do_read);
    if (do_read) {
       btimer_t *tid;
+      btime_t open_start;
 
       if (ff_pkt->type == FT_FIFO) {
          tid = start_thread_timer(jcr, pthread_self(), 60);
@@ -583,6 +593,7 @@ int save_file(JCR *jcr, FF_PKT *ff_pkt, bool top_level)
       ff_pkt->bfd.reparse_point = (ff_pkt->type == FT_REPARSE ||
                                    ff_pkt->type == FT_JUNCTION);
       set_fattrs(&ff_pkt->bfd, &ff_pkt->statp);
+      open_start = bhist_start();
       if (bopen(&ff_pkt->bfd, ff_pkt->snap_fname, O_RDONLY | O_BINARY | noatime, 0) < 0) {
          ff_pkt->ff_errno = errno;
          berrno be;
@@ -595,6 +606,7 @@ int save_file(JCR *jcr, FF_PKT *ff_pkt, bool top_level)
          }
          goto good_rtn;
       }
+      bhist_record(jcr, fdstatmetrics.hist_file_open, open_start);
       if (tid) {
          stop_thread_timer(tid);
          tid = NULL;
@@ -674,6 +686,7 @@ static int send_data(bctx_t &bctx, int stream)
 {
    JCR *jcr = bctx.jcr;
    BSOCK *sd = jcr->store_bsock;
+   btime_t read_start;
 
 #ifdef FD_NO_SEND_TEST
    return 1;
@@ -792,13 +805,16 @@ static int send_data(bctx_t &bctx, int stream)
    /*
     * Normal read the file data in a loop and send it to SD
     */
+   read_start = bhist_start();
    while ((sd->msglen=(uint32_t)bread(&bctx.ff_pkt->bfd, bctx.rbuf, bctx.rsize)) > 0) {
+      bhist_record(jcr, fdstatmetrics.hist_file_read, read_start);
       if (!process_and_send_data(bctx)) {
          goto err;
       }
       if (jcr->sd_packet_mgr) {
          jcr->sd_packet_mgr->send(jcr, sd); // Send a POLL request if needed
       }
+      read_start = bhist_start();
    } /* end while read file data */
    goto finish_sending;
 
@@ -877,6 +893,7 @@ bool process_and_send_data(bctx_t &bctx)
    bool  ret = false;
    BSOCK *sd = bctx.sd;
    JCR *jcr = bctx.jcr;
+   btime_t start;
 
    Dmsg5(DT_DEDUP|620, "bread msglen=%5d data=0x%08x flags=0x%x sparse=%d compress=%d\n",
          sd->msglen, hash2int(bctx.rbuf), bctx.ff_pkt->flags,
@@ -930,6 +947,7 @@ bool process_and_send_data(bctx_t &bctx)
       crypto_digest_update(bctx.signing_digest, (uint8_t *)bctx.rbuf, sd->msglen);
    }
 
+   start = bhist_start();
    if (have_libz && !do_libz_compression(bctx)) {
       goto err;
    }
@@ -937,6 +955,9 @@ bool process_and_send_data(bctx_t &bctx)
    if (have_lzo && !do_lzo_compression(bctx)) {
       goto err;
    }
+   if (bctx.ff_pkt->flags & FO_COMPRESS) {
+      bhist_record(jcr, fdstatmetrics.hist_compression, start);
+   }
 
    /**
     * Note, here we prepend the current record length to the beginning
@@ -1002,6 +1023,7 @@ bool process_and_send_data(bctx_t &bctx)
       sd->msglen += OFFSET_FADDR_SIZE; /* include fileAddr in size */
    }
    sd->msg = bctx.wbuf;              /* set correct write buffer */
+   start = bhist_start();
    if (!sd->send()) {
       if (!jcr->is_job_canceled()) {
          Jmsg1(jcr, M_FATAL, 0, _("Network send error to SD. ERR=%s\n"),
@@ -1009,6 +1031,7 @@ bool process_and_send_data(bctx_t &bctx)
       }
       goto err;
    }
+   bhist_record(jcr, fdstatmetrics.hist_sd_send, start);
    Dmsg1(130, "Send data to SD len=%d\n", sd->msglen);
    /*          #endif */
    jcr->JobBytes += sd->msglen;      /* count bytes saved possibly compressed/encrypted */
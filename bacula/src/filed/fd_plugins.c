@@ -2156,7 +2156,7 @@ static bRC baculaDebugMsg(bpContext *ctx, const char *file, int line,
 static void *baculaMalloc(bpContext *ctx, const char *file, int line,
               size_t size)
 {
-#ifdef SMARTALLOC
+#if defined(SMARTALLOC) || defined(SAMPLEDALLOC)
    return sm_malloc(file, line, size);
 #else
    return malloc(size);
@@ -2165,7 +2165,7 @@ static void *baculaMalloc(bpContext *ctx, const char *file, int line,
 
 static void baculaFree(bpContext *ctx, const char *file, int line, void *mem)
 {
-#ifdef SMARTALLOC
+#if defined(SMARTALLOC) || defined(SAMPLEDALLOC)
    sm_free(file, line, mem);
 #else
    free(mem);
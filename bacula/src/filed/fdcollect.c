@@ -66,6 +66,12 @@ void initialize_statcollector()
    fdstatmetrics.bacula_client_memory_smbytes =
          statcollector->registration(met.c_str(), METRIC_INT, METRIC_UNIT_BYTE,
             "The allocated memory size.");
+   /* latency histograms */
+   fdstatmetrics.hist_file_open = bhist_register("fd_file_open", "The latency of opening a file for backup.");
+   fdstatmetrics.hist_file_read = bhist_register("fd_file_read", "The latency of reading a file data block.");
+   fdstatmetrics.hist_file_stat = bhist_register("fd_file_stat", "The latency of lstat() during the file tree walk.");
+   fdstatmetrics.hist_compression = bhist_register("fd_compression", "The latency of compressing a data block.");
+   fdstatmetrics.hist_sd_send = bhist_register("fd_sd_send", "The latency of sending a data block to the Storage Daemon.");
    // statcollector->dump();
 };
 
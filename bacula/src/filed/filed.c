@@ -352,6 +352,7 @@ void terminate_filed(int sig)
       // statcollector->dump();
       delete(statcollector);
    }
+   bhist_term();
    term_msg();
    cleanup_crypto();
    free(res_head);
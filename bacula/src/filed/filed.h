@@ -84,6 +84,12 @@ typedef struct {
    int bacula_client_memory_smbytes;
    int bacula_client_test_metric;
    int bacula_client_test_metric2;
+   /* latency histograms, see bhistogram.h */
+   int hist_file_open;
+   int hist_file_read;
+   int hist_file_stat;
+   int hist_compression;
+   int hist_sd_send;
 } fdstatmetrics_t;
 
 class bnet_poll_manager: public SMARTALLOC
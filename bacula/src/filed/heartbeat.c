@@ -73,6 +73,8 @@ static void *sd_heartbeat_thread(void *arg)
       if (n < 0 || sd->is_stop()) {
          break;
       }
+      /* Send the messages left in the write buffer by a busy writer */
+      jcr->store_bsock->flush_stale();
       if (me->heartbeat_interval) {
          now = time(NULL);
          if (now-last_heartbeat >= me->heartbeat_interval) {
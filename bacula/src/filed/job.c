@@ -439,6 +439,7 @@ bail_out:
    findFILESET *fileset = ff->fileset;
    if (fileset) {
       int i, j, k;
+      free_fileset_wild(fileset);
       /* Delete FileSet Include lists */
       for (i=0; i<fileset->include_list.size(); i++) {
          findINCEXE *incexe = (findINCEXE *)fileset->include_list.get(i);
@@ -406,6 +406,8 @@ void do_restore(JCR *jcr)
       jcr->compress_buf_size = compress_buf_size;
    }
 
+   /* Get the record headers and the small records with fewer read() */
+   sd->set_buffered(BSOCK_BUFFERED_SIZE, BNET_SETBUF_READ);
    GetMsg *fdmsg = get_msg_buffer(jcr, sd, rec_header);
 
    fdmsg->start_read_sock();
@@ -1147,6 +1149,7 @@ ok_out:
    Dsm_check(200);
    Dmsg0(DT_DEDUP|215, "wait BufferedMsg\n");
    fdmsg->wait_read_sock(jcr->is_job_canceled());
+   sd->clear_buffered(BNET_SETBUF_READ);
    delete bmsg;
    free_GetMsg(fdmsg);
    Dsm_check(200);
@@ -573,6 +573,12 @@ int qstatus_cmd(JCR *jcr)
    } else if (strcasecmp(cmd, "resources") == 0) {
        sp.api = MAX(sp.api, 1);
        show_config(&sp);
+   } else if (strcasecmp(cmd, "memory") == 0) {
+       list_memory_status(&sp);  /* defined in lib/status.h */
+   } else if (strcasecmp(cmd, "lockmgr") == 0 ||
+              strcasecmp(cmd, "lockmgrandzerostats") == 0) {
+       /* defined in lib/status.h */
+       list_lockmgr_status(&sp, strcasecmp(cmd, "lockmgrandzerostats") == 0);
    } else {
       pm_strcpy(&jcr->errmsg, dir->msg);
       Jmsg1(jcr, M_FATAL, 0, _("Bad .status command: %s\n"), jcr->errmsg);
@@ -264,6 +264,69 @@ bool is_in_fileset(FF_PKT *ff)
 }
 
 
+/*
+ * Compile a list of wild cards the first time it is used. A plugin can
+ *  add patterns to the FileSet after that, so check the number of patterns.
+ */
+static wild_set *compile_wild(wild_set **ws, alist *list, int flags)
+{
+   char *pattern;
+
+   if (*ws && (*ws)->size() == list->size() && (*ws)->flags() == flags) {
+      return *ws;
+   }
+   if (*ws) {
+      delete *ws;
+   }
+   *ws = New(wild_set(flags));
+   foreach_alist(pattern, list) {
+      (*ws)->add(pattern);
+   }
+   return *ws;
+}
+
+static wild_set *compile_wild(wild_set **ws, dlist *list, int flags)
+{
+   dlistString *node;
+
+   if (*ws && (*ws)->size() == list->size() && (*ws)->flags() == flags) {
+      return *ws;
+   }
+   if (*ws) {
+      delete *ws;
+   }
+   *ws = New(wild_set(flags));
+   foreach_dlist(node, list) {
+      (*ws)->add(node->c_str());
+   }
+   return *ws;
+}
+
+static void free_incexe_wild(alist *list)
+{
+   findINCEXE *incexe;
+   findFOPTS *fo;
+
+   foreach_alist(incexe, list) {
+      foreach_alist(fo, &incexe->opts_list) {
+         delete fo->cwild;
+         delete fo->cwilddir;
+         delete fo->cwildfile;
+         delete fo->cwildbase;
+         fo->cwild = fo->cwilddir = fo->cwildfile = fo->cwildbase = NULL;
+      }
+      delete incexe->cname_list;
+      incexe->cname_list = NULL;
+   }
+}
+
+/* Free the wild cards compiled by accept_file() */
+void free_fileset_wild(findFILESET *fileset)
+{
+   free_incexe_wild(&fileset->include_list);
+   free_incexe_wild(&fileset->exclude_list);
+}
+
 bool accept_file(FF_PKT *ff)
 {
    int i, j, k;
@@ -271,18 +334,15 @@ bool accept_file(FF_PKT *ff)
    findFILESET *fileset = ff->fileset;
    findINCEXE *incexe = fileset->incexe;
    const char *basename;
-   int (*match_func)(const char *pattern, const char *string, int flags);
+   const char *pattern;
 
    Dmsg1(dbglvl, "enter accept_file: fname=%s\n", ff->fname);
    if (ff->flags & FO_ENHANCEDWILD) {
-//    match_func = enh_fnmatch;
-      match_func = fnmatch;
       if ((basename = last_path_separator(ff->fname)) != NULL)
          basename++;
       else
          basename = ff->fname;
    } else {
-      match_func = fnmatch;
       basename = ff->fname;
    }
 
@@ -301,55 +361,52 @@ bool accept_file(FF_PKT *ff)
       fnm_flags = (ff->flags & FO_IGNORECASE) ? FNM_CASEFOLD : 0;
       fnm_flags |= (ff->flags & FO_ENHANCEDWILD) ? FNM_PATHNAME : 0;
 
+      /* Each list gives the same answer for any of its patterns, so we
+       * only need to know if one pattern of the compiled list matches.
+       */
       if (S_ISDIR(ff->statp.st_mode)) {
-         for (k=0; k<fo->wilddir.size(); k++) {
-            if (match_func((char *)fo->wilddir.get(k), ff->fname, fnmode|fnm_flags) == 0) {
-               if (ff->flags & FO_EXCLUDE) {
-                  Dmsg2(dbglvl, "Exclude wilddir: %s file=%s\n", (char *)fo->wilddir.get(k),
-                     ff->fname);
-                  return false;       /* reject dir */
-               }
-               return true;           /* accept dir */
+         if (fo->wilddir.size() > 0 &&
+             (pattern = compile_wild(&fo->cwilddir, &fo->wilddir,
+                                     fnmode|fnm_flags)->match(ff->fname)) != NULL) {
+            if (ff->flags & FO_EXCLUDE) {
+               Dmsg2(dbglvl, "Exclude wilddir: %s file=%s\n", pattern, ff->fname);
+               return false;          /* reject dir */
             }
+            return true;              /* accept dir */
          }
       } else {
-         for (k=0; k<fo->wildfile.size(); k++) {
-            if (match_func((char *)fo->wildfile.get(k), ff->fname, fnmode|fnm_flags) == 0) {
-               if (ff->flags & FO_EXCLUDE) {
-                  Dmsg2(dbglvl, "Exclude wildfile: %s file=%s\n", (char *)fo->wildfile.get(k),
-                     ff->fname);
-                  return false;       /* reject file */
-               }
-               return true;           /* accept file */
+         if (fo->wildfile.size() > 0 &&
+             (pattern = compile_wild(&fo->cwildfile, &fo->wildfile,
+                                     fnmode|fnm_flags)->match(ff->fname)) != NULL) {
+            if (ff->flags & FO_EXCLUDE) {
+               Dmsg2(dbglvl, "Exclude wildfile: %s file=%s\n", pattern, ff->fname);
+               return false;          /* reject file */
             }
+            return true;              /* accept file */
          }
 
-         for (k=0; k<fo->wildbase.size(); k++) {
-            if (match_func((char *)fo->wildbase.get(k), basename, fnmode|fnm_flags) == 0) {
-               if (ff->flags & FO_EXCLUDE) {
-                  Dmsg2(dbglvl, "Exclude wildbase: %s file=%s\n", (char *)fo->wildbase.get(k),
-                     basename);
-                  return false;       /* reject file */
-               }
-               return true;           /* accept file */
-            }
-         }
-      }
-      for (k=0; k<fo->wild.size(); k++) {
-         if (match_func((char *)fo->wild.get(k), ff->fname, fnmode|fnm_flags) == 0) {
+         if (fo->wildbase.size() > 0 &&
+             (pattern = compile_wild(&fo->cwildbase, &fo->wildbase,
+                                     fnmode|fnm_flags)->match(basename)) != NULL) {
             if (ff->flags & FO_EXCLUDE) {
-               Dmsg2(dbglvl, "Exclude wild: %s file=%s\n", (char *)fo->wild.get(k),
-                  ff->fname);
+               Dmsg2(dbglvl, "Exclude wildbase: %s file=%s\n", pattern, basename);
                return false;          /* reject file */
             }
             return true;              /* accept file */
          }
       }
+      if (fo->wild.size() > 0 &&
+          (pattern = compile_wild(&fo->cwild, &fo->wild,
+                                  fnmode|fnm_flags)->match(ff->fname)) != NULL) {
+         if (ff->flags & FO_EXCLUDE) {
+            Dmsg2(dbglvl, "Exclude wild: %s file=%s\n", pattern, ff->fname);
+            return false;             /* reject file */
+         }
+         return true;                 /* accept file */
+      }
       if (S_ISDIR(ff->statp.st_mode)) {
          for (k=0; k<fo->regexdir.size(); k++) {
-            const int nmatch = 30;
-            regmatch_t pmatch[nmatch];
-            if (regexec((regex_t *)fo->regexdir.get(k), ff->fname, nmatch, pmatch,  0) == 0) {
+            if (regexec((regex_t *)fo->regexdir.get(k), ff->fname, 0, NULL, 0) == 0) {
                if (ff->flags & FO_EXCLUDE) {
                   return false;       /* reject file */
                }
@@ -358,9 +415,7 @@ bool accept_file(FF_PKT *ff)
          }
       } else {
          for (k=0; k<fo->regexfile.size(); k++) {
-            const int nmatch = 30;
-            regmatch_t pmatch[nmatch];
-            if (regexec((regex_t *)fo->regexfile.get(k), ff->fname, nmatch, pmatch,  0) == 0) {
+            if (regexec((regex_t *)fo->regexfile.get(k), ff->fname, 0, NULL, 0) == 0) {
                if (ff->flags & FO_EXCLUDE) {
                   return false;       /* reject file */
                }
@@ -369,9 +424,7 @@ bool accept_file(FF_PKT *ff)
          }
       }
       for (k=0; k<fo->regex.size(); k++) {
-         const int nmatch = 30;
-         regmatch_t pmatch[nmatch];
-         if (regexec((regex_t *)fo->regex.get(k), ff->fname, nmatch, pmatch,  0) == 0) {
+         if (regexec((regex_t *)fo->regex.get(k), ff->fname, 0, NULL, 0) == 0) {
             if (ff->flags & FO_EXCLUDE) {
                return false;          /* reject file */
             }
@@ -398,11 +451,10 @@ bool accept_file(FF_PKT *ff)
       for (j=0; j<incexe->opts_list.size(); j++) {
          findFOPTS *fo = (findFOPTS *)incexe->opts_list.get(j);
          fnm_flags = (fo->flags & FO_IGNORECASE) ? FNM_CASEFOLD : 0;
-         for (k=0; k<fo->wild.size(); k++) {
-            if (fnmatch((char *)fo->wild.get(k), ff->fname, fnmode|fnm_flags) == 0) {
-               Dmsg1(dbglvl, "Reject wild1: %s\n", ff->fname);
-               return false;          /* reject file */
-            }
+         if (fo->wild.size() > 0 &&
+             compile_wild(&fo->cwild, &fo->wild, fnmode|fnm_flags)->match(ff->fname)) {
+            Dmsg1(dbglvl, "Reject wild1: %s\n", ff->fname);
+            return false;             /* reject file */
          }
       }
       /* FIXME: I don't think we can set Options{} inside an Exclude{}, so it is
@@ -412,13 +464,11 @@ bool accept_file(FF_PKT *ff)
        */
       fnm_flags = (incexe->current_opts != NULL && incexe->current_opts->flags & FO_IGNORECASE)
              ? FNM_CASEFOLD : 0;
-      dlistString *node;
-      foreach_dlist(node, &incexe->name_list) {
-         char *fname = node->c_str();
-         if (fnmatch(fname, ff->fname, fnmode|fnm_flags) == 0) {
-            Dmsg1(dbglvl, "Reject wild2: %s\n", ff->fname);
-            return false;          /* reject file */
-         }
+      if (incexe->name_list.size() > 0 &&
+          compile_wild(&incexe->cname_list, &incexe->name_list,
+                       fnmode|fnm_flags)->match(ff->fname)) {
+         Dmsg1(dbglvl, "Reject wild2: %s\n", ff->fname);
+         return false;             /* reject file */
       }
    }
    return true;
@@ -51,6 +51,7 @@ struct utimbuf {
 
 #include "lib/fnmatch.h"
 // #include "lib/enh_fnmatch.h"
+#include "wildset.h"
 
 #ifndef HAVE_REGEX_H
 #include "lib/bregex.h"
@@ -106,6 +107,10 @@ struct findFOPTS {
    alist base;                        /* list of base names */
    alist fstype;                      /* file system type limitation */
    alist drivetype;                   /* drive type limitation */
+   wild_set *cwild;                   /* compiled wild, set by accept_file() */
+   wild_set *cwilddir;                /* compiled wilddir */
+   wild_set *cwildfile;               /* compiled wildfile */
+   wild_set *cwildbase;               /* compiled wildbase */
 };
 
 
@@ -117,6 +122,7 @@ struct findINCEXE {
    dlist plugin_list;                 /* plugin list -- holds dlistString */
    char *ignoredir;                   /* ignore directories with this file */
    bool  list_drives;                 /* list drives on win32 (File=/) */
+   wild_set *cname_list;              /* compiled name_list of an Exclude{} */
 };
 
 /*
@@ -174,6 +180,7 @@ struct FF_PKT {
    struct f_link *linked;             /* Set if this file is hard linked */
    int type;                          /* FT_ type from above */
    int ff_errno;                      /* errno */
+   int stat_hist;                     /* histogram index of lstat() latency, 0 if none */
    BFILE bfd;                         /* Bacula file descriptor */
    time_t save_time;                  /* start of incremental time */
    bool accurate_found;               /* Found in the accurate hash (valid after check_changes()) */
@@ -406,11 +406,15 @@ find_one_file(JCR *jcr, FF_PKT *ff_pkt,
    struct utimbuf restore_times;
    int rtn_stat;
    int len;
+   btime_t stat_start;
 
    ff_pkt->fname = ff_pkt->link = fname;
    ff_pkt->snap_fname = snap_fname;
 
-   if (lstat(snap_fname, &ff_pkt->statp) != 0) {
+   stat_start = bhist_start();
+   rtn_stat = lstat(snap_fname, &ff_pkt->statp);
+   bhist_record(jcr, ff_pkt->stat_hist, stat_start);
+   if (rtn_stat != 0) {
        /* Cannot stat file */
        ff_pkt->type = FT_NOSTAT;
        ff_pkt->ff_errno = errno;
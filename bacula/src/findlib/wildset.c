@@ -0,0 +1,399 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+*/
+/*
+ * Compiled list of wild card patterns, see wildset.h
+ */
+
+#include "bacula.h"
+#include "find.h"
+
+static int fold_c(int c)
+{
+   return B_ISUPPER(c) ? tolower(c) : c;
+}
+
+static int literal_cmp(const void *a, const void *b)
+{
+   return strcmp(*(const char **)a, *(const char **)b);
+}
+
+/* Same order than strcmp() on the folded strings */
+static int literal_casecmp(const void *a, const void *b)
+{
+   const unsigned char *s1 = *(const unsigned char **)a;
+   const unsigned char *s2 = *(const unsigned char **)b;
+   int c1, c2;
+
+   do {
+      c1 = fold_c(*s1++);
+      c2 = fold_c(*s2++);
+   } while (c1 && c1 == c2);
+   return c1 - c2;
+}
+
+static void trie_init(wild_trie *t)
+{
+   t->max = 16;
+   t->nodes = (wild_node *)malloc(t->max * sizeof(wild_node));
+   t->size = 1;
+   t->nodes[0].child = t->nodes[0].next = -1;
+   t->nodes[0].fail = t->nodes[0].out = t->nodes[0].generic = -1;
+   t->nodes[0].pattern = NULL;
+   t->nodes[0].c = 0;
+}
+
+wild_set::wild_set(int flags):
+   m_flags(flags),
+   m_count(0),
+   m_sorted(true),
+   m_literals(NULL),
+   m_nb_literals(0),
+   m_max_literals(0),
+   m_linked(true),
+   m_stamp(0),
+   m_generic(NULL),
+   m_nb_generic(0),
+   m_max_generic(0)
+{
+   trie_init(&m_prefix);
+   trie_init(&m_suffix);
+   trie_init(&m_literal);
+}
+
+wild_set::~wild_set()
+{
+   free(m_prefix.nodes);
+   free(m_suffix.nodes);
+   free(m_literal.nodes);
+   if (m_literals) {
+      free(m_literals);
+   }
+   if (m_generic) {
+      free(m_generic);
+   }
+}
+
+/* Return the child of node for the folded character c, -1 if none */
+int32_t wild_set::trie_child(wild_trie *t, int32_t node, int c)
+{
+   for (node = t->nodes[node].child; node >= 0; node = t->nodes[node].next) {
+      if ((unsigned char)t->nodes[node].c == c) {
+         return node;
+      }
+   }
+   return -1;
+}
+
+/* Return the child of parent for c, create it if needed */
+int32_t wild_set::trie_add(wild_trie *t, int32_t parent, char c)
+{
+   int32_t i;
+
+   c = fold((unsigned char)c);
+   for (i = t->nodes[parent].child; i >= 0; i = t->nodes[i].next) {
+      if (t->nodes[i].c == c) {
+         return i;
+      }
+   }
+   if (t->size == t->max) {
+      t->max *= 2;
+      t->nodes = (wild_node *)realloc(t->nodes, t->max * sizeof(wild_node));
+   }
+   i = t->size++;
+   t->nodes[i].c = c;
+   t->nodes[i].pattern = NULL;
+   t->nodes[i].fail = t->nodes[i].out = t->nodes[i].generic = -1;
+   t->nodes[i].child = -1;
+   t->nodes[i].next = t->nodes[parent].child;
+   t->nodes[parent].child = i;
+   return i;
+}
+
+void wild_set::add(const char *pattern)
+{
+   const char *p, *start, *end, *lit = NULL;
+   int32_t node;
+   int lead = 0, trail = 0, len, lit_len = 0, run;
+   bool simple = true;
+
+   m_count++;
+   len = strlen(pattern);
+
+   /* Brackets, escapes and '?' are handled only by fnmatch() */
+   if (m_flags & (FNM_PERIOD|FNM_LEADING_DIR) || strpbrk(pattern, "[\\?")) {
+      simple = false;
+   }
+   for (start = pattern; *start == '*'; start++) {
+      lead++;
+   }
+   for (end = pattern + len; end > start && end[-1] == '*'; end--) {
+      trail++;
+   }
+   if (simple && memchr(start, '*', end - start)) {
+      simple = false;
+   }
+
+   if (simple && lead == 0 && trail == 0) {
+      if (m_nb_literals == m_max_literals) {
+         m_max_literals = m_max_literals ? m_max_literals * 2 : 16;
+         m_literals = (const char **)realloc(m_literals,
+                                            m_max_literals * sizeof(char *));
+      }
+      m_literals[m_nb_literals++] = pattern;
+      m_sorted = false;
+      return;
+   }
+   if (simple && lead == 0) {          /* literal* */
+      node = 0;
+      for (p = start; p < end; p++) {
+         node = trie_add(&m_prefix, node, *p);
+      }
+      m_prefix.nodes[node].pattern = pattern;
+      return;
+   }
+   if (simple && trail == 0) {         /* *literal */
+      node = 0;
+      for (p = end - 1; p >= start; p--) {
+         node = trie_add(&m_suffix, node, *p);
+      }
+      m_suffix.nodes[node].pattern = pattern;
+      return;
+   }
+
+   /*
+    * Keep the longest literal part to skip most of the fnmatch() calls,
+    *  the bracket expressions and the escaped characters are skipped.
+    */
+   for (p = pattern; *p; ) {
+      run = strcspn(p, "*?[\\");
+      if (run > lit_len) {
+         lit = p;
+         lit_len = run;
+      }
+      p += run;
+      if (*p == '\\') {
+         p += p[1] ? 2 : 1;
+      } else if (*p == '[') {
+         p++;
+         if (*p == '!' || *p == '^') {
+            p++;
+         }
+         if (*p == ']') {
+            p++;
+         }
+         while (*p && *p != ']') {
+            p++;
+         }
+         if (*p) {
+            p++;
+         }
+      } else if (*p) {
+         p++;
+      }
+   }
+   if (m_nb_generic == m_max_generic) {
+      m_max_generic = m_max_generic ? m_max_generic * 2 : 16;
+      m_generic = (wild_generic *)realloc(m_generic,
+                                          m_max_generic * sizeof(wild_generic));
+   }
+   wild_generic *g = &m_generic[m_nb_generic];
+   g->pattern = pattern;
+   g->has_literal = lit_len > 0;
+   g->next = -1;
+   g->seen = 0;
+   if (lit_len > 0) {
+      node = 0;
+      for (p = lit; p < lit + lit_len; p++) {
+         node = trie_add(&m_literal, node, *p);
+      }
+      /* Keep the patterns with the same literal in the list order */
+      if (m_literal.nodes[node].generic < 0) {
+         m_literal.nodes[node].generic = m_nb_generic;
+      } else {
+         int32_t i = m_literal.nodes[node].generic;
+         while (m_generic[i].next >= 0) {
+            i = m_generic[i].next;
+         }
+         m_generic[i].next = m_nb_generic;
+      }
+      m_linked = false;
+   }
+   m_nb_generic++;
+}
+
+/*
+ * Compute the failure links of the literal automaton, breadth first so
+ *  the link of the parent is known.
+ */
+void wild_set::link_literals()
+{
+   wild_node *n = m_literal.nodes;
+   int32_t *queue = (int32_t *)malloc(m_literal.size * sizeof(int32_t));
+   int32_t head = 0, tail = 0, node, child, f;
+
+   n[0].fail = 0;
+   for (child = n[0].child; child >= 0; child = n[child].next) {
+      n[child].fail = 0;
+      n[child].out = -1;
+      queue[tail++] = child;
+   }
+   while (head < tail) {
+      node = queue[head++];
+      for (child = n[node].child; child >= 0; child = n[child].next) {
+         int c = (unsigned char)n[child].c;
+         for (f = n[node].fail; f > 0 && trie_child(&m_literal, f, c) < 0; f = n[f].fail) { }
+         f = trie_child(&m_literal, f, c);
+         n[child].fail = (f >= 0 && f != child) ? f : 0;
+         f = n[child].fail;
+         n[child].out = n[f].generic >= 0 ? f : n[f].out;
+         queue[tail++] = child;
+      }
+   }
+   free(queue);
+   m_linked = true;
+}
+
+/* Mark the generic patterns whose literal part is in the string */
+void wild_set::find_literals(const char *str)
+{
+   wild_node *n = m_literal.nodes;
+   int32_t state = 0, next, o, i;
+
+   for ( ; *str; str++) {
+      int c = fold((unsigned char)*str);
+      while ((next = trie_child(&m_literal, state, c)) < 0 && state > 0) {
+         state = n[state].fail;
+      }
+      state = next >= 0 ? next : 0;
+      for (o = n[state].generic >= 0 ? state : n[state].out; o > 0; o = n[o].out) {
+         for (i = n[o].generic; i >= 0; i = m_generic[i].next) {
+            m_generic[i].seen = m_stamp;
+         }
+      }
+   }
+}
+
+/*
+ * Walk the prefix trie, with FNM_PATHNAME the '*' of "literal*" cannot
+ *  match a '/'
+ */
+const char *wild_set::match_prefix(const char *str, int len, const char *last_sep)
+{
+   int32_t node = 0;
+   int i = 0;
+
+   for ( ;; ) {
+      if (m_prefix.nodes[node].pattern &&
+          (!(m_flags & FNM_PATHNAME) || !last_sep || last_sep < str + i)) {
+         return m_prefix.nodes[node].pattern;
+      }
+      if (i == len) {
+         return NULL;
+      }
+      int c = fold((unsigned char)str[i++]);
+      for (node = m_prefix.nodes[node].child; node >= 0; node = m_prefix.nodes[node].next) {
+         if ((unsigned char)m_prefix.nodes[node].c == c) {
+            break;
+         }
+      }
+      if (node < 0) {
+         return NULL;
+      }
+   }
+}
+
+/*
+ * Walk the suffix trie, with FNM_PATHNAME the '*' of "*literal" cannot
+ *  match a '/'
+ */
+const char *wild_set::match_suffix(const char *str, int len, const char *first_sep)
+{
+   int32_t node = 0;
+   int i = len;
+
+   for ( ;; ) {
+      if (m_suffix.nodes[node].pattern &&
+          (!(m_flags & FNM_PATHNAME) || !first_sep || str + i <= first_sep)) {
+         return m_suffix.nodes[node].pattern;
+      }
+      if (i == 0) {
+         return NULL;
+      }
+      int c = fold((unsigned char)str[--i]);
+      for (node = m_suffix.nodes[node].child; node >= 0; node = m_suffix.nodes[node].next) {
+         if ((unsigned char)m_suffix.nodes[node].c == c) {
+            break;
+         }
+      }
+      if (node < 0) {
+         return NULL;
+      }
+   }
+}
+
+/* Return the pattern that matches str, or NULL */
+const char *wild_set::match(const char *str)
+{
+   const char *ret;
+   int len, i;
+
+   if (m_count == 0) {
+      return NULL;
+   }
+   len = strlen(str);
+   if (m_nb_literals > 0) {
+      int (*cmp)(const void *, const void *) =
+         (m_flags & FNM_CASEFOLD) ? literal_casecmp : literal_cmp;
+      if (!m_sorted) {
+         qsort(m_literals, m_nb_literals, sizeof(char *), cmp);
+         m_sorted = true;
+      }
+      const char **found = (const char **)bsearch(&str, m_literals, m_nb_literals,
+                                                  sizeof(char *), cmp);
+      if (found) {
+         return *found;
+      }
+   }
+   if (m_prefix.size > 1 || m_prefix.nodes[0].pattern) {
+      if ((ret = match_prefix(str, len, strrchr(str, '/'))) != NULL) {
+         return ret;
+      }
+   }
+   if (m_suffix.size > 1 || m_suffix.nodes[0].pattern) {
+      if ((ret = match_suffix(str, len, strchr(str, '/'))) != NULL) {
+         return ret;
+      }
+   }
+   if (m_nb_generic > 0) {
+      if (!m_linked) {
+         link_literals();
+      }
+      m_stamp++;
+      if (m_literal.size > 1) {
+         find_literals(str);
+      }
+      for (i = 0; i < m_nb_generic; i++) {
+         if ((!m_generic[i].has_literal || m_generic[i].seen == m_stamp) &&
+             fnmatch(m_generic[i].pattern, str, m_flags) == 0) {
+            return m_generic[i].pattern;
+         }
+      }
+   }
+   return NULL;
+}
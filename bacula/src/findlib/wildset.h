@@ -0,0 +1,100 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+*/
+/*
+ * Compiled list of wild card patterns
+ *
+ *  A FileSet Options{} can have hundreds of wild card patterns, and each
+ *  file was matched with fnmatch() against all of them. The patterns are
+ *  classified when the list is compiled:
+ *   - "literal"         exact strings, sorted and found with bsearch()
+ *   - "literal*"        in a prefix trie walked from the start of the name
+ *   - "*literal"        in a suffix trie walked from the end of the name
+ *                       (*.o, *.tmp, *~, ...)
+ *   - anything else     fnmatch(), only if the longest literal part of the
+ *                       pattern is in the name. All the literal parts are
+ *                       searched at once with an Aho-Corasick automaton.
+ *
+ *  The result of match() is the same than calling fnmatch() with each
+ *  pattern of the list. A wild_set must be used by one thread at a time.
+ */
+
+#ifndef __WILDSET_H
+#define __WILDSET_H
+
+/* Node of a prefix or suffix trie, the children are linked with next */
+struct wild_node {
+   int32_t child;                 /* First child, -1 if none */
+   int32_t next;                  /* Next sibling, -1 if none */
+   int32_t fail;                  /* Aho-Corasick failure link */
+   int32_t out;                   /* Next node of the failure chain with a literal */
+   int32_t generic;               /* First generic pattern with this literal, -1 if none */
+   const char *pattern;           /* Pattern that ends on this node */
+   char c;                        /* Character of this node */
+};
+
+struct wild_trie {
+   wild_node *nodes;              /* nodes[0] is the root */
+   int32_t size;
+   int32_t max;
+};
+
+/* Pattern that must be checked with fnmatch() */
+struct wild_generic {
+   const char *pattern;
+   bool has_literal;              /* The literal part must be found in the name */
+   int32_t next;                  /* Next pattern with the same literal, -1 if none */
+   uint32_t seen;                 /* Literal found during the match() number seen */
+};
+
+class wild_set: public SMARTALLOC {
+   int m_flags;                   /* fnmatch() flags */
+   int m_count;                   /* Number of patterns */
+   bool m_sorted;                 /* m_literals is sorted */
+   const char **m_literals;       /* Exact strings */
+   int m_nb_literals;
+   int m_max_literals;
+   wild_trie m_prefix;            /* "literal*" patterns */
+   wild_trie m_suffix;            /* "*literal" patterns, stored reversed */
+   wild_trie m_literal;           /* Literal parts of m_generic, Aho-Corasick */
+   bool m_linked;                 /* The failure links of m_literal are computed */
+   uint32_t m_stamp;              /* match() call number */
+   wild_generic *m_generic;       /* Other patterns */
+   int m_nb_generic;
+   int m_max_generic;
+
+   int fold(int c) {
+      return ((m_flags & FNM_CASEFOLD) && B_ISUPPER(c)) ? tolower(c) : c;
+   };
+   int32_t trie_add(wild_trie *t, int32_t parent, char c);
+   int32_t trie_child(wild_trie *t, int32_t node, int c);
+   void link_literals();
+   void find_literals(const char *str);
+   const char *match_prefix(const char *str, int len, const char *last_sep);
+   const char *match_suffix(const char *str, int len, const char *first_sep);
+
+public:
+   wild_set(int flags);
+   ~wild_set();
+   void add(const char *pattern);
+   const char *match(const char *str);
+   int size() { return m_count; };
+   int flags() { return m_flags; };
+};
+
+#endif /* __WILDSET_H */
@@ -145,6 +145,9 @@ class BSOCK;
 struct FF_PKT;
 class  BDB;
 struct ATTR_DBR;
+struct ATTR_DESPOOL;
+class path_hierarchy_list;
+class bwgroup;
 class Plugin;
 struct save_pkt;
 struct bpContext;
@@ -272,6 +275,8 @@ public:
    uint64_t ReadBytes;                /* Bytes read -- before compression */
    uint64_t CommBytes;                /* FD comm line bytes sent to SD */
    uint64_t CommCompressedBytes;      /* FD comm line compressed bytes sent to SD */
+   uint64_t phase_usec[BHIST_MAX];    /* Time spent in every measured phase, see bhistogram.h */
+   uint64_t phase_count[BHIST_MAX];   /* Operations done in every measured phase */
    FileId_t FileId;                   /* Last FileId used */
    volatile int32_t JobStatus;        /* ready, running, blocked, terminated */
    int32_t JobPriority;               /* Job priority */
@@ -320,6 +325,7 @@ public:
    uint64_t nb_base_files_used;       /* Number of useful files in base */
 
    ATTR_DBR *ar;                      /* DB attribute record */
+   path_hierarchy_list *path_hierarchy; /* Directories for the bvfs cache */
    guid_list *id_list;                /* User/group id to name list */
 
    bpContext *plugin_ctx_list;        /* list of contexts for plugins */
@@ -379,6 +385,9 @@ public:
    JOB_DBR previous_jr;               /* previous job database record */
    JOB *previous_job;                 /* Job resource of migration previous job */
    JCR *wjcr;                         /* JCR for migration/copy write job */
+   ATTR_DESPOOL *attr_despool;        /* Attributes despooled while the Job runs */
+   FILE *accurate_base;               /* Accurate state used by this Job */
+   POOLMEM *accurate_jobids;          /* JobIds of the accurate state */
    char FSCreateTime[MAX_TIME_LENGTH]; /* FileSet CreateTime as returned from DB */
    char since[MAX_NAME_LENGTH];       /* since time */
    char PrevJob[MAX_NAME_LENGTH];     /* Previous job name assiciated with since time */
@@ -498,7 +507,13 @@ public:
    JCR *prev_dev;                     /* previous JCR attached to device */
    dlist *jobmedia_queue;             /* JobMedia queue ***BEEF*** */
    dlist *filemedia_queue;            /* FileMedia queue ***BEEF*** */
+   int32_t jobmedia_pending;          /* JobMedia batches sent but not yet acknowledged */
+   POOLMEM *attr_batch;               /* File attributes not yet sent to the Director */
+   int32_t attr_batch_len;            /* length of the attr_batch data */
+   int32_t attr_batch_count;          /* number of records in attr_batch */
+   int64_t attr_checkpoint;           /* attr spool size at the last checkpoint sent to the Director */
    char *dir_auth_key;                /* Dir auth key */
+   bwgroup *bw_group;                 /* Bandwidth group of the FD connection */
    pthread_cond_t job_start_wait;     /* Wait for FD to start Job */
    int32_t type;
    DCR *read_dcr;                     /* device context for reading */
@@ -540,6 +555,8 @@ public:
    bool bscan_files_purged;           /* Flag for bscan to know if this jcr has purged files */
    bool sd_client;                    /* Set if acting as client */
    bool use_new_match_all;            /* TODO: Remove when the match_bsr() will be well tested */
+   void *vread_group;                 /* Volume reader of a vbackup (vbackup.c) */
+   void *vref;                        /* Extent references of the Job (vref.c) */
 
    int32_t fd_dedup;                  /* fdcaps dedup */
    int32_t fd_rehydration;            /* fdcaps rehydration */
@@ -285,6 +285,262 @@ bool save_metrics2graphite(COLLECTOR *collector, alist *list)
    return true;
 };
 
+/*
+ * Filters the metrics array list with a Metrics parameters from Statistics resource.
+ *
+ * in:
+ *    collector - the Statistics resource class
+ *    data - an array list of all metrics
+ * out:
+ *    an array list of filtered metrics which does not own its items or the data list itself
+ *       when no Metrics parameter is defined
+ */
+static alist *filter_metrics(COLLECTOR *collector, alist *data)
+{
+   alist *filtered;
+   bstatmetric *item;
+   char *filter;
+   char *fltm;
+   bool oper, toappend, prevmatch;
+   int match;
+
+   if (!collector->metrics){
+      return data;
+   }
+   /* have some metrics to filter */
+   filtered = New(alist(100, not_owned_by_alist));
+   /* iterate trough all metrics to filter it out */
+   foreach_alist(item, data){
+      Dmsg1(1500, "processing: %s\n", item->name);
+      toappend = true;
+      prevmatch = false;
+      foreach_alist(filter, collector->metrics){
+         fltm = filter;
+         oper = false;           // add filtered metric
+         if (filter[0] == '!'){
+            fltm = filter + 1;
+            oper = true;         // remove filtered metric
+         }
+         match = fnmatch(fltm, item->name, 0);
+         /* now we have to decide if metric should be filtered or not */
+         toappend = (!oper && match == 0) || (match !=0 && prevmatch);
+         prevmatch = match == 0;
+      }
+      if (toappend){
+         /* found */
+         Dmsg0(1500, "metric append\n");
+         filtered->append(item);
+      }
+   }
+   return filtered;
+};
+
+/*
+ * Render a Prometheus text exposition of the metric and store in the buffer.
+ *  The Prometheus metric name allows [a-zA-Z0-9_:] characters only, so any other
+ *  character of the Bacula metric name (i.e. a dot) is replaced with underscore.
+ *
+ * in:
+ *    collector - the Statistics resource class
+ *    out - the POLL_MEM buffer to render a metric to
+ *    item - metric to render
+ */
+void render_metric_prometheus(COLLECTOR *collector, POOL_MEM &out, bstatmetric *item)
+{
+   POOL_MEM name(PM_NAME);
+   POOL_MEM value(PM_NAME);
+   char *p;
+
+   if (collector->prefix){
+      Mmsg(name, "%s.%s", collector->prefix, item->name);
+   } else {
+      Mmsg(name, "%s", item->name);
+   }
+   for (p = name.c_str(); *p; p++){
+      if (!B_ISALPHA(*p) && !B_ISDIGIT(*p) && *p != '_' && *p != ':'){
+         *p = '_';
+      }
+   }
+   item->render_metric_value(value);
+   Mmsg(out, "# HELP %s %s\n# TYPE %s gauge\n%s %s\n", name.c_str(),
+        NPRTB(item->description), name.c_str(), name.c_str(), value.c_str());
+};
+
+static void prometheus_close(int fd)
+{
+#ifdef HAVE_WIN32
+   closesocket(fd);
+#else
+   close(fd);
+#endif
+};
+
+/*
+ * Opens a listening socket for Prometheus scrapes at Host:Port of the Statistics resource.
+ *  The metrics are not authenticated, so when Host is not defined the socket listens
+ *  on the loopback address only. Host = 0.0.0.0 (or ::) exposes them to the network.
+ *
+ * out:
+ *    the listening socket or -1 on error with collector->errmsg set
+ */
+static int prometheus_listen(COLLECTOR *collector)
+{
+   struct addrinfo hints, *res, *ai;
+   const char *host = collector->host ? collector->host : PROMETHEUS_DEFAULT_HOST;
+   char port[20];
+   int fd = -1;
+   int on = 1;
+   int status;
+
+   if (collector->port == 0){
+      Emsg1(M_ERROR, 0, "Port parameter required in Statistics Prometheus resource \"%s\".\n",
+            collector->hdr.name);
+      collector->lock();
+      Mmsg(collector->errmsg, "Port parameter required");
+      collector->unlock();
+      return -1;
+   }
+   memset(&hints, 0, sizeof(hints));
+   hints.ai_family = AF_UNSPEC;
+   hints.ai_socktype = SOCK_STREAM;
+   hints.ai_flags = AI_PASSIVE;
+   bsnprintf(port, sizeof(port), "%u", collector->port);
+   if ((status = getaddrinfo(host, port, &hints, &res)) != 0){
+      Emsg3(M_ERROR, 0, "Cannot resolve Statistics address %s:%s Err=%s\n",
+            host, port, gai_strerror(status));
+      collector->lock();
+      Mmsg(collector->errmsg, "Cannot resolve %s:%s Err=%s", host, port,
+           gai_strerror(status));
+      collector->unlock();
+      return -1;
+   }
+   for (ai = res; ai; ai = ai->ai_next){
+      if ((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0){
+         continue;
+      }
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (sockopt_val_t)&on, sizeof(on));
+      if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, 5) == 0){
+         break;
+      }
+      prometheus_close(fd);
+      fd = -1;
+   }
+   if (fd < 0){
+      berrno be;
+      Emsg3(M_ERROR, 0, "Cannot listen on Statistics address %s:%s Err=%s\n",
+            host, port, be.bstrerror());
+      collector->lock();
+      Mmsg(collector->errmsg, "Cannot listen on %s:%s Err=%s", host, port,
+           be.bstrerror());
+      collector->unlock();
+   }
+   freeaddrinfo(res);
+   return fd;
+};
+
+/*
+ * Answers a single HTTP request of Prometheus. Only "GET /metrics" is supported,
+ *  which returns all filtered metrics, the latency histograms and the phases of running jobs.
+ */
+static void serve_prometheus_request(COLLECTOR *collector, int fd)
+{
+   char req[1024];
+   int len = 0;
+   int n;
+   alist *data, *filtered;
+   bstatmetric *item;
+   const char *code;
+   POOL_MEM body(PM_MESSAGE);
+   POOL_MEM buf(PM_MESSAGE);
+
+   /* read the request header, wait up to 5 secs for a slow client */
+   req[0] = 0;
+   while (len < (int)sizeof(req) - 1 && fd_wait_data(fd, WAIT_READ, 5, 0) > 0){
+      n = recv(fd, req + len, sizeof(req) - 1 - len, 0);
+      if (n <= 0){
+         break;
+      }
+      len += n;
+      req[len] = 0;
+      if (strstr(req, "\r\n\r\n") || strstr(req, "\n\n")){
+         break;
+      }
+   }
+   Dmsg2(500, "%s prometheus request: %.40s\n", collector->hdr.name, req);
+   if (strncmp(req, "GET /metrics", 12) == 0 && (req[12] == ' ' || req[12] == '?')){
+      code = "200 OK";
+      data = collector->statcollector->get_all();
+      collector->updatetimestamp();
+      if (data){
+         filtered = filter_metrics(collector, data);
+         foreach_alist(item, filtered){
+            render_metric_prometheus(collector, buf, item);
+            pm_strcat(body, buf);
+         }
+         if (filtered != data){
+            delete(filtered);
+         }
+         free_metric_alist(data);
+      }
+      bhist_render_prometheus(body);
+   } else {
+      code = "404 Not Found";
+      pm_strcpy(body, "Not Found\n");
+   }
+   len = strlen(body.c_str());
+   Mmsg(buf, "HTTP/1.0 %s\r\nContent-Type: text/plain; version=0.0.4\r\n"
+        "Content-Length: %d\r\nConnection: close\r\n\r\n", code, len);
+   pm_strcat(buf, body);
+   len = strlen(buf.c_str());
+   for (char *p = buf.c_str(); len > 0; p += n, len -= n){
+      if ((n = send(fd, p, len, 0)) <= 0){
+         break;
+      }
+   }
+};
+
+/*
+ * Serves the metrics to Prometheus pointed by a Statistics parameters. Contrary to other
+ *  backends, Prometheus pulls the data, so the backend listens on Host:Port and renders
+ *  the metrics on request. The latency histograms are recorded while the backend runs.
+ *
+ * in:
+ *    collector - the Statistics resource class
+ * out:
+ *    False when the listening socket cannot be opened, True when the Statistics exited on request
+ */
+bool serve_metrics2prometheus(COLLECTOR *collector)
+{
+   int lfd, fd;
+   bool valid;
+
+   if ((lfd = prometheus_listen(collector)) < 0){
+      return false;
+   }
+   Dmsg2(100, "Statistics \"%s\" listening on port %d\n", collector->name(), collector->port);
+   bhist_enable(true);
+   for (;;){
+      collector->lock();
+      valid = collector->valid;
+      collector->unlock();
+      if (!valid){
+         break;
+      }
+      /* wake up every second to check if we have to exit */
+      if (fd_wait_data(lfd, WAIT_READ, 1, 0) <= 0){
+         continue;
+      }
+      if ((fd = accept(lfd, NULL, NULL)) < 0){
+         continue;
+      }
+      serve_prometheus_request(collector, fd);
+      prometheus_close(fd);
+   }
+   bhist_enable(false);
+   prometheus_close(lfd);
+   return true;
+};
+
 /*
  * The main Statistics backend thread function.
  */
@@ -293,12 +549,7 @@ void *collector_thread(void *arg)
 {
    COLLECTOR *collector;
    alist *data = NULL;
-   bstatmetric *item;
-   char *filter;
-   char *fltm;
    alist *filtered = NULL;
-   bool oper, toappend, prevmatch;
-   int match;
    bool status = true;
 
    collector = (COLLECTOR*)arg;
@@ -308,7 +559,8 @@ void *collector_thread(void *arg)
    collector->spooled = BCOLLECT_SPOOL_UNK;    /* when thread start we do not know if spooled */
    switch (collector->type){
       case COLLECTOR_BACKEND_CSV:
-         /* no spooling for CSV collector */
+      case COLLECTOR_BACKEND_Prometheus:
+         /* no spooling for CSV and Prometheus collectors */
          collector->spool_directory = NULL;
          break;
    }
@@ -316,6 +568,12 @@ void *collector_thread(void *arg)
    collector->errmsg[0] = 0;
    collector->unlock();
 
+   if (collector->type == COLLECTOR_BACKEND_Prometheus){
+      /* Prometheus pulls the metrics, so we serve them until asked to exit */
+      serve_metrics2prometheus(collector);
+      goto cleanup;
+   }
+
    while (status){
       collector->lock();
       if (!collector->valid){
@@ -330,35 +588,7 @@ void *collector_thread(void *arg)
       collector->updatetimestamp();
       if (data){
          /* we have some data to proceed */
-         if (collector->metrics){
-            /* have some metrics to filter */
-            filtered = New(alist(100, not_owned_by_alist));
-            /* iterate trough all metrics to filter it out */
-            foreach_alist(item, data){
-               Dmsg1(1500, "processing: %s\n", item->name);
-               toappend = true;
-               prevmatch = false;
-               foreach_alist(filter, collector->metrics){
-                  fltm = filter;
-                  oper = false;           // add filtered metric
-                  if (filter[0] == '!'){
-                     fltm = filter + 1;
-                     oper = true;         // remove filtered metric
-                  }
-                  match = fnmatch(fltm, item->name, 0);
-                  /* now we have to decide if metric should be filtered or not */
-                  toappend = (!oper && match == 0) || (match !=0 && prevmatch);
-                  prevmatch = match == 0;
-               }
-               if (toappend){
-                  /* found */
-                  Dmsg0(1500, "metric append\n");
-                  filtered->append(item);
-               }
-            }
-         } else {
-            filtered = data;
-         }
+         filtered = filter_metrics(collector, data);
          Dmsg1(1000, "collected metrics: %d\n", filtered->size());
          /* save data to destination */
          switch (collector->type){
@@ -539,6 +769,11 @@ void dump_collector_resource(COLLECTOR &res_collector, void sendit(void *sock, c
                res_collector.host ? res_collector.host : "localhost",
                res_collector.port);
          break;
+      case COLLECTOR_BACKEND_Prometheus:
+         sendit(sock, _("            listen host=%s port=%d\n"),
+               res_collector.host ? res_collector.host : PROMETHEUS_DEFAULT_HOST,
+               res_collector.port);
+         break;
    }
    if (res_collector.metrics){
       foreach_alist(metric, res_collector.metrics){
@@ -571,6 +806,11 @@ void dump_collector_resource(COLLECTOR &res_collector, void sendit(const char *m
                        OT_STRING, "port", res_collector.port,
                        OT_END);
          break;
+      case COLLECTOR_BACKEND_Prometheus:
+         ow.get_output(OT_STRING, "host", res_collector.host ? res_collector.host : PROMETHEUS_DEFAULT_HOST,
+                       OT_INT32,  "port", res_collector.port,
+                       OT_END);
+         break;
    }
    if (res_collector.metrics){
       foreach_alist(metric, res_collector.metrics){
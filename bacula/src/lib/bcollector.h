@@ -35,8 +35,12 @@ enum {
     COLLECTOR_BACKEND_Undef = 0,
     COLLECTOR_BACKEND_CSV,
     COLLECTOR_BACKEND_Graphite,
+    COLLECTOR_BACKEND_Prometheus,
 };
 
+/* Prometheus listens on the loopback address unless Host is set */
+#define PROMETHEUS_DEFAULT_HOST "127.0.0.1"
+
 /* spooling status for supported backends */
 enum {
     BCOLLECT_SPOOL_UNK,
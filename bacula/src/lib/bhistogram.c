@@ -0,0 +1,450 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+*/
+/*
+ * Latency histograms of the daemon hot operations and their rendering
+ *  in the Prometheus text exposition format.
+ */
+
+#include "bacula.h"
+#include "jcr.h"
+
+bool bhist_enabled = false;
+
+static pthread_mutex_t bhist_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bhistogram *bhist_table[BHIST_MAX];
+static int bhist_nr = 1;               /* index 0 is "not registered" */
+static int32_t bhist_users = 0;
+
+/* the cumulative buckets exposed to Prometheus are the powers of 4 in us */
+#define BHIST_PROM_MAX     15          /* 4^15us = 1073s */
+
+bhistogram::bhistogram(const char *hname, const char *descr)
+{
+   name = bstrdup(hname);
+   description = bstrdup(descr ? descr : "");
+   reset();
+}
+
+bhistogram::~bhistogram()
+{
+   free(name);
+   free(description);
+}
+
+void bhistogram::reset()
+{
+   count = sum = max = 0;
+   memset(buckets, 0, sizeof(buckets));
+}
+
+/*
+ * Return the bucket index of a value in us. The values below BHIST_SUB are
+ *  exact, the others use BHIST_SUB linear sub-buckets for each power of two.
+ */
+int bhistogram::bucket(uint64_t usec)
+{
+   int e;
+
+   if (usec < BHIST_SUB) {
+      return (int)usec;
+   }
+   e = 63 - __builtin_clzll(usec);
+   if (e > BHIST_MAX_EXP) {
+      return BHIST_BUCKETS - 1;
+   }
+   return BHIST_SUB + (e - BHIST_SUB_BITS) * BHIST_SUB +
+      (int)((usec >> (e - BHIST_SUB_BITS)) & (BHIST_SUB - 1));
+}
+
+/*
+ * Return the exclusive upper bound of a bucket in us.
+ */
+uint64_t bhistogram::bucket_upper(int b)
+{
+   int e, sub;
+
+   if (b < BHIST_SUB) {
+      return b + 1;
+   }
+   e = (b - BHIST_SUB) / BHIST_SUB;
+   sub = (b - BHIST_SUB) % BHIST_SUB;
+   return (uint64_t)(BHIST_SUB + sub + 1) << e;
+}
+
+void bhistogram::record(uint64_t usec)
+{
+   uint64_t cur;
+
+   __sync_fetch_and_add(&buckets[bucket(usec)], 1);
+   __sync_fetch_and_add(&sum, usec);
+   __sync_fetch_and_add(&count, 1);
+   cur = max;
+   while (usec > cur) {
+      if (__sync_bool_compare_and_swap(&max, cur, usec)) {
+         break;
+      }
+      cur = max;
+   }
+}
+
+/*
+ * Return the value in us below which a fraction p (0..1) of the recorded
+ *  values fall, rounded to the upper bound of its bucket.
+ */
+uint64_t bhistogram::percentile(double p)
+{
+   uint64_t total = 0, target, cumul = 0;
+   uint64_t val;
+   int i;
+
+   for (i = 0; i < BHIST_BUCKETS; i++) {
+      total += buckets[i];
+   }
+   if (total == 0) {
+      return 0;
+   }
+   target = (uint64_t)(p * total + 0.999999);
+   if (target < 1) {
+      target = 1;
+   }
+   for (i = 0; i < BHIST_BUCKETS; i++) {
+      cumul += buckets[i];
+      if (cumul >= target) {
+         break;
+      }
+   }
+   val = bucket_upper(i) - 1;
+   return val > max ? max : val;
+}
+
+/*
+ * Register a histogram and return its index, 0 when the registry is full.
+ *  The same index is returned when the name is already registered.
+ */
+int bhist_register(const char *name, const char *descr)
+{
+   int i, idx = 0;
+
+   P(bhist_mutex);
+   for (i = 1; i < bhist_nr; i++) {
+      if (strcmp(bhist_table[i]->name, name) == 0) {
+         idx = i;
+         goto bail_out;
+      }
+   }
+   if (bhist_nr < BHIST_MAX) {
+      idx = bhist_nr;
+      bhist_table[idx] = New(bhistogram(name, descr));
+      bhist_nr++;
+   }
+bail_out:
+   V(bhist_mutex);
+   return idx;
+}
+
+bhistogram *bhist_get(int idx)
+{
+   if (idx <= 0 || idx >= bhist_nr) {
+      return NULL;
+   }
+   return bhist_table[idx];
+}
+
+/*
+ * Enable or disable the recording, each enable must be paired with a disable.
+ */
+void bhist_enable(bool enable)
+{
+   int32_t users;
+
+   if (enable) {
+      users = __sync_add_and_fetch(&bhist_users, 1);
+   } else {
+      users = __sync_sub_and_fetch(&bhist_users, 1);
+   }
+   bhist_enabled = users > 0;
+}
+
+void bhist_reset_all()
+{
+   int i;
+
+   P(bhist_mutex);
+   for (i = 1; i < bhist_nr; i++) {
+      bhist_table[i]->reset();
+   }
+   V(bhist_mutex);
+}
+
+/*
+ * Release the registry at the daemon termination.
+ */
+void bhist_term()
+{
+   int i;
+
+   P(bhist_mutex);
+   bhist_enabled = false;
+   for (i = 1; i < bhist_nr; i++) {
+      delete bhist_table[i];
+      bhist_table[i] = NULL;
+   }
+   bhist_nr = 1;
+   V(bhist_mutex);
+}
+
+btime_t bhist_now()
+{
+#ifdef HAVE_WIN32
+   return get_current_btime();
+#else
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (btime_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+void bhist_record_time(JCR *jcr, int idx, btime_t start)
+{
+   bhistogram *hist = bhist_get(idx);
+   btime_t usec;
+
+   if (!hist) {
+      return;
+   }
+   usec = bhist_now() - start;
+   if (usec < 0) {
+      usec = 0;
+   }
+   hist->record(usec);
+   if (jcr) {
+      __sync_fetch_and_add(&jcr->phase_usec[idx], (uint64_t)usec);
+      __sync_fetch_and_add(&jcr->phase_count[idx], 1);
+   }
+}
+
+/* render a value in us as seconds without loss of precision */
+static char *edit_usec_as_sec(uint64_t usec, char *buf, int len)
+{
+   bsnprintf(buf, len, "%llu.%06llu", (unsigned long long)(usec / 1000000),
+             (unsigned long long)(usec % 1000000));
+   return buf;
+}
+
+static void render_histogram(POOL_MEM &out, bhistogram *hist)
+{
+   POOL_MEM tmp(PM_MESSAGE);
+   uint64_t snap[BHIST_BUCKETS];
+   uint64_t cumul = 0, bound = 1, sum;
+   char ed1[50], ed2[50];
+   int i, k = 0;
+
+   memcpy(snap, hist->buckets, sizeof(snap));
+   sum = hist->sum;
+   Mmsg(tmp, "# HELP bacula_%s_seconds %s\n# TYPE bacula_%s_seconds histogram\n",
+        hist->name, hist->description, hist->name);
+   pm_strcat(out, tmp);
+   for (i = 0; i < BHIST_BUCKETS; i++) {
+      cumul += snap[i];
+      if (k <= BHIST_PROM_MAX && bhistogram::bucket_upper(i) == bound) {
+         Mmsg(tmp, "bacula_%s_seconds_bucket{le=\"%s\"} %s\n", hist->name,
+              edit_usec_as_sec(bound, ed1, sizeof(ed1)), edit_uint64(cumul, ed2));
+         pm_strcat(out, tmp);
+         bound <<= 2;
+         k++;
+      }
+   }
+   Mmsg(tmp, "bacula_%s_seconds_bucket{le=\"+Inf\"} %s\n", hist->name, edit_uint64(cumul, ed2));
+   pm_strcat(out, tmp);
+   Mmsg(tmp, "bacula_%s_seconds_sum %s\nbacula_%s_seconds_count %s\n",
+        hist->name, edit_usec_as_sec(sum, ed1, sizeof(ed1)),
+        hist->name, edit_uint64(cumul, ed2));
+   pm_strcat(out, tmp);
+}
+
+/*
+ * Render the time spent by the running jobs in every phase.
+ */
+static void render_job_phases(POOL_MEM &out)
+{
+   POOL_MEM sec(PM_MESSAGE);
+   POOL_MEM ops(PM_MESSAGE);
+   POOL_MEM tmp(PM_MESSAGE);
+   char ed1[50], ed2[50];
+   JCR *jcr;
+   int i, nr;
+
+   P(bhist_mutex);
+   nr = bhist_nr;
+   V(bhist_mutex);
+
+   foreach_jcr(jcr) {
+      if (jcr->JobId == 0) {
+         continue;
+      }
+      for (i = 1; i < nr; i++) {
+         if (jcr->phase_count[i] == 0) {
+            continue;
+         }
+         Mmsg(tmp, "bacula_job_phase_seconds_total{jobid=\"%s\",job=\"%s\",phase=\"%s\"} %s\n",
+              edit_uint64(jcr->JobId, ed1), jcr->Job, bhist_table[i]->name,
+              edit_usec_as_sec(jcr->phase_usec[i], ed2, sizeof(ed2)));
+         pm_strcat(sec, tmp);
+         Mmsg(tmp, "bacula_job_phase_operations_total{jobid=\"%s\",job=\"%s\",phase=\"%s\"} %s\n",
+              edit_uint64(jcr->JobId, ed1), jcr->Job, bhist_table[i]->name,
+              edit_uint64(jcr->phase_count[i], ed2));
+         pm_strcat(ops, tmp);
+      }
+   }
+   endeach_jcr(jcr);
+
+   pm_strcat(out, "# HELP bacula_job_phase_seconds_total Time spent by the running jobs in every phase.\n"
+                  "# TYPE bacula_job_phase_seconds_total counter\n");
+   pm_strcat(out, sec);
+   pm_strcat(out, "# HELP bacula_job_phase_operations_total Operations done by the running jobs in every phase.\n"
+                  "# TYPE bacula_job_phase_operations_total counter\n");
+   pm_strcat(out, ops);
+}
+
+/*
+ * Append all the histograms and the running jobs phases to the buffer in
+ *  the Prometheus text exposition format.
+ */
+void bhist_render_prometheus(POOL_MEM &out)
+{
+   int i, nr;
+
+   P(bhist_mutex);
+   nr = bhist_nr;
+   V(bhist_mutex);
+   for (i = 1; i < nr; i++) {
+      render_histogram(out, bhist_table[i]);
+   }
+   render_job_phases(out);
+}
+
+#ifndef TEST_PROGRAM
+#define TEST_PROGRAM_A
+#endif
+
+#ifdef TEST_PROGRAM
+#include "unittests.h"
+
+static void *th_record(void *arg)
+{
+   bhistogram *hist = (bhistogram *)arg;
+
+   for (int i = 0; i < 100000; i++) {
+      hist->record(i % 1000);
+   }
+   return NULL;
+}
+
+int main()
+{
+   Unittests hist_test("bhistogram_test", true);
+   bhistogram *hist;
+   JCR *jcr;
+   POOL_MEM out(PM_MESSAGE);
+   pthread_t th[4];
+   uint64_t v, p50, p99;
+   bool ok;
+   int i, b, idx, idx2;
+
+   /* the bucket bounds are consistent with the buckets */
+   ok = true;
+   for (v = 0; v < (1 << 20); v += 7) {
+      b = bhistogram::bucket(v);
+      if (v >= bhistogram::bucket_upper(b) || (b > 0 && v < bhistogram::bucket_upper(b - 1))) {
+         ok = false;
+         break;
+      }
+   }
+   ok(ok, "Bucket bounds");
+   ok(bhistogram::bucket((uint64_t)1 << 50) == BHIST_BUCKETS - 1, "Clamp large values");
+
+   /* relative error of the bucket width */
+   ok = true;
+   for (b = BHIST_SUB; b < BHIST_BUCKETS - 1; b++) {
+      uint64_t lo = bhistogram::bucket_upper(b - 1), hi = bhistogram::bucket_upper(b);
+      if ((hi - lo) * BHIST_SUB > lo) {
+         ok = false;
+      }
+   }
+   ok(ok, "Bucket width below 1/16");
+
+   hist = New(bhistogram("test", "A test histogram."));
+   for (v = 1; v <= 10000; v++) {
+      hist->record(v);
+   }
+   ok(hist->count == 10000, "Count");
+   ok(hist->sum == 50005000, "Sum");
+   ok(hist->max == 10000, "Max");
+   p50 = hist->percentile(0.5);
+   p99 = hist->percentile(0.99);
+   ok(p50 >= 5000 && p50 <= 5000 * 17 / 16, "p50 within 1/16");
+   ok(p99 >= 9900 && p99 <= 10000, "p99 within 1/16");
+   ok(hist->percentile(1.0) == 10000, "p100 is max");
+
+   hist->reset();
+   ok(hist->count == 0 && hist->percentile(0.5) == 0, "Reset");
+   for (i = 0; i < 4; i++) {
+      pthread_create(&th[i], NULL, th_record, hist);
+   }
+   for (i = 0; i < 4; i++) {
+      pthread_join(th[i], NULL);
+   }
+   ok(hist->count == 400000, "Concurrent count");
+   ok(hist->sum == 4 * 100 * 499500, "Concurrent sum");
+   delete hist;
+
+   idx = bhist_register("test_op", "A test operation.");
+   idx2 = bhist_register("test_op2", "Another test operation.");
+   ok(idx > 0 && idx2 > 0 && idx != idx2, "Register");
+   ok(bhist_register("test_op", "A test operation.") == idx, "Register twice");
+   ok(bhist_start() == 0, "Disabled by default");
+   bhist_enable(true);
+   ok(bhist_start() > 0, "Enable");
+   jcr = new_jcr(sizeof(JCR), NULL);
+   jcr->JobId = 12;
+   bstrncpy(jcr->Job, "Backup.2022-06-01_10.00.00_01", sizeof(jcr->Job));
+   bhist_record(jcr, idx, bhist_start());
+   ok(jcr->phase_count[idx] == 1 && jcr->phase_count[idx2] == 0, "Record job phase");
+   bhist_get(idx)->record(3000);
+   bhist_get(idx)->record(70000000);
+   bhist_render_prometheus(out);
+   ok(strstr(out.c_str(), "# TYPE bacula_test_op_seconds histogram\n") != NULL, "Render type");
+   ok(strstr(out.c_str(), "bacula_test_op_seconds_bucket{le=\"0.004096\"} 2\n") != NULL, "Render bucket");
+   ok(strstr(out.c_str(), "bacula_test_op_seconds_bucket{le=\"1073.741824\"} 3\n") != NULL, "Render last bucket");
+   ok(strstr(out.c_str(), "bacula_test_op_seconds_bucket{le=\"+Inf\"} 3\n") != NULL, "Render +Inf");
+   ok(strstr(out.c_str(), "bacula_test_op_seconds_count 3\n") != NULL, "Render count");
+   ok(strstr(out.c_str(), "bacula_test_op2_seconds_count 0\n") != NULL, "Render empty");
+   ok(strstr(out.c_str(), "bacula_job_phase_operations_total{jobid=\"12\",job=\"Backup.2022-06-01_10.00.00_01\",phase=\"test_op\"} 1\n") != NULL, "Render job phase");
+   ok(strstr(out.c_str(), "phase=\"test_op2\"") == NULL, "Skip unused job phase");
+   free_jcr(jcr);
+   bhist_enable(false);
+   ok(bhist_start() == 0, "Disable");
+   bhist_reset_all();
+   ok(bhist_get(idx)->count == 0, "Reset all");
+   bhist_term();
+   ok(bhist_get(idx) == NULL, "Term");
+   term_last_jobs_list();
+   return report();
+}
+#endif /* TEST_PROGRAM */
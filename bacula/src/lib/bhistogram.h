@@ -0,0 +1,90 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+*/
+/*
+ * Latency histograms of the daemon hot operations.
+ *
+ * Every histogram is log-linear (HDR style): the values are recorded in
+ *  microseconds, exactly below 16us, then with 16 sub-buckets for every power
+ *  of two, so the relative error of a percentile is below 6.25%. The counters
+ *  are updated with atomic operations, so no lock is taken on the hot path.
+ *
+ * Each recorded operation is also accumulated in the JCR of the job, so the
+ *  time spent by a job in every phase can be reported while the job runs.
+ *
+ * Nothing is measured until bhist_enable() is called, which is done when
+ *  a Prometheus Statistics resource is started.
+ */
+
+#ifndef __BHISTOGRAM_H_
+#define __BHISTOGRAM_H_
+
+#define BHIST_MAX          24          /* max histograms per daemon, index 0 is unused */
+#define BHIST_SUB_BITS     4
+#define BHIST_SUB          (1 << BHIST_SUB_BITS)
+#define BHIST_MAX_EXP      36          /* values over 2^36us (~19h) are clamped */
+#define BHIST_BUCKETS      (BHIST_SUB + (BHIST_MAX_EXP - BHIST_SUB_BITS + 1) * BHIST_SUB)
+
+class bhistogram : public SMARTALLOC {
+public:
+   char *name;                         /* the phase name, i.e. "fd_file_read" */
+   char *description;                  /* the help text */
+   uint64_t count;                     /* number of recorded values */
+   uint64_t sum;                       /* sum of recorded values in us */
+   uint64_t max;                       /* max recorded value in us */
+   uint64_t buckets[BHIST_BUCKETS];
+
+   bhistogram(const char *hname, const char *descr);
+   ~bhistogram();
+   void record(uint64_t usec);
+   void reset();
+   uint64_t percentile(double p);
+   static int bucket(uint64_t usec);
+   static uint64_t bucket_upper(int b);
+};
+
+/* the registry of the daemon histograms */
+int bhist_register(const char *name, const char *descr);
+bhistogram *bhist_get(int idx);
+void bhist_enable(bool enable);
+void bhist_reset_all();
+void bhist_term();
+void bhist_render_prometheus(POOL_MEM &out);
+
+extern bool bhist_enabled;
+
+/* monotonic time in us */
+btime_t bhist_now();
+
+/* start of a measured operation, 0 when the histograms are disabled */
+inline btime_t bhist_start()
+{
+   return bhist_enabled ? bhist_now() : 0;
+}
+
+/* record the time elapsed since bhist_start() for the job and the daemon */
+void bhist_record_time(JCR *jcr, int idx, btime_t start);
+
+inline void bhist_record(JCR *jcr, int idx, btime_t start)
+{
+   if (start && idx > 0) {
+      bhist_record_time(jcr, idx, start);
+   }
+}
+
+#endif /* __BHISTOGRAM_H_ */
@@ -439,6 +439,10 @@ int32_t BSOCK::recv()
    if (errors || is_terminated() || is_closed()) {
       return BNET_HARDEOF;
    }
+   /* The answer may depend on what is still in the write buffer */
+   if (!flush()) {
+      return BNET_HARDEOF;
+   }
    if (m_use_locking) {
       pP(pm_rmutex);
       locked = true;
@@ -663,15 +667,22 @@ bool BSOCK::signal(int signal)
 /*
  * Despool spooled attributes
  */
-bool BSOCK::despool(void update_attr_spool_size(ssize_t size), ssize_t tsize)
+bool BSOCK::despool(void update_attr_spool_size(ssize_t size), ssize_t tsize,
+                    boffset_t start)
 {
    int32_t pktsiz;
    size_t nbytes;
-   ssize_t last = 0, size = 0;
+   ssize_t last = 0, size = start;
    int count = 0;
    JCR *jcr = get_jcr();
 
-   rewind(m_spool_fd);
+   /* The records before start are already in the catalog */
+   if (fseeko(m_spool_fd, start, SEEK_SET) != 0) {
+      berrno be;
+      Qmsg1(jcr, M_FATAL, 0, _("fseek attr spool error. ERR=%s\n"), be.bstrerror());
+      update_attr_spool_size(tsize);
+      return false;
+   }
 
 #if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_WILLNEED)
    posix_fadvise(fileno(m_spool_fd), 0, 0, POSIX_FADV_WILLNEED);
@@ -888,6 +899,7 @@ BSOCK *dup_bsock(BSOCK *osock)
    bsock->msg = msg;
    bsock->cmsg = cmsg;
    bsock->errmsg = errmsg;
+   bsock->init_buffered();
    if (osock->who()) {
       bsock->set_who(bstrdup(osock->who()));
    }
@@ -952,6 +964,8 @@ int main()
    bool btest;
    char buf[256];       // extend this buffer when hexdata becomes longer
    int fd;
+   int sv[2];
+   struct sockaddr sa;
 
    Pmsg0(0, "Initialize tests ...\n");
 
@@ -961,6 +975,49 @@ int main()
    ok(bs != NULL && bs->jcr() == jcr,
          "Default initialization");
 
+   /* Buffered I/O, the messages must be received unchanged */
+   bmemzero(&sa, sizeof(sa));
+   if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0) {
+      BSOCK *bw = init_bsock(jcr, sv[0], "writer", "localhost", 0, &sa);
+      BSOCK *br = init_bsock(jcr, sv[1], "reader", "localhost", 0, &sa);
+      int i, nok = 0;
+
+      bw->set_buffered(1000, BNET_SETBUF_WRITE);
+      br->set_buffered(512, BNET_SETBUF_READ);
+      ok(bw->is_buffered() && br->is_buffered(), "Set buffered I/O");
+      for (i = 0; i < 100; i++) {
+         bw->msg = check_pool_memory_size(bw->msg, 3000);
+         bw->msglen = (i * 37) % 2000;
+         memset(bw->msg, 'a' + (i % 26), bw->msglen);
+         bw->send();
+      }
+      bw->signal(BNET_EOD);
+      ok(bw->flush(), "Flush write buffer");
+      for (i = 0; i < 100; i++) {
+         if (br->recv() == (i * 37) % 2000 &&
+             (br->msglen == 0 || (br->msg[0] == 'a' + (i % 26) &&
+                                  br->msg[br->msglen - 1] == 'a' + (i % 26)))) {
+            nok++;
+         }
+      }
+      ok(nok == 100, "Receive buffered messages");
+      ok(br->wait_data(0) == 1, "Pending data in read-ahead buffer");
+      ok(br->recv() == BNET_SIGNAL && br->msglen == BNET_EOD, "Receive signal");
+      /* Flushed by the heartbeat thread, so with the locking */
+      bw->set_locking();
+      bw->fsend("stale");
+      ok(bw->flush_stale() && fd_wait_data(sv[1], WAIT_READ, 0, 0) == 0,
+         "Keep a recent buffered message");
+      bmicrosleep(0, BSOCK_FLUSH_DELAY + 50000);
+      ok(bw->flush_stale() && br->wait_data(1) == 1 && br->recv() == 5,
+         "Send a stale buffered message");
+      bw->clear_buffered(BNET_SETBUF_WRITE);
+      br->clear_buffered(BNET_SETBUF_READ);
+      ok(!bw->is_buffered() && !br->is_buffered(), "Clear buffered I/O");
+      bw->destroy();
+      br->destroy();
+   }
+
    Pmsg0(0, "Preparing fork\n");
    pid = fork();
    if (0 == pid){
@@ -88,7 +88,8 @@ public:
    bool signal(int signal);
    void close();              /* close connection and destroy packet */
    bool comm_compress();               /* in bsock.c */
-   bool despool(void update_attr_spool_size(ssize_t size), ssize_t tsize);
+   bool despool(void update_attr_spool_size(ssize_t size), ssize_t tsize,
+                boffset_t start=0);
 #if 0
    bool authenticate_director(const char *name, const char *password,
            TLS_CONTEXT *tls_ctx, char *response, int response_len);
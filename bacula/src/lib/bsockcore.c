@@ -38,6 +38,9 @@
 #include "jcr.h"
 #include <netdb.h>
 #include <netinet/tcp.h>
+#ifndef HAVE_WIN32
+#include <sys/uio.h>
+#endif
 
 #define BSOCKCORE_DEBUG_LVL    900
 
@@ -182,7 +185,16 @@ BSOCKCORE::BSOCKCORE() :
    m_bandwidth(0),
    m_nb_bytes(0),
    m_last_tick(0),
-   m_rtt(0)
+   m_rtt(0),
+   m_bwgroup(NULL),
+   m_wbuf(NULL),
+   m_wbuf_len(0),
+   m_wbuf_size(0),
+   m_wbuf_time(0),
+   m_rbuf(NULL),
+   m_rbuf_pos(0),
+   m_rbuf_len(0),
+   m_rbuf_size(0)
 {
    pthread_mutex_init(&m_rmutex, NULL);
    pthread_mutex_init(&m_wmutex, NULL);
@@ -667,6 +679,9 @@ int32_t BSOCKCORE::recvn(int len)
 
    if (len > 0) {
       /* do read only when len > 0 */
+      if (!flush()) {
+         return -1;
+      }
       if (m_use_locking) {
          pP(pm_rmutex);
          locked = true;
@@ -958,6 +973,10 @@ void BSOCKCORE::restore_blocking (int flags)
  */
 int BSOCKCORE::wait_data(int sec, int msec)
 {
+   if (has_pending_data()) {
+      return 1;                    /* already in the read-ahead buffer */
+   }
+   flush();
    for (;;) {
       switch (fd_wait_data(m_fd, WAIT_READ, sec, msec)) {
       case 0:                      /* timeout */
@@ -986,6 +1005,10 @@ int BSOCKCORE::wait_data(int sec, int msec)
  */
 int BSOCKCORE::wait_data_intr(int sec, int msec)
 {
+   if (has_pending_data()) {
+      return 1;
+   }
+   flush();
    switch (fd_wait_data(m_fd, WAIT_READ, sec, msec)) {
    case 0:                      /* timeout */
       b_errno = 0;
@@ -1044,6 +1067,9 @@ void BSOCKCORE::close()
    if (bsock->is_closed()) {
       return;
    }
+   if (!m_duped && !is_timed_out()) {
+      flush();                     /* send what is still in the write buffer */
+   }
    if (!m_duped) {
       clear_locking();
    }
@@ -1100,6 +1126,14 @@ void BSOCKCORE::_destroy()
       free(src_addr);
       src_addr = NULL;
    }
+   if (m_wbuf) {
+      free_pool_memory(m_wbuf);
+      m_wbuf = NULL;
+   }
+   if (m_rbuf) {
+      free_pool_memory(m_rbuf);
+      m_rbuf = NULL;
+   }
 }
 
 /*
@@ -1135,6 +1169,14 @@ void BSOCKCORE::control_bwlimit(int bytes)
       return;
    }
 
+   /* The bandwidth shared with other connections is checked first */
+   if (m_bwgroup) {
+      m_bwgroup->control_bwlimit(bytes);
+   }
+   if (m_bwlimit <= 0) {
+      return;
+   }
+
    now = get_current_btime();          /* microseconds */
    temp = now - m_last_tick;           /* microseconds */
 
@@ -1175,11 +1217,24 @@ void BSOCKCORE::control_bwlimit(int bytes)
  */
 
 int32_t BSOCKCORE::write_nbytes(char *ptr, int32_t nbytes)
+{
+   if (m_wbuf) {
+      return write_buffered(ptr, nbytes);
+   }
+   return write_direct(ptr, nbytes);
+}
+
+/*
+ * Write nbytes to the network without going through
+ *  the write buffer.
+ */
+int32_t BSOCKCORE::write_direct(char *ptr, int32_t nbytes)
 {
    int32_t nleft, nwritten;
 
 #ifdef HAVE_TLS
-   if (tls) {
+   /* With kernel TLS, the socket encrypts what we write */
+   if (tls && !tls_bsock_ktls_send(tls)) {
       /* TLS enabled */
       return (tls_bsock_writen((BSOCK*)this, ptr, nbytes));
    }
@@ -1234,6 +1289,241 @@ int32_t BSOCKCORE::write_nbytes(char *ptr, int32_t nbytes)
    return nbytes - nleft;
 }
 
+/*
+ * Small writes (typically the many small messages of a backup) are
+ *  copied into the write buffer and sent when the buffer is full, when
+ *  the oldest byte is waiting for more than BSOCK_FLUSH_DELAY, or when
+ *  flush() is called. A write that does not fit is sent along with the
+ *  buffered data in a single writev().
+ */
+int32_t BSOCKCORE::write_buffered(char *ptr, int32_t nbytes)
+{
+   if (m_wbuf_len + nbytes <= m_wbuf_size) {
+      if (m_wbuf_len == 0) {
+         m_wbuf_time = get_current_btime();
+      }
+      memcpy(m_wbuf + m_wbuf_len, ptr, nbytes);
+      m_wbuf_len += nbytes;
+      if (m_wbuf_len == m_wbuf_size ||
+          get_current_btime() - m_wbuf_time > BSOCK_FLUSH_DELAY) {
+         if (!flush_wbuf()) {
+            return -1;
+         }
+      }
+      return nbytes;
+   }
+#ifndef HAVE_WIN32
+   if (m_wbuf_len > 0 && (!tls || tls_bsock_ktls_send(tls))) {
+      return writev_nbytes(ptr, nbytes);
+   }
+#endif
+   if (!flush_wbuf()) {
+      return -1;
+   }
+   return write_direct(ptr, nbytes);
+}
+
+#ifndef HAVE_WIN32
+/*
+ * Send the write buffer followed by nbytes from ptr
+ */
+int32_t BSOCKCORE::writev_nbytes(char *ptr, int32_t nbytes)
+{
+   struct iovec iov[2], *vec = iov;
+   int iovcnt = 2;
+   int32_t nleft, nwritten;
+
+   iov[0].iov_base = m_wbuf;
+   iov[0].iov_len = m_wbuf_len;
+   iov[1].iov_base = ptr;
+   iov[1].iov_len = nbytes;
+   nleft = m_wbuf_len + nbytes;
+   m_wbuf_len = 0;
+
+   while (nleft > 0) {
+      errno = 0;
+      nwritten = ::writev(m_fd, vec, iovcnt);
+      if (is_timed_out() || is_terminated()) {
+         return -1;
+      }
+      if (nwritten == -1 && errno == EINTR) {
+         continue;
+      }
+      if (nwritten == -1 && errno == EAGAIN) {
+         fd_wait_data(m_fd, WAIT_WRITE, 1, 0);
+         continue;
+      }
+      if (nwritten <= 0) {
+         return -1;                /* error */
+      }
+      nleft -= nwritten;
+      if (use_bwlimit()) {
+         control_bwlimit(nwritten);
+      }
+      /* Skip what was accepted by the kernel */
+      while (iovcnt > 0 && (size_t)nwritten >= vec->iov_len) {
+         nwritten -= vec->iov_len;
+         vec++;
+         iovcnt--;
+      }
+      if (iovcnt > 0) {
+         vec->iov_base = (char *)vec->iov_base + nwritten;
+         vec->iov_len -= nwritten;
+      }
+   }
+   return nbytes;
+}
+#else
+int32_t BSOCKCORE::writev_nbytes(char *ptr, int32_t nbytes)
+{
+   if (!flush_wbuf()) {
+      return -1;
+   }
+   return write_direct(ptr, nbytes);
+}
+#endif
+
+/*
+ * Send the content of the write buffer, the caller must hold the write lock
+ */
+bool BSOCKCORE::flush_wbuf()
+{
+   int32_t len = m_wbuf_len;
+
+   if (len == 0) {
+      return true;
+   }
+   m_wbuf_len = 0;
+   return write_direct(m_wbuf, len) == len;
+}
+
+/*
+ * Send the content of the write buffer and report the errors,
+ *  the caller must hold the write lock
+ */
+bool BSOCKCORE::send_wbuf()
+{
+   int32_t len = m_wbuf_len;
+   bool ok;
+
+   if (len == 0) {
+      return true;
+   }
+   if (errors || is_terminated() || is_closed()) {
+      return false;
+   }
+   timer_start = watchdog_time;  /* start timer */
+   clear_timed_out();
+   ok = flush_wbuf();
+   timer_start = 0;              /* clear timer */
+   if (!ok) {
+      errors++;
+      b_errno = (errno == 0) ? EIO : errno;
+      if (!m_suppress_error_msgs) {
+         Qmsg5(m_jcr, M_ERROR, 0,
+               _("Write error sending %d bytes to %s:%s:%d: ERR=%s\n"),
+               len, m_who, m_host, m_port, this->bstrerror());
+      }
+   }
+   return ok;
+}
+
+/*
+ * Send the messages waiting in the write buffer
+ *  Returns: false on error
+ *           true  on success
+ */
+bool BSOCKCORE::flush()
+{
+   bool ok;
+
+   if (m_use_locking) pP(pm_wmutex);
+   ok = send_wbuf();
+   if (m_use_locking) pV(pm_wmutex);
+   return ok;
+}
+
+/*
+ * Send the write buffer if its oldest byte is waiting for more than
+ *  BSOCK_FLUSH_DELAY. The delay is otherwise checked by the next write
+ *  only, so it is called between two files and by the heartbeat thread
+ *  when the writer may not send anything for a while.
+ *  Returns: false on error
+ *           true  on success
+ */
+bool BSOCKCORE::flush_stale()
+{
+   bool ok = true;
+
+   if (m_use_locking) pP(pm_wmutex);
+   if (m_wbuf_len > 0 && get_current_btime() - m_wbuf_time > BSOCK_FLUSH_DELAY) {
+      ok = send_wbuf();
+   }
+   if (m_use_locking) pV(pm_wmutex);
+   return ok;
+}
+
+/*
+ * Turn on the write buffer (BNET_SETBUF_WRITE) and/or the
+ *  read-ahead buffer (BNET_SETBUF_READ). The wire format is not
+ *  modified, so the other side does not need to know about it.
+ */
+void BSOCKCORE::set_buffered(int32_t size, int rw)
+{
+   if (size <= 0) {
+      size = BSOCK_BUFFERED_SIZE;
+   }
+   if (rw & BNET_SETBUF_WRITE) {
+      if (m_use_locking) pP(pm_wmutex);
+      if (m_wbuf) {
+         send_wbuf();
+         m_wbuf = check_pool_memory_size(m_wbuf, size);
+      } else {
+         m_wbuf = get_memory(size);
+         m_wbuf_len = 0;
+      }
+      m_wbuf_size = size;
+      if (m_use_locking) pV(pm_wmutex);
+   }
+   if (rw & BNET_SETBUF_READ) {
+      /* OpenSSL already reads complete records */
+      if (tls) {
+         Dmsg1(DT_NETWORK|50, "No read-ahead buffer on TLS socket %s\n", m_who);
+      } else if (m_rbuf) {
+         m_rbuf = check_pool_memory_size(m_rbuf, size);
+         m_rbuf_size = size;
+      } else {
+         m_rbuf = get_memory(size);
+         m_rbuf_pos = m_rbuf_len = 0;
+         m_rbuf_size = size;
+      }
+   }
+}
+
+/*
+ * Turn off the buffers set by set_buffered(). The data that is already
+ *  in the read-ahead buffer will still be returned by the next reads.
+ */
+void BSOCKCORE::clear_buffered(int rw)
+{
+   if (rw & BNET_SETBUF_WRITE) {
+      /* The heartbeat thread can flush the buffer at the same time */
+      if (m_use_locking) pP(pm_wmutex);
+      if (m_wbuf) {
+         send_wbuf();
+         free_pool_memory(m_wbuf);
+         m_wbuf = NULL;
+         m_wbuf_len = m_wbuf_size = 0;
+      }
+      if (m_use_locking) pV(pm_wmutex);
+   }
+   if ((rw & BNET_SETBUF_READ) && m_rbuf && !has_pending_data()) {
+      free_pool_memory(m_rbuf);
+      m_rbuf = NULL;
+      m_rbuf_pos = m_rbuf_len = m_rbuf_size = 0;
+   }
+}
+
 /*
  * Read a nbytes from the network.
  * It is possible that the total bytes require in several
@@ -1253,8 +1543,50 @@ int32_t BSOCKCORE::read_nbytes(char *ptr, int32_t nbytes)
 
    nleft = nbytes;
    while (nleft > 0) {
+      if (m_rbuf) {
+         if (has_pending_data()) {
+            nread = MIN(nleft, m_rbuf_len - m_rbuf_pos);
+            memcpy(ptr, m_rbuf + m_rbuf_pos, nread);
+            m_rbuf_pos += nread;
+            nleft -= nread;
+            ptr += nread;
+            continue;
+         }
+         /*
+          * Small requests (headers, small messages) refill the read-ahead
+          *  buffer, a single read() will bring several messages. Large
+          *  ones are read directly into the caller's buffer.
+          */
+         if (nleft < m_rbuf_size) {
+            if ((nread = read_once(m_rbuf, m_rbuf_size)) <= 0) {
+               return -1;          /* error, or EOF */
+            }
+            m_rbuf_pos = 0;
+            m_rbuf_len = nread;
+            continue;
+         }
+      }
+      if ((nread = read_once(ptr, nleft)) <= 0) {
+         return -1;                /* error, or EOF */
+      }
+      nleft -= nread;
+      ptr += nread;
+   }
+   return nbytes - nleft;          /* return >= 0 */
+}
+
+/*
+ * Do a single read of at most nbytes from the network
+ *  Returns: number of bytes read
+ *           -1 on error or EOF
+ */
+int32_t BSOCKCORE::read_once(char *ptr, int32_t nbytes)
+{
+   int32_t nread;
+
+   for (;;) {
       errno = 0;
-      nread = socketRead(m_fd, ptr, nleft);
+      nread = socketRead(m_fd, ptr, nbytes);
       if (is_timed_out() || is_terminated()) {
          return -1;
       }
@@ -1289,13 +1621,11 @@ int32_t BSOCKCORE::read_nbytes(char *ptr, int32_t nbytes)
       if (nread <= 0) {
          return -1;                /* error, or EOF */
       }
-      nleft -= nread;
-      ptr += nread;
       if (use_bwlimit()) {
          control_bwlimit(nread);
       }
+      return nread;
    }
-   return nbytes - nleft;          /* return >= 0 */
 }
 
 #ifdef HAVE_WIN32
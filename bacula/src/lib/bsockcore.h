@@ -38,6 +38,8 @@
 #define __BSOCKCORE_H_
 
 #define BSOCKCORE_TIMEOUT  3600 * 24 * 5;  /* default 5 days */
+#define BSOCK_BUFFERED_SIZE (64 * 1024)     /* default size of the I/O buffers */
+#define BSOCK_FLUSH_DELAY   (200 * 1000)    /* max age of buffered writes in usec */
 
 struct btimer_t;                      /* forward reference */
 class BSOCKCORE;
@@ -116,6 +118,15 @@ protected:
    int64_t m_nb_bytes;                /* bytes sent/recv since the last tick */
    btime_t m_last_tick;               /* last tick used by bwlimit */
    btime_t m_rtt;                     /* Average RTT with the other side */
+   bwgroup *m_bwgroup;                /* Bandwidth shared with other sockets */
+   POOLMEM *m_wbuf;                   /* buffer used to coalesce small writes */
+   int32_t m_wbuf_len;                /* bytes waiting in m_wbuf */
+   int32_t m_wbuf_size;               /* flush m_wbuf when it reaches this size */
+   btime_t m_wbuf_time;               /* time when m_wbuf was filled first */
+   POOLMEM *m_rbuf;                   /* read-ahead buffer */
+   int32_t m_rbuf_pos;                /* next byte to return from m_rbuf */
+   int32_t m_rbuf_len;                /* bytes available in m_rbuf */
+   int32_t m_rbuf_size;               /* bytes asked to each read() to fill m_rbuf */
 
    void fin_init(JCR * jcr, int sockfd, const char *who, const char *host, int port,
                struct sockaddr *lclient_addr);
@@ -127,6 +138,12 @@ protected:
    virtual void _destroy();                   /* called by destroy() */
    virtual int32_t write_nbytes(char *ptr, int32_t nbytes);
    virtual int32_t read_nbytes(char *ptr, int32_t nbytes);
+   int32_t write_direct(char *ptr, int32_t nbytes);
+   int32_t write_buffered(char *ptr, int32_t nbytes);
+   int32_t writev_nbytes(char *ptr, int32_t nbytes);
+   int32_t read_once(char *ptr, int32_t nbytes);
+   bool flush_wbuf();
+   bool send_wbuf();
 
 public:
    BSOCKCORE *m_master;                    /* "this" or the "parent" BSOCK if duped */
@@ -156,6 +173,10 @@ public:
    void clear_locking();
    void set_source_address(dlist *src_addr_list);
    void control_bwlimit(int bytes);
+   void set_buffered(int32_t size, int rw);
+   void clear_buffered(int rw);
+   bool flush();
+   bool flush_stale();
 
    /* Inline functions */
    void suppress_error_messages(bool flag) { m_suppress_error_msgs = flag; };
@@ -176,13 +197,24 @@ public:
    bool is_stop() const { return errors || is_terminated() || is_closed(); };
    bool is_error() { errno = b_errno; return errors; };
    void set_bwlimit(int64_t maxspeed) { m_bwlimit = m_bandwidth = maxspeed; };
-   bool use_bwlimit() { return m_bwlimit > 0;};
+   bool use_bwlimit() { return m_bwlimit > 0 || m_bwgroup != NULL;};
+   void set_bwgroup(bwgroup *group) { m_bwgroup = group; };
+   bwgroup *get_bwgroup() { return m_bwgroup; };
    void set_bandwidth(int64_t maxspeed) { m_bandwidth = maxspeed; };
    int64_t get_bwlimit() { return m_bwlimit; };
    int64_t get_bandwidth() { return m_bandwidth; };
    int64_t get_socket_buffer_size() { return get_bandwidth() * get_rtt() / 1000L ; };
    void set_rtt(btime_t rtt) { m_rtt = rtt; };
    btime_t get_rtt() { return m_rtt; };
+   bool is_buffered() const { return m_wbuf != NULL || m_rbuf != NULL; };
+   bool has_pending_data() const { return m_rbuf_pos < m_rbuf_len; };
+   /* The I/O buffers of a duped BSOCKCORE belong to the original one */
+   void init_buffered() {
+            m_wbuf = m_rbuf = NULL;
+            m_wbuf_len = m_wbuf_size = 0;
+            m_rbuf_pos = m_rbuf_len = m_rbuf_size = 0;
+            m_wbuf_time = 0;
+        };
 
    void set_duped() { m_duped = true; };
    void set_master(BSOCKCORE *master) { 
@@ -377,7 +377,7 @@ void *b_malloc(const char *file, int line, size_t size)
 {
   void *buf;
 
-#ifdef SMARTALLOC
+#if defined(SMARTALLOC) || defined(SAMPLEDALLOC)
   buf = sm_malloc(file, line, size);
 #else
   buf = malloc(size);
@@ -138,3 +138,289 @@ void bwlimit::control_bwlimit(int bytes)
       /* m_nb_bytes & m_last_tick will be updated at next iteration */
    }
 }
+
+/*
+ * All the bwgroup trees of the daemon are protected by a single mutex,
+ *  the computations done with it are short and we never sleep with it.
+ */
+static pthread_mutex_t bwgroup_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+bwgroup::bwgroup(const char *name, int64_t limit, bwgroup *parent):
+   m_name(bstrdup(name)), m_parent(parent), m_children(NULL), m_refcount(0),
+   m_keep(false), m_capped(false), m_limit(limit), m_burst(ONE_SEC/10), m_tokens(0),
+   m_last_tick(0), m_last_active(0), m_total_bytes(0), m_total_sleep(0),
+   m_window_bytes(0), m_window_start(0), m_rate(0)
+{
+   m_children = New(alist(10, not_owned_by_alist));
+}
+
+bwgroup::~bwgroup()
+{
+   bwgroup *child;
+   foreach_alist(child, m_children) {
+      child->m_parent = NULL;
+      delete child;
+   }
+   delete m_children;
+   bfree(m_name);
+}
+
+/* Find or create a child node, the caller must call release() when done */
+bwgroup *bwgroup::get_child(const char *name, int64_t limit)
+{
+   bwgroup *child;
+   lock_guard lg(bwgroup_mutex);
+
+   foreach_alist(child, m_children) {
+      if (strcmp(child->m_name, name) == 0) {
+         break;
+      }
+   }
+   if (!child) {
+      child = New(bwgroup(name, limit, this));
+      m_children->append(child);
+      m_refcount++;             /* the child holds a reference on us */
+
+   } else if (!child->m_keep && limit > 0) {
+      /* A limit given with "setbandwidth" wins over the configuration */
+      child->m_limit = limit;
+   }
+   child->m_refcount++;
+   return child;
+}
+
+void bwgroup::release_locked()
+{
+   bwgroup *parent, *child;
+   int i;
+
+   if (--m_refcount > 0 || m_keep || !m_parent) {
+      return;
+   }
+   parent = m_parent;
+   foreach_alist_index(i, child, parent->m_children) {
+      if (child == this) {
+         parent->m_children->remove(i);
+         break;
+      }
+   }
+   delete this;
+   parent->release_locked();
+}
+
+/* Drop a reference on the node, the node is deleted if nobody uses it */
+void bwgroup::release()
+{
+   lock_guard lg(bwgroup_mutex);
+   release_locked();
+}
+
+/* When keep is set, the node and its limit are kept for the next connections */
+void bwgroup::set_limit(int64_t limit, bool keep)
+{
+   lock_guard lg(bwgroup_mutex);
+   m_limit = limit;
+   m_keep = m_keep || keep;
+}
+
+/*
+ * Compute the bandwidth that this node can use right now. The share of the
+ *  parent is split between the active siblings, the siblings that have a
+ *  cap under the fair share get their cap and the rest is split between
+ *  the others. 0 means that there is no limit.
+ */
+int64_t bwgroup::compute_share(btime_t now)
+{
+   bwgroup *sib;
+   int64_t share, remaining;
+   int nb;
+   bool changed;
+
+   if (!m_parent) {
+      return m_limit;
+   }
+   remaining = m_parent->compute_share(now);
+   if (remaining <= 0) {
+      return m_limit;           /* No limit from the parents */
+   }
+   foreach_alist(sib, m_parent->m_children) {
+      sib->m_capped = false;
+   }
+   do {
+      nb = 0;
+      foreach_alist(sib, m_parent->m_children) {
+         if (!sib->m_capped && (sib == this || sib->is_active(now))) {
+            nb++;
+         }
+      }
+      share = remaining / nb;
+      changed = false;
+      foreach_alist(sib, m_parent->m_children) {
+         if (!sib->m_capped && (sib == this || sib->is_active(now)) &&
+             sib->m_limit > 0 && sib->m_limit < share)
+         {
+            /* Removing a capped sibling frees bandwidth for the others */
+            sib->m_capped = changed = true;
+            remaining -= sib->m_limit;
+         }
+      }
+      if (m_capped) {
+         return m_limit;
+      }
+   } while (changed);
+
+   return MAX(share, 1);
+}
+
+int64_t bwgroup::get_share()
+{
+   lock_guard lg(bwgroup_mutex);
+   return compute_share(get_current_btime());
+}
+
+void bwgroup::account(int64_t bytes, btime_t now)
+{
+   for (bwgroup *g = this; g ; g = g->m_parent) {
+      g->m_last_active = now;
+      g->m_total_bytes += bytes;
+      g->m_window_bytes += bytes;
+      if (now - g->m_window_start >= ONE_SEC) {
+         if (g->m_window_start > 0) {
+            g->m_rate = g->m_window_bytes * ONE_SEC / (now - g->m_window_start);
+         }
+         g->m_window_bytes = 0;
+         g->m_window_start = now;
+      }
+   }
+}
+
+/*
+ * Called by each connection attached to the node after a read or a write,
+ *  the connection will sleep if the node used more than its share.
+ */
+void bwgroup::control_bwlimit(int bytes)
+{
+   btime_t now, temp;
+   int64_t share, usec_sleep = 0;
+
+   if (bytes <= 0) {
+      return;
+   }
+   P(bwgroup_mutex);
+   now = get_current_btime();
+   account(bytes, now);
+   share = compute_share(now);
+   if (share > 0) {
+      temp = now - m_last_tick;
+      if (m_last_tick == 0 || temp < 0 || temp > 10 * ONE_SEC) {
+         /* First call, or clock problem, start with a full bucket */
+         m_tokens = share * m_burst / ONE_SEC;
+      } else {
+         m_tokens += (int64_t)(temp * ((double)share / ONE_SEC));
+         m_tokens = MIN(m_tokens, share * m_burst / ONE_SEC);
+      }
+      m_last_tick = now;
+      m_tokens -= bytes;
+      if (m_tokens < 0) {
+         /* What exceed should be converted in sleep time */
+         usec_sleep = (int64_t)(-m_tokens / ((double)share / ONE_SEC));
+         usec_sleep = MIN(usec_sleep, 60 * ONE_SEC);
+         for (bwgroup *g = this; g ; g = g->m_parent) {
+            g->m_total_sleep += usec_sleep;
+         }
+      }
+   }
+   V(bwgroup_mutex);
+
+   if (usec_sleep > 100) {
+      bmicrosleep(usec_sleep / ONE_SEC, usec_sleep % ONE_SEC);
+   }
+}
+
+void bwgroup::get_status_locked(POOLMEM **buf, btime_t now, int level)
+{
+   char ed1[50], ed2[50], ed3[50], ed4[50];
+   POOL_MEM tmp;
+   bwgroup *child;
+
+   Mmsg(tmp, "%*s%s limit=%sB/s share=%sB/s rate=%sB/s bytes=%s sleep=%llds\n",
+        level * 3, "", m_name,
+        edit_uint64_with_suffix(m_limit, ed1),
+        edit_uint64_with_suffix(MAX(compute_share(now), 0), ed2),
+        edit_uint64_with_suffix(is_active(now) ? m_rate : 0, ed3),
+        edit_uint64_with_commas(m_total_bytes, ed4),
+        (long long)(m_total_sleep / ONE_SEC));
+   pm_strcat(buf, tmp.c_str());
+
+   foreach_alist(child, m_children) {
+      child->get_status_locked(buf, now, level + 1);
+   }
+}
+
+/* Append a description of the node and of all its children to buf */
+void bwgroup::get_status(POOLMEM **buf)
+{
+   lock_guard lg(bwgroup_mutex);
+   get_status_locked(buf, get_current_btime(), 0);
+}
+
+#ifdef TEST_PROGRAM
+#include "unittests.h"
+
+int main(int argc, char **argv)
+{
+   Unittests bwlimit_test("bwlimit_test", true);
+   int64_t mb = 1024 * 1024;
+
+   bwgroup *root = New(bwgroup("root", 100 * mb));
+   bwgroup *c1 = root->get_child("client1", 30 * mb);
+   bwgroup *c2 = root->get_child("client2");
+   bwgroup *j1 = c1->get_child("job1");
+   bwgroup *j2 = c2->get_child("job2");
+   bwgroup *j3 = c2->get_child("job3", 10 * mb);
+
+   /* Only one job active, it gets the client limit */
+   j1->control_bwlimit(100);
+   is(c1->get_share(), 30 * mb, "Capped client share");
+   is(j1->get_share(), 30 * mb, "Single job gets the client share");
+   is(j2->get_share(), 70 * mb, "Uncapped client gets the rest");
+
+   /* Two jobs in the second client */
+   j2->control_bwlimit(100);
+   j3->control_bwlimit(100);
+   is(j3->get_share(), 10 * mb, "Capped job share");
+   is(j2->get_share(), 60 * mb, "Job share with a capped sibling");
+
+   /* Runtime adjustment */
+   root->set_limit(40 * mb);
+   is(c2->get_share(), 20 * mb, "Fair share between two clients");
+   is(j2->get_share(), 10 * mb, "Fair share between two jobs");
+   is(j3->get_share(), 10 * mb, "Fair share between two jobs");
+
+   /* Unlimited daemon */
+   root->set_limit(0);
+   is(j2->get_share(), 0, "No limit");
+   is(j3->get_share(), 10 * mb, "Job cap without daemon limit");
+
+   /* Reference counting */
+   c1->set_limit(20 * mb, true);
+   j1->release();
+   c1->release();
+   j2->release();
+   j3->release();
+   c2->release();
+   c1 = root->get_child("client1");
+   is(c1->get_limit(), 20 * mb, "Limit set at runtime is kept");
+   c2 = root->get_child("client2");
+   is(c2->get_limit(), 0, "Unused node was deleted");
+   c1->release();
+   c2->release();
+
+   POOL_MEM buf;
+   root->get_status(buf.handle());
+   ok(strstr(buf.c_str(), "client1") != NULL, "Status output");
+   Dmsg1(0, "%s", buf.c_str());
+   delete root;
+   return report();
+}
+#endif
@@ -60,4 +60,55 @@ public:
    void get_total(int64_t *t, int64_t *bytes, int64_t *sleep);
    void reset_sample();
 };
+
+/*
+ * Bandwidth control shared by several connections, the nodes are organized
+ *  in a tree (daemon -> client -> job). The bandwidth of a node is shared
+ *  fairly between its active children, each node can have its own cap,
+ *  and the sum of the children never goes above the parent limit.
+ */
+class bwgroup: public SMARTALLOC
+{
+private:
+   char *m_name;
+   bwgroup *m_parent;
+   alist *m_children;
+   int m_refcount;              /* connections/children using this node */
+   bool m_keep;                 /* limit set at runtime, keep the node */
+   bool m_capped;               /* used by compute_share() */
+   int64_t m_limit;             /* cap for this node, 0 means no cap */
+   int64_t m_burst;             /* us of traffic that can be sent at once */
+   int64_t m_tokens;            /* bytes that can be sent right now */
+   btime_t m_last_tick;         /* last refill of m_tokens */
+   btime_t m_last_active;       /* last time data went through this node */
+
+   /* Statistics */
+   uint64_t m_total_bytes;      /* bytes controlled by this node */
+   uint64_t m_total_sleep;      /* us of sleep imposed to the connections */
+   uint64_t m_window_bytes;     /* bytes in the current window */
+   btime_t m_window_start;      /* start of the current window */
+   int64_t m_rate;              /* bytes/s measured in the last window */
+
+   bool is_active(btime_t now) { return now - m_last_active < 2000000; };
+   int64_t compute_share(btime_t now);
+   void account(int64_t bytes, btime_t now);
+   void release_locked();
+   void get_status_locked(POOLMEM **buf, btime_t now, int level);
+
+public:
+   bwgroup(const char *name, int64_t limit=0, bwgroup *parent=NULL);
+   ~bwgroup();
+
+   bwgroup *get_child(const char *name, int64_t limit=0);
+   void release();
+   void control_bwlimit(int bytes);
+
+   void set_limit(int64_t limit, bool keep=false);
+   void set_burst(int64_t usec) { m_burst = usec; };
+   int64_t get_limit() { return m_limit; };
+   int64_t get_share();
+   const char *name() { return m_name; };
+   void get_status(POOLMEM **buf);
+};
+
 #endif
@@ -107,6 +107,7 @@ int devlock::destroy()
    }
 
    rwl->valid = 0;
+   lmgr_stats_forget(rwl);
    if ((stat = pthread_mutex_unlock(&rwl->mutex)) != 0) {
       return stat;
    }
@@ -49,6 +49,7 @@
 #include "bjson.h"
 #include "tls.h"
 #include "address_conf.h"
+#include "bwlimit.h"
 #include "bsockcore.h"
 #include "bsock.h"
 #include "bsock_meeting.h"
@@ -77,5 +78,6 @@
 #include "org_lib_dedup.h"
 #endif
 #include "bstat.h"
+#include "bhistogram.h"
 #include "collect.h"
 #include "authenticatebase.h"
@@ -191,10 +191,16 @@ public:
    const char *file;
    int line;
 
+   int64_t wanted;              /* Time of the request, with statistics */
+   int64_t granted;             /* Time of the grant */
+   struct lmgr_mutex_stats *stats;
+
    lmgr_lock_t() {
       lock = NULL;
       state = LMGR_LOCK_EMPTY;
       priority = max_priority = 0;
+      wanted = granted = 0;
+      stats = NULL;
    }
 
    lmgr_lock_t(void *l) {
@@ -285,6 +291,210 @@ typedef struct
 
 }  lmgr_thread_event;
 
+/*
+ * Mutex contention statistics
+ *
+ *  When the DEBUG_MUTEX_STATS flag is set (setdebug options=s), each
+ *  lock request is timed. The acquisitions, the contended ones, the
+ *  wait and hold times are accounted per mutex, with the call sites
+ *  of the holders. The entries are kept in a fixed size table indexed
+ *  by the mutex address. An entry is released when the mutex is
+ *  destroyed, or by lmgr_stats_reset() when no thread wants or holds
+ *  the mutex, so the entry of a locked mutex stays valid. Only the
+ *  bthread_mutex_t, rwlock and devlock are accounted, the destroy of a
+ *  plain pthread_mutex_t cannot release its entry. The counters
+ *  are updated with atomic operations because the readers of a rwlock
+ *  hold it at the same time.
+ *
+ *  A wait is contended when the mutex was already locked, or when it
+ *  took more than LMGR_CONTENDED_NS for the locks managed outside of
+ *  lockmgr (rwlock, devlock).
+ */
+#define LMGR_STATS_SIZE     4096      /* mutexes, power of 2 */
+#define LMGR_STATS_PROBES   32
+#define LMGR_STATS_SITES    8         /* holder call sites per mutex */
+#define LMGR_CONTENDED_NS   2000
+
+struct lmgr_site_stats {
+   const char *file;                  /* NULL when the entry is free */
+   int32_t line;
+   volatile uint64_t count;
+   volatile uint64_t hold;            /* total hold time in ns */
+};
+
+struct lmgr_mutex_stats {
+   void *volatile lock;               /* NULL when the entry is free */
+   volatile uint64_t acquired;
+   volatile uint64_t contended;
+   volatile uint64_t wait;            /* total wait time in ns */
+   volatile uint64_t wait_max;
+   volatile uint64_t hold;            /* total hold time in ns */
+   volatile uint64_t hold_max;
+   struct lmgr_site_stats site[LMGR_STATS_SITES + 1]; /* the last for others */
+};
+
+static struct lmgr_mutex_stats *volatile lmgr_stats = NULL;
+static volatile uint64_t lmgr_stats_dropped = 0;   /* table full */
+
+static inline bool lmgr_stats_on()
+{
+   return (debug_flags & DEBUG_MUTEX_STATS) != 0;
+}
+
+static int64_t lmgr_now()
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void lmgr_stats_max(volatile uint64_t *max, uint64_t val)
+{
+   uint64_t cur = *max;
+   while (val > cur) {
+      if (__sync_bool_compare_and_swap(max, cur, val)) {
+         break;
+      }
+      cur = *max;
+   }
+}
+
+static inline uint32_t lmgr_stats_hash(void *m)
+{
+   return (uint32_t)(((uintptr_t)m >> 4) * 2654435761U);
+}
+
+/* Find the entry of a mutex, NULL if the mutex is not in the table */
+static struct lmgr_mutex_stats *lmgr_stats_find(void *m)
+{
+   struct lmgr_mutex_stats *tab = lmgr_stats;
+   uint32_t h = lmgr_stats_hash(m);
+
+   if (!tab) {
+      return NULL;
+   }
+   for (int i=0; i < LMGR_STATS_PROBES; i++) {
+      struct lmgr_mutex_stats *st = &tab[(h + i) & (LMGR_STATS_SIZE - 1)];
+      if (st->lock == m) {
+         return st;
+      }
+   }
+   return NULL;
+}
+
+/* Find or add the entry of a mutex, NULL if the table is full */
+static struct lmgr_mutex_stats *lmgr_stats_get(void *m)
+{
+   struct lmgr_mutex_stats *tab = lmgr_stats, *st;
+   uint32_t h = lmgr_stats_hash(m);
+
+   /* The entries are released, a free slot can be before our entry */
+   if ((st = lmgr_stats_find(m)) != NULL) {
+      return st;
+   }
+   if (!tab) {
+      tab = (struct lmgr_mutex_stats *)actuallycalloc(LMGR_STATS_SIZE,
+                                          sizeof(struct lmgr_mutex_stats));
+      if (!tab) {
+         return NULL;
+      }
+      if (!__sync_bool_compare_and_swap(&lmgr_stats, NULL, tab)) {
+         actuallyfree(tab);
+         tab = lmgr_stats;
+      }
+   }
+   for (int i=0; i < LMGR_STATS_PROBES; i++) {
+      st = &tab[(h + i) & (LMGR_STATS_SIZE - 1)];
+      if (st->lock == m) {
+         return st;
+      }
+      if (st->lock == NULL && __sync_bool_compare_and_swap(&st->lock, NULL, m)) {
+         return st;
+      }
+      if (st->lock == m) {      /* added by an other thread */
+         return st;
+      }
+   }
+   __sync_add_and_fetch(&lmgr_stats_dropped, 1);
+   return NULL;
+}
+
+/* Clear the counters of an entry, and the call sites when it is released */
+static void lmgr_stats_clear(struct lmgr_mutex_stats *st, bool release)
+{
+   st->acquired = st->contended = 0;
+   st->wait = st->wait_max = st->hold = st->hold_max = 0;
+   for (int j=0; j <= LMGR_STATS_SITES; j++) {
+      st->site[j].count = st->site[j].hold = 0;
+      if (release) {
+         st->site[j].line = 0;
+         st->site[j].file = NULL;
+      }
+   }
+   if (release) {
+      __sync_synchronize();
+      st->lock = NULL;
+   }
+}
+
+/*
+ * Release the entry of a mutex that is destroyed, the address can be
+ *  used by an other mutex.
+ */
+void lmgr_stats_forget(void *m)
+{
+   struct lmgr_mutex_stats *st = lmgr_stats_find(m);
+   if (st) {
+      lmgr_stats_clear(st, true);
+   }
+}
+
+/* Account a lock granted after wait ns, contended is -1 when unknown */
+static struct lmgr_mutex_stats *lmgr_stats_acquired(void *m, int64_t wait,
+                                                    int contended)
+{
+   struct lmgr_mutex_stats *st = lmgr_stats_get(m);
+   if (!st) {
+      return NULL;
+   }
+   if (contended < 0) {
+      contended = wait >= LMGR_CONTENDED_NS;
+   }
+   __sync_add_and_fetch(&st->acquired, 1);
+   if (contended) {
+      __sync_add_and_fetch(&st->contended, 1);
+      __sync_add_and_fetch(&st->wait, (uint64_t)wait);
+      lmgr_stats_max(&st->wait_max, wait);
+   }
+   return st;
+}
+
+/* Account the hold time of a lock to its holder call site */
+static void lmgr_stats_released(struct lmgr_mutex_stats *st, const char *file,
+                                int line, int64_t hold)
+{
+   struct lmgr_site_stats *site = &st->site[LMGR_STATS_SITES];
+
+   __sync_add_and_fetch(&st->hold, (uint64_t)hold);
+   lmgr_stats_max(&st->hold_max, hold);
+   for (int i=0; i < LMGR_STATS_SITES; i++) {
+      struct lmgr_site_stats *cur = &st->site[i];
+      if (cur->file == NULL) {
+         if (__sync_bool_compare_and_swap(&cur->file, NULL, file)) {
+            cur->line = line;
+            site = cur;
+            break;
+         }
+      }
+      if (cur->file == file && cur->line == line) {
+         site = cur;
+         break;
+      }
+   }
+   __sync_add_and_fetch(&site->count, 1);
+   __sync_add_and_fetch(&site->hold, (uint64_t)hold);
+}
+
 static int32_t global_event_id=0;
 
 static int global_int_thread_id=0; /* Keep an integer for each thread */
@@ -443,9 +653,10 @@ public:
 
    /*
     * Call before a lock operation (mark mutex as WANTED)
+    *  stats is false when the lock must not be accounted
     */
    virtual void pre_P(void *m, int priority,
-                      const char *f="*unknown*", int l=0)
+                      const char *f="*unknown*", int l=0, bool stats=true)
    {
       int max_prio = max_priority;
 
@@ -467,6 +678,8 @@ public:
          lock_list[current].line = l;
          lock_list[current].priority = priority;
          lock_list[current].max_priority = MAX(priority, max_priority);
+         lock_list[current].wanted = (stats && lmgr_stats_on()) ? lmgr_now() : 0;
+         lock_list[current].stats = NULL;
          max = MAX(current, max);
          max_priority = MAX(priority, max_priority);
       }
@@ -487,11 +700,18 @@ public:
 
    /*
     * Call after the lock operation (mark mutex as GRANTED)
+    *  contended is -1 when the caller doesn't know if it had to wait
     */
-   virtual void post_P() {
+   virtual void post_P(int contended=-1) {
       ASSERT2(current >= 0, "Lock stack when negative");
       ASSERT(lock_list[current].state == LMGR_LOCK_WANTED);
       lock_list[current].state = LMGR_LOCK_GRANTED;
+      if (lock_list[current].wanted) {
+         int64_t now = lmgr_now();
+         lock_list[current].granted = now;
+         lock_list[current].stats = lmgr_stats_acquired(lock_list[current].lock,
+                                        now - lock_list[current].wanted, contended);
+      }
    }
 
    /* Using this function is some sort of bug */
@@ -526,6 +746,12 @@ public:
       lmgr_p(&mutex);
       {
          if (lock_list[current].lock == m) {
+            if (lock_list[current].stats) {
+               lmgr_stats_released(lock_list[current].stats,
+                                   lock_list[current].file, lock_list[current].line,
+                                   lmgr_now() - lock_list[current].granted);
+               lock_list[current].stats = NULL;
+            }
             lock_list[current].lock = NULL;
             lock_list[current].state = LMGR_LOCK_EMPTY;
             current--;
@@ -568,8 +794,8 @@ public:
 class lmgr_dummy_thread_t: public lmgr_thread_t
 {
    void do_V(void *m, const char *file, int l)  {}
-   void post_P()                                {}
-   void pre_P(void *m, int priority, const char *file, int l) {}
+   void post_P(int contended)                   {}
+   void pre_P(void *m, int priority, const char *file, int l, bool stats) {}
 };
 
 /*
@@ -882,6 +1108,8 @@ void lmgr_cleanup_thread()
    lmgr_thread_t *self = lmgr_get_thread_info();
    lmgr_unregister_thread(self);
    delete(self);
+   /* The thread specific data destructors may still lock a mutex */
+   pthread_setspecific(lmgr_key, NULL);
 }
 
 /*
@@ -946,6 +1174,7 @@ int pthread_mutex_init(bthread_mutex_t *m, const pthread_mutexattr_t *attr)
  */
 int pthread_mutex_destroy(bthread_mutex_t *m)
 {
+   lmgr_stats_forget(m);
    return pthread_mutex_destroy(&m->mutex);
 }
 
@@ -994,12 +1223,28 @@ int bthread_kill(pthread_t thread, int sig,
  * Replacement for pthread_mutex_lock()
  * Returns always ok
  */
+/*
+ * Lock the mutex, with the statistics tell if we had to wait.
+ *  Returns -1 when the statistics are off.
+ */
+static int lmgr_p_stats(pthread_mutex_t *m)
+{
+   if (lmgr_stats_on()) {
+      if (pthread_mutex_trylock(m) == 0) {
+         return 0;
+      }
+      lmgr_p(m);
+      return 1;
+   }
+   lmgr_p(m);
+   return -1;
+}
+
 int bthread_mutex_lock_p(bthread_mutex_t *m, const char *file, int line)
 {
    lmgr_thread_t *self = lmgr_get_thread_info();
    self->pre_P(m, m->priority, file, line);
-   lmgr_p(&m->mutex);
-   self->post_P();
+   self->post_P(lmgr_p_stats(&m->mutex));
    return 0;
 }
 
@@ -1022,7 +1267,7 @@ int bthread_mutex_unlock_p(bthread_mutex_t *m, const char *file, int line)
 int bthread_mutex_lock_p(pthread_mutex_t *m, const char *file, int line)
 {
    lmgr_thread_t *self = lmgr_get_thread_info();
-   if (self) self->pre_P(m, 0, file, line);
+   if (self) self->pre_P(m, 0, file, line, false);
    lmgr_p(m);
    if (self) self->post_P();
    return 0;
@@ -1051,7 +1296,7 @@ int bthread_cond_wait_p(pthread_cond_t *cond,
    lmgr_thread_t *self = lmgr_get_thread_info();
    self->do_V(m, file, line);
    ret = pthread_cond_wait(cond, m);
-   self->pre_P(m, 0, file, line);
+   self->pre_P(m, 0, file, line, false);
    self->post_P();
    return ret;
 }
@@ -1067,7 +1312,7 @@ int bthread_cond_timedwait_p(pthread_cond_t *cond,
    lmgr_thread_t *self = lmgr_get_thread_info();
    self->do_V(m, file, line);
    ret = pthread_cond_timedwait(cond, m, abstime);
-   self->pre_P(m, 0, file, line);
+   self->pre_P(m, 0, file, line, false);
    self->post_P();
    return ret;
 }
@@ -1198,8 +1443,139 @@ int lmgr_thread_create(pthread_t *thread,
    return pthread_create(thread, attr, lmgr_thread_launcher, a);
 }
 
+static int lmgr_stats_cmp(const void *a, const void *b)
+{
+   const struct lmgr_mutex_stats *s1 = *(const struct lmgr_mutex_stats **)a;
+   const struct lmgr_mutex_stats *s2 = *(const struct lmgr_mutex_stats **)b;
+
+   if (s1->wait != s2->wait) {
+      return s1->wait > s2->wait ? -1 : 1;
+   }
+   if (s1->acquired != s2->acquired) {
+      return s1->acquired > s2->acquired ? -1 : 1;
+   }
+   return 0;
+}
+
+/*
+ * Send the statistics of the max most contended mutexes, 0 for all
+ *  of them. The values are read without lock, they can be slightly
+ *  inconsistent when the mutexes are in use.
+ */
+void lmgr_stats_report(void sendit(const char *msg, int len, void *ctx),
+                       void *ctx, int max)
+{
+   struct lmgr_mutex_stats *tab = lmgr_stats, **list;
+   char buf[512], ed1[50], ed2[50], ed3[50], ed4[50], ed5[50], ed6[50];
+   int nb = 0, len;
+
+   len = bsnprintf(buf, sizeof(buf), _("Lock manager statistics: %s\n"),
+                   lmgr_stats_on() ? _("on") : _("off (setdebug options=s)"));
+   sendit(buf, len, ctx);
+   if (!tab) {
+      return;
+   }
+   list = (struct lmgr_mutex_stats **)actuallymalloc(LMGR_STATS_SIZE *
+                                        sizeof(struct lmgr_mutex_stats *));
+   if (!list) {
+      return;
+   }
+   for (int i=0; i < LMGR_STATS_SIZE; i++) {
+      if (tab[i].lock && tab[i].acquired > 0) {
+         list[nb++] = &tab[i];
+      }
+   }
+   qsort(list, nb, sizeof(struct lmgr_mutex_stats *), lmgr_stats_cmp);
+
+   len = bsnprintf(buf, sizeof(buf), _("Mutexes: %d dropped: %s\n"), nb,
+                   edit_uint64(lmgr_stats_dropped, ed1));
+   sendit(buf, len, ctx);
+   len = bsnprintf(buf, sizeof(buf), _("Lock                 Acquired   Contended"
+                   "     Wait(us)  MaxWait(us)     Hold(us)  MaxHold(us)\n"));
+   sendit(buf, len, ctx);
+   for (int i=0; i < nb && (max <= 0 || i < max); i++) {
+      struct lmgr_mutex_stats *st = list[i];
+      len = bsnprintf(buf, sizeof(buf), "%-18p %10s %11s %12s %12s %12s %12s\n",
+              st->lock,
+              edit_uint64_with_commas(st->acquired, ed1),
+              edit_uint64_with_commas(st->contended, ed2),
+              edit_uint64_with_commas(st->wait / 1000, ed3),
+              edit_uint64_with_commas(st->wait_max / 1000, ed4),
+              edit_uint64_with_commas(st->hold / 1000, ed5),
+              edit_uint64_with_commas(st->hold_max / 1000, ed6));
+      sendit(buf, len, ctx);
+      for (int j=0; j <= LMGR_STATS_SITES; j++) {
+         struct lmgr_site_stats *site = &st->site[j];
+         if (site->count == 0) {
+            continue;
+         }
+         len = bsnprintf(buf, sizeof(buf), "   held at %s:%d count=%s hold=%sus\n",
+                 (j == LMGR_STATS_SITES) ? "*Others*" : NPRT(site->file),
+                 (j == LMGR_STATS_SITES) ? 0 : site->line,
+                 edit_uint64_with_commas(site->count, ed1),
+                 edit_uint64_with_commas(site->hold / 1000, ed2));
+         sendit(buf, len, ctx);
+      }
+   }
+   actuallyfree(list);
+}
+
+/*
+ * Clear the counters and release the entries of the mutexes that are
+ *  not wanted or held by a thread, they may be destroyed. The other
+ *  entries stay in the table so they are still valid for their holder.
+ *  The threads cannot lock a new mutex while we check the lock lists.
+ */
+void lmgr_stats_reset()
+{
+   struct lmgr_mutex_stats *tab = lmgr_stats;
+   lmgr_thread_t *item;
+   bool used;
+
+   if (!tab || !lmgr_is_active()) {
+      return;
+   }
+   lmgr_p(&lmgr_global_mutex);
+   foreach_dlist(item, global_mgr) {
+      lmgr_p(&item->mutex);
+   }
+   for (int i=0; i < LMGR_STATS_SIZE; i++) {
+      struct lmgr_mutex_stats *st = &tab[i];
+      if (st->lock == NULL) {
+         continue;
+      }
+      used = false;
+      foreach_dlist(item, global_mgr) {
+         for (int j=0; j <= item->current && !used; j++) {
+            used = item->lock_list[j].lock == st->lock;
+         }
+      }
+      lmgr_stats_clear(st, !used);
+   }
+   foreach_dlist(item, global_mgr) {
+      lmgr_v(&item->mutex);
+   }
+   lmgr_v(&lmgr_global_mutex);
+   lmgr_stats_dropped = 0;
+}
+
 #else  /* USE_LOCKMGR */
 
+void lmgr_stats_report(void sendit(const char *msg, int len, void *ctx),
+                       void *ctx, int max)
+{
+   const char *msg = _("Lock manager not enabled.\n");
+   sendit(msg, strlen(msg), ctx);
+}
+
+void lmgr_stats_reset()
+{
+}
+
+void lmgr_stats_forget(void *m)
+{
+}
+
 intptr_t bthread_get_thread_id()
 {
 # ifdef HAVE_WIN32
@@ -1429,6 +1805,24 @@ void *th_prio(void *a) {
    return (void*) ret;
 }
 
+static int nb_contention = 0;
+
+void *th_contention(void *a) {
+   for (int i=0; i < 1000; i++) {
+      P(mutex5);
+      nb_contention++;
+      bmicrosleep(0, 10);
+      V(mutex5);
+   }
+   return NULL;
+}
+
+static void stats_cb(const char *msg, int len, void *ctx)
+{
+   POOLMEM **out = (POOLMEM **)ctx;
+   pm_strcat(out, msg);
+}
+
 void *th_event1(void *a) {
    lmgr_thread_t *self = lmgr_get_thread_info();
    for (int i=0; i < 10000; i++) {
@@ -1648,7 +2042,69 @@ int main(int argc, char **argv)
    rwl_writeunlock(&wr);
    lmgr_post_lock();
 
-   
+   Pmsg0(0, "Start contention statistics tests\n");
+   {
+      POOLMEM *out = get_pool_memory(PM_MESSAGE);
+      char buf[50];
+      struct lmgr_mutex_stats *st;
+      bthread_mutex_t bm[10];
+      pthread_mutex_t pm = PTHREAD_MUTEX_INITIALIZER;
+      int nb;
+
+      set_debug_flags((char *)"s");
+      for (int i=0; i < 4; i++) {
+         pthread_create(&tab[i], NULL, th_contention, NULL);
+      }
+      for (int i=0; i < 4; i++) {
+         pthread_join(tab[i], NULL);
+      }
+      P(mutex6);
+      V(mutex6);
+      st = lmgr_stats_get(&mutex5);
+      ok(st && st->acquired == 4000, "Check acquired count");
+      ok(st && st->contended > 0 && st->contended <= 4000, "Check contended count");
+      ok(st && st->hold >= st->hold_max && st->hold_max > 0, "Check hold time");
+      ok(st && st->site[0].count == 4000 && st->site[1].count == 0,
+         "Check holder call site");
+      *out = 0;
+      lmgr_stats_report(stats_cb, &out, 0);
+      Pmsg1(0, "%s", out);
+      bsnprintf(buf, sizeof(buf), "%-18p", &mutex5);
+      ok(strstr(out, buf) != NULL, "Check report");
+      ok(strstr(out, "held at lockmgr.c:") != NULL, "Check report call site");
+
+      for (int i=0; i < 10; i++) {
+         pthread_mutex_init(&bm[i], NULL);
+         P(bm[i]);
+         V(bm[i]);
+      }
+      ok(lmgr_stats_find(&bm[0]) && lmgr_stats_find(&bm[9]), "Check new entries");
+      for (int i=0; i < 10; i++) {
+         pthread_mutex_destroy(&bm[i]);
+      }
+      nb = 0;
+      for (int i=0; i < 10; i++) {
+         nb += lmgr_stats_find(&bm[i]) != NULL;
+      }
+      ok(nb == 0, "Check destroy releases the entries");
+
+      P(pm);
+      V(pm);
+      ok(lmgr_stats_find(&pm) == NULL, "Check plain mutexes are not accounted");
+
+      P(mutex6);
+      lmgr_stats_reset();
+      ok(st && st->acquired == 0 && st->site[0].count == 0, "Check reset");
+      ok(st && st->lock == NULL, "Check reset releases the unused entries");
+      ok(lmgr_stats_find(&mutex6) != NULL, "Check reset keeps the held entries");
+      V(mutex6);
+      debug_flags &= ~DEBUG_MUTEX_STATS;
+      P(mutex5);
+      V(mutex5);
+      ok(st && st->acquired == 0, "Check statistics off");
+      free_pool_memory(out);
+   }
+
    Pmsg0(0, "Start lmgr_add_even tests\n");
    for (int i=0; i < 10000; i++) {
       if ((i % 7) == 0) {
@@ -41,6 +41,15 @@ intptr_t bthread_get_thread_id();
  */
 int bthread_change_uid(uid_t uid, gid_t gid);
 
+/*
+ * Mutex contention statistics, collected when the lock manager is
+ * enabled and the "s" debug flag is set (setdebug options=s)
+ */
+void lmgr_stats_report(void sendit(const char *msg, int len, void *ctx),
+                       void *ctx, int max);
+void lmgr_stats_reset();
+void lmgr_stats_forget(void *m);
+
 #ifdef USE_LOCKMGR
 
 typedef struct bthread_mutex_t
@@ -50,6 +50,8 @@ struct s_pool_ctl {
    int32_t max_used;                  /* max buffers used */
    int32_t in_use;                    /* number in use */
    struct abufhead *free_buf;         /* pointer to free buffers */
+   int32_t cache_max;                 /* max buffers kept by a thread */
+   int32_t cached;                    /* number kept in the thread caches */
 };
 
 /* Bacula Name length plus extra */
@@ -61,23 +63,23 @@ struct s_pool_ctl {
  * Define default Pool buffer sizes
  */
 static struct s_pool_ctl pool_ctl[] = {
-   {  256,  256, 0, 0, NULL },        /* PM_NOPOOL no pooling */
-   {  NLEN, NLEN,0, 0, NULL },        /* PM_NAME Bacula name */
-   {  256,  256, 0, 0, NULL },        /* PM_FNAME filename buffers */
-   {  512,  512, 0, 0, NULL },        /* PM_MESSAGE message buffer */
-   { 1024, 1024, 0, 0, NULL },        /* PM_EMSG error message buffer */
-  {  4096, 4096, 0, 0, NULL }         /* PM_BSOCK message buffer */
+   {  256,  256, 0, 0, NULL,  0, 0 }, /* PM_NOPOOL no pooling */
+   {  NLEN, NLEN,0, 0, NULL, 32, 0 }, /* PM_NAME Bacula name */
+   {  256,  256, 0, 0, NULL, 32, 0 }, /* PM_FNAME filename buffers */
+   {  512,  512, 0, 0, NULL, 32, 0 }, /* PM_MESSAGE message buffer */
+   { 1024, 1024, 0, 0, NULL, 16, 0 }, /* PM_EMSG error message buffer */
+  {  4096, 4096, 0, 0, NULL,  8, 0 }  /* PM_BSOCK message buffer */
 };
 #else
 
 /* This is used ONLY when stress testing the code */
 static struct s_pool_ctl pool_ctl[] = {
-   {   20,   20, 0, 0, NULL },        /* PM_NOPOOL no pooling */
-   {  NLEN, NLEN,0, 0, NULL },        /* PM_NAME Bacula name */
-   {   20,   20, 0, 0, NULL },        /* PM_FNAME filename buffers */
-   {   20,   20, 0, 0, NULL },        /* PM_MESSAGE message buffer */
-   {   20,   20, 0, 0, NULL },        /* PM_EMSG error message buffer */
-   {   20,   20, 0, 0, NULL }         /* PM_BSOCK message buffer */
+   {   20,   20, 0, 0, NULL, 0, 0 },  /* PM_NOPOOL no pooling */
+   {  NLEN, NLEN,0, 0, NULL, 2, 0 },  /* PM_NAME Bacula name */
+   {   20,   20, 0, 0, NULL, 2, 0 },  /* PM_FNAME filename buffers */
+   {   20,   20, 0, 0, NULL, 2, 0 },  /* PM_MESSAGE message buffer */
+   {   20,   20, 0, 0, NULL, 2, 0 },  /* PM_EMSG error message buffer */
+   {   20,   20, 0, 0, NULL, 2, 0 }   /* PM_BSOCK message buffer */
 };
 #endif
 
@@ -95,6 +97,248 @@ static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 
 #define HEAD_SIZE BALIGN(sizeof(struct abufhead))
 
+/*
+ * Per thread cache of free buffers
+ *
+ *  Each thread keeps a few free buffers of each pool, so most of the
+ *  get/free calls do not touch the global mutex. When the cache of a
+ *  pool is empty, half of cache_max buffers are taken from the global
+ *  free chain, and when it is full half of them are given back, both
+ *  under the mutex.
+ *
+ *  The cache is used by its thread only, the busy flag protects it
+ *  against close_memory_pool() that empties all the caches. The owner
+ *  never waits for the flag, if it is held by the collector the buffer
+ *  goes through the global free chain. A cache that cannot be emptied
+ *  by the collector is flagged and its owner empties it on its next
+ *  call. The caches are registered in a list protected by the mutex,
+ *  a cache is returned to the global pool when its thread exits.
+ *
+ *  The in_use, max_used and cached counters are updated with atomic
+ *  operations, the statistics are the same than without the caches.
+ */
+struct s_pool_cache {
+   struct s_pool_cache *next;         /* next registered cache */
+   volatile int32_t busy;             /* used by the owner or the collector */
+   volatile int32_t flush;            /* give back all buffers on next call */
+   struct abufhead *free_buf[PM_MAX+1];
+   int32_t count[PM_MAX+1];
+};
+
+static struct s_pool_cache *pool_caches = NULL;
+static pthread_key_t pool_cache_key;
+static pthread_once_t pool_cache_once = PTHREAD_ONCE_INIT;
+static bool pool_cache_ok = false;
+
+/* Count a buffer given to the caller */
+static void pool_inc_in_use(int pool)
+{
+   int32_t used = __sync_add_and_fetch(&pool_ctl[pool].in_use, 1);
+   int32_t max = pool_ctl[pool].max_used;
+   while (used > max) {
+      if (__sync_bool_compare_and_swap(&pool_ctl[pool].max_used, max, used)) {
+         break;
+      }
+      max = pool_ctl[pool].max_used;
+   }
+}
+
+static void pool_set_max_allocated(int pool, int32_t size)
+{
+   int32_t max = pool_ctl[pool].max_allocated;
+   while (size > max) {
+      if (__sync_bool_compare_and_swap(&pool_ctl[pool].max_allocated, max, size)) {
+         break;
+      }
+      max = pool_ctl[pool].max_allocated;
+   }
+}
+
+/* Give back the n first buffers of a cache, the mutex must be held */
+static void pool_cache_flush(struct s_pool_cache *cache, int pool, int n)
+{
+   struct abufhead *buf;
+
+   for (int i=0; i < n && cache->free_buf[pool]; i++) {
+      buf = cache->free_buf[pool];
+      cache->free_buf[pool] = buf->next;
+      buf->next = pool_ctl[pool].free_buf;
+      pool_ctl[pool].free_buf = buf;
+      cache->count[pool]--;
+      __sync_sub_and_fetch(&pool_ctl[pool].cached, 1);
+   }
+}
+
+static void pool_cache_flush_all(struct s_pool_cache *cache)
+{
+   for (int i=1; i<=PM_MAX; i++) {
+      pool_cache_flush(cache, i, cache->count[i]);
+   }
+}
+
+/* Called at the thread exit */
+static void pool_cache_destroy(void *arg)
+{
+   struct s_pool_cache *cache = (struct s_pool_cache *)arg;
+   struct s_pool_cache **prev;
+
+   P(mutex);
+   for (prev = &pool_caches; *prev; prev = &(*prev)->next) {
+      if (*prev == cache) {
+         *prev = cache->next;
+         break;
+      }
+   }
+   pool_cache_flush_all(cache);
+   V(mutex);
+   actuallyfree(cache);
+}
+
+static void create_pool_cache_key()
+{
+   pool_cache_ok = pthread_key_create(&pool_cache_key, pool_cache_destroy) == 0;
+}
+
+/*
+ * Get the cache of the current thread, created on first use. Returns
+ *  NULL if the cache cannot be used now, pool_cache_release() must be
+ *  called otherwise.
+ */
+static struct s_pool_cache *pool_cache_acquire()
+{
+   struct s_pool_cache *cache;
+
+   pthread_once(&pool_cache_once, create_pool_cache_key);
+   if (!pool_cache_ok) {
+      return NULL;
+   }
+   cache = (struct s_pool_cache *)pthread_getspecific(pool_cache_key);
+   if (!cache) {
+      cache = (struct s_pool_cache *)actuallymalloc(sizeof(struct s_pool_cache));
+      if (!cache) {
+         return NULL;
+      }
+      memset(cache, 0, sizeof(struct s_pool_cache));
+      if (pthread_setspecific(pool_cache_key, cache) != 0) {
+         actuallyfree(cache);
+         return NULL;
+      }
+      P(mutex);
+      cache->next = pool_caches;
+      pool_caches = cache;
+      V(mutex);
+   }
+   if (!__sync_bool_compare_and_swap(&cache->busy, 0, 1)) {
+      return NULL;                    /* close_memory_pool() is working on it */
+   }
+   return cache;
+}
+
+static void pool_cache_release(struct s_pool_cache *cache)
+{
+   if (cache->flush) {
+      P(mutex);
+      pool_cache_flush_all(cache);
+      cache->flush = 0;
+      V(mutex);
+   }
+   __sync_lock_release(&cache->busy);
+}
+
+/* Take a free buffer of the pool, NULL if a new one must be allocated */
+static struct abufhead *pool_get_free_buf(int pool)
+{
+   struct s_pool_cache *cache;
+   struct abufhead *buf;
+   int32_t n;
+
+   if (pool_ctl[pool].cache_max > 0 && (cache = pool_cache_acquire()) != NULL) {
+      if (!cache->free_buf[pool]) {
+         /* Refill the cache with a batch of buffers from the global chain */
+         P(mutex);
+         for (n = 0; n < (pool_ctl[pool].cache_max+1)/2 && pool_ctl[pool].free_buf; n++) {
+            buf = pool_ctl[pool].free_buf;
+            pool_ctl[pool].free_buf = buf->next;
+            buf->next = cache->free_buf[pool];
+            cache->free_buf[pool] = buf;
+         }
+         V(mutex);
+         cache->count[pool] = n;
+         __sync_add_and_fetch(&pool_ctl[pool].cached, n);
+      }
+      buf = cache->free_buf[pool];
+      if (buf) {
+         cache->free_buf[pool] = buf->next;
+         cache->count[pool]--;
+         __sync_sub_and_fetch(&pool_ctl[pool].cached, 1);
+      }
+      pool_cache_release(cache);
+      return buf;
+   }
+
+   P(mutex);
+   buf = pool_ctl[pool].free_buf;
+   if (buf) {
+      pool_ctl[pool].free_buf = buf->next;
+   }
+   V(mutex);
+   return buf;
+}
+
+/* Give a buffer back to the cache or to the global free chain */
+static void pool_put_free_buf(struct abufhead *buf, int pool)
+{
+   struct s_pool_cache *cache;
+
+   if (pool_ctl[pool].cache_max > 0 && (cache = pool_cache_acquire()) != NULL) {
+      buf->next = cache->free_buf[pool];
+      cache->free_buf[pool] = buf;
+      cache->count[pool]++;
+      __sync_add_and_fetch(&pool_ctl[pool].cached, 1);
+      if (cache->count[pool] > pool_ctl[pool].cache_max) {
+         P(mutex);
+         pool_cache_flush(cache, pool, cache->count[pool] / 2);
+         V(mutex);
+      }
+      pool_cache_release(cache);
+      return;
+   }
+
+   P(mutex);
+   /* Disabled with SMARTALLOC because it hangs in #5507 */
+#if defined(DEBUG) && !defined(SMARTALLOC)
+   struct abufhead *next;
+   /* Don't let him free the same buffer twice */
+   for (next=pool_ctl[pool].free_buf; next; next=next->next) {
+      if (next == buf) {
+         V(mutex);
+         ASSERT(next != buf);  /* attempt to free twice */
+      }
+   }
+#endif
+   buf->next = pool_ctl[pool].free_buf;
+   pool_ctl[pool].free_buf = buf;
+   V(mutex);
+}
+
+/*
+ * Empty the caches of all threads, the mutex must be held. The caches
+ *  in use are flagged and emptied by their owner.
+ */
+static void pool_cache_flush_threads()
+{
+   struct s_pool_cache *cache;
+
+   for (cache = pool_caches; cache; cache = cache->next) {
+      if (__sync_bool_compare_and_swap(&cache->busy, 0, 1)) {
+         pool_cache_flush_all(cache);
+         __sync_lock_release(&cache->busy);
+      } else {
+         cache->flush = 1;
+      }
+   }
+}
+
 #ifdef SMARTALLOC
 
 POOLMEM *sm_get_pool_memory(const char *fname, int lineno, int pool)
@@ -104,31 +348,20 @@ POOLMEM *sm_get_pool_memory(const char *fname, int lineno, int pool)
    if (pool > PM_MAX) {
       Emsg2(M_ABORT, 0, _("MemPool index %d larger than max %d\n"), pool, PM_MAX);
    }
-   P(mutex);
-   if (pool_ctl[pool].free_buf) {
-      buf = pool_ctl[pool].free_buf;
-      pool_ctl[pool].free_buf = buf->next;
-      pool_ctl[pool].in_use++;
-      if (pool_ctl[pool].in_use > pool_ctl[pool].max_used) {
-         pool_ctl[pool].max_used = pool_ctl[pool].in_use;
-      }
-      V(mutex);
+   if ((buf = pool_get_free_buf(pool)) != NULL) {
+      pool_inc_in_use(pool);
       Dmsg3(dbglvl, "sm_get_pool_memory reuse %p to %s:%d\n", buf, fname, lineno);
       sm_new_owner(fname, lineno, (char *)buf);
       return (POOLMEM *)((char *)buf+HEAD_SIZE);
    }
 
    if ((buf = (struct abufhead *)sm_malloc(fname, lineno, pool_ctl[pool].size+HEAD_SIZE)) == NULL) {
-      V(mutex);
       Emsg1(M_ABORT, 0, _("Out of memory requesting %d bytes\n"), pool_ctl[pool].size);
    }
    buf->ablen = pool_ctl[pool].size;
    buf->pool = pool;
-   pool_ctl[pool].in_use++;
-   if (pool_ctl[pool].in_use > pool_ctl[pool].max_used) {
-      pool_ctl[pool].max_used = pool_ctl[pool].in_use;
-   }
-   V(mutex);
+   buf->next = NULL;
+   pool_inc_in_use(pool);
    Dmsg3(dbglvl, "sm_get_pool_memory give %p to %s:%d\n", buf, fname, lineno);
    return (POOLMEM *)((char *)buf+HEAD_SIZE);
 }
@@ -145,11 +378,7 @@ POOLMEM *sm_get_memory(const char *fname, int lineno, int32_t size)
    buf->ablen = size;
    buf->pool = pool;
    buf->next = NULL;
-   P(mutex);
-   pool_ctl[pool].in_use++;
-   if (pool_ctl[pool].in_use > pool_ctl[pool].max_used)
-      pool_ctl[pool].max_used = pool_ctl[pool].in_use;
-   V(mutex);
+   pool_inc_in_use(pool);
    return (POOLMEM *)(((char *)buf)+HEAD_SIZE);
 }
 
@@ -170,22 +399,15 @@ POOLMEM *sm_realloc_pool_memory(const char *fname, int lineno, POOLMEM *obuf, in
 {
    char *cp = (char *)obuf;
    void *buf;
-   int pool;
 
    ASSERT(obuf);
-   P(mutex);
    cp -= HEAD_SIZE;
    buf = sm_realloc(fname, lineno, cp, size+HEAD_SIZE);
    if (buf == NULL) {
-      V(mutex);
       Emsg1(M_ABORT, 0, _("Out of memory requesting %d bytes\n"), size);
    }
    ((struct abufhead *)buf)->ablen = size;
-   pool = ((struct abufhead *)buf)->pool;
-   if (size > pool_ctl[pool].max_allocated) {
-      pool_ctl[pool].max_allocated = size;
-   }
-   V(mutex);
+   pool_set_max_allocated(((struct abufhead *)buf)->pool, size);
    return (POOLMEM *)(((char *)buf)+HEAD_SIZE);
 }
 
@@ -205,32 +427,15 @@ void sm_free_pool_memory(const char *fname, int lineno, POOLMEM *obuf)
    int pool;
 
    ASSERT(obuf);
-   P(mutex);
    buf = (struct abufhead *)((char *)obuf - HEAD_SIZE);
    pool = buf->pool;
-   pool_ctl[pool].in_use--;
+   __sync_sub_and_fetch(&pool_ctl[pool].in_use, 1);
+   Dmsg4(dbglvl, "free_pool_memory %p pool=%d from %s:%d\n", buf, pool, fname, lineno);
    if (pool == 0) {
       free((char *)buf);              /* free nonpooled memory */
-   } else {                           /* otherwise link it to the free pool chain */
-
-   /* Disabled because it hangs in #5507 */
-#ifdef xDEBUG
-      struct abufhead *next;
-      /* Don't let him free the same buffer twice */
-      for (next=pool_ctl[pool].free_buf; next; next=next->next) {
-         if (next == buf) {
-            Dmsg4(dbglvl, "free_pool_memory %p pool=%d from %s:%d\n", buf, pool, fname, lineno);
-            Dmsg4(dbglvl, "bad free_pool_memory %p pool=%d from %s:%d\n", buf, pool, fname, lineno);
-            V(mutex);                 /* unblock the pool */
-            ASSERT(next != buf);      /* attempt to free twice */
-         }
-      }
-#endif
-      buf->next = pool_ctl[pool].free_buf;
-      pool_ctl[pool].free_buf = buf;
+   } else {                           /* otherwise keep it for the next call */
+      pool_put_free_buf(buf, pool);
    }
-   Dmsg4(dbglvl, "free_pool_memory %p pool=%d from %s:%d\n", buf, pool, fname, lineno);
-   V(mutex);
 }
 
 #else
@@ -241,26 +446,18 @@ POOLMEM *get_pool_memory(int pool)
 {
    struct abufhead *buf;
 
-   P(mutex);
-   if (pool_ctl[pool].free_buf) {
-      buf = pool_ctl[pool].free_buf;
-      pool_ctl[pool].free_buf = buf->next;
-      V(mutex);
+   if ((buf = pool_get_free_buf(pool)) != NULL) {
+      pool_inc_in_use(pool);
       return (POOLMEM *)((char *)buf+HEAD_SIZE);
    }
 
    if ((buf=(struct abufhead*)malloc(pool_ctl[pool].size+HEAD_SIZE)) == NULL) {
-      V(mutex);
       Emsg1(M_ABORT, 0, _("Out of memory requesting %d bytes\n"), pool_ctl[pool].size);
    }
    buf->ablen = pool_ctl[pool].size;
    buf->pool = pool;
    buf->next = NULL;
-   pool_ctl[pool].in_use++;
-   if (pool_ctl[pool].in_use > pool_ctl[pool].max_used) {
-      pool_ctl[pool].max_used = pool_ctl[pool].in_use;
-   }
-   V(mutex);
+   pool_inc_in_use(pool);
    return (POOLMEM *)(((char *)buf)+HEAD_SIZE);
 }
 
@@ -276,10 +473,7 @@ POOLMEM *get_memory(int32_t size)
    buf->ablen = size;
    buf->pool = pool;
    buf->next = NULL;
-   pool_ctl[pool].in_use++;
-   if (pool_ctl[pool].in_use > pool_ctl[pool].max_used) {
-      pool_ctl[pool].max_used = pool_ctl[pool].in_use;
-   }
+   pool_inc_in_use(pool);
    return (POOLMEM *)(((char *)buf)+HEAD_SIZE);
 }
 
@@ -298,22 +492,15 @@ POOLMEM *realloc_pool_memory(POOLMEM *obuf, int32_t size)
 {
    char *cp = (char *)obuf;
    void *buf;
-   int pool;
 
    ASSERT(obuf);
-   P(mutex);
    cp -= HEAD_SIZE;
    buf = realloc(cp, size+HEAD_SIZE);
    if (buf == NULL) {
-      V(mutex);
       Emsg1(M_ABORT, 0, _("Out of memory requesting %d bytes\n"), size);
    }
    ((struct abufhead *)buf)->ablen = size;
-   pool = ((struct abufhead *)buf)->pool;
-   if (size > pool_ctl[pool].max_allocated) {
-      pool_ctl[pool].max_allocated = size;
-   }
-   V(mutex);
+   pool_set_max_allocated(((struct abufhead *)buf)->pool, size);
    return (POOLMEM *)(((char *)buf)+HEAD_SIZE);
 }
 
@@ -333,28 +520,15 @@ void free_pool_memory(POOLMEM *obuf)
    int pool;
 
    ASSERT(obuf);
-   P(mutex);
    buf = (struct abufhead *)((char *)obuf - HEAD_SIZE);
    pool = buf->pool;
-   pool_ctl[pool].in_use--;
+   __sync_sub_and_fetch(&pool_ctl[pool].in_use, 1);
+   Dmsg2(dbglvl, "free_pool_memory %p pool=%d\n", buf, pool);
    if (pool == 0) {
       free((char *)buf);              /* free nonpooled memory */
-   } else {                           /* otherwise link it to the free pool chain */
-#ifdef DEBUG
-      struct abufhead *next;
-      /* Don't let him free the same buffer twice */
-      for (next=pool_ctl[pool].free_buf; next; next=next->next) {
-         if (next == buf) {
-            V(mutex);
-            ASSERT(next != buf);  /* attempt to free twice */
-         }
-      }
-#endif
-      buf->next = pool_ctl[pool].free_buf;
-      pool_ctl[pool].free_buf = buf;
+   } else {                           /* otherwise keep it for the next call */
+      pool_put_free_buf(buf, pool);
    }
-   Dmsg2(dbglvl, "free_pool_memory %p pool=%d\n", buf, pool);
-   V(mutex);
 }
 #endif /* SMARTALLOC */
 
@@ -397,6 +571,7 @@ void close_memory_pool()
 
    sm_check(__FILE__, __LINE__, false);
    P(mutex);
+   pool_cache_flush_threads();
    for (int i=1; i<=PM_MAX; i++) {
       buf = pool_ctl[i].free_buf;
       while (buf) {
@@ -431,6 +606,20 @@ void garbage_collect_memory()
 #endif
 }
 
+#ifdef SAMPLEDALLOC
+static void sa_pmsg(const char *msg, int len, void *ctx)
+{
+   Pmsg1(-1, "%s", msg);
+}
+
+/* Print the biggest call sites of the sampled allocations */
+static void print_sampled_alloc_stats()
+{
+   sa_report(sa_pmsg, NULL, 30);
+   Pmsg0(-1, "\n");
+}
+#endif
+
 #ifdef DEBUG
 static const char *pool_name(int pool)
 {
@@ -448,16 +637,24 @@ static const char *pool_name(int pool)
  */
 void print_memory_pool_stats()
 {
-   Pmsg0(-1, "Pool   Maxsize  Maxused  Inuse\n");
+   Pmsg0(-1, "Pool   Maxsize  Maxused  Inuse  Cached\n");
    for (int i=0; i<=PM_MAX; i++)
-      Pmsg4(-1, "%5s  %7d  %7d  %5d\n", pool_name(i), pool_ctl[i].max_allocated,
-         pool_ctl[i].max_used, pool_ctl[i].in_use);
+      Pmsg5(-1, "%5s  %7d  %7d  %5d  %6d\n", pool_name(i), pool_ctl[i].max_allocated,
+         pool_ctl[i].max_used, pool_ctl[i].in_use, pool_ctl[i].cached);
 
    Pmsg0(-1, "\n");
+#ifdef SAMPLEDALLOC
+   print_sampled_alloc_stats();
+#endif
 }
 
 #else
-void print_memory_pool_stats() {}
+void print_memory_pool_stats()
+{
+#ifdef SAMPLEDALLOC
+   print_sampled_alloc_stats();
+#endif
+}
 #endif /* DEBUG */
 
 /*
@@ -622,23 +819,16 @@ void POOL_MEM::realloc_pm(int32_t size)
 {
    char *cp = mem;
    char *buf;
-   int pool;
 
-   P(mutex);
    cp -= HEAD_SIZE;
    buf = (char *)realloc(cp, size+HEAD_SIZE);
    if (buf == NULL) {
-      V(mutex);
       Emsg1(M_ABORT, 0, _("Out of memory requesting %d bytes\n"), size);
    }
    Dmsg2(900, "Old buf=%p new buf=%p\n", cp, buf);
    ((struct abufhead *)buf)->ablen = size;
-   pool = ((struct abufhead *)buf)->pool;
-   if (size > pool_ctl[pool].max_allocated) {
-      pool_ctl[pool].max_allocated = size;
-   }
+   pool_set_max_allocated(((struct abufhead *)buf)->pool, size);
    mem = buf+HEAD_SIZE;
-   V(mutex);
    Dmsg3(900, "Old buf=%p new buf=%p mem=%p\n", cp, buf, mem);
 }
 
@@ -666,3 +856,98 @@ int POOL_MEM::strcpy(const char *str)
    memcpy(mem, str, len);
    return len - 1;
 }
+
+#ifdef TEST_PROGRAM
+#include "unittests.h"
+
+#define NB_THREADS 8
+#define NB_LOOPS   20000
+
+static void *th_pool(void *arg)
+{
+   POOLMEM *bufs[40];
+   int pool = 1 + ((intptr_t)arg % PM_MAX);
+
+   for (int i=0; i < NB_LOOPS; i++) {
+      int n = 1 + (i % 40);
+      for (int j=0; j < n; j++) {
+         bufs[j] = get_pool_memory(pool);
+         *bufs[j] = 0;
+      }
+      if (i % 100 == 0) {
+         bufs[0] = check_pool_memory_size(bufs[0], 2 * pool_ctl[pool].size);
+      }
+      for (int j=0; j < n; j++) {
+         free_pool_memory(bufs[j]);
+      }
+   }
+   return NULL;
+}
+
+int main(int argc, char **argv)
+{
+   Unittests mem_pool_test("mem_pool_test", true);
+   pthread_t ids[NB_THREADS];
+   POOLMEM *b1, *b2;
+   int i, total;
+
+   /* Reuse in the same thread goes through the cache */
+   int32_t used = pool_ctl[PM_FNAME].in_use;
+   b1 = get_pool_memory(PM_FNAME);
+   is(pool_ctl[PM_FNAME].in_use, used + 1, "One more buffer in use");
+   free_pool_memory(b1);
+   is(pool_ctl[PM_FNAME].in_use, used, "Buffer released");
+   ok(pool_ctl[PM_FNAME].cached > 0, "Buffer kept in the thread cache");
+   b2 = get_pool_memory(PM_FNAME);
+   ok(b1 == b2, "Buffer reused from the cache");
+   free_pool_memory(b2);
+
+   /* The cache is bounded */
+   POOLMEM *bufs[100];
+   for (i=0; i < 100; i++) {
+      bufs[i] = get_pool_memory(PM_MESSAGE);
+   }
+   ok(pool_ctl[PM_MESSAGE].max_used >= 100, "Max used");
+   for (i=0; i < 100; i++) {
+      free_pool_memory(bufs[i]);
+   }
+   ok(pool_ctl[PM_MESSAGE].cached <= pool_ctl[PM_MESSAGE].cache_max,
+      "Cache size is limited");
+
+   used = 0;
+   for (i=0; i <= PM_MAX; i++) {
+      used += pool_ctl[i].in_use;
+   }
+   for (i=0; i < NB_THREADS; i++) {
+      pthread_create(&ids[i], NULL, th_pool, (void *)(intptr_t)i);
+   }
+   for (i=0; i < NB_THREADS; i++) {
+      pthread_join(ids[i], NULL);
+   }
+   total = 0;
+   for (i=0; i <= PM_MAX; i++) {
+      total += pool_ctl[i].in_use;
+   }
+   is(total, used, "All buffers are released");
+   ok(pool_ctl[PM_NAME].max_used >= 40, "Max used with threads");
+   ok(pool_ctl[PM_NAME].max_allocated >= 2 * pool_ctl[PM_NAME].size,
+      "Max allocated with threads");
+
+   /* The exited threads gave back their cache */
+   total = used = 0;
+   for (i=0; i <= PM_MAX; i++) {
+      total += pool_ctl[i].cached;
+      used += pool_ctl[i].cache_max;
+   }
+   ok(total <= used, "Only the main thread cache is used");
+
+   close_memory_pool();
+   total = 0;
+   for (i=0; i <= PM_MAX; i++) {
+      total += pool_ctl[i].cached;
+      ok(pool_ctl[i].free_buf == NULL, "Free chain released");
+   }
+   is(total, 0, "Thread caches released");
+   return report();
+}
+#endif /* TEST_PROGRAM */
@@ -226,6 +226,11 @@ void set_debug_flags(char *options)
          debug_flags |= DEBUG_PRINT_EVENT;
          break;
 
+      case 's':
+         /* Collect the mutex contention statistics */
+         debug_flags |= DEBUG_MUTEX_STATS;
+         break;
+
       default:
          Dmsg1(000, "Unknown debug flag %c\n", *p);
       }
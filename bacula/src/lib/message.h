@@ -155,6 +155,7 @@ struct MQUEUE_ITEM {
 /* Bits (1, 2, 4, ...) for debug_flags used by set_debug_flags() */
 #define DEBUG_MUTEX_EVENT           (1 << 0)    /* l */
 #define DEBUG_PRINT_EVENT           (1 << 1)    /* p */
+#define DEBUG_MUTEX_STATS           (1 << 2)    /* s */
 
 /* Tags that can be used with the setdebug command
  * We can extend this list to use 64bit
@@ -127,7 +127,7 @@ RES_ITEM collector_items[] = {
    {"Metrics",          store_alist_str,  ITEM(res_collector.metrics),           0, 0, 0},   /* default all */
    {"Interval",         store_time,       ITEM(res_collector.interval),          0, ITEM_DEFAULT, 5*60}, /* default 5 min */
    {"Port",             store_pint32,     ITEM(res_collector.port),              0, 0, 0},
-   {"Host",             store_str,        ITEM(res_collector.host),              0, 0, 0},
+   {"Host",             store_str,        ITEM(res_collector.host),              0, 0, 0},   /* Prometheus: default 127.0.0.1 */
    {"Type",             store_coll_type,  ITEM(res_collector.type),              0, ITEM_REQUIRED, 0},
    {"File",             store_str,        ITEM(res_collector.file),              0, 0, 0},
    {"MangleMetric",     store_bool,       ITEM(res_collector.mangle_name),       0, 0, 0},
@@ -179,6 +179,7 @@ s_kw tapelabels[] = {
 s_collt collectortypes[] = {
    {"CSV",           COLLECTOR_BACKEND_CSV},
    {"Graphite",      COLLECTOR_BACKEND_Graphite},
+   {"Prometheus",    COLLECTOR_BACKEND_Prometheus},
    {NULL,            0}
 };
 
@@ -982,7 +983,7 @@ void store_label(LEX *lc, RES_ITEM *item, int index, int pass)
 }
 
 /*
- * Store Statistics Type (CSV, Graphite - only supported)
+ * Store Statistics Type (CSV, Graphite, Prometheus - only supported)
  */
 void store_coll_type(LEX *lc, RES_ITEM *item, int index, int pass)
 {
@@ -376,6 +376,7 @@ bool             tls_bsock_probe         (BSOCKCORE *bsock);
 bool             tls_bsock_connect       (BSOCK *bsock);
 void             tls_bsock_shutdown      (BSOCKCORE *bsock);
 void             free_tls_connection     (TLS_CONNECTION *tls);
+bool             tls_bsock_ktls_send     (TLS_CONNECTION *tls);
 bool             get_tls_require         (TLS_CONTEXT *ctx);
 bool             get_tls_enable          (TLS_CONTEXT *ctx);
 bool             get_tls_psk_context     (TLS_CONTEXT *ctx);
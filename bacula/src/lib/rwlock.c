@@ -95,6 +95,7 @@ int rwl_destroy(brwlock_t *rwl)
   }
 
   rwl->valid = 0;
+  lmgr_stats_forget(rwl);
   if ((stat = pthread_mutex_unlock(&rwl->mutex)) != 0) {
      return stat;
   }
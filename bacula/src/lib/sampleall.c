@@ -0,0 +1,541 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+*/
+/*
+ * Sampled allocation tracking
+ *
+ *  SMARTALLOC tracks every buffer in a list protected by a mutex, this
+ *  is too expensive for a production daemon. When Bacula is built with
+ *  SAMPLEDALLOC, the malloc() family is redirected here and one
+ *  allocation in sa_sample_rate (on average) is accounted to its call
+ *  site, so the live memory per source line can be estimated at any
+ *  time with a very small cost.
+ *
+ *  Each buffer has a small header. For a sampled buffer, it points to
+ *  the call site entry and keeps the size, the other buffers have a
+ *  NULL site. The call sites are kept in a table owned by each thread,
+ *  only the owner adds entries, the counters are updated with atomic
+ *  operations because a buffer can be released by any thread. The
+ *  table of a terminated thread is kept with its counters and reused
+ *  by the next new thread.
+ *
+ *  The interval between two samples is random, so periodic allocation
+ *  patterns are not always (or never) sampled.
+ *
+ *  As with SMARTALLOC, free() and realloc() read the header in front of
+ *  the buffer, so they must only get the buffers allocated by Bacula.
+ *  The buffers allocated by the libc or by a library (strdup(),
+ *  readline(), backtrace_symbols(), ...) are released with
+ *  actuallyfree(). The magic of the header depends on its address, a
+ *  buffer released by mistake is not taken for one of ours, it is
+ *  reported with its caller and released with the libc routine.
+ */
+
+#define LOCKMGR_COMPLIANT
+
+#include "bacula.h"
+/* Use the real routines here */
+#undef realloc
+#undef calloc
+#undef malloc
+#undef free
+
+#define SA_MAGIC        0x5A4D4C43     /* buffer allocated by sa_malloc() */
+#define SA_SITES        256            /* call sites per thread, power of 2 */
+#define SA_PROBES       16             /* before using the overflow entry */
+
+/* One source line, counters are for the sampled buffers */
+struct sa_site {
+   const char *fname;                  /* NULL when the entry is free */
+   int32_t lineno;
+   volatile int32_t count;             /* live sampled buffers */
+   volatile int64_t bytes;             /* live sampled bytes */
+   volatile int64_t total;             /* sampled buffers allocated */
+};
+
+struct sa_table {
+   struct sa_table *next;              /* next registered table */
+   volatile int32_t in_use;            /* owned by a running thread */
+   int32_t countdown;                  /* allocations before the next sample */
+   uint32_t seed;                      /* random interval generator */
+   struct sa_site site[SA_SITES + 1];  /* the last one is the overflow */
+};
+
+struct sa_head {
+   struct sa_site *site;               /* call site of a sampled buffer */
+   uint32_t size;                      /* user size of a sampled buffer */
+   uint32_t magic;
+};
+
+/* Keep the user buffer aligned as malloc() does */
+#define SA_HEAD_SIZE ((sizeof(struct sa_head) + 15) & ~15)
+
+static struct sa_table *sa_tables = NULL;
+static pthread_key_t sa_key;
+static pthread_once_t sa_once = PTHREAD_ONCE_INIT;
+static bool sa_key_ok = false;
+
+int32_t sa_sample_rate = SA_DEFAULT_RATE;
+static volatile int64_t sa_foreign = 0;   /* buffers not allocated by us */
+static volatile int32_t sa_foreign_reported = 0;
+
+/* Called at the thread exit, the table is left to the next thread */
+static void sa_table_release(void *arg)
+{
+   struct sa_table *table = (struct sa_table *)arg;
+   __sync_lock_release(&table->in_use);
+}
+
+static void sa_create_key()
+{
+   sa_key_ok = pthread_key_create(&sa_key, sa_table_release) == 0;
+}
+
+static int32_t sa_next_interval(struct sa_table *table)
+{
+   int32_t rate = sa_sample_rate;
+
+   if (rate <= 1) {
+      return 1;
+   }
+   /* xorshift, the mean interval is the sample rate */
+   table->seed ^= table->seed << 13;
+   table->seed ^= table->seed >> 17;
+   table->seed ^= table->seed << 5;
+   return 1 + table->seed % (2 * rate - 1);
+}
+
+/*
+ * Get the table of the current thread, reuse the table of a
+ *  terminated thread when possible. Returns NULL on error.
+ */
+static struct sa_table *sa_get_table()
+{
+   struct sa_table *table;
+
+   pthread_once(&sa_once, sa_create_key);
+   if (!sa_key_ok) {
+      return NULL;
+   }
+   table = (struct sa_table *)pthread_getspecific(sa_key);
+   if (table) {
+      return table;
+   }
+   for (table = sa_tables; table; table = table->next) {
+      if (__sync_bool_compare_and_swap(&table->in_use, 0, 1)) {
+         break;
+      }
+   }
+   if (!table) {
+      struct sa_table *head;
+      table = (struct sa_table *)calloc(1, sizeof(struct sa_table));
+      if (!table) {
+         return NULL;
+      }
+      table->in_use = 1;
+      table->seed = (uint32_t)(((intptr_t)table >> 4) ^ time(NULL)) | 1;
+      table->countdown = sa_next_interval(table);
+      table->site[SA_SITES].fname = "*Overflow*";
+      do {
+         head = sa_tables;
+         table->next = head;
+      } while (!__sync_bool_compare_and_swap(&sa_tables, head, table));
+   }
+   if (pthread_setspecific(sa_key, table) != 0) {
+      __sync_lock_release(&table->in_use);
+      return NULL;
+   }
+   return table;
+}
+
+/* Find or add the entry of a call site in the table of the thread */
+static struct sa_site *sa_get_site(struct sa_table *table, const char *fname,
+                                   int lineno)
+{
+   uint32_t h = (uint32_t)((intptr_t)fname >> 3) ^ ((uint32_t)lineno * 2654435761U);
+
+   for (int i=0; i < SA_PROBES; i++) {
+      struct sa_site *site = &table->site[(h + i) & (SA_SITES - 1)];
+      if (site->fname == NULL) {
+         site->lineno = lineno;
+         __sync_synchronize();           /* lineno is visible before fname */
+         site->fname = fname;
+         return site;
+      }
+      if (site->fname == fname && site->lineno == lineno) {
+         return site;
+      }
+   }
+   return &table->site[SA_SITES];
+}
+
+/* The magic of a header, it depends on the header address */
+static inline uint32_t sa_magic(struct sa_head *head)
+{
+   return SA_MAGIC ^ (uint32_t)((uintptr_t)head >> 4);
+}
+
+/* Set the header of a new buffer, sample it if needed */
+static void *sa_track(struct sa_head *head, const char *fname, int lineno,
+                      unsigned int nbytes)
+{
+   struct sa_table *table;
+
+   head->magic = sa_magic(head);
+   head->site = NULL;
+   head->size = 0;
+   if (sa_sample_rate > 0 && (table = sa_get_table()) != NULL &&
+       --table->countdown <= 0) {
+      struct sa_site *site = sa_get_site(table, fname, lineno);
+      table->countdown = sa_next_interval(table);
+      head->site = site;
+      head->size = nbytes;
+      __sync_add_and_fetch(&site->count, 1);
+      __sync_add_and_fetch(&site->bytes, (int64_t)nbytes);
+      __sync_add_and_fetch(&site->total, 1);
+   }
+   return (char *)head + SA_HEAD_SIZE;
+}
+
+static void sa_untrack(struct sa_head *head)
+{
+   struct sa_site *site = head->site;
+   if (site) {
+      __sync_sub_and_fetch(&site->count, 1);
+      __sync_sub_and_fetch(&site->bytes, (int64_t)head->size);
+   }
+   head->magic = 0;
+}
+
+/*
+ * Returns the header, or NULL if the buffer was not allocated by us.
+ *  The caller must use actuallyfree() for such a buffer, the first
+ *  one is reported.
+ */
+static struct sa_head *sa_get_head(const char *fname, int lineno, void *ptr)
+{
+   struct sa_head *head = (struct sa_head *)((char *)ptr - SA_HEAD_SIZE);
+   if (head->magic != sa_magic(head)) {
+      __sync_add_and_fetch(&sa_foreign, 1);
+      if (__sync_bool_compare_and_swap(&sa_foreign_reported, 0, 1)) {
+         Pmsg3(0, _("Buffer %p not allocated by Bacula released from %s:%d, use actuallyfree()\n"),
+               ptr, fname, lineno);
+      }
+      return NULL;
+   }
+   return head;
+}
+
+static void sa_nomem(const char *fname, int lineno, unsigned int nbytes)
+{
+   berrno be;
+   e_msg(fname, lineno, M_ABORT, 0, _("Out of memory requesting %u bytes: ERR=%s\n"),
+         nbytes, be.bstrerror());
+}
+
+void *sa_malloc(const char *fname, int lineno, unsigned int nbytes)
+{
+   struct sa_head *head = (struct sa_head *)malloc(nbytes + SA_HEAD_SIZE);
+   if (!head) {
+      sa_nomem(fname, lineno, nbytes);
+      return NULL;
+   }
+   return sa_track(head, fname, lineno, nbytes);
+}
+
+void *sa_calloc(const char *fname, int lineno, unsigned int nelem,
+                unsigned int elsize)
+{
+   uint64_t nbytes = (uint64_t)nelem * elsize;
+   struct sa_head *head = NULL;
+
+   if (nbytes <= UINT32_MAX - SA_HEAD_SIZE) {
+      head = (struct sa_head *)calloc(1, nbytes + SA_HEAD_SIZE);
+   }
+   if (!head) {
+      sa_nomem(fname, lineno, (unsigned int)nbytes);
+      return NULL;
+   }
+   return sa_track(head, fname, lineno, (unsigned int)nbytes);
+}
+
+void *sa_realloc(const char *fname, int lineno, void *ptr, unsigned int size)
+{
+   struct sa_head *head, *nhead;
+   void *buf;
+
+   if (ptr == NULL) {
+      return sa_malloc(fname, lineno, size);
+   }
+   if ((head = sa_get_head(fname, lineno, ptr)) == NULL) {
+      if ((buf = realloc(ptr, size)) == NULL) {
+         sa_nomem(fname, lineno, size);
+      }
+      return buf;
+   }
+   sa_untrack(head);
+   if ((nhead = (struct sa_head *)realloc(head, size + SA_HEAD_SIZE)) == NULL) {
+      head->magic = sa_magic(head);      /* still valid for the caller */
+      head->site = NULL;
+      sa_nomem(fname, lineno, size);
+      return NULL;
+   }
+   return sa_track(nhead, fname, lineno, size);
+}
+
+void sa_free(const char *fname, int lineno, void *ptr)
+{
+   struct sa_head *head;
+
+   if (ptr == NULL) {
+      return;
+   }
+   if ((head = sa_get_head(fname, lineno, ptr)) == NULL) {
+      free(ptr);                        /* from the libc or a library */
+      return;
+   }
+   sa_untrack(head);
+   free(head);
+}
+
+/* A rate of 0 stops the sampling, 1 samples all allocations */
+void sa_set_sample_rate(int32_t rate)
+{
+   sa_sample_rate = MAX(rate, 0);
+}
+
+static int sa_compare(const void *a, const void *b)
+{
+   const struct sa_site *s1 = (const struct sa_site *)a;
+   const struct sa_site *s2 = (const struct sa_site *)b;
+
+   if (s1->bytes != s2->bytes) {
+      return s1->bytes > s2->bytes ? -1 : 1;
+   }
+   if (s1->total != s2->total) {
+      return s1->total > s2->total ? -1 : 1;
+   }
+   return 0;
+}
+
+/*
+ * Send the estimated live memory of the max biggest call sites,
+ *  0 for all of them. The sites of all threads are merged.
+ */
+void sa_report(void sendit(const char *msg, int len, void *ctx), void *ctx,
+               int max)
+{
+   struct sa_table *table;
+   struct sa_site *sites;
+   char buf[512], ed1[50], ed2[50], ed3[50];
+   int32_t rate = sa_sample_rate;
+   int nb = 0, allocated = 0, len;
+   int64_t bytes = 0;
+
+   if (rate == 0) {
+      len = bsnprintf(buf, sizeof(buf), _("Allocation sampling disabled.\n"));
+      sendit(buf, len, ctx);
+      return;
+   }
+   for (table = sa_tables; table; table = table->next) {
+      allocated += SA_SITES + 1;
+   }
+   sites = (struct sa_site *)malloc(MAX(allocated, 1) * sizeof(struct sa_site));
+   if (!sites) {
+      return;
+   }
+   /* Merge the entries of the same site */
+   for (table = sa_tables; table && nb < allocated; table = table->next) {
+      for (int i=0; i <= SA_SITES; i++) {
+         struct sa_site *site = &table->site[i];
+         const char *fname = site->fname;
+         int j;
+         if (fname == NULL || site->total == 0) {
+            continue;
+         }
+         __sync_synchronize();
+         for (j=0; j < nb; j++) {
+            if (sites[j].lineno == site->lineno &&
+                (sites[j].fname == fname || strcmp(sites[j].fname, fname) == 0)) {
+               break;
+            }
+         }
+         if (j == nb) {
+            sites[nb].fname = fname;
+            sites[nb].lineno = site->lineno;
+            sites[nb].count = 0;
+            sites[nb].bytes = 0;
+            sites[nb].total = 0;
+            nb++;
+         }
+         sites[j].count += site->count;
+         sites[j].bytes += site->bytes;
+         sites[j].total += site->total;
+      }
+   }
+   qsort(sites, nb, sizeof(struct sa_site), sa_compare);
+   for (int i=0; i < nb; i++) {
+      bytes += sites[i].bytes;
+   }
+
+   len = bsnprintf(buf, sizeof(buf),
+           _("Sampled allocations: rate=1/%d sites=%d live_bytes~%s foreign_frees=%s\n"),
+           rate, nb, edit_uint64_with_commas(bytes * rate, ed1),
+           edit_uint64_with_commas(sa_foreign, ed2));
+   sendit(buf, len, ctx);
+   len = bsnprintf(buf, sizeof(buf), _("     Live bytes   Live count       Allocs  Site\n"));
+   sendit(buf, len, ctx);
+   for (int i=0; i < nb && (max <= 0 || i < max); i++) {
+      len = bsnprintf(buf, sizeof(buf), "%15s %12s %12s  %s:%d\n",
+              edit_int64_with_commas(sites[i].bytes * rate, ed1),
+              edit_int64_with_commas((int64_t)sites[i].count * rate, ed2),
+              edit_int64_with_commas(sites[i].total * rate, ed3),
+              sites[i].fname, sites[i].lineno);
+      sendit(buf, len, ctx);
+   }
+   free(sites);
+}
+
+#ifdef SAMPLEDALLOC
+
+/* The standard routines, for memory released by a library */
+void *actuallymalloc(unsigned int size)
+{
+   return malloc(size);
+}
+
+void *actuallycalloc(unsigned int nelem, unsigned int elsize)
+{
+   return calloc(nelem, elsize);
+}
+
+void *actuallyrealloc(void *ptr, unsigned int size)
+{
+   return realloc(ptr, size);
+}
+
+void actuallyfree(void *cp)
+{
+   free(cp);
+}
+
+#endif /* SAMPLEDALLOC */
+
+#ifdef TEST_PROGRAM
+#include "unittests.h"
+
+#define NB_THREADS 8
+#define NB_LOOPS   10000
+
+static void report_cb(const char *msg, int len, void *ctx)
+{
+   POOLMEM **out = (POOLMEM **)ctx;
+   pm_strcat(out, msg);
+}
+
+static void *th_alloc(void *arg)
+{
+   void **bufs = (void **)arg;
+   /* Free the buffers of the main thread, then allocate some */
+   for (int i=0; i < NB_LOOPS; i++) {
+      sa_free(__FILE__, __LINE__, bufs[i]);
+      bufs[i] = sa_malloc(__FILE__, __LINE__, 32);
+   }
+   return NULL;
+}
+
+int main(int argc, char **argv)
+{
+   Unittests sampleall_test("sampleall_test", true);
+   pthread_t ids[NB_THREADS];
+   void *bufs[NB_THREADS][NB_LOOPS];
+   POOLMEM *out = get_pool_memory(PM_MESSAGE);
+   char *p, *q, *f;
+
+   /* Sample all allocations */
+   sa_set_sample_rate(1);
+   p = (char *)sa_malloc(__FILE__, __LINE__, 100);
+   ok(p != NULL, "sa_malloc()");
+   ok(((intptr_t)p & 15) == 0, "Buffer aligned");
+   memset(p, 'a', 100);
+   p = (char *)sa_realloc(__FILE__, __LINE__, p, 1000);
+   ok(p[99] == 'a', "sa_realloc() keeps the data");
+   q = (char *)sa_calloc(__FILE__, __LINE__, 10, 10);
+   ok(q[0] == 0 && q[99] == 0, "sa_calloc() clears the buffer");
+
+   /* A buffer from the libc released by mistake is detected */
+   sa_free(__FILE__, __LINE__, strdup("foreign"));
+   ok(sa_foreign == 1, "Foreign buffer detected");
+   f = (char *)sa_realloc(__FILE__, __LINE__, strdup("foreign"), 100);
+   ok(sa_foreign == 2 && strcmp(f, "foreign") == 0, "Foreign buffer reallocated");
+   actuallyfree(f);
+
+   for (int i=0; i < NB_THREADS; i++) {
+      for (int j=0; j < NB_LOOPS; j++) {
+         bufs[i][j] = sa_malloc(__FILE__, __LINE__, 64);
+      }
+   }
+   for (int i=0; i < NB_THREADS; i++) {
+      pthread_create(&ids[i], NULL, th_alloc, bufs[i]);
+   }
+   for (int i=0; i < NB_THREADS; i++) {
+      pthread_join(ids[i], NULL);
+   }
+
+   *out = 0;
+   sa_report(report_cb, &out, 0);
+   Dmsg1(0, "%s", out);
+   ok(strstr(out, "Live bytes") != NULL, "Report header");
+   /* 8 * 10000 buffers of 32 bytes are live */
+   ok(strstr(out, "      2,560,000       80,000       80,000") != NULL,
+      "Live bytes of the threads site");
+   ok(strstr(out, "              0            0       80,000") != NULL,
+      "Buffers released by the threads");
+   ok(strstr(out, "          1,000            1            1") != NULL,
+      "Reallocated buffer");
+
+   for (int i=0; i < NB_THREADS; i++) {
+      for (int j=0; j < NB_LOOPS; j++) {
+         sa_free(__FILE__, __LINE__, bufs[i][j]);
+      }
+   }
+   sa_free(__FILE__, __LINE__, p);
+   sa_free(__FILE__, __LINE__, q);
+
+   /* With sampling disabled nothing is accounted */
+   sa_set_sample_rate(0);
+   p = (char *)sa_malloc(__FILE__, __LINE__, 10);
+   ok(sa_get_head(__FILE__, __LINE__, p)->site == NULL, "Not sampled");
+   sa_free(__FILE__, __LINE__, p);
+
+   /* The mean interval is the rate */
+   sa_set_sample_rate(100);
+   int nb = 0;
+   for (int i=0; i < 100000; i++) {
+      p = (char *)sa_malloc(__FILE__, __LINE__, 10);
+      if (sa_get_head(__FILE__, __LINE__, p)->site) {
+         nb++;
+      }
+      sa_free(__FILE__, __LINE__, p);
+   }
+   ok(nb > 800 && nb < 1200, "About one allocation in 100 sampled");
+
+   free_pool_memory(out);
+   return report();
+}
+#endif /* TEST_PROGRAM */
@@ -33,6 +33,21 @@ extern uint32_t DLL_IMP_EXP sm_buffers;
 /* Avoid aggressive GCC optimization */
 extern void *bmemset(void *s, int c, size_t n);
 
+/* Sampled allocation tracking, see sampleall.c */
+#if defined(SAMPLEDALLOC) && defined(SMARTALLOC)
+#undef SAMPLEDALLOC                  /* SMARTALLOC tracks everything */
+#endif
+#define SA_DEFAULT_RATE 1024
+extern int32_t DLL_IMP_EXP sa_sample_rate;
+extern void *sa_malloc(const char *fname, int lineno, unsigned int nbytes),
+            *sa_calloc(const char *fname, int lineno,
+                unsigned int nelem, unsigned int elsize),
+            *sa_realloc(const char *fname, int lineno, void *ptr, unsigned int size);
+extern void sa_free(const char *fname, int lineno, void *ptr);
+extern void sa_set_sample_rate(int32_t rate);
+extern void sa_report(void sendit(const char *msg, int len, void *ctx), void *ctx,
+                      int max);
+
 #ifdef  SMARTALLOC
 #undef  SMARTALLOC
 #define SMARTALLOC SMARTALLOC
@@ -69,6 +84,33 @@ extern int sm_check_rtn(const char *fname, int lineno, bool bufdump);
 #define calloc(n,e)    sm_calloc(__FILE__, __LINE__, (n), (e))
 #define realloc(p,x)   sm_realloc(__FILE__, __LINE__, (p), (x))
 
+#elif defined(SAMPLEDALLOC)
+
+/* Redefine the standard memory allocator calls to sample them. As with
+   SMARTALLOC, the buffers of the libc or of a library are released with
+   actuallyfree(). */
+extern void *actuallymalloc(unsigned int size),
+            *actuallycalloc(unsigned int nelem, unsigned int elsize),
+            *actuallyrealloc(void *ptr, unsigned int size);
+extern void actuallyfree(void *cp);
+inline void sm_dump(int x, int y=0) {} /* with default arguments, we can't use a #define */
+#define sm_static(x)
+#define sm_new_owner(a, b, c)
+#define sm_get_owner(a,b)
+#define sm_malloc(f, l, n)     sa_malloc(f, l, n)
+#define sm_free(f, l, n)       sa_free(f, l, (void *)n)
+#define Dsm_check(lvl)
+#define sm_check(f, l, fl)
+#define sm_check_rtn(f, l, fl) 1
+
+extern void *b_malloc(const char *file, int line, size_t size);
+
+#define free(x)        sa_free(__FILE__, __LINE__, (void *)(x))
+#define cfree(x)       sa_free(__FILE__, __LINE__, (void *)(x))
+#define malloc(x)      sa_malloc(__FILE__, __LINE__, (x))
+#define calloc(n,e)    sa_calloc(__FILE__, __LINE__, (n), (e))
+#define realloc(p,x)   sa_realloc(__FILE__, __LINE__, (p), (x))
+
 #else
 
 /* If SMARTALLOC is disabled, define its special calls to default to
@@ -96,7 +138,7 @@ extern void *b_malloc(const char *file, int line, size_t size);
 
 #endif
 
-#ifdef SMARTALLOC
+#if defined(SMARTALLOC) || defined(SAMPLEDALLOC)
 
 #define New(type) new(__FILE__, __LINE__) type
 
@@ -181,6 +181,32 @@ static void list_terminated_jobs(STATUS_PKT *sp)
    }
 }
 
+/* sendit() for the lib reporting functions */
+static void sendit_ctx(const char *msg, int len, void *ctx)
+{
+   sendit(msg, len, (STATUS_PKT *)ctx);
+}
+
+/* common to SD/FD, live memory per call site */
+static void list_memory_status(STATUS_PKT *sp)
+{
+#ifdef SAMPLEDALLOC
+   sa_report(sendit_ctx, sp, 0);
+#else
+   const char *msg = _("Sampled allocation tracking not enabled.\n");
+   sendit(msg, strlen(msg), sp);
+#endif
+}
+
+/* common to SD/FD, mutex contention statistics */
+static void list_lockmgr_status(STATUS_PKT *sp, bool reset)
+{
+   lmgr_stats_report(sendit_ctx, sp, 0);
+   if (reset) {
+      lmgr_stats_reset();
+   }
+}
+
 /* common to SD/FD/DIR */
 static void list_resource_limits(STATUS_PKT *sp, int64_t l_nofile, int64_t l_memlock)
 {
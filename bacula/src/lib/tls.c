@@ -50,6 +50,16 @@
 /* No anonymous ciphers, no <128 bit ciphers, no export ciphers, no MD5 ciphers */
 #define TLS_DEFAULT_CIPHERS "ALL:!ADH:!LOW:!EXP:!MD5:@STRENGTH"
 
+/* Number of client sessions kept by a TLS context to be resumed */
+#define TLS_SESSION_CACHE_SIZE 16
+
+/* Client session that can be resumed by the next connection to the same peer */
+struct TLS_Session {
+   char *peer;                 /* host:port of the server */
+   SSL_SESSION *session;
+   time_t last_use;
+};
+
 /* TLS Context Structure */
 struct TLS_Context {
    SSL_CTX *openssl;
@@ -58,10 +68,16 @@ struct TLS_Context {
    bool tls_enable;
    bool tls_require;
    bool tls_psk_context; /* true if this context is used for TLS-PSK */
+   pthread_mutex_t sessions_lock;  /* protects sessions[] */
+   TLS_Session sessions[TLS_SESSION_CACHE_SIZE];
 };
 
 struct TLS_Connection {
    SSL *openssl;
+   TLS_CONTEXT *ctx;       /* context used to create the connection */
+   char *peer;             /* host:port of the server, client side only */
+   bool ktls_send;         /* the kernel encrypts what we write */
+   bool ktls_recv;         /* the kernel decrypts what we read */
    pthread_mutex_t wlock;  /* make openssl_bsock_readwrite() atomic when writing */
    pthread_mutex_t rwlock; /* only one SSL_read() or SSL_write() at a time */
 };
@@ -108,6 +124,88 @@ static int tls_pem_callback_dispatch (char *buf, int size, int rwflag, void *use
    return (ctx->pem_callback(buf, size, ctx->pem_userdata));
 }
 
+/*
+ * Called by OpenSSL when the server gives us a session (or a session
+ * ticket) that can be resumed. Keep it for the next connection to the
+ * same peer, replacing the oldest entry if the cache is full.
+ *  Returns: 1 if we keep the reference to the session
+ *           0 otherwise
+ */
+static int tls_new_session_cb(SSL *ssl, SSL_SESSION *session)
+{
+   TLS_CONNECTION *tls = (TLS_CONNECTION *)SSL_get_app_data(ssl);
+   TLS_Session *entry = NULL;
+   TLS_CONTEXT *ctx;
+   int i;
+
+   if (SSL_is_server(ssl) || !tls || !tls->peer) {
+      return 0;
+   }
+   ctx = tls->ctx;
+   P(ctx->sessions_lock);
+   for (i = 0; i < TLS_SESSION_CACHE_SIZE; i++) {
+      TLS_Session *e = &ctx->sessions[i];
+      if (e->peer && strcmp(e->peer, tls->peer) == 0) {
+         entry = e;
+         break;
+      }
+      if (!entry || !e->peer || (entry->peer && e->last_use < entry->last_use)) {
+         entry = e;
+      }
+   }
+   if (entry->session) {
+      SSL_SESSION_free(entry->session);
+   }
+   if (!entry->peer || strcmp(entry->peer, tls->peer) != 0) {
+      bfree_and_null(entry->peer);
+      entry->peer = bstrdup(tls->peer);
+   }
+   entry->session = session;
+   entry->last_use = time(NULL);
+   V(ctx->sessions_lock);
+   Dmsg1(50, "New TLS session for %s\n", tls->peer);
+   return 1;
+}
+
+/*
+ * Give to the connection the session of a previous connection
+ * to the same peer so that the full handshake can be skipped.
+ * With forget set, drop the session instead, it could not be resumed.
+ */
+static void tls_session_lookup(TLS_CONNECTION *tls, bool forget)
+{
+   TLS_CONTEXT *ctx = tls->ctx;
+   int i;
+
+   P(ctx->sessions_lock);
+   for (i = 0; i < TLS_SESSION_CACHE_SIZE; i++) {
+      TLS_Session *e = &ctx->sessions[i];
+      if (e->peer && strcmp(e->peer, tls->peer) == 0) {
+         if (forget) {
+            SSL_SESSION_free(e->session);
+            e->session = NULL;
+            bfree_and_null(e->peer);
+         } else {
+            SSL_set_session(tls->openssl, e->session);
+            e->last_use = time(NULL);
+         }
+         break;
+      }
+   }
+   V(ctx->sessions_lock);
+}
+
+/*
+ * Use the kernel TLS offload when it is available, OpenSSL
+ * falls back to the user space implementation otherwise.
+ */
+static void tls_enable_ktls(SSL_CTX *openssl)
+{
+#ifdef SSL_OP_ENABLE_KTLS
+   SSL_CTX_set_options(openssl, SSL_OP_ENABLE_KTLS);
+#endif
+}
+
 #ifdef HAVE_TLS_PSK
 static const char *psk_cipher = "PSK-AES256-CBC-SHA";
 
@@ -258,6 +356,8 @@ TLS_CONTEXT *new_tls_context(const char *ca_certfile, const char *ca_certdir,
    DH *dh;
 
    ctx = (TLS_CONTEXT *)malloc(sizeof(TLS_CONTEXT));
+   bmemzero(ctx, sizeof(TLS_CONTEXT));
+   pthread_mutex_init(&ctx->sessions_lock, NULL);
 
    /* Allocate our OpenSSL TLS Context */
 #if (OPENSSL_VERSION_NUMBER >= 0x10100000L)
@@ -274,6 +374,19 @@ TLS_CONTEXT *new_tls_context(const char *ca_certfile, const char *ca_certdir,
       openssl_post_errors(M_FATAL, _("Error initializing SSL context"));
       goto err;
    }
+   tls_enable_ktls(ctx->openssl);
+
+   /*
+    * Resume the sessions to skip the full handshake. The server side
+    * uses the session tickets, the client side keeps the sessions
+    * given by the servers in our own cache (see tls_new_session_cb()).
+    * The session id context is required to resume sessions when the
+    * peer certificate is verified.
+    */
+   SSL_CTX_set_session_id_context(ctx->openssl, (const unsigned char *)"bacula", 6);
+   SSL_CTX_set_session_cache_mode(ctx->openssl,
+      SSL_SESS_CACHE_BOTH | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+   SSL_CTX_sess_set_new_cb(ctx->openssl, tls_new_session_cb);
 
    /* Use SSL_OP_ALL to turn on all "rather harmless" workarounds that
     * OpenSSL offers 
@@ -370,6 +483,7 @@ err:
    if(ctx->openssl) {
       SSL_CTX_free(ctx->openssl);
    }
+   pthread_mutex_destroy(&ctx->sessions_lock);
    free(ctx);
    return NULL;
 }
@@ -379,6 +493,13 @@ err:
  */
 void free_tls_context(TLS_CONTEXT *ctx)
 {
+   for (int i = 0; i < TLS_SESSION_CACHE_SIZE; i++) {
+      if (ctx->sessions[i].session) {
+         SSL_SESSION_free(ctx->sessions[i].session);
+      }
+      bfree_and_null(ctx->sessions[i].peer);
+   }
+   pthread_mutex_destroy(&ctx->sessions_lock);
    SSL_CTX_free(ctx->openssl);
    free(ctx);
 }
@@ -388,6 +509,8 @@ TLS_CONTEXT *new_psk_context(const char *unused_shared_key)
 #ifdef HAVE_TLS_PSK
    TLS_CONTEXT *ctx = NULL;
    ctx = (TLS_CONTEXT *)malloc(sizeof(TLS_CONTEXT));
+   bmemzero(ctx, sizeof(TLS_CONTEXT));
+   pthread_mutex_init(&ctx->sessions_lock, NULL);
    /* Allocate our OpenSSL TLS Context */
 #if (OPENSSL_VERSION_NUMBER >= 0x10100000L)
    /* Allows SSLv3, TLSv1, TLSv1.1 and TLSv1.2 protocols */
@@ -411,6 +534,7 @@ TLS_CONTEXT *new_psk_context(const char *unused_shared_key)
       openssl_post_errors(M_FATAL, _("Error initializing SSL context"));
       goto err;
    }
+   tls_enable_ktls(ctx->openssl);
 
    /* NO pem encryption callback for TLS-PSK */
    ctx->pem_callback = NULL;
@@ -438,6 +562,7 @@ err:
    if(ctx->openssl) {
       SSL_CTX_free(ctx->openssl);
    }
+   pthread_mutex_destroy(&ctx->sessions_lock);
    free(ctx);
 #endif  /* HAVE_TLS_PSK */
    return NULL;
@@ -454,6 +579,7 @@ bool psk_set_shared_key(TLS_CONNECTION *tls, const char *shared_key)
  */
 void free_psk_context(TLS_CONTEXT *ctx)
 {
+   pthread_mutex_destroy(&ctx->sessions_lock);
    SSL_CTX_free(ctx->openssl);
    free(ctx);
 }
@@ -675,6 +801,8 @@ TLS_CONNECTION *new_tls_connection(TLS_CONTEXT *ctx, int fd)
 
    /* Allocate our new tls connection */
    TLS_CONNECTION *tls = (TLS_CONNECTION *)malloc(sizeof(TLS_CONNECTION));
+   bmemzero(tls, sizeof(TLS_CONNECTION));
+   tls->ctx = ctx;
 
    /* Create the SSL object and attach the socket BIO */
    if ((tls->openssl = SSL_new(ctx->openssl)) == NULL) {
@@ -684,6 +812,7 @@ TLS_CONNECTION *new_tls_connection(TLS_CONTEXT *ctx, int fd)
    }
 
    SSL_set_bio(tls->openssl, bio, bio);
+   SSL_set_app_data(tls->openssl, tls);      /* for tls_new_session_cb() */
 
    /* Non-blocking partial writes */
    SSL_set_mode(tls->openssl, SSL_MODE_ENABLE_PARTIAL_WRITE|SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
@@ -710,6 +839,7 @@ void free_tls_connection(TLS_CONNECTION *tls)
       pthread_mutex_destroy(&tls->rwlock);
       pthread_mutex_destroy(&tls->wlock);
       SSL_free(tls->openssl);
+      bfree_and_null(tls->peer);
       free(tls);
    }
 }
@@ -730,6 +860,10 @@ static inline bool openssl_bsock_session_start(BSOCK *bsock, bool server)
    bsock->clear_timed_out();
    bsock->set_killable(false);
 
+   if (tls->peer) {
+      tls_session_lookup(tls, false);
+   }
+
    for (;;) {
       if (server) {
          err = SSL_accept(tls->openssl);
@@ -774,6 +908,17 @@ cleanup:
    bsock->timer_start = 0;
    bsock->set_killable(true);
 
+   if (stat) {
+#ifdef BIO_get_ktls_send         /* not defined with OPENSSL_NO_KTLS */
+      tls->ktls_send = BIO_get_ktls_send(SSL_get_wbio(tls->openssl));
+      tls->ktls_recv = BIO_get_ktls_recv(SSL_get_rbio(tls->openssl));
+#endif
+      Dmsg4(50, "TLS %s established with %s resumed=%d ktls=%d\n",
+            SSL_get_version(tls->openssl), NPRTB(bsock->host()),
+            SSL_session_reused(tls->openssl), tls->ktls_send);
+   } else if (tls->peer) {
+      tls_session_lookup(tls, true);   /* do not try it again */
+   }
    return stat;
 }
 
@@ -784,6 +929,14 @@ cleanup:
  */
 bool tls_bsock_connect(BSOCK *bsock)
 {
+   TLS_CONNECTION *tls = bsock->tls;
+
+   /* The session of the last connection to this peer may be resumed */
+   if (!tls->ctx->tls_psk_context && bsock->host()) {
+      POOL_MEM peer;
+      Mmsg(peer, "%s:%d", bsock->host(), bsock->port());
+      tls->peer = bstrdup(peer.c_str());
+   }
    /* SSL_connect(bsock->tls) */
    return openssl_bsock_session_start(bsock, false);
 }
@@ -926,7 +1079,8 @@ static inline int openssl_bsock_readwrite(BSOCK *bsock, char *ptr, int nbytes, b
          goto cleanup;
       }
 
-      if (write && bsock->use_bwlimit()) {
+      /* Data received by a socket of a bandwidth group is limited too */
+      if (bsock->use_bwlimit() && (write || bsock->get_bwgroup())) {
          bsock->control_bwlimit(nwritten);
       }
 
@@ -965,6 +1119,15 @@ int tls_bsock_readn(BSOCK *bsock, char *ptr, int32_t nbytes)
    return openssl_bsock_readwrite(bsock, ptr, nbytes, false);
 }
 
+/*
+ * Returns true when the kernel encrypts the data written on the
+ * socket, plain write() calls can be used to send application data.
+ */
+bool tls_bsock_ktls_send(TLS_CONNECTION *tls)
+{
+   return tls->ktls_send;
+}
+
 /* test if 4 bytes can be read without "blocking" */
 bool tls_bsock_probe(BSOCKCORE *bsock)
 {
@@ -1007,6 +1170,11 @@ void tls_bsock_shutdown(BSOCKCORE *bsock) { }
 
 void free_tls_connection(TLS_CONNECTION *tls) { }
 
+bool tls_bsock_ktls_send(TLS_CONNECTION *tls)
+{
+   return false;
+}
+
 bool get_tls_require(TLS_CONTEXT *ctx)
 {
    return false;
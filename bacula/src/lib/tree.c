@@ -396,6 +396,18 @@ TREE_NODE *tree_cwd(char *path, TREE_ROOT *root, TREE_NODE *node)
 }
 
 
+/*
+ * If the tree is built on demand, make sure that the content of
+ *  the given directory is in the tree.
+ */
+bool tree_load_dir(TREE_ROOT *root, TREE_NODE *node)
+{
+   if (!root->load_dir || node->loaded || node->type == TN_FILE) {
+      return true;
+   }
+   return root->load_dir(root, node);
+}
+
 /*
  * Do a relative cwd -- i.e. relative to current node rather than root node
  */
@@ -417,6 +429,7 @@ TREE_NODE *tree_relcwd(char *path, TREE_ROOT *root, TREE_NODE *node)
       len = strlen(path);
    }
    Dmsg2(100, "tree_relcwd: len=%d path=%s\n", len, path);
+   tree_load_dir(root, node);
    foreach_child(cd, node) {
       Dmsg1(100, "tree_relcwd: test cd=%s\n", cd->fname);
       if (cd->fname[0] == path[0] && len == (int)strlen(cd->fname)
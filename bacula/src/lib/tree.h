@@ -111,6 +111,9 @@ struct s_tree_root {
    char *cached_path;                 /* cached current path */
    TREE_NODE *cached_parent;          /* cached parent for above path */
    htable hardlinks;                  /* references to first occurrence of hardlinks */
+   /* When set, called to load the content of a directory on demand */
+   bool (*load_dir)(struct s_tree_root *root, struct s_tree_node *node);
+   void *load_ctx;                    /* context for load_dir */
 };
 typedef struct s_tree_root TREE_ROOT;
 
@@ -136,6 +139,7 @@ TREE_NODE *insert_tree_node(char *path, char *fname, int type,
 TREE_NODE *make_tree_path(char *path, TREE_ROOT *root);
 TREE_NODE *tree_cwd(char *path, TREE_ROOT *root, TREE_NODE *node);
 TREE_NODE *tree_relcwd(char *path, TREE_ROOT *root, TREE_NODE *node);
+bool tree_load_dir(TREE_ROOT *root, TREE_NODE *node);
 void tree_add_delta_part(TREE_ROOT *root, TREE_NODE *node,
                          JobId_t JobId, int32_t FileIndex);
 void free_tree(TREE_ROOT *root);
@@ -0,0 +1,953 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+ */
+/**
+ * @file dklayers.c
+ * @brief Layer aware backup and restore of Docker images for the Docker plugin.
+ */
+
+#include "dklayers.h"
+#include <dirent.h>
+
+#define PLUGINPREFIX                "dklayers:"
+
+#define TARBLOCK                    512
+#define TARPADDED(s)                (((s) + TARBLOCK - 1) & ~((uint64_t)TARBLOCK - 1))
+#define DKLAYERSMAXJSON             (64 * 1024 * 1024)
+#define DKLAYERSBUFSIZE             (64 * 1024)
+
+/* tar entry types */
+#define TARREGTYPE                  '0'
+#define TARAREGTYPE                 '\0'
+#define TARSYMTYPE                  '2'
+
+/* a tar entry of the spooled image archive */
+typedef struct {
+   char *name;
+   char *link;
+   char type;
+   uint64_t hdroffset;
+   uint64_t dataoffset;
+   uint64_t size;
+   bool layer;
+} DKTARENTRY;
+
+/*
+ * Get the numeric field of the tar header, octal or base-256 encoded.
+ */
+static uint64_t tar_number(const char *p, int len)
+{
+   uint64_t n = 0;
+   int i = 0;
+
+   if ((unsigned char)p[0] & 0x80){
+      /* base-256 encoding */
+      n = (unsigned char)p[0] & 0x7f;
+      for (i = 1; i < len; i++){
+         n = (n << 8) | (unsigned char)p[i];
+      }
+      return n;
+   }
+   while (i < len && (p[i] == ' ' || p[i] == '0')){
+      i++;
+   }
+   for (; i < len && p[i] >= '0' && p[i] <= '7'; i++){
+      n = (n << 3) | (p[i] - '0');
+   }
+   return n;
+}
+
+/*
+ * Get a string field of the tar header which is not always nul terminated.
+ */
+static void tar_string(const char *p, int len, POOL_MEM &out)
+{
+   int l = strnlen(p, len);
+
+   out.check_size(l + 1);
+   memcpy(out.c_str(), p, l);
+   out.c_str()[l] = 0;
+}
+
+/*
+ * Get the entry name of the tar header, with the ustar prefix if any.
+ */
+static void tar_entry_name(const char *hdr, POOL_MEM &out)
+{
+   POOL_MEM name(PM_FNAME);
+
+   tar_string(hdr, 100, name);
+   if (strncmp(hdr + 257, "ustar", 5) == 0 && hdr[345] != 0){
+      tar_string(hdr + 345, 155, out);
+      pm_strcat(out, "/");
+      pm_strcat(out, name);
+   } else {
+      pm_strcpy(out, name.c_str());
+   }
+}
+
+static bool tar_is_end(const char *hdr)
+{
+   for (int i = 0; i < TARBLOCK; i++){
+      if (hdr[i]){
+         return false;
+      }
+   }
+   return true;
+}
+
+/*
+ * Normalize a relative path of the archive, so "a/../b/./layer.tar" is "b/layer.tar".
+ */
+static void normalize_path(POOL_MEM &path)
+{
+   POOL_MEM out(PM_FNAME);
+   char *p, *q, *s;
+
+   *out.c_str() = 0;
+   for (p = path.c_str(); *p; p = q){
+      q = strchr(p, '/');
+      if (q){
+         *q++ = 0;
+      } else {
+         q = p + strlen(p);
+      }
+      if (*p == 0 || bstrcmp(p, ".")){
+         continue;
+      }
+      if (bstrcmp(p, "..")){
+         /* remove the last component */
+         s = strrchr(out.c_str(), '/');
+         if (s){
+            *s = 0;
+         } else {
+            *out.c_str() = 0;
+         }
+         continue;
+      }
+      if (*out.c_str()){
+         pm_strcat(out, "/");
+      }
+      pm_strcat(out, p);
+   }
+   pm_strcpy(path, out.c_str());
+}
+
+/*
+ * Return the value of the key in json document or NULL when not found.
+ *  It is not a json parser, but the documents generated by "docker save" are
+ *  simple enough to find what we need.
+ */
+static const char *json_key(const char *p, const char *key)
+{
+   int len = strlen(key);
+
+   while ((p = strchr(p, '"')) != NULL){
+      if (strncmp(p + 1, key, len) == 0 && p[len + 1] == '"'){
+         p += len + 2;
+         while (B_ISSPACE(*p)){
+            p++;
+         }
+         if (*p == ':'){
+            p++;
+            while (B_ISSPACE(*p)){
+               p++;
+            }
+            return p;
+         }
+      }
+      p++;
+   }
+   return NULL;
+}
+
+/*
+ * Scan a json string, return the position after the string or NULL on error.
+ */
+static const char *json_string(const char *p, POOL_MEM &out)
+{
+   int len = 0;
+
+   if (*p++ != '"'){
+      return NULL;
+   }
+   out.check_size(strlen(p) + 1);
+   while (*p && *p != '"'){
+      if (*p == '\\' && p[1]){
+         p++;
+      }
+      out.c_str()[len++] = *p++;
+   }
+   out.c_str()[len] = 0;
+   return *p == '"' ? p + 1 : NULL;
+}
+
+/*
+ * Scan a json array of strings into the list, return the position after the
+ *  array or NULL on error.
+ */
+static const char *json_string_array(const char *p, alist *list)
+{
+   POOL_MEM str(PM_FNAME);
+
+   if (*p++ != '['){
+      return NULL;
+   }
+   for (;;){
+      while (B_ISSPACE(*p) || *p == ','){
+         p++;
+      }
+      if (*p == ']'){
+         return p + 1;
+      }
+      if ((p = json_string(p, str)) == NULL){
+         return NULL;
+      }
+      list->append(bstrdup(str.c_str()));
+   }
+}
+
+static bool is_digest(const char *p)
+{
+   int len;
+
+   for (len = 0; p[len]; len++){
+      if (!((p[len] >= '0' && p[len] <= '9') || (p[len] >= 'a' && p[len] <= 'f'))){
+         return false;
+      }
+   }
+   return len == DKIDDIGESTSIZE;
+}
+
+/*
+ * Scan a digest followed by a space, return the position after the space or
+ *  NULL on error.
+ */
+static const char *scan_digest(const char *p, char *digest)
+{
+   const char *q = strchr(p, ' ');
+
+   if (q == NULL || q - p != DKIDDIGESTSIZE){
+      return NULL;
+   }
+   memcpy(digest, p, DKIDDIGESTSIZE);
+   digest[DKIDDIGESTSIZE] = 0;
+   return is_digest(digest) ? q + 1 : NULL;
+}
+
+static void free_layer(DKLAYER *layer)
+{
+   if (layer->path){
+      free(layer->path);
+   }
+   free(layer);
+}
+
+static void free_state(DKLAYERSTATE *st)
+{
+   if (st->name){
+      free(st->name);
+   }
+   free(st);
+}
+
+static bool write_out(bpContext *ctx, FILE *out, POOLMEM *buf, int32_t len)
+{
+   if (fwrite(buf, 1, len, out) != (size_t)len){
+      berrno be;
+      DMSG1(ctx, DERROR, "cannot send image archive. Err=%s\n", be.bstrerror());
+      JMSG1(ctx, M_ERROR, "Cannot send image archive. Err=%s\n", be.bstrerror());
+      return false;
+   }
+   return true;
+}
+
+static DKTARENTRY *find_tar_entry(alist *entries, const char *name)
+{
+   DKTARENTRY *entry;
+
+   foreach_alist(entry, entries){
+      if (bstrcmp(entry->name, name)){
+         return entry;
+      }
+   }
+   return NULL;
+}
+
+/*
+ * DKLAYERS class constructor, does default initialization.
+ */
+DKLAYERS::DKLAYERS() :
+   layers(New(alist(10, not_owned_by_alist))),
+   state(New(alist(100, not_owned_by_alist))),
+   pending(New(alist(100, not_owned_by_alist))),
+   statefile(PM_FNAME),
+   stashdir(PM_FNAME),
+   manifestsize(0)
+{
+}
+
+/*
+ * DKLAYERS class destructor, releases all the lists.
+ */
+DKLAYERS::~DKLAYERS()
+{
+   DKLAYERSTATE *st;
+
+   clear();
+   delete layers;
+   foreach_alist(st, state){
+      free_state(st);
+   }
+   delete state;
+   foreach_alist(st, pending){
+      free_state(st);
+   }
+   delete pending;
+}
+
+/*
+ * Release the layers of the current object.
+ */
+void DKLAYERS::clear()
+{
+   DKLAYER *layer;
+
+   foreach_alist(layer, layers){
+      free_layer(layer);
+   }
+   layers->destroy();
+   manifestsize = 0;
+}
+
+/*
+ * Loads the layers saved by the previous jobs. A missing state file is not
+ *  an error, all layers will be saved then.
+ *
+ * in:
+ *    bpContext - for Bacula debug and jobinfo messages
+ *    statefile - the layers state file name
+ * out:
+ *    bRC_OK - when state loaded or no state file
+ *    bRC_Error - on any error
+ */
+bRC DKLAYERS::load_state(bpContext *ctx, const char *fname)
+{
+   POOL_MEM line(PM_FNAME);
+   DKLAYERSTATE *st;
+   FILE *fp;
+   const char *p;
+   char *q;
+   int jobid;
+   char digest[DKIDDIGESTSIZE_Len];
+
+   pm_strcpy(statefile, fname);
+   fp = bfopen(fname, "r");
+   if (fp == NULL){
+      berrno be;
+      if (be.code() == ENOENT){
+         DMSG1(ctx, DINFO, "no layers state file: %s\n", fname);
+         return bRC_OK;
+      }
+      DMSG2(ctx, DERROR, "cannot open layers state file: %s Err=%s\n", fname, be.bstrerror());
+      JMSG2(ctx, M_ERROR, "Cannot open layers state file: %s Err=%s\n", fname, be.bstrerror());
+      return bRC_Error;
+   }
+   while (bfgets(line.addr(), fp) != NULL){
+      /* <level> <jobid> <digest> <name> */
+      p = strip_trailing_newline(line.c_str());
+      jobid = strtol(p + 1, &q, 10);
+      if (p[0] == 0 || p[1] != ' ' || *q != ' ' || (p = scan_digest(q + 1, digest)) == NULL || *p == 0){
+         DMSG1(ctx, DERROR, "invalid layers state line: %s\n", line.c_str());
+         continue;
+      }
+      st = (DKLAYERSTATE *)malloc(sizeof(DKLAYERSTATE));
+      st->level = line.c_str()[0];
+      st->jobid = jobid;
+      bstrncpy(st->digest, digest, sizeof(st->digest));
+      st->name = bstrdup(p);
+      state->append(st);
+   }
+   fclose(fp);
+   DMSG2(ctx, DINFO, "loaded %d layers from state file: %s\n", state->size(), fname);
+   return bRC_OK;
+}
+
+/*
+ * Saves the layers state when the backup job finish. A Full backup replaces
+ *  all the state, a Differential backup keeps the layers saved by the Full
+ *  and an Incremental backup keeps everything.
+ *
+ * in:
+ *    bpContext - for Bacula debug and jobinfo messages
+ *    level - the backup job level
+ * out:
+ *    bRC_OK - when state saved
+ *    bRC_Error - on any error
+ */
+bRC DKLAYERS::commit_state(bpContext *ctx, char level)
+{
+   POOL_MEM tmp(PM_FNAME);
+   DKLAYERSTATE *st;
+   FILE *fp;
+   int a;
+
+   if (strlen(statefile.c_str()) == 0){
+      return bRC_OK;
+   }
+   Mmsg(tmp, "%s.tmp", statefile.c_str());
+   fp = bfopen(tmp.c_str(), "w");
+   if (fp == NULL){
+      berrno be;
+      DMSG2(ctx, DERROR, "cannot create layers state file: %s Err=%s\n", tmp.c_str(), be.bstrerror());
+      JMSG2(ctx, M_ERROR, "Cannot create layers state file: %s Err=%s\n", tmp.c_str(), be.bstrerror());
+      return bRC_Error;
+   }
+   for (a = 0; a < 2; a++){
+      foreach_alist(st, a == 0 ? state : pending){
+         if (a == 0 && (level == 'F' || (level == 'D' && st->level != 'F'))){
+            continue;
+         }
+         fprintf(fp, "%c %d %s %s\n", st->level, st->jobid, st->digest, st->name);
+      }
+   }
+   if (fclose(fp) != 0 || rename(tmp.c_str(), statefile.c_str()) != 0){
+      berrno be;
+      DMSG2(ctx, DERROR, "cannot save layers state file: %s Err=%s\n", statefile.c_str(), be.bstrerror());
+      JMSG2(ctx, M_ERROR, "Cannot save layers state file: %s Err=%s\n", statefile.c_str(), be.bstrerror());
+      unlink(tmp.c_str());
+      return bRC_Error;
+   }
+   DMSG2(ctx, DINFO, "saved %d new layers to state file: %s\n", pending->size(), statefile.c_str());
+   return bRC_OK;
+}
+
+DKLAYERSTATE *DKLAYERS::find_state(const char *name, const char *digest, bool fullonly)
+{
+   DKLAYERSTATE *st;
+
+   foreach_alist(st, state){
+      if (bstrcmp(st->digest, digest) && bstrcmp(st->name, name) &&
+            (!fullonly || st->level == 'F')){
+         return st;
+      }
+   }
+   return NULL;
+}
+
+/*
+ * Select the layers of the current object to save for the backup level.
+ *
+ * in:
+ *    name - the docker object name
+ *    level - the backup job level
+ */
+void DKLAYERS::select(const char *name, char level)
+{
+   DKLAYER *layer;
+
+   foreach_alist(layer, layers){
+      switch (level){
+         case 'D':
+            layer->save = find_state(name, layer->digest, true) == NULL;
+            break;
+         case 'I':
+            layer->save = find_state(name, layer->digest, false) == NULL;
+            break;
+         default:
+            layer->save = true;
+            break;
+      }
+   }
+}
+
+/*
+ * Record the layers saved for the current object, so they will be added
+ *  to the state file at the end of the job.
+ */
+void DKLAYERS::record(const char *name, int jobid, char level)
+{
+   DKLAYERSTATE *st;
+   DKLAYER *layer;
+
+   foreach_alist(layer, layers){
+      if (!layer->save){
+         continue;
+      }
+      st = (DKLAYERSTATE *)malloc(sizeof(DKLAYERSTATE));
+      st->level = level;
+      st->jobid = jobid;
+      bstrncpy(st->digest, layer->digest, sizeof(st->digest));
+      st->name = bstrdup(name);
+      pending->append(st);
+   }
+}
+
+/*
+ * Return the nr-th layer to save or NULL when no more layers.
+ */
+DKLAYER *DKLAYERS::get_to_save(int nr)
+{
+   DKLAYER *layer;
+
+   foreach_alist(layer, layers){
+      if (layer->save && nr-- == 0){
+         return layer;
+      }
+   }
+   return NULL;
+}
+
+bool DKLAYERS::read_entry(int fd, uint64_t offset, uint64_t size, POOL_MEM &out)
+{
+   ssize_t rc;
+   uint64_t done = 0;
+
+   if (size > DKLAYERSMAXJSON){
+      return false;
+   }
+   out.check_size(size + 1);
+   while (done < size){
+      rc = pread(fd, out.c_str() + done, size - done, offset + done);
+      if (rc <= 0){
+         return false;
+      }
+      done += rc;
+   }
+   out.c_str()[size] = 0;
+   return true;
+}
+
+bool DKLAYERS::copy_data(int infd, uint64_t offset, uint64_t size, int outfd, POOLMEM *buf)
+{
+   ssize_t rc;
+   int32_t len;
+
+   while (size > 0){
+      len = size > DKLAYERSBUFSIZE ? DKLAYERSBUFSIZE : size;
+      rc = pread(infd, buf, len, offset);
+      if (rc <= 0){
+         return false;
+      }
+      if (write(outfd, buf, rc) != rc){
+         return false;
+      }
+      offset += rc;
+      size -= rc;
+   }
+   return true;
+}
+
+/*
+ * Scans the spooled image archive for layers and generates the manifest.
+ *  The layers are listed in manifest.json of the archive, their digest is the
+ *  blob name of the OCI layout or the matching rootfs diff_id of the image
+ *  config for the legacy layout. The archive entries which are not recognized
+ *  as layers stay in the manifest, so the restore is always possible.
+ *
+ * in:
+ *    bpContext - for Bacula debug and jobinfo messages
+ *    spoolfile - the image archive
+ *    manifestfile - the manifest file to generate
+ * out:
+ *    bRC_OK - when scan was successful
+ *    bRC_Error - on any error
+ */
+bRC DKLAYERS::scan(bpContext *ctx, const char *spoolfile, const char *manifestfile)
+{
+   POOL_MEM name(PM_FNAME);
+   POOL_MEM json(PM_BSOCK);
+   POOL_MEM config(PM_BSOCK);
+   POOL_MEM cfgname(PM_FNAME);
+   POOLMEM *buf = NULL;
+   alist entries(100, not_owned_by_alist);
+   alist paths(10, owned_by_alist);
+   alist diffids(10, owned_by_alist);
+   DKTARENTRY *entry;
+   DKLAYER *layer;
+   char hdr[TARBLOCK];
+   const char *p, *q, *digest;
+   char *path;
+   struct stat statp;
+   uint64_t offset = 0;
+   uint64_t from;
+   ssize_t rc;
+   int fd, mfd = -1;
+   int i;
+   bRC status = bRC_Error;
+
+   clear();
+   fd = open(spoolfile, O_RDONLY);
+   if (fd < 0){
+      berrno be;
+      DMSG2(ctx, DERROR, "cannot open image archive: %s Err=%s\n", spoolfile, be.bstrerror());
+      JMSG2(ctx, M_ERROR, "Cannot open image archive: %s Err=%s\n", spoolfile, be.bstrerror());
+      return bRC_Error;
+   }
+
+   /* index all archive entries */
+   for (;;){
+      rc = pread(fd, hdr, TARBLOCK, offset);
+      if (rc != TARBLOCK){
+         DMSG1(ctx, DERROR, "image archive truncated at %llu\n", (unsigned long long)offset);
+         JMSG1(ctx, M_ERROR, "Image archive truncated at %llu\n", (unsigned long long)offset);
+         goto bailout;
+      }
+      if (tar_is_end(hdr)){
+         break;
+      }
+      tar_entry_name(hdr, name);
+      entry = (DKTARENTRY *)malloc(sizeof(DKTARENTRY));
+      entry->name = bstrdup(name.c_str());
+      tar_string(hdr + 157, 100, name);
+      entry->link = bstrdup(name.c_str());
+      entry->type = hdr[156];
+      entry->hdroffset = offset;
+      entry->dataoffset = offset + TARBLOCK;
+      entry->size = tar_number(hdr + 124, 12);
+      entry->layer = false;
+      entries.append(entry);
+      offset = entry->dataoffset + TARPADDED(entry->size);
+   }
+
+   /* find the layers listed in manifest.json */
+   entry = find_tar_entry(&entries, "manifest.json");
+   if (entry == NULL || !read_entry(fd, entry->dataoffset, entry->size, json)){
+      DMSG0(ctx, DINFO, "no manifest.json found, the image archive will be saved as a whole\n");
+   } else {
+      for (p = json.c_str(); (p = json_key(p, "Config")) != NULL; ){
+         paths.destroy();
+         diffids.destroy();
+         if ((p = json_string(p, cfgname)) == NULL ||
+               (q = json_key(p, "Layers")) == NULL ||
+               (q = json_string_array(q, &paths)) == NULL){
+            DMSG0(ctx, DERROR, "cannot parse manifest.json\n");
+            break;
+         }
+         p = q;
+         /* the legacy layout requires rootfs diff_ids from image config */
+         entry = find_tar_entry(&entries, cfgname.c_str());
+         if (entry && read_entry(fd, entry->dataoffset, entry->size, config) &&
+               (q = json_key(config.c_str(), "diff_ids")) != NULL){
+            json_string_array(q, &diffids);
+         }
+         i = 0;
+         foreach_alist(path, &paths){
+            pm_strcpy(name, path);
+            entry = find_tar_entry(&entries, name.c_str());
+            if (entry && entry->type == TARSYMTYPE){
+               /* duplicated layers are symlinks to the first one */
+               q = strrchr(path, '/');
+               Mmsg(name, "%.*s/%s", q ? (int)(q - path) : 0, path, entry->link);
+               normalize_path(name);
+               entry = find_tar_entry(&entries, name.c_str());
+            }
+            digest = NULL;
+            if (entry && !entry->layer && (entry->type == TARREGTYPE || entry->type == TARAREGTYPE)){
+               if (strncmp(entry->name, "blobs/sha256/", 13) == 0){
+                  digest = entry->name + 13;
+               } else
+               if (i < diffids.size() && strncmp((char *)diffids.get(i), "sha256:", 7) == 0){
+                  digest = (char *)diffids.get(i) + 7;
+               }
+            }
+            if (digest && is_digest(digest)){
+               layer = (DKLAYER *)malloc(sizeof(DKLAYER));
+               layer->path = bstrdup(entry->name);
+               bstrncpy(layer->digest, digest, sizeof(layer->digest));
+               layer->offset = entry->dataoffset;
+               layer->size = entry->size;
+               layer->save = true;
+               layers->append(layer);
+               entry->layer = true;
+            }
+            i++;
+         }
+      }
+   }
+
+   /* generate the manifest: the layers list and the archive without layers data */
+   mfd = open(manifestfile, O_CREAT|O_TRUNC|O_WRONLY, 0600);
+   if (mfd < 0){
+      berrno be;
+      DMSG2(ctx, DERROR, "cannot create manifest: %s Err=%s\n", manifestfile, be.bstrerror());
+      JMSG2(ctx, M_ERROR, "Cannot create manifest: %s Err=%s\n", manifestfile, be.bstrerror());
+      goto bailout;
+   }
+   Mmsg(json, "%s\n", DKLAYERSMAGIC);
+   foreach_alist(layer, layers){
+      Mmsg(name, "%s %llu %s\n", layer->digest, (unsigned long long)layer->size, layer->path);
+      pm_strcat(json, name);
+   }
+   pm_strcat(json, "\n");
+   buf = get_pool_memory(PM_BSOCK);
+   buf = check_pool_memory_size(buf, DKLAYERSBUFSIZE);
+   rc = strlen(json.c_str());
+   if (write(mfd, json.c_str(), rc) != rc){
+      goto werror;
+   }
+   from = 0;
+   foreach_alist(entry, &entries){
+      if (entry->layer){
+         if (!copy_data(fd, from, entry->dataoffset - from, mfd, buf)){
+            goto werror;
+         }
+         from = entry->dataoffset + TARPADDED(entry->size);
+      }
+   }
+   if (fstat(fd, &statp) != 0 || !copy_data(fd, from, statp.st_size - from, mfd, buf)){
+      goto werror;
+   }
+   if (fstat(mfd, &statp) != 0){
+      goto werror;
+   }
+   manifestsize = statp.st_size;
+   DMSG2(ctx, DINFO, "found %d layers, manifest size: %llu\n", layers->size(), (unsigned long long)manifestsize);
+   status = bRC_OK;
+   goto bailout;
+
+werror:
+   {
+      berrno be;
+      DMSG2(ctx, DERROR, "cannot write manifest: %s Err=%s\n", manifestfile, be.bstrerror());
+      JMSG2(ctx, M_ERROR, "Cannot write manifest: %s Err=%s\n", manifestfile, be.bstrerror());
+   }
+
+bailout:
+   foreach_alist(entry, &entries){
+      free(entry->name);
+      free(entry->link);
+      free(entry);
+   }
+   if (buf){
+      free_pool_memory(buf);
+   }
+   if (mfd >= 0){
+      close(mfd);
+   }
+   close(fd);
+   return status;
+}
+
+/*
+ * Prepares a directory where layers are restored before the manifest comes.
+ *
+ * in:
+ *    bpContext - for Bacula debug and jobinfo messages
+ *    dir - the stash directory
+ * out:
+ *    bRC_OK - when directory is ready
+ *    bRC_Error - on any error
+ */
+bRC DKLAYERS::prepare_stash(bpContext *ctx, const char *dir)
+{
+   struct stat statp;
+
+   if (strlen(stashdir.c_str()) > 0){
+      return bRC_OK;
+   }
+   if (stat(dir, &statp) != 0 && mkdir(dir, 0700) != 0){
+      berrno be;
+      DMSG2(ctx, DERROR, "cannot create layers directory: %s Err=%s\n", dir, be.bstrerror());
+      JMSG2(ctx, M_ERROR, "Cannot create layers directory: %s Err=%s\n", dir, be.bstrerror());
+      return bRC_Error;
+   }
+   pm_strcpy(stashdir, dir);
+   return bRC_OK;
+}
+
+void DKLAYERS::render_stash_filename(POOL_MEM &buf, const char *fname)
+{
+   Mmsg(buf, "%s/%s", stashdir.c_str(), fname);
+}
+
+/*
+ * Removes the layers stash with all restored files.
+ */
+void DKLAYERS::clean_stash(bpContext *ctx)
+{
+   POOL_MEM fname(PM_FNAME);
+   struct dirent *de;
+   DIR *dir;
+
+   if (strlen(stashdir.c_str()) == 0){
+      return;
+   }
+   dir = opendir(stashdir.c_str());
+   if (dir){
+      while ((de = readdir(dir)) != NULL){
+         if (bstrcmp(de->d_name, ".") || bstrcmp(de->d_name, "..")){
+            continue;
+         }
+         render_stash_filename(fname, de->d_name);
+         unlink(fname.c_str());
+      }
+      closedir(dir);
+   }
+   if (rmdir(stashdir.c_str()) != 0){
+      berrno be;
+      DMSG2(ctx, DERROR, "cannot remove layers directory: %s Err=%s\n", stashdir.c_str(), be.bstrerror());
+   }
+   *stashdir.c_str() = 0;
+}
+
+/*
+ * Reassembles the image archive from the manifest and the layers restored in
+ *  the stash and sends it to command tool. All jobs of the backup chain have
+ *  to be restored before, so every layer is in the stash.
+ *
+ * in:
+ *    bpContext - for Bacula debug and jobinfo messages
+ *    manifestfile - the restored manifest
+ *    out - the stdin of "docker load" command
+ * out:
+ *    bRC_OK - when the image archive was sent
+ *    bRC_Error - on any error
+ */
+bRC DKLAYERS::assemble(bpContext *ctx, const char *manifestfile, FILE *out)
+{
+   POOL_MEM line(PM_FNAME);
+   POOL_MEM name(PM_FNAME);
+   POOL_MEM lname(PM_FNAME);
+   POOLMEM *buf;
+   alist list(10, not_owned_by_alist);
+   DKLAYER *layer, *l;
+   struct stat statp;
+   FILE *fp;
+   const char *p;
+   char *q;
+   uint64_t size, done;
+   int32_t len;
+   int fd;
+   bRC status = bRC_Error;
+
+   if (out == NULL){
+      DMSG0(ctx, DERROR, "no command tool to send image archive\n");
+      return bRC_Error;
+   }
+   fp = bfopen(manifestfile, "r");
+   if (fp == NULL){
+      berrno be;
+      DMSG2(ctx, DERROR, "cannot open manifest: %s Err=%s\n", manifestfile, be.bstrerror());
+      JMSG2(ctx, M_ERROR, "Cannot open manifest: %s Err=%s\n", manifestfile, be.bstrerror());
+      return bRC_Error;
+   }
+   buf = get_pool_memory(PM_BSOCK);
+   buf = check_pool_memory_size(buf, DKLAYERSBUFSIZE);
+
+   /* the layers list */
+   if (bfgets(line.addr(), fp) == NULL || !bstrcmp(strip_trailing_newline(line.c_str()), DKLAYERSMAGIC)){
+      DMSG1(ctx, DERROR, "invalid manifest: %s\n", manifestfile);
+      JMSG1(ctx, M_ERROR, "Invalid image manifest: %s\n", manifestfile);
+      goto bailout;
+   }
+   while (bfgets(line.addr(), fp) != NULL && *strip_trailing_newline(line.c_str()) != 0){
+      layer = (DKLAYER *)malloc(sizeof(DKLAYER));
+      layer->path = NULL;
+      list.append(layer);
+      /* <digest> <size> <tar entry name> */
+      if ((p = scan_digest(line.c_str(), layer->digest)) == NULL ||
+            (layer->size = strtoull(p, &q, 10), *q != ' ')){
+         DMSG1(ctx, DERROR, "invalid manifest line: %s\n", line.c_str());
+         JMSG1(ctx, M_ERROR, "Invalid image manifest: %s\n", manifestfile);
+         goto bailout;
+      }
+      layer->path = bstrdup(q + 1);
+   }
+
+   /* the archive, with layers data inserted */
+   for (;;){
+      if (fread(buf, 1, TARBLOCK, fp) != TARBLOCK){
+         DMSG1(ctx, DERROR, "manifest truncated: %s\n", manifestfile);
+         JMSG1(ctx, M_ERROR, "Image manifest truncated: %s\n", manifestfile);
+         goto bailout;
+      }
+      if (!write_out(ctx, out, buf, TARBLOCK)){
+         goto bailout;
+      }
+      if (tar_is_end(buf)){
+         /* copy the end of archive as is */
+         while ((len = fread(buf, 1, DKLAYERSBUFSIZE, fp)) > 0){
+            if (!write_out(ctx, out, buf, len)){
+               goto bailout;
+            }
+         }
+         break;
+      }
+      tar_entry_name(buf, name);
+      size = tar_number(buf + 124, 12);
+      layer = NULL;
+      foreach_alist(l, &list){
+         if (l->size == size && bstrcmp(l->path, name.c_str())){
+            layer = l;
+            break;
+         }
+      }
+      if (layer == NULL){
+         /* not a layer, the data is in the manifest */
+         for (done = 0; done < TARPADDED(size); done += len){
+            len = TARPADDED(size) - done > DKLAYERSBUFSIZE ? DKLAYERSBUFSIZE : TARPADDED(size) - done;
+            if (fread(buf, 1, len, fp) != (size_t)len){
+               DMSG1(ctx, DERROR, "manifest truncated: %s\n", manifestfile);
+               JMSG1(ctx, M_ERROR, "Image manifest truncated: %s\n", manifestfile);
+               goto bailout;
+            }
+            if (!write_out(ctx, out, buf, len)){
+               goto bailout;
+            }
+         }
+         continue;
+      }
+      Mmsg(lname, "%s%s", layer->digest, DKLAYERSUFFIX);
+      render_stash_filename(line, lname.c_str());
+      fd = open(line.c_str(), O_RDONLY);
+      if (fd < 0 || fstat(fd, &statp) != 0 || (uint64_t)statp.st_size != size){
+         DMSG1(ctx, DERROR, "missing layer: %s\n", layer->digest);
+         JMSG2(ctx, M_ERROR, "Missing image layer %s of %s, all jobs of the backup chain should be restored.\n",
+               layer->digest, manifestfile);
+         if (fd >= 0){
+            close(fd);
+         }
+         goto bailout;
+      }
+      DMSG2(ctx, DDEBUG, "inserting layer: %s size: %llu\n", layer->digest, (unsigned long long)size);
+      while ((len = read(fd, buf, DKLAYERSBUFSIZE)) > 0){
+         if (!write_out(ctx, out, buf, len)){
+            close(fd);
+            goto bailout;
+         }
+      }
+      close(fd);
+      if (TARPADDED(size) > size){
+         len = TARPADDED(size) - size;
+         memset(buf, 0, len);
+         if (!write_out(ctx, out, buf, len)){
+            goto bailout;
+         }
+      }
+   }
+   status = bRC_OK;
+
+bailout:
+   foreach_alist(layer, &list){
+      free_layer(layer);
+   }
+   free_pool_memory(buf);
+   fclose(fp);
+   return status;
+}
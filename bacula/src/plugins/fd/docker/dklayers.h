@@ -0,0 +1,106 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+ */
+/**
+ * @file dklayers.h
+ * @brief Layer aware backup and restore of Docker images for the Docker plugin.
+ *
+ * The image archive generated by "docker save" is spooled into the File Daemon
+ * working directory and split into:
+ *  - one file for every layer archive, named by the layer digest,
+ *  - a manifest, the image archive without the layers data, which is used
+ *    at restore to reassemble the archive for "docker load".
+ *
+ * The layers saved by the previous jobs are recorded in a state file, so an
+ * Incremental or a Differential backup has to save the new layers only.
+ * The manifest format is:
+ *
+ *    BaculaDockerLayers 1\n
+ *    <digest> <size> <tar entry name>\n       one line for every layer
+ *    \n
+ *    <the image archive with the layers data removed>
+ */
+
+#ifndef _DKLAYERS_H_
+#define _DKLAYERS_H_
+
+#include "dkid.h"
+#include "pluginlib/pluginlib.h"
+
+#define DKLAYERSMAGIC            "BaculaDockerLayers 1"
+#define DKLAYERSUFFIX            ".layer"
+#define DKMANIFESTSUFFIX         ".manifest"
+
+/* a single layer found in the image archive */
+typedef struct {
+   char *path;                            /* the tar entry name */
+   char digest[DKIDDIGESTSIZE_Len];       /* the layer digest, hex chars */
+   uint64_t offset;                       /* the layer data offset in spool file */
+   uint64_t size;                         /* the layer data size */
+   bool save;                             /* not saved by the previous jobs */
+} DKLAYER;
+
+/* a layer saved by a previous job, an entry of the layers state file */
+typedef struct {
+   char level;                            /* 'F', 'D' or 'I' */
+   int jobid;
+   char digest[DKIDDIGESTSIZE_Len];
+   char *name;                            /* the docker object name */
+} DKLAYERSTATE;
+
+/*
+ * This class handles the layers of a single docker object for backup and
+ * the layers state of the job. On restore it handles the layers stash.
+ */
+class DKLAYERS: public SMARTALLOC
+{
+ public:
+   DKLAYERS();
+   ~DKLAYERS();
+
+   /* backup */
+   bRC load_state(bpContext *ctx, const char *statefile);
+   bRC commit_state(bpContext *ctx, char level);
+   bRC scan(bpContext *ctx, const char *spoolfile, const char *manifestfile);
+   void select(const char *name, char level);
+   void record(const char *name, int jobid, char level);
+   void clear();
+   inline int size() { return layers->size(); }
+   DKLAYER *get_to_save(int nr);
+   inline uint64_t manifest_size() { return manifestsize; }
+
+   /* restore */
+   bRC prepare_stash(bpContext *ctx, const char *stashdir);
+   void render_stash_filename(POOL_MEM &buf, const char *fname);
+   bRC assemble(bpContext *ctx, const char *manifestfile, FILE *out);
+   void clean_stash(bpContext *ctx);
+
+ private:
+   alist *layers;                         /* DKLAYER list of the current object */
+   alist *state;                          /* DKLAYERSTATE list loaded from the state file */
+   alist *pending;                        /* DKLAYERSTATE list saved by this job */
+   POOL_MEM statefile;                    /* the layers state file name */
+   POOL_MEM stashdir;                     /* the restore layers stash directory */
+   uint64_t manifestsize;                 /* the size of the current object manifest */
+
+   DKLAYERSTATE *find_state(const char *name, const char *digest, bool fullonly);
+   bool read_entry(int fd, uint64_t offset, uint64_t size, POOL_MEM &out);
+   bool copy_data(int infd, uint64_t offset, uint64_t size, int outfd, POOLMEM *buf);
+};
+
+#endif   /* _DKLAYERS_H_ */
@@ -0,0 +1,363 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+*/
+/**
+ * @file dklayers_test.c
+ * @brief Layer aware backup and restore of Docker images for the Docker plugin - unittest.
+ *
+ * The test generates "docker save" like image archives, splits them into
+ * layers and manifest for a Full, an Incremental and a Differential backup
+ * with the layers state file, and reassembles the archive for restore.
+ */
+
+#include "bacula.h"
+#include "unittests.h"
+#include "dklayers.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+bFuncs *bfuncs;
+bInfo *binfo;
+
+const char *img      = "testimage:latest";
+const char *dcfg     = "0f601bcb1ef5c1ae0c67b9e1e2f6e6e3b7ba4b2cfca3d15e6f8b30e2a1de4a21";
+const char *dig1     = "66f45d8601bae26a6b2ffeb46922318534d3b3905377b3a224693bd78601cb3b";
+const char *dig2     = "b546087c43f75a2c1484b4aee0737499aa69a09067b04237907fccd4bde938c7";
+const char *dig3     = "daabf4372f900cb1ad0db17d26abf3acce55224275d1850f02459180e4dacf1d";
+
+/* add a single entry to the generated tar archive */
+static void tar_add(POOL_MEM &tar, int &len, const char *name, char type, const char *link, const char *data, int size)
+{
+   char *hdr;
+   unsigned int sum = 0;
+   int padded = (size + 511) & ~511;
+   int i;
+
+   tar.check_size(len + 512 + padded + 1024);
+   hdr = tar.c_str() + len;
+   memset(hdr, 0, 512 + padded);
+   bstrncpy(hdr, name, 100);
+   bsnprintf(hdr + 100, 8, "%07o", 0644);
+   bsnprintf(hdr + 108, 8, "%07o", 0);
+   bsnprintf(hdr + 116, 8, "%07o", 0);
+   bsnprintf(hdr + 124, 12, "%011o", size);
+   bsnprintf(hdr + 136, 12, "%011o", 0);
+   hdr[156] = type;
+   if (link){
+      bstrncpy(hdr + 157, link, 100);
+   }
+   memcpy(hdr + 257, "ustar", 6);
+   memcpy(hdr + 263, "00", 2);
+   memset(hdr + 148, ' ', 8);
+   for (i = 0; i < 512; i++){
+      sum += (unsigned char)hdr[i];
+   }
+   bsnprintf(hdr + 148, 8, "%06o", sum);
+   if (data){
+      memcpy(hdr + 512, data, size);
+   }
+   len += 512 + padded;
+}
+
+/* the layer data, not aligned to the tar block size */
+static void layer_data(POOL_MEM &buf, int nr, int size)
+{
+   buf.check_size(size);
+   for (int i = 0; i < size; i++){
+      buf.c_str()[i] = (char)(nr * 31 + i * 7);
+   }
+}
+
+/* generates an OCI layout image archive with the first nrlayers layers */
+static bool make_oci_archive(const char *fname, int nrlayers, POOL_MEM &tar, int &len)
+{
+   const char *digs[] = { dig1, dig2, dig3 };
+   const int sizes[] = { 5000, 1536, 777 };
+   POOL_MEM json(PM_MESSAGE);
+   POOL_MEM tmp(PM_FNAME);
+   POOL_MEM data(PM_BSOCK);
+   FILE *fp;
+   int i;
+
+   len = 0;
+   tar_add(tar, len, "blobs/", '5', NULL, NULL, 0);
+   tar_add(tar, len, "blobs/sha256/", '5', NULL, NULL, 0);
+   for (i = 0; i < nrlayers; i++){
+      Mmsg(tmp, "blobs/sha256/%s", digs[i]);
+      layer_data(data, i, sizes[i]);
+      tar_add(tar, len, tmp.c_str(), '0', NULL, data.c_str(), sizes[i]);
+   }
+   Mmsg(json, "{\"architecture\":\"amd64\",\"os\":\"linux\"}");
+   Mmsg(tmp, "blobs/sha256/%s", dcfg);
+   tar_add(tar, len, tmp.c_str(), '0', NULL, json.c_str(), strlen(json.c_str()));
+   Mmsg(json, "[{\"Config\":\"blobs/sha256/%s\",\"RepoTags\":[\"%s\"],\"Layers\":[", dcfg, img);
+   for (i = 0; i < nrlayers; i++){
+      Mmsg(tmp, "%s\"blobs/sha256/%s\"", i ? "," : "", digs[i]);
+      pm_strcat(json, tmp);
+   }
+   pm_strcat(json, "]}]");
+   tar_add(tar, len, "manifest.json", '0', NULL, json.c_str(), strlen(json.c_str()));
+   /* the end of archive */
+   memset(tar.c_str() + len, 0, 1024);
+   len += 1024;
+
+   fp = bfopen(fname, "w");
+   if (fp == NULL){
+      return false;
+   }
+   i = fwrite(tar.c_str(), 1, len, fp);
+   fclose(fp);
+   return i == len;
+}
+
+/* generates a legacy layout image archive, the second layer is a duplicate */
+static bool make_legacy_archive(const char *fname, POOL_MEM &tar, int &len)
+{
+   POOL_MEM json(PM_MESSAGE);
+   POOL_MEM data(PM_BSOCK);
+   FILE *fp;
+   int i;
+
+   len = 0;
+   layer_data(data, 0, 3000);
+   tar_add(tar, len, "aaaa/layer.tar", '0', NULL, data.c_str(), 3000);
+   tar_add(tar, len, "bbbb/layer.tar", '2', "../aaaa/layer.tar", NULL, 0);
+   Mmsg(json, "{\"rootfs\":{\"type\":\"layers\",\"diff_ids\":[\"sha256:%s\",\"sha256:%s\"]}}", dig1, dig1);
+   Mmsg(data, "%s.json", dcfg);
+   tar_add(tar, len, data.c_str(), '0', NULL, json.c_str(), strlen(json.c_str()));
+   Mmsg(json, "[{\"Config\":\"%s.json\",\"RepoTags\":[\"%s\"],\"Layers\":[\"aaaa/layer.tar\",\"bbbb/layer.tar\"]}]", dcfg, img);
+   tar_add(tar, len, "manifest.json", '0', NULL, json.c_str(), strlen(json.c_str()));
+   memset(tar.c_str() + len, 0, 1024);
+   len += 1024;
+
+   fp = bfopen(fname, "w");
+   if (fp == NULL){
+      return false;
+   }
+   i = fwrite(tar.c_str(), 1, len, fp);
+   fclose(fp);
+   return i == len;
+}
+
+/* counts the lines of the state file */
+static int state_lines(const char *fname, const char *match)
+{
+   POOL_MEM line(PM_FNAME);
+   FILE *fp;
+   int nr = 0;
+
+   fp = bfopen(fname, "r");
+   if (fp == NULL){
+      return -1;
+   }
+   while (bfgets(line.addr(), fp) != NULL){
+      if (match == NULL || strstr(line.c_str(), match) != NULL){
+         nr++;
+      }
+   }
+   fclose(fp);
+   return nr;
+}
+
+/* copies the layers data from the archive to the restore stash */
+static bool stash_layers(DKLAYERS *dkl, POOL_MEM &tar)
+{
+   POOL_MEM fname(PM_FNAME);
+   POOL_MEM lname(PM_FNAME);
+   DKLAYER *layer;
+   FILE *fp;
+   bool rc;
+
+   for (int i = 0; (layer = dkl->get_to_save(i)) != NULL; i++){
+      Mmsg(lname, "%s%s", layer->digest, DKLAYERSUFFIX);
+      dkl->render_stash_filename(fname, lname.c_str());
+      fp = bfopen(fname.c_str(), "w");
+      if (fp == NULL){
+         return false;
+      }
+      rc = fwrite(tar.c_str() + layer->offset, 1, layer->size, fp) == layer->size;
+      fclose(fp);
+      if (!rc){
+         return false;
+      }
+   }
+   return true;
+}
+
+/* assembles the archive from the manifest and compares it with the original */
+static bool check_assemble(DKLAYERS *dkl, const char *manifest, POOL_MEM &tar, int len)
+{
+   POOL_MEM out(PM_BSOCK);
+   FILE *fp;
+   long size;
+   bool rc = false;
+
+   fp = tmpfile();
+   if (fp == NULL){
+      return false;
+   }
+   if (dkl->assemble(NULL, manifest, fp) == bRC_OK){
+      size = ftell(fp);
+      out.check_size(size + 1);
+      rewind(fp);
+      rc = size == len && fread(out.c_str(), 1, size, fp) == (size_t)size &&
+            memcmp(out.c_str(), tar.c_str(), len) == 0;
+   }
+   fclose(fp);
+   return rc;
+}
+
+int main()
+{
+   Unittests dklayers_test("dklayers_test");
+   POOL_MEM tmpdir(PM_FNAME);
+   POOL_MEM archive(PM_FNAME);
+   POOL_MEM manifest(PM_FNAME);
+   POOL_MEM statefile(PM_FNAME);
+   POOL_MEM stash(PM_FNAME);
+   POOL_MEM tar1(PM_BSOCK);
+   POOL_MEM tar2(PM_BSOCK);
+   POOL_MEM tar3(PM_BSOCK);
+   POOL_MEM line(PM_FNAME);
+   POOL_MEM expect(PM_FNAME);
+   DKLAYERS *dkl;
+   DKLAYER *layer;
+   FILE *fp;
+   int len1, len2, len3;
+
+   Pmsg0(0, "Initialize tests ...\n");
+
+   Mmsg(tmpdir, "%s/dklayers_test.XXXXXX", getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp");
+   ok(mkdtemp(tmpdir.c_str()) != NULL, "Create the test directory");
+   Mmsg(archive, "%s/image.tar", tmpdir.c_str());
+   Mmsg(manifest, "%s/image%s", tmpdir.c_str(), DKMANIFESTSUFFIX);
+   Mmsg(statefile, "%s/backup.docker-layers", tmpdir.c_str());
+   Mmsg(stash, "%s/layers", tmpdir.c_str());
+
+   Pmsg0(0, "First backup tests ...\n");
+
+   ok(make_oci_archive(archive.c_str(), 2, tar1, len1), "Generate the image archive with two layers");
+   dkl = New(DKLAYERS());
+   ok(dkl->load_state(NULL, statefile.c_str()) == bRC_OK, "Checking load_state without state file");
+   ok(dkl->scan(NULL, archive.c_str(), manifest.c_str()) == bRC_OK, "Checking scan");
+   ok(dkl->size() == 2, "Checking the number of layers found");
+   ok(dkl->manifest_size() > 0 && dkl->manifest_size() < (uint64_t)len1 - 5000, "Checking the manifest size");
+   fp = bfopen(manifest.c_str(), "r");
+   ok(fp != NULL, "Checking the manifest was generated");
+   if (fp){
+      ok(bfgets(line.addr(), fp) != NULL && bstrcmp(strip_trailing_newline(line.c_str()), DKLAYERSMAGIC),
+            "Checking the manifest magic");
+      Mmsg(expect, "%s 5000 blobs/sha256/%s", dig1, dig1);
+      ok(bfgets(line.addr(), fp) != NULL && bstrcmp(strip_trailing_newline(line.c_str()), expect.c_str()),
+            "Checking the manifest first layer");
+      Mmsg(expect, "%s 1536 blobs/sha256/%s", dig2, dig2);
+      ok(bfgets(line.addr(), fp) != NULL && bstrcmp(strip_trailing_newline(line.c_str()), expect.c_str()),
+            "Checking the manifest second layer");
+      ok(bfgets(line.addr(), fp) != NULL && *strip_trailing_newline(line.c_str()) == 0,
+            "Checking the manifest layers list end");
+      fclose(fp);
+   }
+   dkl->select(img, 'F');
+   layer = dkl->get_to_save(0);
+   ok(layer != NULL && bstrcmp(layer->digest, dig1), "Checking the first layer to save");
+   ok(layer != NULL && layer->size == 5000 && memcmp(tar1.c_str() + layer->offset, tar1.c_str() + 512 * 3, 5000) == 0,
+         "Checking the first layer data");
+   layer = dkl->get_to_save(1);
+   ok(layer != NULL && bstrcmp(layer->digest, dig2), "Checking the second layer to save");
+   ok(dkl->get_to_save(2) == NULL, "Checking no more layers to save");
+   dkl->record(img, 1, 'F');
+   ok(dkl->commit_state(NULL, 'F') == bRC_OK, "Checking commit_state for Full");
+   ok(state_lines(statefile.c_str(), NULL) == 2, "Checking the state file after Full");
+   Mmsg(line, "F 1 %s %s", dig1, img);
+   ok(state_lines(statefile.c_str(), line.c_str()) == 1, "Checking the state file entry");
+   delete dkl;
+
+   Pmsg0(0, "Incremental backup tests ...\n");
+
+   ok(make_oci_archive(archive.c_str(), 3, tar2, len2), "Generate the image archive with three layers");
+   dkl = New(DKLAYERS());
+   ok(dkl->load_state(NULL, statefile.c_str()) == bRC_OK, "Checking load_state");
+   ok(dkl->scan(NULL, archive.c_str(), manifest.c_str()) == bRC_OK, "Checking scan");
+   ok(dkl->size() == 3, "Checking the number of layers found");
+   dkl->select("otherimage:latest", 'I');
+   ok(dkl->get_to_save(2) != NULL, "Checking all layers are saved for other object");
+   dkl->select(img, 'I');
+   layer = dkl->get_to_save(0);
+   ok(layer != NULL && bstrcmp(layer->digest, dig3) && layer->size == 777, "Checking the new layer to save");
+   ok(dkl->get_to_save(1) == NULL, "Checking only the new layer is saved");
+   dkl->record(img, 2, 'I');
+   ok(dkl->commit_state(NULL, 'I') == bRC_OK, "Checking commit_state for Incremental");
+   ok(state_lines(statefile.c_str(), NULL) == 3, "Checking the state file after Incremental");
+   Mmsg(line, "I 2 %s %s", dig3, img);
+   ok(state_lines(statefile.c_str(), line.c_str()) == 1, "Checking the state file Incremental entry");
+   delete dkl;
+
+   Pmsg0(0, "Differential backup tests ...\n");
+
+   dkl = New(DKLAYERS());
+   ok(dkl->load_state(NULL, statefile.c_str()) == bRC_OK, "Checking load_state");
+   ok(dkl->scan(NULL, archive.c_str(), manifest.c_str()) == bRC_OK, "Checking scan");
+   dkl->select(img, 'D');
+   layer = dkl->get_to_save(0);
+   ok(layer != NULL && bstrcmp(layer->digest, dig3), "Checking the layer saved since the Full");
+   ok(dkl->get_to_save(1) == NULL, "Checking the layers of the Full are not saved");
+   dkl->record(img, 3, 'D');
+   ok(dkl->commit_state(NULL, 'D') == bRC_OK, "Checking commit_state for Differential");
+   ok(state_lines(statefile.c_str(), NULL) == 3, "Checking the state file after Differential");
+   Mmsg(line, "I 2 %s", dig3);
+   ok(state_lines(statefile.c_str(), line.c_str()) == 0, "Checking the Incremental entry was dropped");
+   Mmsg(line, "D 3 %s", dig3);
+   ok(state_lines(statefile.c_str(), line.c_str()) == 1, "Checking the state file Differential entry");
+   delete dkl;
+
+   Pmsg0(0, "Restore tests ...\n");
+
+   dkl = New(DKLAYERS());
+   ok(dkl->scan(NULL, archive.c_str(), manifest.c_str()) == bRC_OK, "Checking scan");
+   dkl->select(img, 'F');
+   ok(dkl->prepare_stash(NULL, stash.c_str()) == bRC_OK, "Checking prepare_stash");
+   nok(check_assemble(dkl, manifest.c_str(), tar2, len2), "Checking assemble without layers");
+   ok(stash_layers(dkl, tar2), "Copy the layers to the stash");
+   ok(check_assemble(dkl, manifest.c_str(), tar2, len2), "Checking assemble of the image archive");
+   dkl->clean_stash(NULL);
+   ok(access(stash.c_str(), F_OK) != 0, "Checking clean_stash");
+   delete dkl;
+
+   Pmsg0(0, "Legacy layout tests ...\n");
+
+   ok(make_legacy_archive(archive.c_str(), tar3, len3), "Generate the legacy image archive");
+   dkl = New(DKLAYERS());
+   ok(dkl->scan(NULL, archive.c_str(), manifest.c_str()) == bRC_OK, "Checking scan");
+   ok(dkl->size() == 1, "Checking the duplicated layer is found once");
+   layer = dkl->get_to_save(0);
+   ok(layer != NULL && bstrcmp(layer->digest, dig1) && bstrcmp(layer->path, "aaaa/layer.tar"),
+         "Checking the layer digest from the image config");
+   ok(dkl->prepare_stash(NULL, stash.c_str()) == bRC_OK, "Checking prepare_stash");
+   ok(stash_layers(dkl, tar3), "Copy the layers to the stash");
+   ok(check_assemble(dkl, manifest.c_str(), tar3, len3), "Checking assemble of the legacy image archive");
+   dkl->clean_stash(NULL);
+   delete dkl;
+
+   unlink(archive.c_str());
+   unlink(manifest.c_str());
+   unlink(statefile.c_str());
+   rmdir(tmpdir.c_str());
+
+   return report();
+}
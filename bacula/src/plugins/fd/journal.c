@@ -0,0 +1,1288 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+ */
+
+#include "journal.h"
+
+static int DBGLVL = 90;
+
+/*
+ * Binary Journal format
+ *
+ *  Header:  magic[8] version(32) reserved(32) generation(64)
+ *  Record:  magic(32) length(32) type(32) seq(64) data[length] crc(32)
+ *
+ *  The CRC covers the type, the sequence number and the data. The
+ *  integers are stored in network byte order (see serial.h). The
+ *  records are written in sequence number order.
+ */
+#define JOURNAL_MAGIC       "BCDPJRNL"
+#define JOURNAL_HDR_SIZE    24
+#define JREC_MAGIC          0x4A524543
+#define JREC_HDR_SIZE       20
+#define JREC_MAX_LEN        (1024 * 1024)
+#define JREC_SIZE(len)      (JREC_HDR_SIZE + (len) + 4)
+
+/* Minimum size of the Journal before a compaction */
+#define JOURNAL_COMPACT_MIN (1024 * 1024)
+
+static int journal_fsync(FILE *fp)
+{
+   if (fflush(fp) != 0) {
+      return -1;
+   }
+#ifdef HAVE_WIN32
+   return _commit(fileno(fp));
+#else
+   return fsync(fileno(fp));
+#endif
+}
+
+/* Write a record at the current position of the file */
+static bool write_record(FILE *fp, uint32_t type, uint64_t seq, uint8_t *data, int len)
+{
+   POOLMEM *buf = get_pool_memory(PM_MESSAGE);
+   uint32_t crc;
+   bool ok;
+   ser_declare;
+
+   buf = check_pool_memory_size(buf, JREC_SIZE(len));
+   ser_begin(buf, JREC_SIZE(len));
+   ser_uint32(JREC_MAGIC);
+   ser_uint32(len);
+   ser_uint32(type);
+   ser_uint64(seq);
+   ser_bytes(data, len);
+   crc = bcrc32((unsigned char *)buf + 8, JREC_HDR_SIZE - 8 + len);
+   ser_uint32(crc);
+   ok = fwrite(buf, 1, JREC_SIZE(len), fp) == (size_t)JREC_SIZE(len);
+   free_pool_memory(buf);
+   return ok;
+}
+
+/*
+ * Read the record at the current position of the file, the data is
+ *  at buf + JREC_HDR_SIZE. Returns false at the end of the file or if
+ *  the record is truncated or corrupted.
+ */
+static bool read_record(FILE *fp, POOLMEM *&buf, uint32_t *type, uint64_t *seq, int *len)
+{
+   uint32_t magic, rlen, crc, rcrc;
+   unser_declare;
+
+   buf = check_pool_memory_size(buf, JREC_HDR_SIZE);
+   if (fread(buf, 1, JREC_HDR_SIZE, fp) != JREC_HDR_SIZE) {
+      return false;
+   }
+   unser_begin(buf, JREC_HDR_SIZE);
+   unser_uint32(magic);
+   unser_uint32(rlen);
+   unser_uint32(*type);
+   unser_uint64(*seq);
+   if (magic != JREC_MAGIC || rlen > JREC_MAX_LEN) {
+      return false;
+   }
+   buf = check_pool_memory_size(buf, JREC_SIZE(rlen));
+   if (fread(buf + JREC_HDR_SIZE, 1, rlen + 4, fp) != rlen + 4) {
+      return false;
+   }
+   crc = bcrc32((unsigned char *)buf + 8, JREC_HDR_SIZE - 8 + rlen);
+   unser_begin(buf + JREC_HDR_SIZE + rlen, 4);
+   unser_uint32(rcrc);
+   if (crc != rcrc) {
+      return false;
+   }
+   *len = rlen;
+   return true;
+}
+
+/* Get a string from the record data */
+static char *get_string(uint8_t **ptr, uint8_t *end)
+{
+   uint8_t *p = (uint8_t *)memchr(*ptr, 0, end - *ptr);
+   char *ret = (char *)*ptr;
+
+   if (p == NULL) {
+      return NULL;
+   }
+   *ptr = p + 1;
+   return ret;
+}
+
+static int ser_file_record(POOLMEM *&buf, const FileRecord &rec)
+{
+   const char *name = rec.name ? rec.name : "";
+   const char *sname = rec.sname ? rec.sname : "";
+   const char *fattrs = rec.fattrs ? rec.fattrs : "";
+   int len = 8 + strlen(name) + strlen(sname) + strlen(fattrs) + 3;
+   ser_declare;
+
+   buf = check_pool_memory_size(buf, len);
+   ser_begin(buf, len);
+   ser_int64(rec.mtime);
+   ser_string(name);
+   ser_string(sname);
+   ser_string(fattrs);
+   return ser_length(buf);
+}
+
+static FileRecord *unser_file_record(uint8_t *data, int len)
+{
+   uint8_t *end = data + len;
+   char *name, *sname, *fattrs;
+   int64_t mtime;
+   unser_declare;
+
+   if (len < 8) {
+      return NULL;
+   }
+   unser_begin(data, len);
+   unser_int64(mtime);
+   if ((name = get_string(&ser_ptr, end)) == NULL ||
+       (sname = get_string(&ser_ptr, end)) == NULL ||
+       (fattrs = get_string(&ser_ptr, end)) == NULL) {
+      return NULL;
+   }
+   FileRecord *rec = new FileRecord();
+   rec->name = bstrdup(name);
+   rec->sname = bstrdup(sname);
+   rec->fattrs = bstrdup(fattrs);
+   rec->mtime = mtime;
+   return rec;
+}
+
+static int ser_settings_record(POOLMEM *&buf, SettingsRecord &rec)
+{
+   const char *spoolDir = rec.getSpoolDir() ? rec.getSpoolDir() : "";
+   int len = 16 + strlen(spoolDir) + 1;
+   ser_declare;
+
+   buf = check_pool_memory_size(buf, len);
+   ser_begin(buf, len);
+   ser_int64(rec.heartbeat);
+   ser_int64(rec.journalVersion);
+   ser_string(spoolDir);
+   return ser_length(buf);
+}
+
+static int ser_folder_record(POOLMEM *&buf, const char *path)
+{
+   int len = strlen(path) + 1;
+
+   buf = check_pool_memory_size(buf, len);
+   memcpy(buf, path, len);
+   return len;
+}
+
+static int ser_checkpoint(POOLMEM *&buf, uint32_t jobid, uint64_t seq, uint64_t offset)
+{
+   ser_declare;
+
+   buf = check_pool_memory_size(buf, 20);
+   ser_begin(buf, 20);
+   ser_uint32(jobid);
+   ser_uint64(seq);
+   ser_uint64(offset);
+   return ser_length(buf);
+}
+
+Journal::~Journal()
+{
+   closeCursor();
+   endTransaction();
+   resetIndex();
+   delete _settings;
+   if (_folders) {
+      delete _folders;
+   }
+   if (_checkpoints) {
+      delete _checkpoints;
+   }
+   if (_jPath) {
+      free(_jPath);
+   }
+}
+
+bool Journal::writeHeader(FILE *fp, uint64_t generation)
+{
+   uint8_t buf[JOURNAL_HDR_SIZE];
+   ser_declare;
+
+   ser_begin(buf, JOURNAL_HDR_SIZE);
+   ser_bytes(JOURNAL_MAGIC, 8);
+   ser_uint32(JOURNAL_VERSION);
+   ser_uint32(0);
+   ser_uint64(generation);
+   return fseeko(fp, 0, SEEK_SET) == 0 &&
+      fwrite(buf, 1, JOURNAL_HDR_SIZE, fp) == JOURNAL_HDR_SIZE;
+}
+
+bool Journal::readHeader(FILE *fp, uint64_t *generation)
+{
+   uint8_t buf[JOURNAL_HDR_SIZE];
+   uint32_t version;
+   unser_declare;
+
+   if (fseeko(fp, 0, SEEK_SET) != 0 ||
+       fread(buf, 1, JOURNAL_HDR_SIZE, fp) != JOURNAL_HDR_SIZE ||
+       memcmp(buf, JOURNAL_MAGIC, 8) != 0) {
+      return false;
+   }
+   unser_begin(buf + 8, JOURNAL_HDR_SIZE - 8);
+   unser_uint32(version);
+   if (version != JOURNAL_VERSION) {
+      Dmsg2(0, "Unsupported Journal version %d in %s\n", version, _jPath);
+      return false;
+   }
+   ser_ptr += 4;
+   unser_uint64(*generation);
+   return true;
+}
+
+/* Free the index, it is built again by the next refresh() */
+void Journal::resetIndex()
+{
+   if (_settings) {
+      delete _settings;
+      _settings = NULL;
+   }
+   if (_folders) {
+      _folders->destroy();
+      _folders->init(10, owned_by_alist);
+   } else {
+      _folders = New(alist(10, owned_by_alist));
+   }
+   if (_files) {
+      _files->destroy();
+      free(_files);
+      _files = NULL;
+   }
+   if (_checkpoints) {
+      _checkpoints->destroy();
+      _checkpoints->init(10, owned_by_alist);
+   } else {
+      _checkpoints = New(alist(10, owned_by_alist));
+   }
+   _indexed = 0;
+   _lastSeq = 0;
+}
+
+/* Add a record to the index */
+void Journal::indexRecord(uint32_t type, uint64_t seq, uint64_t offset,
+                          uint8_t *data, int len)
+{
+   uint8_t *end = data + len;
+   JournalFileEntry *entry = NULL;
+   JournalCheckpoint *ckpt;
+   char *path, *str;
+   int64_t mtime;
+   int i;
+   unser_declare;
+
+   _lastSeq = MAX(_lastSeq, seq);
+   unser_begin(data, len);
+
+   switch (type) {
+   case JREC_SETTINGS:
+      if (len < 17) {
+         break;
+      }
+      ser_ptr += 16;
+      if ((str = get_string(&ser_ptr, end)) == NULL) {
+         break;
+      }
+      if (_settings) {
+         delete _settings;
+      }
+      _settings = new SettingsRecord();
+      unser_begin(data, len);
+      unser_int64(_settings->heartbeat);
+      unser_int64(_settings->journalVersion);
+      if (*str) {
+         _settings->setSpoolDir(str);
+      }
+      break;
+
+   case JREC_FOLDER_ADD:
+   case JREC_FOLDER_DEL:
+      if ((path = get_string(&ser_ptr, end)) == NULL) {
+         break;
+      }
+      foreach_alist_index(i, str, _folders) {
+         if (strcmp(str, path) == 0) {
+            break;
+         }
+      }
+      if (type == JREC_FOLDER_ADD && str == NULL) {
+         _folders->append(bstrdup(path));
+      } else if (type == JREC_FOLDER_DEL && str != NULL) {
+         free(_folders->remove(i));
+      }
+      break;
+
+   case JREC_FILE:
+      if (len < 8) {
+         break;
+      }
+      unser_int64(mtime);
+      if ((path = get_string(&ser_ptr, end)) == NULL) {
+         break;
+      }
+      if (!_files) {
+         _files = (htable *)malloc(sizeof(htable));
+         _files->init(entry, &entry->link, 1000);
+      }
+      entry = (JournalFileEntry *)_files->lookup(path);
+      if (!entry) {
+         entry = (JournalFileEntry *)_files->hash_malloc(sizeof(JournalFileEntry) + strlen(path) + 1);
+         entry->path = (char *)entry + sizeof(JournalFileEntry);
+         strcpy(entry->path, path);
+         _files->insert(entry->path, entry);
+      }
+      entry->seq = seq;
+      entry->offset = offset;
+      entry->mtime = mtime;
+      break;
+
+   case JREC_CHECKPOINT:
+      if (len < 20) {
+         break;
+      }
+      ckpt = (JournalCheckpoint *)malloc(sizeof(JournalCheckpoint));
+      unser_uint32(ckpt->jobid);
+      unser_uint64(ckpt->seq);
+      unser_uint64(ckpt->offset);
+      _checkpoints->append(ckpt);
+      break;
+
+   default:
+      Dmsg2(DBGLVL, "Unknown record type %d in Journal %s\n", type, _jPath);
+      break;
+   }
+}
+
+/*
+ * Index the records appended since the last call. The whole Journal is
+ *  read only when it was replaced by a compaction. A record truncated
+ *  by a crash is removed. The Journal must be locked.
+ */
+bool Journal::refresh()
+{
+   struct stat sf;
+   uint64_t generation, size;
+   uint64_t seq;
+   uint32_t type;
+   int len;
+
+   if (fstat(_fd, &sf) != 0) {
+      return false;
+   }
+   size = sf.st_size;
+
+   if (size == 0) {
+      /* New Journal */
+      resetIndex();
+      _generation = 1;
+      if (!writeHeader(_fp, _generation) || fflush(_fp) != 0) {
+         Dmsg1(0, "Could not write Journal header %s\n", _jPath);
+         return false;
+      }
+      _indexed = size = JOURNAL_HDR_SIZE;
+      _ino = sf.st_ino;
+
+   } else {
+      if (!readHeader(_fp, &generation)) {
+         Dmsg1(0, "Could not read Journal header %s. Journal is Corrupted.\n", _jPath);
+         return false;
+      }
+      if (_indexed == 0 || generation != _generation || sf.st_ino != _ino ||
+          size < _indexed) {
+         resetIndex();
+         _generation = generation;
+         _ino = sf.st_ino;
+         _indexed = JOURNAL_HDR_SIZE;
+      }
+   }
+
+   if (_indexed < size) {
+      POOLMEM *buf = get_pool_memory(PM_MESSAGE);
+      fseeko(_fp, _indexed, SEEK_SET);
+      while (_indexed < size && read_record(_fp, buf, &type, &seq, &len)) {
+         indexRecord(type, seq, _indexed, (uint8_t *)buf + JREC_HDR_SIZE, len);
+         _indexed += JREC_SIZE(len);
+      }
+      free_pool_memory(buf);
+
+      if (_indexed < size) {
+         Dmsg2(0, "Discarding the truncated record at %lld of Journal %s\n",
+               (long long)_indexed, _jPath);
+         if (ftruncate(_fd, _indexed) != 0) {
+            Dmsg1(0, "Could not truncate Journal %s\n", _jPath);
+         }
+      }
+   }
+
+   _folderIdx = 0;
+   _readPos = checkpointOffset(0);
+   _readEnd = _indexed;
+   return true;
+}
+
+/* Offset of the first record after the Checkpoint, 0 if not found */
+uint64_t Journal::checkpointOffset(uint32_t jobid)
+{
+   JournalCheckpoint *ckpt;
+
+   for (int i = _checkpoints->size() - 1; i >= 0; i--) {
+      ckpt = (JournalCheckpoint *)_checkpoints->get(i);
+      if (jobid == 0 || ckpt->jobid == jobid) {
+         return ckpt->offset;
+      }
+   }
+   return jobid == 0 ? JOURNAL_HDR_SIZE : 0;
+}
+
+bool Journal::open(const char *mode)
+{
+   _fp = bfopen(_jPath, "r+b");
+
+   /* The Journal is created only by writers */
+   if (!_fp && (mode[0] == 'w' || mode[0] == 'a')) {
+      _fp = bfopen(_jPath, "w+b");
+   }
+   if (!_fp) {
+      return false;
+   }
+   _fd = fileno(_fp);
+   return true;
+}
+
+bool Journal::beginTransaction(const char *mode)
+{
+   if (hasTransaction) {
+      return true;
+   }
+
+   bool hasLock = false;
+   int timeout = 1800;
+
+   for (int time = 0; time < timeout; time++) {
+      if (!this->open(mode)) {
+         Dmsg0(0, "Tried to start transaction but Journal File was not found.\n");
+         return false;
+      }
+
+      int rc = flock(_fd, LOCK_EX | LOCK_NB);
+
+      //Success. Lock acquired.
+      if (rc == 0) {
+#ifndef HAVE_WIN32
+         struct stat sp, sf;
+
+         //The Journal was replaced by a compaction while we were waiting
+         if (stat(_jPath, &sp) == 0 && fstat(_fd, &sf) == 0 && sp.st_ino != sf.st_ino) {
+            flock(_fd, LOCK_UN);
+            fclose(_fp);
+            continue;
+         }
+#endif
+         hasLock = true;
+         break;
+      }
+
+      fclose(_fp);
+      sleep(1);
+   }
+
+   if (!hasLock) {
+      _fp = NULL;
+      _fd = -1;
+      Dmsg0(0, "Tried to start transaction but could not lock Journal File.\n");
+      return false;
+   }
+
+   hasTransaction = true;
+
+   if (!refresh()) {
+      endTransaction();
+      return false;
+   }
+   return true;
+}
+
+void Journal::endTransaction()
+{
+   if (!hasTransaction) {
+      return;
+   }
+
+   if (_fp != NULL) {
+      fflush(_fp);
+      int rc = flock(_fd, LOCK_UN);
+
+      if (rc != 0) {
+         Dmsg0(0, "could not release flock\n");
+      }
+
+      fclose(_fp);
+      _fp = NULL;
+   }
+
+   _fd = -1;
+   hasTransaction = false;
+}
+
+/* Append a record, the Journal must be locked */
+bool Journal::appendRecord(uint32_t type, uint8_t *data, int len)
+{
+   uint64_t offset = _indexed;
+   uint64_t seq = _lastSeq + 1;
+
+   if (fseeko(_fp, offset, SEEK_SET) != 0 ||
+       !write_record(_fp, type, seq, data, len) ||
+       fflush(_fp) != 0) {
+      Dmsg2(0, "(ERROR) Could not write record to Journal %s. ERR=%s\n",
+            _jPath, strerror(errno));
+      /* Remove what was written */
+      if (ftruncate(_fd, offset) != 0) {
+         Dmsg1(0, "Could not truncate Journal %s\n", _jPath);
+      }
+      return false;
+   }
+   indexRecord(type, seq, offset, data, len);
+   _indexed = offset + JREC_SIZE(len);
+   _readEnd = _indexed;
+   return true;
+}
+
+/**
+ * Given a string formatted as 'key=val\n',
+ * this function tries to return 'val'
+ */
+char *Journal::extract_val(const char *key_val)
+{
+   const int SANITY_CHECK = 10000;
+   int max_idx = cstrlen(key_val) - 1;
+   char *val = (char *) malloc(SANITY_CHECK * sizeof(char));
+
+   int idx_keyend = 0;
+
+   while(key_val[idx_keyend] != '=') {
+      idx_keyend++;
+
+      if(idx_keyend > max_idx) {
+         free(val);
+         return NULL;
+      }
+   }
+
+   int i;
+   int j = 0;
+   for(i = idx_keyend + 1; key_val[i] != '\n' ; i++) {
+      val[j] = key_val[i];
+      j++;
+
+      if(i > max_idx) {
+         free(val);
+         return NULL;
+      }
+   }
+
+   val[j] = '\0';
+   return val;
+}
+
+/*
+ * Convert a Journal written in the text format of the version 1, all
+ *  its FileRecords will be sent by the next Job.
+ */
+bool Journal::convertTextJournal()
+{
+   const int SANITY_CHECK = 10000;
+   char tmp[SANITY_CHECK];
+   char *val[4];
+   const char *name;
+   int nb, len;
+   uint64_t seq = 0;
+   bool success = false;
+   FILE *tmpFp = NULL;
+   POOLMEM *buf = get_pool_memory(PM_MESSAGE);
+   POOL_MEM tmp_jPath;
+
+   Mmsg(tmp_jPath, "%s.temp", _jPath);
+   Dmsg1(DBGLVL, "Converting text Journal %s\n", _jPath);
+
+   _fp = bfopen(_jPath, "r");
+   if (!_fp) {
+      goto bail_out;
+   }
+   _fd = fileno(_fp);
+   if (flock(_fd, LOCK_EX) != 0) {
+      goto bail_out;
+   }
+   tmpFp = bfopen(tmp_jPath.c_str(), "w+b");
+   if (!tmpFp || !writeHeader(tmpFp, 1)) {
+      goto bail_out;
+   }
+
+   while (bfgets(tmp, SANITY_CHECK, _fp)) {
+      if (strstr(tmp, "Settings {\n") != NULL) {
+         nb = 3;
+      } else if (strstr(tmp, "File {\n") != NULL) {
+         nb = 4;
+      } else if (strstr(tmp, "Folder {\n") != NULL) {
+         nb = 1;
+      } else {
+         continue;
+      }
+      name = tmp[1] == 'e' ? "Settings" : (tmp[1] == 'i' ? "File" : "Folder");
+      memset(val, 0, sizeof(val));
+      for (int i = 0; i < nb; i++) {
+         if (!bfgets(tmp, SANITY_CHECK, _fp) || (val[i] = extract_val(tmp)) == NULL) {
+            Dmsg1(0, "Could not read %s Record. Journal is Corrupted.\n", name);
+            break;
+         }
+      }
+      if (val[nb - 1] != NULL) {
+         if (nb == 3) {
+            SettingsRecord rec;
+            if (strcmp(val[0], "<NULL>") != 0) {
+               rec.setSpoolDir(val[0]);
+            }
+            rec.heartbeat = str_to_int64(val[1]);
+            rec.journalVersion = JOURNAL_VERSION;
+            len = ser_settings_record(buf, rec);
+            write_record(tmpFp, JREC_SETTINGS, ++seq, (uint8_t *)buf, len);
+
+         } else if (nb == 4) {
+            FileRecord rec;
+            rec.name = val[0];
+            rec.sname = val[1];
+            rec.mtime = str_to_int64(val[2]);
+            rec.fattrs = val[3];
+            len = ser_file_record(buf, rec);
+            write_record(tmpFp, JREC_FILE, ++seq, (uint8_t *)buf, len);
+            val[0] = val[1] = val[3] = NULL; /* freed by the FileRecord */
+
+         } else {
+            len = ser_folder_record(buf, val[0]);
+            write_record(tmpFp, JREC_FOLDER_ADD, ++seq, (uint8_t *)buf, len);
+         }
+      }
+      for (int i = 0; i < nb; i++) {
+         if (val[i]) {
+            free(val[i]);
+         }
+      }
+   }
+
+   if (journal_fsync(tmpFp) != 0) {
+      goto bail_out;
+   }
+   fclose(tmpFp);
+   tmpFp = NULL;
+#ifdef HAVE_WIN32
+   flock(_fd, LOCK_UN);
+   fclose(_fp);
+   _fp = NULL;
+   unlink(_jPath);
+#endif
+   if (rename(tmp_jPath.c_str(), _jPath) != 0) {
+      Dmsg0(0, "Could not rename TMP Journal\n");
+      goto bail_out;
+   }
+   success = true;
+   Dmsg2(DBGLVL, "Converted %lld records of Journal %s\n", (long long)seq, _jPath);
+
+bail_out:
+   if (tmpFp) {
+      fclose(tmpFp);
+      unlink(tmp_jPath.c_str());
+   }
+   if (_fp) {
+      flock(_fd, LOCK_UN);
+      fclose(_fp);
+      _fp = NULL;
+   }
+   _fd = -1;
+   free_pool_memory(buf);
+   return success;
+}
+
+bool Journal::setJournalPath(const char *path)
+{
+   return setJournalPath(path, NULL);
+}
+
+bool Journal::setJournalPath(const char *path, const char *spoolDir)
+{
+   char magic[8];
+   bool binary = false;
+
+   if (_jPath) {
+      free(_jPath);
+   }
+   _jPath = bstrdup(path);
+   FILE *jfile = bfopen(_jPath, "rb");
+
+   if (!jfile) {
+      if (this->beginTransaction("w")) {
+         SettingsRecord rec;
+         rec.journalVersion = JOURNAL_VERSION;
+         rec.setSpoolDir(spoolDir);
+         this->writeSettings(rec);
+      } else {
+         Dmsg1(0, "(ERROR) Could not create Journal File: %s\n", path);
+         return false;
+      }
+   } else {
+      binary = fread(magic, 1, 8, jfile) != 8 || memcmp(magic, JOURNAL_MAGIC, 8) == 0;
+      fclose(jfile);
+
+      if (!binary && !convertTextJournal()) {
+         Dmsg1(0, "(ERROR) Could not convert Journal File: %s\n", path);
+         return false;
+      }
+   }
+
+   return true;
+}
+
+bool Journal::writeSettings(SettingsRecord &rec)
+{
+   POOL_MEM buf(PM_MESSAGE);
+   bool success;
+   bool started = !hasTransaction;
+   int len;
+
+   if(!this->beginTransaction("r+")) {
+      Dmsg0(50, "Could not start transaction for writeSettings()\n");
+      return false;
+   }
+
+   len = ser_settings_record(buf.addr(), rec);
+   success = appendRecord(JREC_SETTINGS, (uint8_t *)buf.c_str(), len);
+
+   if (success) {
+      Dmsg3(DBGLVL,
+            "WROTE RECORD:\n"
+            " Settings {\n"
+            "  spooldir=%s\n"
+            "  heartbeat=%lld\n"
+            "  jversion=%lld\n"
+            " }\n",
+            NPRT(rec.getSpoolDir()),
+            (long long)rec.heartbeat,
+            (long long)rec.journalVersion);
+   }
+
+   if (started) {
+      this->endTransaction();
+   }
+   return success;
+}
+
+SettingsRecord *Journal::readSettings()
+{
+   SettingsRecord *rec = NULL;
+   bool started = !hasTransaction;
+
+   if(!this->beginTransaction("r+")) {
+      Dmsg0(0, "Could not start transaction for readSettings()\n");
+      return NULL;
+   }
+
+   if (_settings) {
+      rec = new SettingsRecord();
+      rec->setSpoolDir(_settings->getSpoolDir());
+      rec->heartbeat = _settings->heartbeat;
+      rec->journalVersion = _settings->journalVersion;
+
+      Dmsg3(DBGLVL,
+            "READ RECORD:\n"
+            " Settings {\n"
+            "  spooldir=%s\n"
+            "  heartbeat=%lld\n"
+            "  jversion=%lld\n"
+            " }\n",
+            NPRT(rec->getSpoolDir()),
+            (long long)rec->heartbeat,
+            (long long)rec->journalVersion);
+   } else {
+      Dmsg0(0, "Could not read Settings Record. Journal is Corrupted.\n");
+   }
+
+   if (started) {
+      this->endTransaction();
+   }
+   return rec;
+}
+
+bool Journal::writeFileRecord(const FileRecord &record)
+{
+   POOL_MEM buf(PM_MESSAGE);
+   bool success;
+   bool started = !hasTransaction;
+   int len;
+
+   if(!this->beginTransaction("a")) {
+      Dmsg0(0, "Could not start transaction for writeFileRecord()\n");
+      return false;
+   }
+
+   len = ser_file_record(buf.addr(), record);
+   success = appendRecord(JREC_FILE, (uint8_t *)buf.c_str(), len);
+
+   if (success) {
+      Dmsg4(DBGLVL,
+            "NEW RECORD:\n"
+            " File {\n"
+            "  name=%s\n"
+            "  sname=%s\n"
+            "  mtime=%lld\n"
+            "  attrs=%s\n"
+            " }\n",
+            record.name,
+            record.sname,
+            (long long)record.mtime,
+            record.fattrs);
+
+      if (needCompaction()) {
+         compact();
+      }
+   }
+
+   if (started) {
+      this->endTransaction();
+   }
+   return success;
+}
+
+/*
+ * Read the next FileRecord between pos and end, the other records are
+ *  skipped.
+ */
+FileRecord *Journal::readFileRecordAt(FILE *fp, uint64_t *pos, uint64_t end, uint64_t *seq)
+{
+   POOLMEM *buf;
+   FileRecord *rec = NULL;
+   uint32_t type;
+   int len;
+
+   if (*pos >= end) {
+      return NULL;
+   }
+   if (fseeko(fp, *pos, SEEK_SET) != 0) {
+      return NULL;
+   }
+   buf = get_pool_memory(PM_MESSAGE);
+   while (*pos < end) {
+      if (!read_record(fp, buf, &type, seq, &len)) {
+         Dmsg1(0, "Could not read File Record at %lld. Journal is Corrupted.\n",
+               (long long)*pos);
+         *pos = end;
+         break;
+      }
+      *pos += JREC_SIZE(len);
+      if (type == JREC_FILE) {
+         rec = unser_file_record((uint8_t *)buf + JREC_HDR_SIZE, len);
+         if (rec) {
+            Dmsg4(DBGLVL,
+                  "READ RECORD:\n"
+                  " File {\n"
+                  "  name=%s\n"
+                  "  sname=%s\n"
+                  "  mtime=%lld\n"
+                  "  attrs=%s\n"
+                  " }\n",
+                  rec->name,
+                  rec->sname,
+                  (long long)rec->mtime,
+                  rec->fattrs);
+            break;
+         }
+      }
+   }
+   free_pool_memory(buf);
+   return rec;
+}
+
+/* Read the FileRecords written after the last Checkpoint */
+FileRecord *Journal::readFileRecord()
+{
+   uint64_t seq;
+
+   if(!hasTransaction) {
+      Dmsg0(0, "(ERROR) Journal::readFileRecord() called without any transaction\n");
+      return NULL;
+   }
+
+   return readFileRecordAt(_fp, &_readPos, _readEnd, &seq);
+}
+
+FileRecord *Journal::findFileRecord(const char *path)
+{
+   JournalFileEntry *entry;
+   FileRecord *rec = NULL;
+   bool started = !hasTransaction;
+   uint64_t pos, seq;
+
+   if(!this->beginTransaction("r")) {
+      return NULL;
+   }
+
+   if (_files && (entry = (JournalFileEntry *)_files->lookup((char *)path)) != NULL) {
+      pos = entry->offset;
+      rec = readFileRecordAt(_fp, &pos, _indexed, &seq);
+   }
+
+   if (started) {
+      this->endTransaction();
+   }
+   return rec;
+}
+
+bool Journal::writeFolderRecord(const FolderRecord &record)
+{
+   POOL_MEM buf(PM_FNAME);
+   bool success;
+   bool started = !hasTransaction;
+   int len;
+
+   if(!this->beginTransaction("a")) {
+      Dmsg0(0, "Could not start transaction for writeFolderRecord()\n");
+      return false;
+   }
+
+   len = ser_folder_record(buf.addr(), record.path);
+   success = appendRecord(JREC_FOLDER_ADD, (uint8_t *)buf.c_str(), len);
+
+   if (success) {
+      Dmsg1(DBGLVL,
+            "NEW RECORD:\n"
+            " Folder {\n"
+            "  path=%s\n"
+            " }\n",
+            record.path);
+   }
+
+   if (started) {
+      this->endTransaction();
+   }
+   return success;
+}
+
+/* Return the watched folders, one by one */
+FolderRecord *Journal::readFolderRecord()
+{
+   FolderRecord *rec;
+
+   if(!hasTransaction) {
+      Dmsg0(0, "(ERROR) Journal::readFolderRecord() called without any transaction\n");
+      return NULL;
+   }
+
+   if (_folderIdx >= _folders->size()) {
+      return NULL;
+   }
+
+   rec = new FolderRecord();
+   rec->path = bstrdup((char *)_folders->get(_folderIdx));
+   _folderIdx++;
+
+   Dmsg1(DBGLVL,
+         "READ RECORD:\n"
+         " Folder {\n"
+         "  path=%s\n"
+         " }\n",
+         rec->path);
+   return rec;
+}
+
+bool Journal::removeFolderRecord(const char* folder)
+{
+   POOL_MEM buf(PM_FNAME);
+   bool success = false;
+   bool started = !hasTransaction;
+   char *path;
+   int len;
+
+   if(!this->beginTransaction("r")) {
+      return false;
+   }
+
+   foreach_alist(path, _folders) {
+      if (strcmp(path, folder) == 0) {
+         len = ser_folder_record(buf.addr(), folder);
+         success = appendRecord(JREC_FOLDER_DEL, (uint8_t *)buf.c_str(), len);
+         break;
+      }
+   }
+
+   if (started) {
+      this->endTransaction();
+   }
+   return success;
+}
+
+bool Journal::openCursor(uint32_t jobid)
+{
+   bool started = !hasTransaction;
+   uint64_t offset;
+
+   closeCursor();
+
+   if(!this->beginTransaction("r")) {
+      return false;
+   }
+
+   offset = checkpointOffset(jobid);
+   if (offset == 0) {
+      Dmsg2(0, "No Checkpoint for JobId %d in Journal %s\n", jobid, _jPath);
+
+   } else {
+      /* Opened with the lock, a compaction cannot replace the file now */
+      _curFp = bfopen(_jPath, "rb");
+      _curPos = offset;
+      _curEnd = _indexed;
+      _curSeq = _lastSeq;
+      _curGeneration = _generation;
+      Dmsg4(DBGLVL, "Cursor on Journal %s from %lld to %lld seq=%lld\n",
+            _jPath, (long long)_curPos, (long long)_curEnd, (long long)_curSeq);
+   }
+
+   if (started) {
+      this->endTransaction();
+   }
+   return _curFp != NULL;
+}
+
+FileRecord *Journal::nextFileRecord()
+{
+   uint64_t seq;
+
+   if (!_curFp) {
+      return NULL;
+   }
+   return readFileRecordAt(_curFp, &_curPos, _curEnd, &seq);
+}
+
+void Journal::closeCursor()
+{
+   if (_curFp) {
+      fclose(_curFp);
+      _curFp = NULL;
+   }
+}
+
+/*
+ * Write a Checkpoint for the records read with the cursor, the next
+ *  cursor will start after them. The Checkpoint is synced to disk.
+ */
+bool Journal::commitCursor(uint32_t jobid)
+{
+   POOL_MEM buf(PM_MESSAGE);
+   POOLMEM *rbuf;
+   bool success = false;
+   bool started = !hasTransaction;
+   uint64_t offset, pos, seq;
+   uint32_t type;
+   int len;
+
+   if (!_curFp) {
+      return false;
+   }
+
+   if(!this->beginTransaction("r")) {
+      return false;
+   }
+
+   offset = _curEnd;
+   if (_generation != _curGeneration) {
+      /* Compacted since openCursor(), look for the next FileRecord */
+      offset = pos = JOURNAL_HDR_SIZE;
+      rbuf = get_pool_memory(PM_MESSAGE);
+      fseeko(_fp, pos, SEEK_SET);
+      while (pos < _indexed && read_record(_fp, rbuf, &type, &seq, &len)) {
+         if (type == JREC_FILE && seq > _curSeq) {
+            break;
+         }
+         pos += JREC_SIZE(len);
+         if (type == JREC_FILE) {
+            offset = pos;
+         }
+      }
+      free_pool_memory(rbuf);
+   }
+
+   len = ser_checkpoint(buf.addr(), jobid, _curSeq, offset);
+   if (appendRecord(JREC_CHECKPOINT, (uint8_t *)buf.c_str(), len)) {
+      if (journal_fsync(_fp) != 0) {
+         Dmsg2(0, "Could not sync Journal %s. ERR=%s\n", _jPath, strerror(errno));
+      } else {
+         success = true;
+      }
+   }
+   Dmsg3(DBGLVL, "Checkpoint JobId=%d seq=%lld in Journal %s\n", jobid,
+         (long long)_curSeq, _jPath);
+
+   if (success && needCompaction()) {
+      compact();
+   }
+
+   if (started) {
+      this->endTransaction();
+   }
+   closeCursor();
+   return success;
+}
+
+/* Most of the Journal was backed up */
+bool Journal::needCompaction()
+{
+   int nb = _checkpoints->size();
+   uint64_t cut;
+
+   if (nb == 0 || _indexed < JOURNAL_COMPACT_MIN) {
+      return false;
+   }
+   cut = ((JournalCheckpoint *)_checkpoints->get(MAX(nb - _retention, 0)))->offset;
+   return cut - JOURNAL_HDR_SIZE > _indexed / 2;
+}
+
+/*
+ * Write a new Journal with the last Settings, the watched Folders and
+ *  the records after the oldest Checkpoint kept, and replace the current
+ *  one. The offsets of the Checkpoints are adjusted.
+ */
+bool Journal::compact()
+{
+   POOLMEM *buf = get_pool_memory(PM_MESSAGE);
+   POOLMEM *data = get_pool_memory(PM_MESSAGE);
+   POOL_MEM tmp_jPath;
+   FILE *tmpFp = NULL;
+   JournalCheckpoint *ckpt;
+   uint64_t cut, base, pos, seq, ck_seq, ck_offset, old_size = _indexed;
+   uint32_t type, jobid;
+   bool success = false;
+   bool started = !hasTransaction;
+   char *path;
+   int len, nb;
+   unser_declare;
+
+   if(!this->beginTransaction("r")) {
+      goto bail_out;
+   }
+
+   nb = _checkpoints->size();
+   if (nb == 0) {
+      success = true;                 /* Nothing was backed up */
+      goto bail_out;
+   }
+   ckpt = (JournalCheckpoint *)_checkpoints->get(MAX(nb - _retention, 0));
+   cut = ckpt->offset;
+
+   Mmsg(tmp_jPath, "%s.temp", _jPath);
+   tmpFp = bfopen(tmp_jPath.c_str(), "w+b");
+   if (!tmpFp || !writeHeader(tmpFp, _generation + 1)) {
+      goto bail_out;
+   }
+   if (_settings) {
+      len = ser_settings_record(data, *_settings);
+      if (!write_record(tmpFp, JREC_SETTINGS, 0, (uint8_t *)data, len)) {
+         goto bail_out;
+      }
+   }
+   foreach_alist(path, _folders) {
+      len = ser_folder_record(data, path);
+      if (!write_record(tmpFp, JREC_FOLDER_ADD, 0, (uint8_t *)data, len)) {
+         goto bail_out;
+      }
+   }
+   base = ftello(tmpFp);
+
+   /* Copy the records after the cut */
+   pos = cut;
+   fseeko(_fp, pos, SEEK_SET);
+   while (pos < _indexed && read_record(_fp, buf, &type, &seq, &len)) {
+      pos += JREC_SIZE(len);
+      if (type == JREC_CHECKPOINT && len >= 20) {
+         unser_begin(buf + JREC_HDR_SIZE, len);
+         unser_uint32(jobid);
+         unser_uint64(ck_seq);
+         unser_uint64(ck_offset);
+         if (ck_offset < cut) {
+            continue;                 /* Older Checkpoint, not kept */
+         }
+         len = ser_checkpoint(data, jobid, ck_seq, ck_offset - cut + base);
+         if (!write_record(tmpFp, type, seq, (uint8_t *)data, len)) {
+            goto bail_out;
+         }
+      } else if (fwrite(buf, 1, JREC_SIZE(len), tmpFp) != (size_t)JREC_SIZE(len)) {
+         goto bail_out;
+      }
+   }
+
+   if (journal_fsync(tmpFp) != 0) {
+      goto bail_out;
+   }
+   fclose(tmpFp);
+   tmpFp = NULL;
+
+#ifdef HAVE_WIN32
+   flock(_fd, LOCK_UN);
+   fclose(_fp);
+   _fp = NULL;
+   unlink(_jPath);
+#endif
+   if (rename(tmp_jPath.c_str(), _jPath) != 0) {
+      Dmsg0(0, "Could not rename TMP Journal\n");
+      goto bail_out;
+   }
+
+   /* Continue the transaction with the new Journal */
+   if (_fp) {
+      flock(_fd, LOCK_UN);
+      fclose(_fp);
+   }
+   _fp = NULL;
+   if (!this->open("r") || flock(_fd, LOCK_EX) != 0) {
+      if (_fp) {
+         fclose(_fp);
+         _fp = NULL;
+      }
+      hasTransaction = false;
+      goto bail_out;
+   }
+   resetIndex();
+   success = refresh();
+   Dmsg3(DBGLVL, "Compacted Journal %s from %lld to %lld bytes\n", _jPath,
+         (long long)old_size, (long long)_indexed);
+
+bail_out:
+   if (tmpFp) {
+      fclose(tmpFp);
+      unlink(tmp_jPath.c_str());
+   }
+   if (started) {
+      this->endTransaction();
+   }
+   free_pool_memory(buf);
+   free_pool_memory(data);
+   return success;
+}
@@ -0,0 +1,190 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+*/
+
+#ifndef journal_H
+#define journal_H
+
+#include "settings-record.h"
+#include "folder-record.h"
+#include "file-record.h"
+
+#ifndef HAVE_WIN32
+#include <sys/file.h>
+#endif
+
+#ifdef HAVE_WIN32
+#define JOURNAL_CLI_FNAME "bcdp-cli.journal"
+#else
+#define JOURNAL_CLI_FNAME ".bcdp-cli.journal"
+#endif
+
+#define JOURNAL_VERSION 2
+
+/* Record types of the binary Journal */
+enum {
+   JREC_SETTINGS   = 1,               /* SettingsRecord, the last one is used */
+   JREC_FOLDER_ADD = 2,               /* A folder is watched */
+   JREC_FOLDER_DEL = 3,               /* A folder is no longer watched */
+   JREC_FILE       = 4,               /* FileRecord */
+   JREC_CHECKPOINT = 5                /* FileRecords backed up by a Job */
+};
+
+/* Files known by the Journal, indexed by path */
+struct JournalFileEntry {
+   hlink link;
+   uint64_t seq;                      /* Sequence number of the last record */
+   uint64_t offset;                   /* Offset of the last record */
+   int64_t mtime;
+   char *path;
+};
+
+/* FileRecords up to seq were backed up by JobId */
+struct JournalCheckpoint {
+   uint32_t jobid;
+   uint64_t seq;                      /* Last FileRecord backed up */
+   uint64_t offset;                   /* Offset of the next FileRecord */
+};
+
+/**
+ * @brief The Journal persists and retrieves @class FileRecord objects.
+ *
+ * Used by:
+ *
+ * 1-) The CDP Client, to store information about files that
+ * should backed up.
+ *
+ * 2-) The CDP FD Plugin, to decide which file should be backed
+ * up on a specific Job.
+ *
+ * The Journal is an append-only binary log. Each record has a sequence
+ * number and a CRC, a record truncated by a crash is discarded when the
+ * Journal is opened. The process that uses the Journal keeps an index
+ * of the records (last Settings, watched Folders, Files by path and
+ * Checkpoints) that is updated with the records appended since the last
+ * transaction, so the cost of a transaction is proportional to the
+ * number of changes.
+ *
+ * A Job reads the FileRecords written since the last Checkpoint with a
+ * cursor, and appends a Checkpoint when they are backed up. The Journal
+ * is compacted when most of its size is made of records that were
+ * backed up. The compacted Journal is written in a new file that
+ * replaces the old one.
+ *
+ * A Journal written by older versions (text format) is converted when
+ * it is opened.
+ */
+class Journal
+{
+
+private:
+    FILE * _fp;
+    int _fd;
+    bool _ownTransaction;
+
+    /* Index of the records, see refresh() */
+    ino_t _ino;
+    uint64_t _generation;             /* Incremented by each compaction */
+    uint64_t _indexed;                /* Offset of the first record not indexed */
+    uint64_t _lastSeq;                /* Last sequence number used */
+    SettingsRecord *_settings;
+    alist *_folders;
+    htable *_files;
+    alist *_checkpoints;
+    int _retention;                   /* Number of Checkpoints kept by compact() */
+
+    /* Iterators used by readFolderRecord() and readFileRecord() */
+    int _folderIdx;
+    uint64_t _readPos;
+    uint64_t _readEnd;
+
+    /* Cursor used by the Job, see openCursor() */
+    FILE *_curFp;
+    uint64_t _curPos;
+    uint64_t _curEnd;
+    uint64_t _curSeq;
+    uint64_t _curGeneration;
+
+    bool open(const char *mode);
+    bool writeHeader(FILE *fp, uint64_t generation);
+    bool readHeader(FILE *fp, uint64_t *generation);
+    bool appendRecord(uint32_t type, uint8_t *data, int len);
+    bool refresh();
+    void resetIndex();
+    void indexRecord(uint32_t type, uint64_t seq, uint64_t offset, uint8_t *data, int len);
+    FileRecord *readFileRecordAt(FILE *fp, uint64_t *pos, uint64_t end, uint64_t *seq);
+    uint64_t checkpointOffset(uint32_t jobid);
+    bool needCompaction();
+    bool convertTextJournal();
+
+public:
+    char *_jPath;
+    bool hasTransaction;
+
+    Journal():
+        _fp(NULL), _fd(-1), _ownTransaction(false), _ino(0), _generation(0),
+        _indexed(0), _lastSeq(0), _settings(NULL),
+        _folders(NULL), _files(NULL), _checkpoints(NULL), _retention(1),
+        _folderIdx(0), _readPos(0), _readEnd(0), _curFp(NULL), _curPos(0),
+        _curEnd(0), _curSeq(0), _curGeneration(0), _jPath(NULL),
+        hasTransaction(false)
+    {}
+
+    ~Journal();
+
+    bool setJournalPath(const char *path);
+    bool setJournalPath(const char *path, const char *spoolDir);
+
+    bool beginTransaction(const char *mode);
+    void endTransaction();
+
+    bool writeSettings(SettingsRecord &record);
+    SettingsRecord *readSettings();
+
+    bool writeFileRecord(const FileRecord &record);
+    FileRecord *readFileRecord();
+
+    /** Last FileRecord written for this path, NULL if none */
+    FileRecord *findFileRecord(const char *path);
+
+    bool removeFolderRecord(const char *folder);
+    bool writeFolderRecord(const FolderRecord &record);
+    FolderRecord *readFolderRecord();
+
+    /**
+     * Cursor on the FileRecords written after the Checkpoint of a Job,
+     * or after the last Checkpoint if jobid is 0. The Journal is not
+     * locked while the records are read.
+     */
+    bool openCursor(uint32_t jobid);
+    FileRecord *nextFileRecord();
+    /** Write the Checkpoint of the records read with the cursor */
+    bool commitCursor(uint32_t jobid);
+    void closeCursor();
+
+    /** Number of Checkpoints (and their FileRecords) kept by compact() */
+    void setRetention(int nb) { _retention = MAX(nb, 1); }
+    bool compact();
+
+    /** Public only because it's used by Unit Tests */
+    char *extract_val(const char *key_val);
+
+    //TODO: warnSizeFull();
+};
+
+#endif
@@ -373,6 +373,8 @@ DCR *acquire_device_for_append(DCR *dcr)
    JCR *jcr = dcr->jcr;
    bool ok = false;
    bool have_vol = false;
+   bool mounted;
+   btime_t mount_start;
 
    Enter(200);
    dcr->set_ameta();
@@ -417,7 +419,10 @@ DCR *acquire_device_for_append(DCR *dcr)
       block_device(dev, BST_DOING_ACQUIRE);
       dev->Unlock();
       Dmsg1(190, "jid=%u Do mount_next_write_vol\n", (uint32_t)jcr->JobId);
-      if (!dcr->mount_next_write_volume()) {
+      mount_start = bhist_start();
+      mounted = dcr->mount_next_write_volume();
+      bhist_record(jcr, sdhistograms.mount_wait, mount_start);
+      if (!mounted) {
          if (!job_canceled(jcr) && !jcr->is_incomplete()) {
             /* Reduce "noise" -- don't print if job canceled */
             Mmsg2(jcr->errmsg, _("Could not ready %s device %s for append.\n"),
@@ -149,6 +149,8 @@ bool do_append_data(JCR *jcr)
    dcr->VolFirstIndex = dcr->VolLastIndex = 0;
    jcr->run_time = time(NULL);              /* start counting time for rates */
 
+   /* Get several of the small messages sent for each file with one read() */
+   fd->set_buffered(BSOCK_BUFFERED_SIZE, BNET_SETBUF_READ);
    GetMsg *qfd = dcr->dev->get_msg_queue(jcr, fd, DEDUP_MAX_MSG_SIZE);
 
    qfd->start_read_sock();
@@ -328,6 +330,7 @@ fi_checked:
    /* stop local and remote dedup  */
    Dmsg2(DT_DEDUP|215, "Wait for deduplication quarantine: emergency_exit=%d device=%s\n", ok?0:1, dev->print_name());
    qfd->wait_read_sock((ok == false) || jcr->is_job_canceled());
+   fd->clear_buffered(BNET_SETBUF_READ);
 
    if (qfd->commit(errmsg.addr(), jcr->JobId)) {
       ok = false;
@@ -460,6 +463,10 @@ bool send_attrs_to_dir(JCR *jcr, DEV_RECORD *rec)
             return false;
          }
          dir->clear_spooling();
+         if (rec->maskedStream == STREAM_UNIX_ATTRIBUTES ||
+             rec->maskedStream == STREAM_UNIX_ATTRIBUTES_EX) {
+            return checkpoint_attribute_spool(jcr->dcr);
+         }
       }
    }
    return true;
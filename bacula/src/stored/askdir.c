@@ -40,6 +40,7 @@ static char Update_media[] = "CatReq JobId=%ld UpdateMedia VolName=%s"
    " LastPartBytes=%lld Enabled=%d Recycle=%d\n";
 static char Create_jobmedia[] = "CatReq JobId=%ld CreateJobMedia\n";
 static char FileAttributes[] = "UpdCat JobId=%ld FileAttributes ";
+static char FileAttrBatch[] = "UpdCat JobId=%ld FileAttrBatch %d ";
 
 /* Responses received from the Director */
 static char OK_media[] = "1000 OK VolName=%127s VolJobs=%u VolFiles=%lu"
@@ -55,6 +56,15 @@ static char OK_media[] = "1000 OK VolName=%127s VolJobs=%u VolFiles=%lu"
 
 static char OK_create[] = "1000 OK CreateJobMedia\n";
 
+/* Max JobMedia batches sent to the Director without reading the acknowledgement */
+static const int max_jobmedia_pending = 8;
+
+/* First Director version that understands the FileAttrBatch message */
+static const int32_t attr_batch_dir_version = 10003;
+/* Limits of a file attributes batch, the network packet is limited to 1MB */
+static const int32_t max_attr_batch_count = 1000;
+static const int32_t max_attr_batch_len = 256 * 1024;
+
 static bthread_mutex_t vol_info_mutex = BTHREAD_MUTEX_PRIORITY(PRIO_SD_VOL_INFO);
 
 #ifdef needed
@@ -203,6 +213,11 @@ static bool do_get_volume_info(DCR *dcr)
     int32_t InChanger;
 
     dcr->setVolCatInfo(false);
+    /* The answers of the JobMedia batches sent before our request come first */
+    if (!wait_jobmedia_acks(jcr)) {
+       Mmsg(jcr->errmsg, _("Error creating JobMedia records.\n"));
+       return false;
+    }
     if (dir->recv() <= 0) {
        Dmsg0(dbglvl, "getvolname error bnet_recv\n");
        Mmsg(jcr->errmsg, _("Network error on bnet_recv in req_vol_info.\n"));
@@ -583,7 +598,43 @@ void create_jobmedia_queue(JCR *jcr)
 }
 
 
-bool flush_jobmedia_queue(JCR *jcr)
+/*
+ * Read the acknowledgements of the JobMedia batches sent to the Director.
+ *  It must be called before reading any other answer from the Director,
+ *  and at the end of the Job so that the catalog is consistent before
+ *  the Job terminates.
+ */
+bool wait_jobmedia_acks(JCR *jcr)
+{
+   BSOCK *dir = jcr->dir_bsock;
+   bool ok = true;
+
+   while (jcr->jobmedia_pending > 0) {
+      jcr->jobmedia_pending--;
+      if (dir->recv() <= 0) {
+         Dmsg0(dbglvl, "create_jobmedia error bnet_recv\n");
+         Jmsg(jcr, M_FATAL, 0, _("Error creating JobMedia records: ERR=%s\n"),
+              dir->bstrerror());
+         jcr->jobmedia_pending = 0;
+         return false;
+      }
+      Dmsg1(210, "<dird %s", dir->msg);
+      if (strcmp(dir->msg, OK_create) != 0) {
+         Dmsg1(dbglvl, "Bad response from Dir: %s\n", dir->msg);
+         Jmsg(jcr, M_FATAL, 0, _("Error creating JobMedia records: %s\n"), dir->msg);
+         ok = false;               /* read the other acknowledgements */
+      }
+   }
+   return ok;
+}
+
+/*
+ * Send the queued JobMedia records to the Director as a single batch.
+ *  When wait is false, the acknowledgement is read later by wait_jobmedia_acks()
+ *  so the writer does not wait for the catalog, unless too many batches
+ *  are pending.
+ */
+bool flush_jobmedia_queue(JCR *jcr, bool wait)
 {
    if (askdir_handler) {
       return askdir_handler->flush_jobmedia_queue(jcr);
@@ -593,48 +644,45 @@ bool flush_jobmedia_queue(JCR *jcr)
    BSOCK *dir = jcr->dir_bsock;
    bool ok;
 
+   /* The attributes of the files in the JobMedia go first */
+   if (!dir_flush_file_attributes(jcr)) {
+      Jmsg(jcr, M_FATAL, 0, _("Error updating file attributes. ERR=%s\n"),
+           dir->bstrerror());
+      return false;
+   }
    if (!flush_filemedia_queue(jcr)) {
       return false;             /* already in FATAL */
    }
 
-   if (!jcr->jobmedia_queue || jcr->jobmedia_queue->size() == 0) {
-      return true;     /* should never happen */
-   }
-   Dmsg1(400, "=== Flush jobmedia queue = %d\n", jcr->jobmedia_queue->size());
-
-   dir->fsend(Create_jobmedia, jcr->JobId);
-   foreach_dlist(item, jcr->jobmedia_queue) {
-      if (jcr->is_JobStatus(JS_Incomplete)) {
-         if (item->VolFirstIndex >= dir->get_lastFileIndex()) {
-            continue;
-         }
-         if (item->VolLastIndex >= dir->get_lastFileIndex()) {
-            item->VolLastIndex = dir->get_lastFileIndex() - 1;
+   if (jcr->jobmedia_queue && jcr->jobmedia_queue->size() > 0) {
+      Dmsg1(400, "=== Flush jobmedia queue = %d\n", jcr->jobmedia_queue->size());
+
+      dir->fsend(Create_jobmedia, jcr->JobId);
+      foreach_dlist(item, jcr->jobmedia_queue) {
+         if (jcr->is_JobStatus(JS_Incomplete)) {
+            if (item->VolFirstIndex >= dir->get_lastFileIndex()) {
+               continue;
+            }
+            if (item->VolLastIndex >= dir->get_lastFileIndex()) {
+               item->VolLastIndex = dir->get_lastFileIndex() - 1;
+            }
          }
+         ok = dir->fsend("%u %u %u %u %u %u %lld\n",
+            item->VolFirstIndex, item->VolLastIndex,
+            item->StartFile, item->EndFile,
+            item->StartBlock, item->EndBlock,
+            item->VolMediaId);
+         /* Keep track of last FileIndex flushed */
+         dir->set_lastFlushIndex(item->VolLastIndex);
+         Dmsg2(400, "sd->dir: ok=%d Jobmedia=%s", ok, dir->msg);
       }
-      ok = dir->fsend("%u %u %u %u %u %u %lld\n",
-         item->VolFirstIndex, item->VolLastIndex,
-         item->StartFile, item->EndFile,
-         item->StartBlock, item->EndBlock,
-         item->VolMediaId);
-      /* Keep track of last FileIndex flushed */
-      dir->set_lastFlushIndex(item->VolLastIndex);
-      Dmsg2(400, "sd->dir: ok=%d Jobmedia=%s", ok, dir->msg);
-   }
-   dir->signal(BNET_EOD);
-   jcr->jobmedia_queue->destroy();
-
-   if (dir->recv() <= 0) {
-      Dmsg0(dbglvl, "create_jobmedia error bnet_recv\n");
-      Jmsg(jcr, M_FATAL, 0, _("Error creating JobMedia records: ERR=%s\n"),
-           dir->bstrerror());
-      return false;
+      dir->signal(BNET_EOD);
+      jcr->jobmedia_queue->destroy();
+      jcr->jobmedia_pending++;
    }
-   Dmsg1(210, "<dird %s", dir->msg);
-   if (strcmp(dir->msg, OK_create) != 0) {
-      Dmsg1(dbglvl, "Bad response from Dir: %s\n", dir->msg);
-      Jmsg(jcr, M_FATAL, 0, _("Error creating JobMedia records: %s\n"), dir->msg);
-      return false;
+
+   if (wait || jcr->jobmedia_pending >= max_jobmedia_pending) {
+      return wait_jobmedia_acks(jcr);
    }
    return true;
 }
@@ -717,9 +765,9 @@ bool dir_create_jobmedia_record(DCR *dcr, bool zero)
       item->VolMediaId = dcr->VolMediaId;
    }
    jcr->jobmedia_queue->append(item);
-   /* Flush at queue size of 1000 jobmedia records */
+   /* Flush at queue size of 1000 jobmedia records, the label (zero) is synchronous */
    if (zero || jcr->jobmedia_queue->size() >= 1000) {
-      ok = flush_jobmedia_queue(jcr);
+      ok = flush_jobmedia_queue(jcr, zero);
    }
 
    dcr->VolFirstIndex = dcr->VolLastIndex = 0;
@@ -759,6 +807,43 @@ bool dir_update_file_attributes(DCR *dcr, DEV_RECORD *rec)
    return true;
 #endif
 
+   /*
+    * When the attributes are not spooled, they are packed into a single
+    *  message per batch of files. The spooled attributes are sent one
+    *  record at a time so that the spool file can be truncated at the
+    *  last valid FileIndex.
+    */
+   if (!dir->is_spooling() && jcr->DIRVersion >= attr_batch_dir_version &&
+       rec->data_len < (uint32_t)max_attr_batch_len) {
+      int32_t reclen = 5 * sizeof(int32_t) + rec->data_len;
+      if (jcr->attr_batch_len + reclen > max_attr_batch_len &&
+          !dir_flush_file_attributes(jcr)) {
+         return false;
+      }
+      if (!jcr->attr_batch) {
+         jcr->attr_batch = get_pool_memory(PM_MESSAGE);
+      }
+      jcr->attr_batch = check_pool_memory_size(jcr->attr_batch,
+                           jcr->attr_batch_len + reclen);
+      ser_begin(jcr->attr_batch + jcr->attr_batch_len, 0);
+      ser_uint32(rec->VolSessionId);
+      ser_uint32(rec->VolSessionTime);
+      ser_int32(rec->FileIndex);
+      ser_int32(rec->Stream);
+      ser_uint32(rec->data_len);
+      ser_bytes(rec->data, rec->data_len);
+      jcr->attr_batch_len = ser_length(jcr->attr_batch);
+      jcr->attr_batch_count++;
+      if (jcr->attr_batch_count >= max_attr_batch_count) {
+         return dir_flush_file_attributes(jcr);
+      }
+      return true;
+   }
+   /* Keep the order of the records in the catalog */
+   if (!dir_flush_file_attributes(jcr)) {
+      return false;
+   }
+
    dir->msg = check_pool_memory_size(dir->msg, sizeof(FileAttributes) +
                 MAX_NAME_LENGTH + sizeof(DEV_RECORD) + rec->data_len + 1);
    dir->msglen = bsnprintf(dir->msg, sizeof(FileAttributes) +
@@ -780,6 +865,31 @@ bool dir_update_file_attributes(DCR *dcr, DEV_RECORD *rec)
    return dir->send();
 }
 
+/*
+ * Send the file attributes queued by dir_update_file_attributes()
+ *  to the Director in a single FileAttrBatch message.
+ */
+bool dir_flush_file_attributes(JCR *jcr)
+{
+   BSOCK *dir = jcr->dir_bsock;
+   int32_t len;
+
+   if (jcr->attr_batch_count == 0) {
+      return true;
+   }
+   Dmsg2(400, "Flush attributes batch count=%d len=%d\n", jcr->attr_batch_count,
+         jcr->attr_batch_len);
+   dir->msg = check_pool_memory_size(dir->msg, sizeof(FileAttrBatch) +
+                MAX_NAME_LENGTH + jcr->attr_batch_len + 1);
+   len = bsnprintf(dir->msg, sizeof(FileAttrBatch) + MAX_NAME_LENGTH + 1,
+                FileAttrBatch, jcr->JobId, jcr->attr_batch_count);
+   memcpy(dir->msg + len, jcr->attr_batch, jcr->attr_batch_len);
+   dir->msglen = len + jcr->attr_batch_len;
+   jcr->attr_batch_len = 0;
+   jcr->attr_batch_count = 0;
+   return dir->send();
+}
+
 
 /**
  *   Request the sysop to create an appendable volume
@@ -128,6 +128,7 @@ bool DCR::write_block_to_dev()
    uint32_t checksum;
    uint32_t pad;                      /* padding or zeros written */
    boffset_t pos;
+   btime_t write_start;
    char ed1[50];
 
    if (no_tape_write_test) {
@@ -226,6 +227,7 @@ bool DCR::write_block_to_dev()
    stat = 0;
    /* ***FIXME**** remove next line debug */
    pos =  dev->lseek(dcr, 0, SEEK_CUR);
+   write_start = bhist_start();
    do {
       if (retry > 0 && stat == -1 && errno == EBUSY) {
          berrno be;
@@ -239,6 +241,7 @@ bool DCR::write_block_to_dev()
          block->adata?"Adata":"Ameta", block->BlockAddr, wlen,
          dev->VolHdr.VolumeName);
    } while (stat == -1 && (errno == EBUSY || errno == EIO) && retry++ < 3);
+   bhist_record(jcr, sdhistograms.block_write, write_start);
 
    /* ***FIXME*** remove 2 lines debug */
    Dmsg2(100, "Wrote %d bytes at %s\n", wlen, dev->print_addr(ed1, sizeof(ed1), pos));
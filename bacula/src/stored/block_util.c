@@ -754,7 +754,7 @@ bool terminate_writing_volume(DCR *dcr)
        Jmsg(dcr->jcr, M_FATAL, 0, "%s", dev->errmsg);
        ok = false;
    }
-   flush_jobmedia_queue(dcr->jcr);
+   flush_jobmedia_queue(dcr->jcr, false);
    bstrncpy(dev->LoadedVolName, dev->VolCatInfo.VolCatName, sizeof(dev->LoadedVolName));
    dcr->block->write_failed = true;
    if (dev->can_append() && !dev->weof(dcr, 1)) {     /* end the tape */
@@ -839,7 +839,7 @@ bool check_for_newvol_or_newfile(DCR *dcr)
       }
       if (dcr->NewVol) {
          Dmsg0(250, "Process NewVol\n");
-         flush_jobmedia_queue(jcr);
+         flush_jobmedia_queue(jcr, false);
          /* Note, setting a new volume also handles any pending new file */
          set_new_volume_parameters(dcr);
       } else {
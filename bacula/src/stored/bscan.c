@@ -35,6 +35,11 @@ extern bool parse_sd_config(CONFIG *config, const char *configfile, int exit_cod
 /* Forward referenced functions */
 static void do_scan(void);
 static bool record_cb(DCR *dcr, DEV_RECORD *rec);
+static bool catalog_record(JCR *mjcr, DEV_RECORD *rec, int32_t FirstIndex, ATTR *attr);
+static void start_scan_threads(int nthreads);
+static void stop_scan_threads();
+static void scan_queue(JCR *mjcr, DEV_RECORD *rec, int32_t FirstIndex);
+static void scan_wait_idle();
 static int  create_file_attributes_record(JCR *mjcr, ATTR *attrs, DEV_RECORD *rec);
 static int  create_media_record(BDB *db, MEDIA_DBR *mr, VOLUME_LABEL *vl);
 static bool update_media_record(BDB *db, MEDIA_DBR *mr);
@@ -59,8 +64,6 @@ static POOL_DBR pr;
 static JOB_DBR jr;
 static CLIENT_DBR cr;
 static FILESET_DBR fsr;
-static ATTR_DBR ar;
-static FILE_DBR fr;
 static SESSION_LABEL label;
 static SESSION_LABEL elabel;
 static ATTR *attr;
@@ -94,6 +97,35 @@ static int num_media = 0;
 static int num_files = 0;
 static int num_plugin_objects = 0;
 
+/*
+ * With -T, the records of the Jobs are handed to catalog threads while
+ *  the Volume is read. All the records of a session go to the same
+ *  thread, the labels are handled by the main thread once the catalog
+ *  threads are idle, and the batch of a Job is flushed by its thread.
+ */
+#define SCAN_QUEUE_SIZE (4 * 1024 * 1024) /* bytes queued for a thread */
+
+struct SCAN_ITEM {
+   dlink link;
+   JCR *mjcr;                         /* got from get_jcr_by_session() */
+   DEV_RECORD *rec;                   /* NULL to release mjcr */
+   int32_t FirstIndex;                /* FirstIndex of the block of rec */
+};
+
+struct SCAN_THREAD {
+   pthread_t tid;
+   dlist *queue;
+   int64_t queued;                    /* bytes in the queue */
+   ATTR *attr;
+};
+
+static int scan_threads = 0;
+static SCAN_THREAD *scan_thr = NULL;
+static pthread_mutex_t scan_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t scan_cond = PTHREAD_COND_INITIALIZER;
+static int scan_pending = 0;          /* records queued or being processed */
+static bool scan_quit = false;
+
 static CONFIG *config;
 #define CONFIG_FILE "bacula-sd.conf"
 
@@ -120,6 +152,7 @@ PROG_COPYRIGHT
 "       -r                list records\n"
 "       -s                synchronize or store in database\n"
 "       -S                show scan progress periodically\n"
+"       -T <nn>           update the catalog with <nn> threads while reading\n"
 "       -v                verbose\n"
 "       -V <Volumes>      specify Volume names (separated by |)\n"
 "       -w <dir>          specify working directory (default from conf file)\n"
@@ -147,11 +180,18 @@ int main (int argc, char *argv[])
 
    OSDependentInit();
 
-   while ((ch = getopt(argc, argv, "b:c:d:D:h:o:k:e:a:mn:pP:rsSt:u:vV:w:?")) != -1) {
+   while ((ch = getopt(argc, argv, "b:c:d:D:h:o:k:e:a:mn:pP:rsSt:T:u:vV:w:?")) != -1) {
       switch (ch) {
       case 'S' :
          showProgress = true;
          break;
+      case 'T':
+         scan_threads = atoi(optarg);
+         if (scan_threads < 0 || scan_threads > 64) {
+            Pmsg0(0, _("The number of catalog threads must be between 0 and 64.\n"));
+            usage();
+         }
+         break;
       case 'b':
          bsr = parse_bsr(NULL, optarg);
          break;
@@ -358,6 +398,8 @@ static bool bscan_mount_next_read_volume(DCR *dcr)
 {
    DEVICE *dev = dcr->dev;
    DCR *mdcr;
+
+   scan_wait_idle();                  /* the jcrs are up to date */
    Dmsg1(100, "Walk attached jcrs. Volume=%s\n", dev->getVolCatName());
    foreach_dlist(mdcr, dev->attached_dcrs) {
       JCR *mjcr = mdcr->jcr;
@@ -403,23 +445,165 @@ static void do_scan()
 {
    attr = new_attr(bjcr);
 
-   bmemset(&ar, 0, sizeof(ar));
    bmemset(&pr, 0, sizeof(pr));
    bmemset(&jr, 0, sizeof(jr));
    bmemset(&cr, 0, sizeof(cr));
    bmemset(&fsr, 0, sizeof(fsr));
-   bmemset(&fr, 0, sizeof(fr));
+
+   start_scan_threads(scan_threads);
 
    /* Detach bscan's jcr as we are not a real Job on the tape */
 
    read_records(bjcr->read_dcr, record_cb, bscan_mount_next_read_volume);
 
+   stop_scan_threads();
    if (update_db) {
       db_write_batch_file_records(bjcr); /* used by bulk batch file insert */
    }
    free_attr(attr);
 }
 
+/*
+ * Catalog thread, update the catalog with the records of the sessions
+ *  queued for it.
+ */
+static void *scan_thread(void *arg)
+{
+   SCAN_THREAD *thr = (SCAN_THREAD *)arg;
+   SCAN_ITEM *item;
+
+   for ( ;; ) {
+      P(scan_mutex);
+      while ((item = (SCAN_ITEM *)thr->queue->first()) == NULL && !scan_quit) {
+         pthread_cond_wait(&scan_cond, &scan_mutex);
+      }
+      if (item) {
+         thr->queue->remove(item);
+         if (item->rec) {
+            thr->queued -= item->rec->data_len;
+         }
+         pthread_cond_broadcast(&scan_cond);
+      }
+      V(scan_mutex);
+      if (!item) {
+         break;                       /* queue empty and asked to quit */
+      }
+      if (item->rec) {
+         catalog_record(item->mjcr, item->rec, item->FirstIndex, thr->attr);
+         free_record(item->rec);
+         P(scan_mutex);
+         scan_pending--;
+         pthread_cond_broadcast(&scan_cond);
+         V(scan_mutex);
+      } else {
+         free_jcr(item->mjcr);        /* writes the batch of the Job */
+      }
+      free(item);
+   }
+   return NULL;
+}
+
+static void start_scan_threads(int nthreads)
+{
+   SCAN_ITEM *item = NULL;
+   int i, stat;
+
+   if (nthreads <= 0) {
+      return;
+   }
+   scan_thr = (SCAN_THREAD *)malloc(nthreads * sizeof(SCAN_THREAD));
+   bmemzero(scan_thr, nthreads * sizeof(SCAN_THREAD));
+   for (i=0; i < nthreads; i++) {
+      scan_thr[i].queue = New(dlist(item, &item->link));
+      scan_thr[i].attr = new_attr(bjcr);
+      if ((stat = pthread_create(&scan_thr[i].tid, NULL, scan_thread, &scan_thr[i])) != 0) {
+         berrno be;
+         Emsg1(M_ERROR_TERM, 0, _("Cannot create catalog thread: ERR=%s\n"),
+               be.bstrerror(stat));
+      }
+   }
+   if (verbose) {
+      Pmsg1(000, _("Updating the catalog with %d threads.\n"), nthreads);
+   }
+}
+
+/* Wait for the queued records and the batches of the Jobs */
+static void stop_scan_threads()
+{
+   int i;
+
+   if (!scan_thr) {
+      return;
+   }
+   P(scan_mutex);
+   scan_quit = true;
+   pthread_cond_broadcast(&scan_cond);
+   V(scan_mutex);
+   for (i=0; i < scan_threads; i++) {
+      pthread_join(scan_thr[i].tid, NULL);
+      delete scan_thr[i].queue;
+      free_attr(scan_thr[i].attr);
+   }
+   free(scan_thr);
+   scan_thr = NULL;
+   scan_threads = 0;
+}
+
+/*
+ * Hand a copy of the record to the thread of its session, or release
+ *  the Job when rec is NULL.
+ */
+static void scan_queue(JCR *mjcr, DEV_RECORD *rec, int32_t FirstIndex)
+{
+   SCAN_THREAD *thr;
+   SCAN_ITEM *item;
+   DEV_RECORD *qrec = NULL;
+   POOLMEM *data;
+
+   thr = &scan_thr[(mjcr->VolSessionId + mjcr->VolSessionTime) % scan_threads];
+   if (rec) {
+      qrec = new_record();
+      data = qrec->data;
+      memcpy(qrec, rec, sizeof(DEV_RECORD));
+      qrec->data = check_pool_memory_size(data, rec->data_len + 1);
+      memcpy(qrec->data, rec->data, rec->data_len);
+      qrec->VolumeName = NULL;
+   }
+   item = (SCAN_ITEM *)malloc(sizeof(SCAN_ITEM));
+   bmemzero(item, sizeof(SCAN_ITEM));
+   item->mjcr = mjcr;
+   item->rec = qrec;
+   item->FirstIndex = FirstIndex;
+
+   P(scan_mutex);
+   while (qrec && thr->queued > SCAN_QUEUE_SIZE) {
+      pthread_cond_wait(&scan_cond, &scan_mutex);
+   }
+   thr->queue->append(item);
+   if (qrec) {
+      thr->queued += qrec->data_len;
+      scan_pending++;
+   }
+   pthread_cond_broadcast(&scan_cond);
+   V(scan_mutex);
+}
+
+/*
+ * Wait until the catalog threads have done all the records queued,
+ *  the labels change the state shared with them.
+ */
+static void scan_wait_idle()
+{
+   if (!scan_thr) {
+      return;
+   }
+   P(scan_mutex);
+   while (scan_pending > 0) {
+      pthread_cond_wait(&scan_cond, &scan_mutex);
+   }
+   V(scan_mutex);
+}
+
 /*
  * Returns: true  if OK
  *          false if error
@@ -430,12 +614,9 @@ static bool record_cb(DCR *dcr, DEV_RECORD *rec)
    char ec1[30];
    DEVICE *dev = dcr->dev;
    JCR *bjcr = dcr->jcr;
-   DEV_BLOCK *block = dcr->block;
    POOL_MEM sql_buffer;
    db_int64_ctx jmr_count;
 
-   char digest[BASE64_SIZE(CRYPTO_DIGEST_MAX_SIZE)];
-
    if (rec->data_len > 0) {
       mr.VolBytes += rec->data_len + WRITE_RECHDR_LENGTH; /* Accumulate Volume bytes */
       if (showProgress && currentVolumeSize > 0) {
@@ -466,6 +647,7 @@ static bool record_cb(DCR *dcr, DEV_RECORD *rec)
    if (rec->FileIndex < 0) {
       bool save_update_db = update_db;
 
+      scan_wait_idle();
       if (verbose > 1) {
          dump_label_record(dev, rec, 1, false);
       }
@@ -671,7 +853,11 @@ static bool record_cb(DCR *dcr, DEV_RECORD *rec)
          }
          free_dcr(mjcr->read_dcr);
          mjcr->dec_use_count(); /* Decrease reference counter increased by get_jcr_by_session call */
-         free_jcr(mjcr);
+         if (scan_thr) {
+            scan_queue(mjcr, NULL, 0);   /* flush the batch of the job in its thread */
+         } else {
+            free_jcr(mjcr);
+         }
 
          break;
 
@@ -741,9 +927,26 @@ static bool record_cb(DCR *dcr, DEV_RECORD *rec)
       }
       return true;
    }
-   dcr = mjcr->read_dcr;
+   if (scan_thr) {
+      scan_queue(mjcr, rec, dcr->block->FirstIndex);
+      return true;
+   }
+   return catalog_record(mjcr, rec, dcr->block->FirstIndex, attr);
+}
+
+/*
+ * Update the catalog with a record of the Job mjcr
+ *  Returns: true  if OK
+ *           false if error
+ */
+static bool catalog_record(JCR *mjcr, DEV_RECORD *rec, int32_t FirstIndex, ATTR *attr)
+{
+   DCR *dcr = mjcr->read_dcr;
+   char digest[BASE64_SIZE(CRYPTO_DIGEST_MAX_SIZE)];
+   int nfiles;
+
    if (dcr->VolFirstIndex == 0) {
-      dcr->VolFirstIndex = block->FirstIndex;
+      dcr->VolFirstIndex = FirstIndex;
    }
 
    /* File Attributes stream */
@@ -760,13 +963,13 @@ static bool record_cb(DCR *dcr, DEV_RECORD *rec)
          build_attr_output_fnames(bjcr, attr);
          print_ls_output(bjcr, attr);
       }
-      fr.JobId = mjcr->JobId;
-      fr.FileId = 0;
-      num_files++;
-      if (verbose && (num_files & 0x7FFF) == 0) {
+      P(scan_mutex);
+      nfiles = ++num_files;
+      V(scan_mutex);
+      if (verbose && (nfiles & 0x7FFF) == 0) {
          char ed1[30], ed2[30], ed3[30];
          Pmsg3(000, _("%s file records. At addr=%s bytes=%s\n"),
-                     edit_uint64_with_commas(num_files, ed1),
+                     edit_uint64_with_commas(nfiles, ed1),
                      edit_uint64_with_commas(rec->Addr, ed2),
                      edit_uint64_with_commas(mr.VolBytes, ed3));
       }
@@ -837,7 +1040,9 @@ static bool record_cb(DCR *dcr, DEV_RECORD *rec)
       {
          OBJECT_DBR obj_r;
          char *buf = rec->data;
+         P(scan_mutex);
          num_plugin_objects++;
+         V(scan_mutex);
 
          if (!obj_r.parse_plugin_object_string(&buf)) {
             Pmsg0(000, _("Failed to parse plugin object!\n"));
@@ -1070,6 +1275,9 @@ static void bscan_free_jcr(JCR *jcr)
 static int create_file_attributes_record(JCR *mjcr, ATTR *attrs, DEV_RECORD *rec)
 {
    DCR *dcr = mjcr->read_dcr;
+   ATTR_DBR ar;
+
+   bmemset(&ar, 0, sizeof(ar));
    ar.fname = attrs->fname;
    ar.link = attrs->lname;
    ar.ClientId = mjcr->ClientId;
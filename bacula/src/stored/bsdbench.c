@@ -0,0 +1,751 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+*/
+/*
+ *
+ *  Program to benchmark the Storage daemon write path.
+ *
+ *   Synthetic File daemon streams (attributes, data and digest
+ *   records) are written in-process through one DCR per thread
+ *   to any device of the configuration file, and the results are
+ *   printed in JSON so that they can be compared between builds.
+ *
+ *   The data is generated with a fixed seed, two runs with the
+ *   same arguments write exactly the same records.
+ *
+ */
+
+#include "bacula.h"
+#include "stored.h"
+#include "findlib/find.h"
+#include <sys/resource.h>
+
+extern bool parse_sd_config(CONFIG *config, const char *configfile, int exit_code);
+
+/* Size of the pre-generated data the records are taken from */
+#define BENCH_PATTERN_SIZE  (4 * 1024 * 1024)
+#define BENCH_CHUNK         4096
+
+/* One writer, i.e. one job with its own JCR and DCR */
+typedef struct {
+   pthread_t tid;
+   int id;
+   JCR *jcr;
+   DCR *dcr;
+   uint32_t nb_files;                 /* files to write */
+   uint64_t seed;                     /* for the file sizes and data offsets */
+   uint64_t files;                    /* files written */
+   uint64_t records;                  /* records written */
+   uint64_t bytes;                    /* file data bytes written */
+   bhistogram *hist;                  /* write_record() latency */
+   bool ok;
+} BENCH_THREAD;
+
+/* Forward referenced functions */
+static void *bench_thread(void *arg);
+static void bench_free_jcr(JCR *jcr);
+
+/* Global variables */
+static const char *wd = "/tmp";
+static const char *VolumeName = "BenchVol";
+static uint32_t nb_files = 1000;
+static uint64_t min_size = 1024 * 1024;
+static uint64_t max_size = 1024 * 1024;
+static uint32_t rec_size = DEFAULT_NETWORK_BUFFER_SIZE;
+static int compress_pct = 0;
+static int nb_threads = 1;
+static bool with_digest = false;
+static char *pattern = NULL;
+
+static CONFIG *config;
+#define CONFIG_FILE "bacula-sd.conf"
+
+char *configfile = NULL;
+
+/*
+ * The tool never talks to a Director and must not wait for an
+ *  operator, the only Volume used is the one labeled at startup.
+ */
+class BenchAskDirHandler: public BtoolsAskDirHandler
+{
+public:
+   BenchAskDirHandler() {}
+   ~BenchAskDirHandler() {}
+   bool dir_find_next_appendable_volume(DCR *dcr) {
+      return dcr->VolumeName[0] != 0;
+   }
+   bool dir_ask_sysop_to_mount_volume(DCR *dcr, bool /* writing */) {
+      Pmsg2(0, _("Volume \"%s\" is not mounted on device %s.\n"),
+            dcr->VolumeName, dcr->dev->print_name());
+      return false;
+   }
+   bool dir_ask_sysop_to_create_appendable_volume(DCR *dcr) {
+      Pmsg1(0, _("Volume \"%s\" is full.\n"), dcr->VolumeName);
+      return false;
+   }
+};
+
+static void usage()
+{
+   fprintf(stderr, _(
+PROG_COPYRIGHT
+"\n%sVersion: %s (%s)\n\n"
+"Usage: bsdbench [options] <device-name>\n"
+"       -b <size>         use this Maximum Block Size for the device\n"
+"       -c <file>         specify a Storage configuration file\n"
+"       -d <nn>           set debug level to <nn>\n"
+"       -dt               print timestamp in debug output\n"
+"       -f                overwrite the Volume if it exists\n"
+"       -j <nn>           number of concurrent writers (default 1)\n"
+"       -k                keep the Volume at the end\n"
+"       -m                write a MD5 digest record for each file\n"
+"       -n <nn>           number of files to write (default 1000)\n"
+"       -o <file>         write the JSON results to a file\n"
+"       -r <size>         size of the data records (default %d)\n"
+"       -s <size>[:<max>] size of the files (default 1M)\n"
+"       -v                verbose\n"
+"       -V <name>         specify the Volume name (default BenchVol)\n"
+"       -w <dir>          specify working directory (default /tmp)\n"
+"       -z <nn>           percentage of compressible data (default 0)\n"
+"       -?                print this message\n\n"),
+      2022, BDEMO, VERSION, BDATE, DEFAULT_NETWORK_BUFFER_SIZE);
+   exit(1);
+}
+
+/* xorshift64*, fast enough to stay out of the measures */
+static inline uint64_t bench_rand(uint64_t *state)
+{
+   uint64_t x = *state;
+   x ^= x >> 12;
+   x ^= x << 25;
+   x ^= x >> 27;
+   *state = x;
+   return x * 2685821657736338717ULL;
+}
+
+/*
+ * Fill the pattern buffer, in each chunk the first part is random
+ *  and the remaining compress_pct percent is made of zeros.
+ */
+static void fill_pattern()
+{
+   uint64_t state = 0x9E3779B97F4A7C15ULL;
+   int rnd = BENCH_CHUNK - (BENCH_CHUNK * compress_pct) / 100;
+
+   pattern = (char *)bmalloc(BENCH_PATTERN_SIZE + rec_size);
+   for (uint32_t i = 0; i < BENCH_PATTERN_SIZE + rec_size; i += BENCH_CHUNK) {
+      uint32_t len = MIN(BENCH_CHUNK, BENCH_PATTERN_SIZE + rec_size - i);
+      for (uint32_t j = 0; j < len; j += sizeof(uint64_t)) {
+         uint64_t v = (int)j < rnd ? bench_rand(&state) : 0;
+         memcpy(pattern + i + j, &v, MIN(sizeof(v), len - j));
+      }
+   }
+}
+
+static bool get_size_arg(char *str, uint64_t *value)
+{
+   return size_to_uint64(str, strlen(str), value) && *value > 0;
+}
+
+/*
+ * Parse -s <size>[:<max>]
+ */
+static bool get_file_size_arg(char *str)
+{
+   char *p = strchr(str, ':');
+
+   if (p) {
+      *p++ = 0;
+      if (!get_size_arg(p, &max_size)) {
+         return false;
+      }
+   }
+   if (!get_size_arg(str, &min_size)) {
+      return false;
+   }
+   if (!p) {
+      max_size = min_size;
+   }
+   return min_size <= max_size;
+}
+
+/*
+ * The DEVICE is created by setup_jcr(), the block size must be
+ *  changed in the resource before.
+ */
+static bool set_block_size(char *dev_name, uint32_t block_size)
+{
+   DEVRES *device;
+
+   foreach_res(device, R_DEVICE) {
+      if (strcmp(device->hdr.name, dev_name) == 0 ||
+          strcmp(device->device_name, dev_name) == 0) {
+         device->max_block_size = block_size;
+         device->min_block_size = 0;
+         return true;
+      }
+   }
+   return false;
+}
+
+/*
+ * Path of the Volume of a file device, false for the others
+ */
+static bool get_volume_path(DEVICE *dev, POOL_MEM &path)
+{
+   if (!dev->is_file() || dev->is_null()) {
+      return false;
+   }
+   pm_strcpy(path, dev->archive_name());
+   if (!IsPathSeparator(path.c_str()[strlen(path.c_str())-1])) {
+      pm_strcat(path, "/");
+   }
+   pm_strcat(path, VolumeName);
+   return true;
+}
+
+/*
+ * Create the JCR of an additional writer. Everything that goes
+ *  into the session labels is defined like in setup_jcr().
+ */
+static JCR *new_bench_jcr(DCR *main_dcr, int id)
+{
+   JCR *jcr = new_jcr(sizeof(JCR), bench_free_jcr);
+   DCR *dcr;
+
+   jcr->VolSessionId = id + 1;
+   jcr->VolSessionTime = main_dcr->jcr->VolSessionTime;
+   jcr->JobId = 0;
+   jcr->setJobType(JT_CONSOLE);
+   jcr->setJobLevel(L_FULL);
+   jcr->JobStatus = JS_Terminated;
+   jcr->where = bstrdup("");
+   jcr->job_name = get_pool_memory(PM_FNAME);
+   pm_strcpy(jcr->job_name, "Dummy.Job.Name");
+   jcr->client_name = get_pool_memory(PM_FNAME);
+   pm_strcpy(jcr->client_name, "Dummy.Client.Name");
+   bsnprintf(jcr->Job, sizeof(jcr->Job), "bsdbench.%d", id);
+   jcr->fileset_name = get_pool_memory(PM_FNAME);
+   pm_strcpy(jcr->fileset_name, "Dummy.fileset.name");
+   jcr->fileset_md5 = get_pool_memory(PM_FNAME);
+   pm_strcpy(jcr->fileset_md5, "Dummy.fileset.md5");
+
+   jcr->dcr = dcr = new_dcr(jcr, NULL, main_dcr->dev, SD_APPEND);
+   bstrncpy(dcr->VolumeName, main_dcr->VolumeName, sizeof(dcr->VolumeName));
+   bstrncpy(dcr->dev_name, main_dcr->dev_name, sizeof(dcr->dev_name));
+   bstrncpy(dcr->pool_name, main_dcr->pool_name, sizeof(dcr->pool_name));
+   bstrncpy(dcr->pool_type, main_dcr->pool_type, sizeof(dcr->pool_type));
+   return jcr;
+}
+
+static void bench_free_jcr(JCR *jcr)
+{
+   if (jcr->job_name) {
+      free_pool_memory(jcr->job_name);
+      jcr->job_name = NULL;
+   }
+   if (jcr->client_name) {
+      free_pool_memory(jcr->client_name);
+      jcr->client_name = NULL;
+   }
+   if (jcr->fileset_name) {
+      free_pool_memory(jcr->fileset_name);
+      jcr->fileset_name = NULL;
+   }
+   if (jcr->fileset_md5) {
+      free_pool_memory(jcr->fileset_md5);
+      jcr->fileset_md5 = NULL;
+   }
+   if (jcr->dcr) {
+      free_dcr(jcr->dcr);
+      jcr->dcr = NULL;
+   }
+}
+
+/* Print a latency histogram as a JSON object */
+static void print_latency(FILE *fd, const char *name, bhistogram *hist, bool last)
+{
+   fprintf(fd, "  \"%s\": {\n", name);
+   fprintf(fd, "    \"count\": %llu,\n", (unsigned long long)hist->count);
+   fprintf(fd, "    \"mean\": %.1f,\n",
+           hist->count ? (double)hist->sum / hist->count : 0.0);
+   fprintf(fd, "    \"p50\": %llu,\n", (unsigned long long)hist->percentile(0.5));
+   fprintf(fd, "    \"p90\": %llu,\n", (unsigned long long)hist->percentile(0.9));
+   fprintf(fd, "    \"p99\": %llu,\n", (unsigned long long)hist->percentile(0.99));
+   fprintf(fd, "    \"p999\": %llu,\n", (unsigned long long)hist->percentile(0.999));
+   fprintf(fd, "    \"max\": %llu\n", (unsigned long long)hist->max);
+   fprintf(fd, "  }%s\n", last ? "" : ",");
+}
+
+static double tv_to_sec(struct timeval *tv)
+{
+   return tv->tv_sec + tv->tv_usec / 1000000.0;
+}
+
+int main (int argc, char *argv[])
+{
+   int ch;
+   char *dev_name;
+   char *output = NULL;
+   uint64_t block_size = 0;
+   bool force = false;
+   bool keep = false;
+   bool ok = true;
+   JCR *jcr;
+   DCR *dcr;
+   DEVICE *dev;
+   BENCH_THREAD *thr;
+   bhistogram *hist;
+   struct rusage ru_start, ru_end;
+   btime_t start, elapsed;
+   uint64_t vol_bytes, vol_blocks;
+   uint64_t files = 0, records = 0, bytes = 0;
+   double sec, cpu_user, cpu_sys;
+   POOL_MEM path(PM_FNAME);
+   POOLMEM *qbuf;
+   FILE *fd = stdout;
+   BenchAskDirHandler askdir_handler;
+
+   init_askdir_handler(&askdir_handler);
+   setlocale(LC_ALL, "");
+   bindtextdomain("bacula", LOCALEDIR);
+   textdomain("bacula");
+   init_stack_dump();
+
+   my_name_is(argc, argv, "bsdbench");
+   lmgr_init_thread();
+   init_msg(NULL, NULL);
+
+   while ((ch = getopt(argc, argv, "b:c:d:fj:kmn:o:r:s:vV:w:z:?")) != -1) {
+      switch (ch) {
+      case 'b':
+         if (!get_size_arg(optarg, &block_size) || block_size > MAX_BLOCK_LENGTH) {
+            Pmsg1(0, _("Invalid block size \"%s\".\n"), optarg);
+            usage();
+         }
+         break;
+
+      case 'c':                    /* specify config file */
+         if (configfile != NULL) {
+            free(configfile);
+         }
+         configfile = bstrdup(optarg);
+         break;
+
+      case 'd':                    /* debug level */
+         if (*optarg == 't') {
+            dbg_timestamp = true;
+         } else {
+            debug_level = atoi(optarg);
+            if (debug_level <= 0) {
+               debug_level = 1;
+            }
+         }
+         break;
+
+      case 'f':
+         force = true;
+         break;
+
+      case 'j':
+         nb_threads = atoi(optarg);
+         if (nb_threads < 1 || nb_threads > 64) {
+            Pmsg0(0, _("The number of writers must be between 1 and 64.\n"));
+            usage();
+         }
+         break;
+
+      case 'k':
+         keep = true;
+         break;
+
+      case 'm':
+         with_digest = true;
+         break;
+
+      case 'n':
+         nb_files = str_to_uint64(optarg);
+         break;
+
+      case 'o':
+         output = optarg;
+         break;
+
+      case 'r': {
+         uint64_t size;
+         if (!get_size_arg(optarg, &size) || size > MAX_BLOCK_LENGTH) {
+            Pmsg1(0, _("Invalid record size \"%s\".\n"), optarg);
+            usage();
+         }
+         rec_size = (uint32_t)size;
+         break;
+      }
+
+      case 's':
+         if (!get_file_size_arg(optarg)) {
+            Pmsg0(0, _("Invalid file size.\n"));
+            usage();
+         }
+         break;
+
+      case 'v':
+         verbose++;
+         break;
+
+      case 'V':                    /* Volume name */
+         VolumeName = optarg;
+         break;
+
+      case 'w':
+         wd = optarg;
+         break;
+
+      case 'z':
+         compress_pct = atoi(optarg);
+         if (compress_pct < 0 || compress_pct > 100) {
+            Pmsg0(0, _("The compressibility must be between 0 and 100.\n"));
+            usage();
+         }
+         break;
+
+      case '?':
+      default:
+         usage();
+
+      }
+   }
+   argc -= optind;
+   argv += optind;
+
+   if (argc != 1) {
+      Pmsg0(0, _("Wrong number of arguments: \n"));
+      usage();
+   }
+   dev_name = argv[0];
+
+   OSDependentInit();
+
+   working_directory = wd;
+
+   if (configfile == NULL) {
+      configfile = bstrdup(CONFIG_FILE);
+   }
+
+   config = New(CONFIG());
+   parse_sd_config(config, configfile, M_ERROR_TERM);
+   setup_me();
+   load_sd_plugins(me->plugin_directory);
+
+   if (block_size && !set_block_size(dev_name, (uint32_t)block_size)) {
+      Pmsg1(0, _("Cannot find device \"%s\" in config file.\n"), dev_name);
+      exit(1);
+   }
+
+   /* The time spent to write the blocks is measured by the device layer */
+   sdhistograms.block_write = bhist_register("sd_block_write",
+      "The latency of writing a block to a device.");
+   bhist_enable(true);
+
+   /* No Volume name here, it would be added to the list of the read Volumes */
+   jcr = setup_jcr("bsdbench", dev_name, NULL, NULL, SD_APPEND);
+   if (!jcr) {
+      exit(1);
+   }
+   dcr = jcr->dcr;
+   dev = dcr->dev;
+   bstrncpy(dcr->VolumeName, VolumeName, sizeof(dcr->VolumeName));
+
+   if (get_volume_path(dev, path)) {
+      struct stat sp;
+      if (stat(path.c_str(), &sp) == 0) {
+         if (!force) {
+            Pmsg1(0, _("Volume \"%s\" already exists, use -f to overwrite it.\n"),
+                  path.c_str());
+            exit(1);
+         }
+         unlink(path.c_str());
+      }
+   }
+
+   if (dev->is_null()) {
+      /* Nothing can be read back, the Volume is mounted as it is */
+      dev->setVolCatName(VolumeName);
+      if (!dev->open_device(dcr, OPEN_READ_WRITE)) {
+         Pmsg1(0, _("dev open failed: %s\n"), dev->errmsg);
+         exit(1);
+      }
+      bstrncpy(dev->VolHdr.VolumeName, VolumeName, sizeof(dev->VolHdr.VolumeName));
+      dev->set_labeled();
+      dev->set_append();
+
+   } else {
+      /* Label a fresh Volume, then acquire it like a backup job does */
+      if (!dev->write_volume_label(dcr, VolumeName, "Default", false, true)) {
+         Pmsg2(0, _("Cannot label Volume \"%s\" on device %s.\n"), VolumeName,
+               dev->print_name());
+         exit(1);
+      }
+      Dmsg1(10, "Labeled Volume \"%s\".\n", VolumeName);
+      dev->close(dcr);
+   }
+
+   fill_pattern();
+
+   thr = (BENCH_THREAD *)bmalloc(nb_threads * sizeof(BENCH_THREAD));
+   bmemzero(thr, nb_threads * sizeof(BENCH_THREAD));
+   for (int i = 0; i < nb_threads; i++) {
+      thr[i].id = i;
+      thr[i].jcr = i == 0 ? jcr : new_bench_jcr(dcr, i);
+      thr[i].dcr = thr[i].jcr->dcr;
+      thr[i].nb_files = nb_files / nb_threads + (i < (int)(nb_files % nb_threads));
+      thr[i].seed = 0x2545F4914F6CDD1DULL * (i + 1);
+      thr[i].hist = New(bhistogram("bench_write_record",
+                                   "The latency of writing a record."));
+      if (!acquire_device_for_append(thr[i].dcr)) {
+         Pmsg2(0, _("Cannot acquire device %s for append. ERR=%s"),
+               dev->print_name(), thr[i].jcr->errmsg);
+         exit(1);
+      }
+   }
+
+   vol_bytes = dev->VolCatInfo.VolCatBytes;
+   vol_blocks = dev->VolCatInfo.VolCatBlocks;
+   getrusage(RUSAGE_SELF, &ru_start);
+   start = bhist_now();
+
+   for (int i = 0; i < nb_threads; i++) {
+      pthread_create(&thr[i].tid, NULL, bench_thread, &thr[i]);
+   }
+   for (int i = 0; i < nb_threads; i++) {
+      pthread_join(thr[i].tid, NULL);
+   }
+
+   elapsed = bhist_now() - start;
+   getrusage(RUSAGE_SELF, &ru_end);
+   vol_bytes = dev->VolCatInfo.VolCatBytes - vol_bytes;
+   vol_blocks = dev->VolCatInfo.VolCatBlocks - vol_blocks;
+
+   /* Merge the latencies of all the writers */
+   hist = New(bhistogram("bench_write_record", "The latency of writing a record."));
+   for (int i = 0; i < nb_threads; i++) {
+      ok = ok && thr[i].ok;
+      files += thr[i].files;
+      records += thr[i].records;
+      bytes += thr[i].bytes;
+      hist->count += thr[i].hist->count;
+      hist->sum += thr[i].hist->sum;
+      hist->max = MAX(hist->max, thr[i].hist->max);
+      for (int b = 0; b < BHIST_BUCKETS; b++) {
+         hist->buckets[b] += thr[i].hist->buckets[b];
+      }
+   }
+
+   sec = elapsed > 0 ? elapsed / 1000000.0 : 0.000001;
+   cpu_user = tv_to_sec(&ru_end.ru_utime) - tv_to_sec(&ru_start.ru_utime);
+   cpu_sys = tv_to_sec(&ru_end.ru_stime) - tv_to_sec(&ru_start.ru_stime);
+
+   if (output && (fd = bfopen(output, "w")) == NULL) {
+      berrno be;
+      Pmsg2(0, _("Cannot open %s. ERR=%s\n"), output, be.bstrerror());
+      fd = stdout;
+   }
+   qbuf = get_pool_memory(PM_MESSAGE);
+   fprintf(fd, "{\n");
+   fprintf(fd, "  \"version\": %s,\n", quote_string(qbuf, VERSION));
+   fprintf(fd, "  \"device\": %s,\n", quote_string(qbuf, dev->device->hdr.name));
+   fprintf(fd, "  \"archive_device\": %s,\n", quote_string(qbuf, dev->archive_name()));
+   fprintf(fd, "  \"device_type\": %s,\n", quote_string(qbuf, dev->print_type()));
+   fprintf(fd, "  \"volume\": %s,\n", quote_string(qbuf, VolumeName));
+   fprintf(fd, "  \"block_size\": %u,\n", dcr->block->buf_len);
+   fprintf(fd, "  \"record_size\": %u,\n", rec_size);
+   fprintf(fd, "  \"file_size_min\": %llu,\n", (unsigned long long)min_size);
+   fprintf(fd, "  \"file_size_max\": %llu,\n", (unsigned long long)max_size);
+   fprintf(fd, "  \"compressibility\": %d,\n", compress_pct);
+   fprintf(fd, "  \"digest\": %s,\n", with_digest ? "true" : "false");
+   fprintf(fd, "  \"writers\": %d,\n", nb_threads);
+   fprintf(fd, "  \"status\": %s,\n", ok ? "\"OK\"" : "\"Error\"");
+   fprintf(fd, "  \"files\": %llu,\n", (unsigned long long)files);
+   fprintf(fd, "  \"records\": %llu,\n", (unsigned long long)records);
+   fprintf(fd, "  \"bytes\": %llu,\n", (unsigned long long)bytes);
+   fprintf(fd, "  \"volume_bytes\": %llu,\n", (unsigned long long)vol_bytes);
+   fprintf(fd, "  \"blocks\": %llu,\n", (unsigned long long)vol_blocks);
+   fprintf(fd, "  \"elapsed_sec\": %.6f,\n", sec);
+   fprintf(fd, "  \"mb_per_sec\": %.2f,\n", bytes / sec / 1000000.0);
+   fprintf(fd, "  \"volume_mb_per_sec\": %.2f,\n", vol_bytes / sec / 1000000.0);
+   fprintf(fd, "  \"blocks_per_sec\": %.1f,\n", vol_blocks / sec);
+   fprintf(fd, "  \"files_per_sec\": %.1f,\n", files / sec);
+   fprintf(fd, "  \"cpu_user_sec\": %.3f,\n", cpu_user);
+   fprintf(fd, "  \"cpu_sys_sec\": %.3f,\n", cpu_sys);
+   fprintf(fd, "  \"cpu_sec_per_gb\": %.3f,\n",
+           bytes ? (cpu_user + cpu_sys) * 1000000000.0 / bytes : 0.0);
+   print_latency(fd, "record_latency_us", hist, false);
+   print_latency(fd, "block_write_latency_us", bhist_get(sdhistograms.block_write), true);
+   fprintf(fd, "}\n");
+   if (fd != stdout) {
+      fclose(fd);
+   }
+   free_pool_memory(qbuf);
+
+   for (int i = 0; i < nb_threads; i++) {
+      release_device(thr[i].dcr);
+      delete thr[i].hist;
+      if (i > 0) {
+         free_jcr(thr[i].jcr);
+      }
+   }
+   delete hist;
+   free(thr);
+   free(pattern);
+   if (!keep && get_volume_path(dev, path)) {
+      unlink(path.c_str());
+   }
+   free_jcr(jcr);
+   dev->term(NULL);
+   bhist_term();
+
+   return ok ? 0 : 1;
+}
+
+/*
+ * Write the records of one file like the File daemon sends them
+ */
+static bool write_file(BENCH_THREAD *t, DEV_RECORD *rec, uint32_t FileIndex)
+{
+   JCR *jcr = t->jcr;
+   DCR *dcr = t->dcr;
+   POOLMEM *attr = get_pool_memory(PM_MESSAGE);
+   POOLMEM *digest = get_pool_memory(PM_MESSAGE);
+   char attribs[MAXSTRING];
+   struct stat statp;
+   uint64_t size, left;
+   btime_t rec_start;
+   bool ok = false;
+
+   size = min_size;
+   if (max_size > min_size) {
+      size += bench_rand(&t->seed) % (max_size - min_size + 1);
+   }
+
+   bmemzero(&statp, sizeof(statp));
+   statp.st_mode = S_IFREG | 0640;
+   statp.st_nlink = 1;
+   statp.st_size = size;
+   statp.st_mtime = statp.st_ctime = statp.st_atime = jcr->VolSessionTime;
+   encode_stat(attribs, &statp, sizeof(statp), 0, STREAM_FILE_DATA);
+   Mmsg(attr, "%u %d /bsdbench/%d/%u/file%u", FileIndex, FT_REG, t->id,
+        FileIndex / 1000, FileIndex);
+   rec->data_len = strlen(attr) + 1;
+   attr = check_pool_memory_size(attr, rec->data_len + strlen(attribs) + 3);
+   strcpy(attr + rec->data_len, attribs);
+   rec->data_len += strlen(attribs) + 1;
+   attr[rec->data_len++] = 0;         /* no link */
+
+   rec->FileIndex = FileIndex;
+   rec->Stream = rec->maskedStream = STREAM_UNIX_ATTRIBUTES;
+   rec->data = attr;
+   rec_start = bhist_now();
+   if (!dcr->write_record(rec)) {
+      goto bail_out;
+   }
+   t->hist->record(bhist_now() - rec_start);
+   t->records++;
+
+   rec->Stream = rec->maskedStream = STREAM_FILE_DATA;
+   for (left = size; left > 0; ) {
+      rec->data_len = (uint32_t)MIN(left, (uint64_t)rec_size);
+      rec->data = pattern + bench_rand(&t->seed) % BENCH_PATTERN_SIZE;
+      rec_start = bhist_now();
+      if (!dcr->write_record(rec)) {
+         goto bail_out;
+      }
+      t->hist->record(bhist_now() - rec_start);
+      t->records++;
+      left -= rec->data_len;
+   }
+   t->bytes += size;
+   jcr->JobBytes += size;
+
+   if (with_digest) {
+      for (int i = 0; i < 16; i += sizeof(uint64_t)) {
+         uint64_t v = bench_rand(&t->seed);
+         memcpy(digest + i, &v, sizeof(v));
+      }
+      rec->Stream = rec->maskedStream = STREAM_MD5_DIGEST;
+      rec->data = digest;
+      rec->data_len = 16;
+      rec_start = bhist_now();
+      if (!dcr->write_record(rec)) {
+         goto bail_out;
+      }
+      t->hist->record(bhist_now() - rec_start);
+      t->records++;
+   }
+   t->files++;
+   jcr->JobFiles++;
+   ok = true;
+
+bail_out:
+   rec->data = NULL;
+   free_pool_memory(attr);
+   free_pool_memory(digest);
+   return ok;
+}
+
+/*
+ * Write a complete session: begin label, the files, end label
+ */
+static void *bench_thread(void *arg)
+{
+   BENCH_THREAD *t = (BENCH_THREAD *)arg;
+   JCR *jcr = t->jcr;
+   DCR *dcr = t->dcr;
+   DEVICE *dev = dcr->dev;
+   DEV_RECORD *rec;
+   POOLMEM *save_data;
+
+   set_jcr_in_tsd(jcr);
+   rec = new_record();
+   save_data = rec->data;
+   rec->VolSessionId = jcr->VolSessionId;
+   rec->VolSessionTime = jcr->VolSessionTime;
+
+   if (!write_session_label(dcr, SOS_LABEL)) {
+      Pmsg1(0, _("Write session label failed. ERR=%s\n"), dev->bstrerror());
+      goto bail_out;
+   }
+   for (uint32_t i = 1; i <= t->nb_files; i++) {
+      if (!write_file(t, rec, i)) {
+         Pmsg1(0, _("Write record failed. ERR=%s\n"), dev->bstrerror());
+         goto bail_out;
+      }
+   }
+   if (!write_session_label(dcr, EOS_LABEL)) {
+      Pmsg1(0, _("Error writing end session label. ERR=%s\n"), dev->bstrerror());
+      goto bail_out;
+   }
+   if (!dcr->write_final_block_to_device()) {
+      Pmsg1(0, _("Write of last block failed. ERR=%s\n"), dev->bstrerror());
+      goto bail_out;
+   }
+   t->ok = true;
+
+bail_out:
+   rec->data = save_data;
+   free_record(rec);
+   return NULL;
+}
@@ -87,6 +87,7 @@ DEVICE *m_init_dev(JCR *jcr, DEVRES *device, bool adata);
 
 /* To open device readonly when appropriate, like for bls for dedup devices */
 int device_default_open_mode = omd_rdonly;
+sdhistograms_t sdhistograms;
 
 /*
  * Device specific initialization.
@@ -85,6 +85,8 @@ bool fixup_device_block_write_error(DCR *dcr, int retries)
    DEVICE *dev;
    int blocked;              /* save any previous blocked status */
    bool ok = false;
+   bool mounted;
+   btime_t mount_start;
    bool save_adata = dcr->dev->adata;
 
    Enter(100);
@@ -131,7 +133,10 @@ bool fixup_device_block_write_error(DCR *dcr, int retries)
    dcr->VolMediaId = 0;
    dcr->WroteVol = false;
 
-   if (!dcr->mount_next_write_volume()) {
+   mount_start = bhist_start();
+   mounted = dcr->mount_next_write_volume();
+   bhist_record(jcr, sdhistograms.mount_wait, mount_start);
+   if (!mounted) {
       dev->free_dcr_blocks(dcr);
       dcr->block = block;
       dcr->ameta_block = ameta_block;
@@ -75,6 +75,7 @@ static bool upload_cmd(JCR *jcr);
 static bool readlabel_cmd(JCR *jcr);
 static bool release_cmd(JCR *jcr);
 static bool setdebug_cmd(JCR *jcr);
+static bool setbandwidth_cmd(JCR *jcr);
 static bool cancel_cmd(JCR *cjcr);
 static bool mount_cmd(JCR *jcr);
 static bool unmount_cmd(JCR *jcr);
@@ -103,6 +104,7 @@ bool dedup_cmd(JCR *jcr); /* BEEF */
 /* Responses send to Director for storage command */
 static char BADcmd[]  = "2902 Bad %s\n";
 static char OKstore[] = "2000 OK storage\n";
+static char OKBandwidth[] = "2000 OK Bandwidth\n";
 
 /* Commands received from director that need scanning */
 static char storaddr[] = "storage address=%s port=%d ssl=%d Job=%127s Authentication=%127s";
@@ -131,6 +133,7 @@ static struct dir_cmds cmds[] = {
    {"release",     release_cmd,     0},
    {"relabel",     relabel_cmd,     0},     /* relabel a tape */
    {"setdebug=",   setdebug_cmd,    0},     /* set debug level */
+   {"setbandwidth=", setbandwidth_cmd, 0},  /* set bandwidth limit */
    {"status",      status_cmd,      1},
    {".status",     qstatus_cmd,     1},
    {"stop",        cancel_cmd,      0},
@@ -452,6 +455,48 @@ bail_out:
 }
 
 
+/*
+ * Set the bandwidth limit of a running job, of a client or of
+ *  the daemon as requested by the Director
+ */
+static bool setbandwidth_cmd(JCR *jcr)
+{
+   BSOCK *dir = jcr->dir_bsock;
+   char name[MAX_NAME_LENGTH];
+   int64_t bw = 0;
+   bwgroup *group;
+   JCR *cjcr;
+
+   *name = 0;
+   if (sscanf(dir->msg, "setbandwidth=%lld Job=%127s", &bw, name) == 2 && bw >= 0) {
+      if (!(cjcr = get_jcr_by_full_name(name))) {
+         dir->fsend(_("3904 Job %s not found.\n"), name);
+         return true;
+      }
+      if (cjcr->bw_group) {
+         cjcr->bw_group->set_limit(bw);
+      }
+      free_jcr(cjcr);
+
+   } else if (sscanf(dir->msg, "setbandwidth=%lld Client=%127s", &bw, name) == 2 && bw >= 0) {
+      /* Running and future jobs of the Client */
+      unbash_spaces(name);
+      group = bwroot->get_child(name);
+      group->set_limit(bw, true);
+      group->release();
+
+   } else if (sscanf(dir->msg, "setbandwidth=%lld", &bw) == 1 && bw >= 0) {
+      bwroot->set_limit(bw);
+
+   } else {
+      pm_strcpy(jcr->errmsg, dir->msg);
+      dir->fsend(_("3991 Bad setbandwidth command: %s\n"), jcr->errmsg);
+      return false;
+   }
+   Dmsg2(50, "Set bandwidth limit %lld for \"%s\"\n", bw, name);
+   return dir->fsend(OKBandwidth);
+}
+
 /*
  * Set debug level as requested by the Director
  *
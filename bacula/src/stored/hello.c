@@ -108,6 +108,7 @@ bool validate_dir_hello(JCR* jcr)
       return false;
    }
 
+   jcr->DIRVersion = dir_version;
    if (dir_version >= 1 && me->comm_compression) {
       dir->set_compress();
    } else {
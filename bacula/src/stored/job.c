@@ -171,6 +171,24 @@ bool job_cmd(JCR *jcr)
    return true;
 }
 
+/*
+ * Attach the connection with the Client to the bandwidth group of
+ *  the job, the bandwidth of the daemon is shared fairly between the
+ *  clients, and the bandwidth of a client between its jobs.
+ */
+static void attach_bwgroup(JCR *jcr)
+{
+   bwgroup *client;
+
+   if (!bwroot || !jcr->file_bsock || jcr->bw_group) {
+      return;
+   }
+   client = bwroot->get_child(NPRT(jcr->client_name), me->max_bandwidth_per_client);
+   jcr->bw_group = client->get_child(jcr->Job, me->max_bandwidth_per_job);
+   client->release();           /* The job node holds a reference */
+   jcr->file_bsock->set_bwgroup(jcr->bw_group);
+}
+
 bool run_cmd(JCR *jcr)
 {
    struct timeval tv;
@@ -249,6 +267,7 @@ bool run_cmd(JCR *jcr)
 
    if (jcr->authenticated && !job_canceled(jcr) && !jcr->is_incomplete()) {
       Dmsg2(800, "Running jid=%d %p\n", jcr->JobId, jcr);
+      attach_bwgroup(jcr);
       run_job(jcr);                   /* Run the job */
    }
    Dmsg2(800, "Done jid=%d %p\n", jcr->JobId, jcr);
@@ -345,8 +364,16 @@ void stored_free_jcr(JCR *jcr)
       delete jcr->filemedia_queue;
       jcr->filemedia_queue = NULL;
    }
+   if (jcr->attr_batch) {
+      free_pool_memory(jcr->attr_batch);
+      jcr->attr_batch = NULL;
+   }
    free_bsock(jcr->file_bsock);
    free_bsock(jcr->dir_bsock);
+   if (jcr->bw_group) {
+      jcr->bw_group->release();
+      jcr->bw_group = NULL;
+   }
    if (jcr->job_name) {
       free_pool_memory(jcr->job_name);
    }
@@ -366,6 +393,7 @@ void stored_free_jcr(JCR *jcr)
    }
    /* Free any restore volume list created */
    free_restore_volume_list(jcr);
+   vref_free(jcr);
    if (jcr->RestoreBootstrap) {
       unlink(jcr->RestoreBootstrap);
       bfree_and_null(jcr->RestoreBootstrap);
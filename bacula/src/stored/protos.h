@@ -48,9 +48,11 @@ bool    dir_update_volume_info(DCR *dcr, bool label, bool update_LastWritten,
 bool    dir_ask_sysop_to_create_appendable_volume(DCR *dcr);
 bool    dir_ask_sysop_to_mount_volume(DCR *dcr, bool read_access);
 bool    dir_update_file_attributes(DCR *dcr, DEV_RECORD *rec);
+bool    dir_flush_file_attributes(JCR *jcr);
 bool    dir_create_jobmedia_record(DCR *dcr, bool zero=false);
 void    create_jobmedia_queue(JCR *jcr);
-bool    flush_jobmedia_queue(JCR *jcr);
+bool    flush_jobmedia_queue(JCR *jcr, bool wait=true);
+bool    wait_jobmedia_acks(JCR *jcr);
 bool    dir_update_device(JCR *jcr, DEVICE *dev);
 bool    dir_update_changer(JCR *jcr, AUTOCHANGER *changer);
 bool    dir_create_filemedia_record(DCR *dcr);
@@ -292,6 +294,15 @@ extern  int vol_list_lock_count;
 void    add_read_volume(JCR *jcr, const char *VolumeName);
 void    remove_read_volume(JCR *jcr, const char *VolumeName);
 
+/* From vref.c */
+void     vref_init_write(JCR *jcr);
+int      vref_fold_record(DCR *dcr, DEV_RECORD *rec);
+bool     vref_flush(JCR *jcr);
+uint64_t vref_copy_reference(JCR *jcr, DEV_RECORD *rec);
+bool     vref_create_jobmedia(JCR *jcr);
+bool     vref_expand(DCR *dcr, DEV_RECORD *rec,
+                     bool record_cb(DCR *dcr, DEV_RECORD *rec));
+void     vref_free(JCR *jcr);
 
 /* From spool.c */
 bool    begin_data_spool          (DCR *dcr);
@@ -301,6 +312,7 @@ bool    are_attributes_spooled    (JCR *jcr);
 bool    begin_attribute_spool     (JCR *jcr);
 bool    discard_attribute_spool   (JCR *jcr);
 bool    commit_attribute_spool    (JCR *jcr);
+bool    checkpoint_attribute_spool(DCR *dcr);
 bool    write_block_to_spool_file (DCR *dcr);
 void    list_spool_stats          (void sendit(const char *msg, int len, void *sarg), void *arg);
 
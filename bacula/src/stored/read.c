@@ -86,6 +86,11 @@ bool do_read_data(JCR *jcr)
    jcr->run_time = time(NULL);
    jcr->JobFiles = 0;
 
+   /* Coalesce the small records, the dedup flow control needs direct writes */
+   if (!jcr->dedup) {
+      fd->set_buffered(dcr->device->max_network_buffer_size, BNET_SETBUF_WRITE);
+   }
+
    if (jcr->is_JobType(JT_MIGRATE) || jcr->is_JobType(JT_COPY)) {
       ok = read_records(dcr, mac_record_cb, mount_next_read_volume);
    } else {
@@ -122,12 +127,14 @@ bool do_read_data(JCR *jcr)
 
    /* Send end of data to FD */
    fd->signal(BNET_EOD);
+   fd->clear_buffered(BNET_SETBUF_WRITE);
 
    dcr->dev->free_dedup_rehydration_interface(dcr);
 
    if (!release_device(jcr->read_dcr)) {
       ok = false;
    }
+   vref_free(jcr);
 
    Dmsg0(30, "Done reading.\n");
    return ok;
@@ -146,6 +153,10 @@ static bool read_record_cb(DCR *dcr, DEV_RECORD *rec)
    if (rec->FileIndex < 0) {
       return true;
    }
+   /* Send the data referenced by a Virtual Full */
+   if (rec->maskedStream == STREAM_EXTENT_REFERENCE) {
+      return vref_expand(dcr, rec, read_record_cb);
+   }
 
    /* Do rehydration */
    if (rec->Stream & STREAM_BIT_DEDUPLICATION_DATA) {
@@ -271,6 +282,10 @@ static bool mac_record_cb(DCR *dcr, DEV_RECORD *rec)
       Dmsg1(100, "FileIndex=%d\n", rec->FileIndex);
       return true;
    }
+   /* Copy the data referenced by a Virtual Full */
+   if (rec->maskedStream == STREAM_EXTENT_REFERENCE) {
+      return vref_expand(dcr, rec, mac_record_cb);
+   }
 
    if (rec->Stream & STREAM_BIT_DEDUPLICATION_DATA) {
       if (jcr->dedup==NULL) {  // aka dcr->dev->dev_type!=B_DEDUP_DEV
@@ -161,6 +161,8 @@ const char *stream_to_ascii(char *buf, int stream, int fi)
          return "contADATA-BLOCK-HEADER";
       case STREAM_ADATA_RECORD_HEADER:
          return "contADATA-RECORD-HEADER";
+      case STREAM_EXTENT_REFERENCE:
+         return "contEXTENT-REFERENCE";
 
       default:
          sprintf(buf, "%d", -stream);
@@ -239,6 +241,8 @@ const char *stream_to_ascii(char *buf, int stream, int fi)
       return "ADATA-BLOCK-HEADER";
    case STREAM_ADATA_RECORD_HEADER:
       return "ADATA-RECORD-HEADER";
+   case STREAM_EXTENT_REFERENCE:
+      return "EXTENT-REFERENCE";
    default:
       sprintf(buf, "%d", stream);
       return buf;
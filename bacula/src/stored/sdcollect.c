@@ -78,6 +78,10 @@ void initialize_statcollector()
    sdstatmetrics.bacula_storage_memory_smbytes =
          statcollector->registration(met.c_str(), METRIC_INT, METRIC_UNIT_BYTE,
             "The allocated memory size.");
+   /* latency histograms */
+   sdhistograms.block_write = bhist_register("sd_block_write", "The latency of writing a block to a device.");
+   sdhistograms.despool = bhist_register("sd_despool", "The duration of despooling the job data to a device.");
+   sdhistograms.mount_wait = bhist_register("sd_mount_wait", "The wait for a Volume to be mounted or labeled for append.");
    // statcollector->dump();
 };
 
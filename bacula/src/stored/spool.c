@@ -38,6 +38,12 @@ static ssize_t write_spool_header(DCR *dcr, ssize_t *expected);
 static ssize_t write_spool_data(DCR *dcr, ssize_t *expected);
 static ssize_t write_spool_filemedia(DCR *dcr, ssize_t *expected);
 static bool write_spool_block(DCR *dcr);
+static bool send_attr_checkpoint(JCR *jcr, int32_t FileIndex);
+
+/* Director version that accepts the attribute spool checkpoints */
+static const int32_t attr_checkpoint_dir_version = 10004;
+/* Attributes spooled between two checkpoints when the data is not spooled */
+static const int64_t attr_checkpoint_size = 32 * 1024 * 1024;
 
 struct spool_stats_t {
    uint32_t data_jobs;                /* current jobs spooling data */
@@ -190,6 +196,7 @@ static bool despool_data(DCR *dcr, bool commit)
    JCR *jcr = dcr->jcr;
    int stat;
    char ec1[50];
+   btime_t hist_start = bhist_start();
 
    Dmsg0(100, "Despooling data\n");
    if (jcr->dcr->job_spool_size == 0) {
@@ -283,7 +290,7 @@ static bool despool_data(DCR *dcr, bool commit)
          dcr->getVolCatName(), jcr->Job);
       jcr->forceJobStatus(JS_FatalError);  /* override any Incomplete */
    }
-   flush_jobmedia_queue(jcr);
+   flush_jobmedia_queue(jcr, false);
    /* Set new file/block parameters for current dcr */
    set_new_file_parameters(dcr);
 
@@ -343,7 +350,12 @@ static bool despool_data(DCR *dcr, bool commit)
    if (!commit) {
       dcr->dev->dunblock();
    }
+   /* The files before the block being spooled are now on the Volume */
+   if (ok && !commit && !is_block_empty(block)) {
+      send_attr_checkpoint(jcr, block->FirstIndex);
+   }
    jcr->sendJobStatus(JS_Running);
+   bhist_record(jcr, sdhistograms.despool, hist_start);
    return ok;
 }
 
@@ -688,9 +700,10 @@ static void make_unique_spool_filename(JCR *jcr, POOLMEM **name, int fd)
  * Tell Director where to find the attributes spool file
  *  Note, if we are not on the same machine, the Director will
  *  return an error, and the higher level routine will transmit
- *  the data record by record -- using bsock->despool().
+ *  the data record by record -- using bsock->despool(). The
+ *  Director may have stored the records before *start already.
  */
-static bool blast_attr_spool_file(JCR *jcr, boffset_t size)
+static bool blast_attr_spool_file(JCR *jcr, boffset_t size, boffset_t *start)
 {
    /* send full spool file name */
    POOLMEM *name  = get_pool_memory(PM_MESSAGE);
@@ -699,6 +712,10 @@ static bool blast_attr_spool_file(JCR *jcr, boffset_t size)
    jcr->dir_bsock->fsend("BlastAttr JobId=%d File=%s\n", jcr->JobId, name);
    free_pool_memory(name);
 
+   if (!wait_jobmedia_acks(jcr)) {
+      jcr->forceJobStatus(JS_FatalError);  /* override any Incomplete */
+      return false;
+   }
    if (jcr->dir_bsock->recv() <= 0) {
       Jmsg(jcr, M_FATAL, 0, _("Network error on BlastAttributes.\n"));
       jcr->forceJobStatus(JS_FatalError);  /* override any Incomplete */
@@ -706,14 +723,87 @@ static bool blast_attr_spool_file(JCR *jcr, boffset_t size)
    }
 
    if (!bstrcmp(jcr->dir_bsock->msg, "1000 OK BlastAttr\n")) {
+      int64_t pos;
+      if (sscanf(jcr->dir_bsock->msg, "1990 ERROR BlastAttr Pos=%lld", &pos) == 1 &&
+          pos > 0 && pos <= size) {
+         Dmsg1(100, "Director stored the attributes up to %lld\n", pos);
+         *start = pos;
+      }
       return false;
    }
    return true;
 }
 
+/*
+ * Tell the Director that the spooled attributes of the files before
+ *  FileIndex can go to the catalog while the Job is running. The data
+ *  of these files is on the Volume and their JobMedia records were sent.
+ *  The Director does not answer, it reads the spool file up to its
+ *  current size in the background and keeps a checkpoint of its position.
+ *  If it cannot open the file, everything is sent at commit time.
+ */
+static bool send_attr_checkpoint(JCR *jcr, int32_t FileIndex)
+{
+   BSOCK *dir = jcr->dir_bsock;
+   boffset_t size;
+   POOLMEM *name;
+   char ed1[50];
+   bool ok;
+
+   if (!are_attributes_spooled(jcr) || FileIndex <= 0 ||
+       jcr->DIRVersion < attr_checkpoint_dir_version) {
+      return true;
+   }
+   if (fflush(dir->m_spool_fd) != 0) {
+      berrno be;
+      Jmsg(jcr, M_ERROR, 0, _("Flush of attributes file failed: ERR=%s\n"),
+           be.bstrerror());
+      return false;
+   }
+   size = ftello(dir->m_spool_fd);
+   if (size <= jcr->attr_checkpoint) {
+      return true;                    /* nothing new */
+   }
+   name = get_pool_memory(PM_MESSAGE);
+   make_unique_spool_filename(jcr, &name, dir->m_fd);
+   bash_spaces(name);
+   ok = dir->fsend("BlastAttr JobId=%d File=%s Size=%s Index=%d\n", jcr->JobId,
+                   name, edit_int64(size, ed1), FileIndex);
+   free_pool_memory(name);
+   Dmsg2(100, "Attribute spool checkpoint size=%s FI=%d\n", ed1, FileIndex);
+   jcr->attr_checkpoint = size;
+   return ok;
+}
+
+/*
+ * Called after the attributes of a file are spooled. When the data
+ *  goes directly to the Volume, a checkpoint is sent every
+ *  attr_checkpoint_size bytes of attributes, the JobMedia of the blocks
+ *  written so far go first. With data spooling, the checkpoint is sent
+ *  when the data is despooled.
+ */
+bool checkpoint_attribute_spool(DCR *dcr)
+{
+   JCR *jcr = dcr->jcr;
+
+   if (dcr->spooling || !are_attributes_spooled(jcr) ||
+       jcr->DIRVersion < attr_checkpoint_dir_version ||
+       is_block_empty(dcr->block)) {
+      return true;
+   }
+   if (ftello(jcr->dir_bsock->m_spool_fd) - jcr->attr_checkpoint < attr_checkpoint_size) {
+      return true;
+   }
+   if (!dir_create_jobmedia_record(dcr) || !flush_jobmedia_queue(jcr, false)) {
+      return false;
+   }
+   set_new_file_parameters(dcr);
+   return send_attr_checkpoint(jcr, dcr->block->FirstIndex);
+}
+
 bool commit_attribute_spool(JCR *jcr)
 {
-   boffset_t size, data_end;
+   boffset_t size, data_end, start = 0;
    char ec1[30];
    char tbuf[100];
    BSOCK *dir;
@@ -763,11 +853,11 @@ bool commit_attribute_spool(JCR *jcr)
       Jmsg(jcr, M_INFO, 0, _("Sending spooled attrs to the Director. Despooling %s bytes ...\n"),
             edit_uint64_with_commas(size, ec1));
 
-      if (!blast_attr_spool_file(jcr, size)) {
+      if (!blast_attr_spool_file(jcr, size, &start)) {
          /* Can't read spool file from director side,
           * send content over network.
           */
-         dir->despool(update_attr_spool_size, size);
+         dir->despool(update_attr_spool_size, size, start);
       }
       return close_attr_spool_file(jcr, dir);
    }
@@ -795,6 +885,7 @@ static bool open_attr_spool_file(JCR *jcr, BSOCK *bs)
    P(mutex);
    spool_stats.attr_jobs++;
    V(mutex);
+   jcr->attr_checkpoint = 0;
    free_pool_memory(name);
    return true;
 }
@@ -817,7 +908,13 @@ static bool close_attr_spool_file(JCR *jcr, BSOCK *bs)
    V(mutex);
    make_unique_spool_filename(jcr, &name, bs->m_fd);
    fclose(bs->m_spool_fd);
-   unlink(name);
+   if (jcr->attr_checkpoint > 0 && bs->is_error()) {
+      /* A restarted Director continues from its checkpoint */
+      Jmsg(jcr, M_WARNING, 0, _("Connection to the Director lost. Keeping attribute spool file %s\n"),
+           name);
+   } else {
+      unlink(name);
+   }
    free_pool_memory(name);
    bs->m_spool_fd = NULL;
    bs->clear_spooling();
@@ -52,6 +52,7 @@ static void list_status_header(STATUS_PKT *sp);
 static void list_devices(STATUS_PKT *sp, char *name=NULL);
 static void list_plugins(STATUS_PKT *sp);
 static void list_cloud_transfers(STATUS_PKT *sp, bool verbose);
+static void list_bandwidth(STATUS_PKT *sp);
 static void list_collectors_status(STATUS_PKT *sp, char *collname);
 static void api_collectors_status(STATUS_PKT *sp, char *collname);
 
@@ -103,6 +104,11 @@ void output_status(STATUS_PKT *sp)
     */
    list_running_jobs(sp);
 
+   /*
+    * List bandwidth groups
+    */
+   list_bandwidth(sp);
+
    /*
     * List jobs stuck in reservation system
     */
@@ -535,6 +541,30 @@ static void list_cloud_transfers(STATUS_PKT *sp, bool verbose)
    }
 }
 
+/*
+ * Display the bandwidth used by the clients and the jobs when
+ *  the bandwidth of the daemon is shared
+ */
+static void list_bandwidth(STATUS_PKT *sp)
+{
+   POOL_MEM msg(PM_MESSAGE);
+   int len;
+
+   if (sp->api || !bwroot) {
+      return;
+   }
+   if (bwroot->get_limit() == 0 && me->max_bandwidth_per_client == 0 &&
+       me->max_bandwidth_per_job == 0)
+   {
+      return;
+   }
+   len = Mmsg(msg, _("Bandwidth groups:\n"));
+   sendit(msg, len, sp);
+   bwroot->get_status(msg.handle());
+   sendit(msg, strlen(msg.c_str()), sp);
+   sendit("====\n\n", 6, sp);
+}
+
 static void api_list_sd_status_header(STATUS_PKT *sp)
 {
    char *p;
@@ -1178,6 +1208,8 @@ bool qstatus_cmd(JCR *jcr)
    } else if (strcasecmp(cmd, "devices") == 0) {
        sp.api = api;
        list_devices(&sp, device);
+   } else if (strcasecmp(cmd, "bandwidth") == 0) {
+       list_bandwidth(&sp);
    } else if (strcasecmp(cmd, "volumes") == 0) {
        sp.api = api;
        list_volumes(sendit, &sp);
@@ -1203,6 +1235,12 @@ bool qstatus_cmd(JCR *jcr)
    } else if (strcasecmp(cmd, "statistics") == 0) {
       sp.api = api;
       list_collectors_status(&sp, collname);
+   } else if (strcasecmp(cmd, "memory") == 0) {
+      list_memory_status(&sp);  /* defined in lib/status.h */
+   } else if (strcasecmp(cmd, "lockmgr") == 0 ||
+              strcasecmp(cmd, "lockmgrandzerostats") == 0) {
+      /* defined in lib/status.h */
+      list_lockmgr_status(&sp, strcasecmp(cmd, "lockmgrandzerostats") == 0);
    } else {
       pm_strcpy(jcr->errmsg, dir->msg);
       dir->fsend(_("3900 Unknown arg in .status command: %s\n"), jcr->errmsg);
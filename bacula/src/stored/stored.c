@@ -54,6 +54,7 @@ char OK_msg[]   = "3000 OK\n";
 char TERM_msg[] = "3999 Terminate\n";
 static bool test_config = false;
 bstatcollect *statcollector = NULL;
+bwgroup *bwroot = NULL;               /* Bandwidth shared by all the jobs */
 sdstatmetrics_t sdstatmetrics;
 
 static uint32_t VolSessionId = 0;
@@ -304,6 +305,9 @@ int main (int argc, char *argv[])
    /* initialize a statistics collector */
    initialize_statcollector();
 
+   /* Root of the bandwidth groups (daemon -> client -> job) */
+   bwroot = New(bwgroup(me->hdr.name, me->max_bandwidth));
+
    cleanup_old_files();
 
    /* Ensure that Volume Session Time and Id are both
@@ -925,6 +929,11 @@ void terminate_stored(int sig)
       // statcollector->dump();
       delete(statcollector);
    }
+   bhist_term();
+   if (bwroot) {
+      delete bwroot;
+      bwroot = NULL;
+   }
    term_msg();
    cleanup_crypto();
    term_reservations_lock();
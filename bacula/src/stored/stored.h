@@ -114,6 +114,13 @@ typedef struct {
    int bacula_storage_memory_smbytes;
 } sdstatmetrics_t;
 
+/* latency histograms, see bhistogram.h, registered by the Storage Daemon only */
+typedef struct {
+   int block_write;
+   int despool;
+   int mount_wait;
+} sdhistograms_t;
+
 /* Daemon globals from stored.c */
 extern STORES *me;                    /* "Global" daemon resource */
 extern bool forge_on;                 /* proceed inspite of I/O errors */
@@ -121,6 +128,8 @@ extern pthread_mutex_t device_release_mutex;
 extern pthread_cond_t wait_device_release; /* wait for any device to be released */
 extern bool update_permanent_stats(void *data);
 extern bstatcollect *statcollector;
+extern bwgroup *bwroot;
 extern sdstatmetrics_t sdstatmetrics;
+extern sdhistograms_t sdhistograms;    /* in dev.c */
 
 #endif /* __STORED_H_ */
@@ -93,6 +93,10 @@ static RES_ITEM store_items[] = {
    {"TlsAllowedCn",          store_alist_str, ITEM(res_store.tls_allowed_cns), 0, 0, 0},
    {"ClientConnectWait",     store_time,  ITEM(res_store.client_wait), 0, ITEM_DEFAULT, 30 * 60},
    {"VerId",                 store_str,   ITEM(res_store.verid), 0, 0, 0},
+   {"MaximumBandwidth",      store_speed, ITEM(res_store.max_bandwidth), 0, 0, 0},
+   {"MaximumBandwidthPerClient", store_speed, ITEM(res_store.max_bandwidth_per_client), 0, 0, 0},
+   {"MaximumBandwidthPerJob", store_speed, ITEM(res_store.max_bandwidth_per_job), 0, 0, 0},
+   {"MaximumVolumeReaders",  store_pint32, ITEM(res_store.max_volume_readers), 0, ITEM_DEFAULT, 4},
    {"CommCompression",       store_bool,  ITEM(res_store.comm_compression), 0, ITEM_DEFAULT, true},
 #ifdef SD_DEDUP_SUPPORT
    {"DedupDirectory",        store_dir,   ITEM(res_store.dedup_dir),  0, 0, 0},
@@ -159,6 +163,7 @@ static RES_ITEM dev_items[] = {
    {"Enabled",               store_bool, ITEM(res_dev.enabled), 0, ITEM_DEFAULT, 1},
    {"AutoSelect",            store_bool, ITEM(res_dev.autoselect), 0, ITEM_DEFAULT, 1},
    {"ReadOnly",              store_bool, ITEM(res_dev.read_only), 0, ITEM_DEFAULT, 0},
+   {"VirtualFullReferences", store_bool, ITEM(res_dev.vf_references), 0, ITEM_DEFAULT, 0},
    {"ChangerDevice",         store_strname,ITEM(res_dev.changer_name), 0, 0, 0},
    {"ControlDevice",         store_strname,ITEM(res_dev.control_name), 0, 0, 0},
    {"ChangerCommand",        store_strname,ITEM(res_dev.changer_command), 0, 0, 0},
@@ -591,6 +596,10 @@ static void dump_store_resource(STORES *store,
                  OT_BOOL,     "TLSVerifyPeer", store->tls_verify_peer,
                  OT_INT64,    "ClientConnectWait", store->client_wait,
                  OT_STRING,   "VerId", store->verid,
+                 OT_INT64,    "MaximumBandwidth", store->max_bandwidth,
+                 OT_INT64,    "MaximumBandwidthPerClient", store->max_bandwidth_per_client,
+                 OT_INT64,    "MaximumBandwidthPerJob", store->max_bandwidth_per_job,
+                 OT_INT32,    "MaximumVolumeReaders", store->max_volume_readers,
                  OT_BOOL,     "CommCommpression", store->comm_compression,
 #ifdef SD_DEDUP_SUPPORT
                  OT_STRING,   "DedupDirectory", store->dedup_dir,
@@ -168,6 +168,10 @@ public:
    utime_t ClientConnectTimeout;      /* Max time to wait to connect client */
    utime_t heartbeat_interval;        /* Interval to send hb to FD */
    utime_t client_wait;               /* Time to wait for FD to connect */
+   int64_t max_bandwidth;             /* Bandwidth limit for all the clients */
+   int64_t max_bandwidth_per_client;  /* Bandwidth limit for each client */
+   int64_t max_bandwidth_per_job;     /* Bandwidth limit for each job */
+   uint32_t max_volume_readers;       /* Volumes read in parallel by a vbackup */
    bool comm_compression;             /* Set to allow comm line compression */
    bool require_fips;                  /* Check for FIPS module */
    bool tls_authenticate;             /* Authenticate with TLS */
@@ -223,6 +227,7 @@ public:
    bool enabled;                      /* Set when enabled (default) */
    bool autoselect;                   /* Automatically select from AutoChanger */
    bool read_only;                    /* Drive is read only */
+   bool vf_references;                /* Virtual Full references older disk Volumes */
    uint32_t drive_index;              /* Autochanger drive index */
    uint32_t cap_bits;                 /* Capabilities of this device */
    utime_t max_changer_wait;          /* Changer timeout */
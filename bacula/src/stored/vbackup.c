@@ -32,6 +32,47 @@ extern char Job_end[];
 /* Forward referenced subroutines */
 static bool record_cb(DCR *dcr, DEV_RECORD *rec);
 
+/*
+ * When the read device is a simple disk device, the sessions found in
+ *  the BSR (a run of BSR entries with the same VolSessionId/VolSessionTime)
+ *  are read by separate threads, each one on a clone of the read device.
+ *  The records are queued and handed to record_cb() in the BSR order by
+ *  the job thread, so the result is the same as read_records().
+ */
+#define VREAD_QUEUE_SIZE (8 * 1024 * 1024) /* bytes queued by a reader */
+
+struct VREAD_CTX;
+
+struct VREAD_GROUP {
+   VREAD_CTX *ctx;
+   BSR *bsr;                          /* first bsr of the session */
+   BSR *last;                         /* last bsr of the session */
+   dlist *queue;                      /* records read, not yet written */
+   int64_t queued;                    /* bytes in the queue */
+   pthread_t tid;
+   bool started;                      /* reader thread created */
+   bool done;                         /* reader thread finished */
+   bool error;                        /* reader thread failed */
+   POOLMEM *errmsg;
+   uint32_t last_VolSessionId;        /* FileIndex sequencing for record_cb() */
+   uint32_t last_VolSessionTime;
+   int32_t  last_FileIndex;
+};
+
+struct VREAD_CTX {
+   JCR *jcr;
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;
+   VREAD_GROUP *groups;
+   int ngroups;
+   int nreaders;                      /* sessions read at the same time */
+   bool quit;                         /* tell the readers to stop */
+};
+
+static VREAD_CTX *new_vread_ctx(JCR *jcr);
+static bool vread_records(VREAD_CTX *ctx);
+static void free_vread_ctx(VREAD_CTX *ctx);
+
 /*
  *  Read Data and send to File Daemon
  *   Returns: false on failure
@@ -44,6 +85,7 @@ bool do_vbackup(JCR *jcr)
    const char *Type;
    char ec1[50];
    DEVICE *dev;
+   VREAD_CTX *vctx;
 
    switch(jcr->getJobType()) {
    case JT_MIGRATE:
@@ -109,7 +151,16 @@ bool do_vbackup(JCR *jcr)
    jcr->JobFiles = 0;
    jcr->dcr->set_ameta();
    jcr->read_dcr->set_ameta();
-   ok = read_records(jcr->read_dcr, record_cb, mount_next_read_volume);
+   vref_init_write(jcr);
+   if ((vctx = new_vread_ctx(jcr)) != NULL) {
+      ok = vread_records(vctx);
+      free_vread_ctx(vctx);
+   } else {
+      ok = read_records(jcr->read_dcr, record_cb, mount_next_read_volume);
+   }
+   if (ok && !vref_flush(jcr)) {
+      ok = false;
+   }
    goto ok_out;
 
 bail_out:
@@ -141,6 +192,9 @@ ok_out:
          }
          Dmsg2(200, "Flush block to device pos %u:%u\n", dev->file, dev->block_num);
       }
+      if (ok && !vref_create_jobmedia(jcr)) {
+         ok = false;
+      }
       flush_jobmedia_queue(jcr);
       if (!ok) {
          discard_data_spool(jcr->dcr);
@@ -178,6 +232,7 @@ ok_out:
          ok = false;
       }
    }
+   vref_free(jcr);
 
    jcr->sendJobStatus();              /* update director */
 
@@ -214,6 +269,7 @@ static bool record_cb(DCR *dcr, DEV_RECORD *rec)
    bool     restoredatap = false;
    POOLMEM *orgdata = NULL;
    uint32_t orgdata_len = 0;
+   uint64_t vref_bytes = 0;
    bool ret = false;
 
    /* If label and not for us, discard it */
@@ -230,6 +286,14 @@ static bool record_cb(DCR *dcr, DEV_RECORD *rec)
       ret = true;                    /* don't write vol labels */
       goto bail_out;
    }
+   /* Copy the data referenced, unless we write references too */
+   if (rec->maskedStream == STREAM_EXTENT_REFERENCE && rec->FileIndex > 0) {
+      vref_bytes = vref_copy_reference(jcr, rec);
+      if (vref_bytes == 0) {
+         ret = vref_expand(dcr, rec, record_cb);
+         goto bail_out;
+      }
+   }
 
    /*
     * For normal migration jobs, FileIndex values are sequential because
@@ -252,6 +316,15 @@ static bool record_cb(DCR *dcr, DEV_RECORD *rec)
       rec->FileIndex = jcr->JobFiles;     /* set sequential output FileIndex */
    }
 
+   switch (vref_fold_record(dcr, rec)) {
+   case 1:
+      jcr->JobBytes += rec->data_len;  /* referenced, not written */
+      ret = true;
+      goto bail_out;
+   case -1:
+      goto bail_out;
+   }
+
    /* TODO: If user really wants to do rehydrate the data, we should propose
     * this option.
     */
@@ -307,7 +380,8 @@ static bool record_cb(DCR *dcr, DEV_RECORD *rec)
       ret = true;                    /* don't send LABELs to Dir */
       goto bail_out;
    }
-   jcr->JobBytes += rec->data_len;   /* increment bytes this job */
+   /* increment bytes this job, a reference counts for the data referenced */
+   jcr->JobBytes += vref_bytes > 0 ? vref_bytes : rec->data_len;
    Dmsg5(500, "wrote_record JobId=%d FI=%s SessId=%d Strm=%s len=%d\n",
       jcr->JobId,
       FI_to_ascii(buf1, rec->FileIndex), rec->VolSessionId,
@@ -323,3 +397,382 @@ bail_out:
    }
    return ret;
 }
+
+
+static bool same_session(BSR *a, BSR *b)
+{
+   return a->sessid->sessid == b->sessid->sessid &&
+          a->sesstime->sesstime == b->sesstime->sesstime;
+}
+
+/*
+ * Split the job bsr into sessions that can be read in parallel
+ *   Returns: NULL if the Volumes must be read one after the other
+ */
+static VREAD_CTX *new_vread_ctx(JCR *jcr)
+{
+   DCR *dcr = jcr->read_dcr;
+   VREAD_CTX *ctx;
+   VREAD_GROUP *grp = NULL;
+   DEV_RECORD *rec = NULL;
+   VOL_LIST *vol;
+   BSR *bsr, *prev, *b;
+   int ngroups = 0, i;
+
+   if (me->max_volume_readers < 2 || !jcr->bsr || jcr->NumReadVolumes < 2) {
+      return NULL;
+   }
+   /* Clones of the device must be able to open the Volumes directly */
+   if (dcr->dev->dev_type != B_FILE_DEV || dcr->dev->requires_mount() ||
+       (dcr->device->changer_command && !dcr->is_virtual_autochanger())) {
+      return NULL;
+   }
+   for (vol=jcr->VolList; vol; vol=vol->next) {
+      if (strcmp(vol->MediaType, dcr->device->media_type) != 0) {
+         return NULL;                 /* the read device changes during the job */
+      }
+   }
+   for (prev=NULL, bsr=jcr->bsr; bsr; prev=bsr, bsr=bsr->next) {
+      if (!bsr->volume || bsr->volume->next ||
+          !bsr->sessid || bsr->sessid->next ||
+          bsr->sessid->sessid != bsr->sessid->sessid2 ||
+          !bsr->sesstime || bsr->sesstime->next) {
+         return NULL;
+      }
+      if (prev && same_session(prev, bsr)) {
+         continue;
+      }
+      /* A session must be in a single run of bsrs */
+      for (b=jcr->bsr; b != bsr; b=b->next) {
+         if (same_session(b, bsr)) {
+            return NULL;
+         }
+      }
+      ngroups++;
+   }
+   if (ngroups < 2) {
+      return NULL;
+   }
+
+   ctx = (VREAD_CTX *)malloc(sizeof(VREAD_CTX));
+   bmemzero(ctx, sizeof(VREAD_CTX));
+   ctx->jcr = jcr;
+   ctx->nreaders = MIN((int)me->max_volume_readers, ngroups);
+   ctx->ngroups = ngroups;
+   ctx->groups = (VREAD_GROUP *)malloc(ngroups * sizeof(VREAD_GROUP));
+   bmemzero(ctx->groups, ngroups * sizeof(VREAD_GROUP));
+   pthread_mutex_init(&ctx->mutex, NULL);
+   pthread_cond_init(&ctx->cond, NULL);
+
+   i = -1;
+   for (prev=NULL, bsr=jcr->bsr; bsr; prev=bsr, bsr=bsr->next) {
+      if (!prev || !same_session(prev, bsr)) {
+         grp = &ctx->groups[++i];
+         grp->ctx = ctx;
+         grp->bsr = bsr;
+         grp->queue = New(dlist(rec, &rec->link));
+         grp->errmsg = get_pool_memory(PM_MESSAGE);
+         *grp->errmsg = 0;
+      }
+      grp->last = bsr;
+   }
+
+   /* Each session gets its own bsr list, it is put back together at the end */
+   for (i=0; i < ngroups; i++) {
+      grp = &ctx->groups[i];
+      grp->bsr->prev = NULL;
+      grp->last->next = NULL;
+      grp->bsr->use_fast_rejection = jcr->bsr->use_fast_rejection;
+      grp->bsr->use_positioning = jcr->bsr->use_positioning;
+      for (bsr=grp->bsr; bsr; bsr=bsr->next) {
+         bsr->root = grp->bsr;
+      }
+   }
+   Dmsg2(100, "Read %d sessions with %d readers\n", ngroups, ctx->nreaders);
+   return ctx;
+}
+
+static void free_vread_ctx(VREAD_CTX *ctx)
+{
+   JCR *jcr = ctx->jcr;
+   VREAD_GROUP *grp;
+   DEV_RECORD *rec;
+   BSR *bsr;
+   int i;
+
+   P(ctx->mutex);
+   ctx->quit = true;
+   pthread_cond_broadcast(&ctx->cond);
+   V(ctx->mutex);
+
+   for (i=0; i < ctx->ngroups; i++) {
+      grp = &ctx->groups[i];
+      if (grp->started) {
+         pthread_join(grp->tid, NULL);
+      }
+      while ((rec = (DEV_RECORD *)grp->queue->first()) != NULL) {
+         grp->queue->remove(rec);
+         free_record(rec);
+      }
+      delete grp->queue;
+      free_pool_memory(grp->errmsg);
+      if (i + 1 < ctx->ngroups) {
+         grp->last->next = ctx->groups[i+1].bsr;
+         ctx->groups[i+1].bsr->prev = grp->last;
+      }
+   }
+   for (bsr=jcr->bsr; bsr; bsr=bsr->next) {
+      bsr->root = jcr->bsr;
+   }
+   pthread_cond_destroy(&ctx->cond);
+   pthread_mutex_destroy(&ctx->mutex);
+   free(ctx->groups);
+   free(ctx);
+}
+
+/*
+ * Mount callback of the readers, the Volumes are opened directly
+ *  on the cloned device, there is nothing to ask to the Director.
+ */
+static bool vread_mount_next_volume(DCR *dcr)
+{
+   JCR *jcr = dcr->jcr;
+   DEVICE *dev = dcr->dev;
+   VOL_LIST *vol;
+   int i;
+
+   if (jcr->CurReadVolume >= jcr->NumReadVolumes) {
+      return false;                   /* end of the session */
+   }
+   jcr->CurReadVolume++;
+   for (i=1, vol=jcr->VolList; vol; i++, vol=vol->next) {
+      if (i == jcr->CurReadVolume) {
+         break;
+      }
+   }
+   if (!vol) {
+      return false;
+   }
+   if (dev->is_open()) {
+      dev->close(dcr);
+   }
+   bstrncpy(dcr->VolumeName, vol->VolumeName, sizeof(dcr->VolumeName));
+   dcr->setVolCatName(vol->VolumeName);
+   bstrncpy(dcr->media_type, vol->MediaType, sizeof(dcr->media_type));
+   dcr->CurrentVol = vol;
+
+   if (!dev->open_device(dcr, OPEN_READ_ONLY)) {
+      Mmsg4(jcr->errmsg, _("Read open %s device %s Volume \"%s\" failed: ERR=%s\n"),
+            dev->print_type(), dev->print_name(), dcr->VolumeName, dev->bstrerror());
+      jcr->setJobStatus(JS_FatalError);
+      return false;
+   }
+   if (dev->read_dev_volume_label(dcr) != VOL_OK) {
+      if (!jcr->errmsg[0]) {
+         Mmsg2(jcr->errmsg, _("Cannot read the label of Volume \"%s\": ERR=%s\n"),
+               dcr->VolumeName, dev->bstrerror());
+      }
+      jcr->setJobStatus(JS_FatalError);
+      return false;
+   }
+   dev->clear_append();
+   dev->set_read();
+   Dmsg2(100, "Reader opened Volume \"%s\" on %s\n", dcr->VolumeName, dev->print_name());
+   return true;
+}
+
+/* Volume of the job VolList, it lives until the end of the job */
+static VOL_LIST *find_read_volume(JCR *jcr, const char *VolumeName)
+{
+   VOL_LIST *vol;
+
+   for (vol=jcr->VolList; vol; vol=vol->next) {
+      if (strcmp(vol->VolumeName, VolumeName) == 0) {
+         return vol;
+      }
+   }
+   return NULL;
+}
+
+/*
+ * Record callback of the readers, queue a copy of the record
+ *  for the job thread.
+ */
+static bool vread_record_cb(DCR *dcr, DEV_RECORD *rec)
+{
+   VREAD_GROUP *grp = (VREAD_GROUP *)dcr->jcr->vread_group;
+   VREAD_CTX *ctx = grp->ctx;
+   DEV_RECORD *qrec;
+   VOL_LIST *vol;
+   POOLMEM *data;
+
+   qrec = new_record();
+   data = qrec->data;
+   memcpy(qrec, rec, sizeof(DEV_RECORD));
+   qrec->data = check_pool_memory_size(data, rec->data_len + 1);
+   memcpy(qrec->data, rec->data, rec->data_len);
+   /* The reader VolList is freed first, the record may also continue
+    *  on the next Volume
+    */
+   qrec->VolumeName = NULL;
+   if (rec->VolumeName && dcr->CurrentVol &&
+       strcmp(rec->VolumeName, dcr->CurrentVol->VolumeName) == 0 &&
+       (vol = find_read_volume(ctx->jcr, rec->VolumeName)) != NULL) {
+      qrec->VolumeName = vol->VolumeName;
+   }
+
+   P(ctx->mutex);
+   while (grp->queued > VREAD_QUEUE_SIZE && !ctx->quit) {
+      pthread_cond_wait(&ctx->cond, &ctx->mutex);
+   }
+   if (ctx->quit) {
+      V(ctx->mutex);
+      free_record(qrec);
+      return false;
+   }
+   grp->queue->append(qrec);
+   grp->queued += qrec->data_len;
+   pthread_cond_broadcast(&ctx->cond);
+   V(ctx->mutex);
+   return true;
+}
+
+/*
+ * Reader thread, read one session with read_records() using
+ *  a private JCR, DCR and a clone of the job read device.
+ */
+static void *vread_thread(void *arg)
+{
+   VREAD_GROUP *grp = (VREAD_GROUP *)arg;
+   VREAD_CTX *ctx = grp->ctx;
+   JCR *jcr = ctx->jcr;
+   JCR *rjcr;
+   DEVICE *dev;
+   DCR *dcr = NULL;
+   bool ok = false;
+
+   rjcr = new_jcr(sizeof(JCR), stored_free_jcr);
+   set_jcr_in_tsd(rjcr);
+   bstrncpy(rjcr->Job, jcr->Job, sizeof(rjcr->Job));
+   rjcr->use_new_match_all = jcr->use_new_match_all;
+   rjcr->ignore_label_errors = jcr->ignore_label_errors;
+   rjcr->vread_group = grp;
+   rjcr->bsr = grp->bsr;
+   create_restore_volume_list(rjcr, false);
+
+   dev = init_dev(rjcr, jcr->read_dcr->device, false, NULL, true);
+   if (!dev) {
+      Mmsg1(grp->errmsg, _("Cannot init a clone of device %s.\n"),
+            jcr->read_dcr->dev->print_name());
+      goto bail_out;
+   }
+   dcr = new_dcr(rjcr, NULL, dev, SD_READ);
+   rjcr->read_dcr = dcr;
+   dcr->set_ameta();
+   if (vread_mount_next_volume(dcr)) {
+      ok = read_records(dcr, vread_record_cb, vread_mount_next_volume);
+   }
+   if (job_canceled(rjcr)) {
+      ok = false;
+   }
+   if (!ok) {
+      pm_strcpy(grp->errmsg, rjcr->errmsg[0] ? rjcr->errmsg : dev->bstrerror());
+   }
+
+bail_out:
+   if (dcr) {
+      dev->close(dcr);
+      free_volume(dev);
+      free_dcr(dcr);
+   }
+   rjcr->bsr = NULL;                  /* belongs to the job */
+   free_jcr(rjcr);
+   if (dev) {
+      dev->term(NULL);
+   }
+   P(ctx->mutex);
+   grp->error = !ok;
+   grp->done = true;
+   pthread_cond_broadcast(&ctx->cond);
+   V(ctx->mutex);
+   return NULL;
+}
+
+static bool vread_start(VREAD_GROUP *grp)
+{
+   int stat;
+
+   if ((stat = pthread_create(&grp->tid, NULL, vread_thread, (void *)grp)) != 0) {
+      berrno be;
+      Jmsg1(grp->ctx->jcr, M_FATAL, 0, _("Cannot create Volume reader thread: ERR=%s\n"),
+            be.bstrerror(stat));
+      return false;
+   }
+   grp->started = true;
+   return true;
+}
+
+/*
+ * Pass the records of all the sessions to record_cb() in the BSR order,
+ *  while the next sessions are read ahead.
+ */
+static bool vread_records(VREAD_CTX *ctx)
+{
+   JCR *jcr = ctx->jcr;
+   VREAD_GROUP *grp;
+   DEV_RECORD *rec;
+   VOL_LIST *vol;
+   struct timespec timeout;
+   int i, next = 0;
+   bool ok = true;
+
+   Jmsg(jcr, M_INFO, 0, _("Reading %d sessions from %d Volumes with %d readers.\n"),
+        ctx->ngroups, jcr->NumReadVolumes, ctx->nreaders);
+
+   for (i=0; ok && i < ctx->ngroups; i++) {
+      grp = &ctx->groups[i];
+      for ( ; ok && next < ctx->ngroups && next < i + ctx->nreaders; next++) {
+         ok = vread_start(&ctx->groups[next]);
+      }
+      while (ok) {
+         P(ctx->mutex);
+         while ((rec = (DEV_RECORD *)grp->queue->first()) == NULL && !grp->done &&
+                !job_canceled(jcr)) {
+            timeout.tv_sec = time(NULL) + 1;
+            timeout.tv_nsec = 0;
+            pthread_cond_timedwait(&ctx->cond, &ctx->mutex, &timeout);
+         }
+         if (rec) {
+            grp->queue->remove(rec);
+            grp->queued -= rec->data_len;
+            pthread_cond_broadcast(&ctx->cond);
+         }
+         V(ctx->mutex);
+         if (!rec) {
+            if (grp->error) {
+               Jmsg(jcr, M_FATAL, 0, _("Read error on session VolSessionId=%u VolSessionTime=%u: ERR=%s"),
+                    grp->bsr->sessid->sessid, grp->bsr->sesstime->sesstime, grp->errmsg);
+               ok = false;
+            } else if (job_canceled(jcr)) {
+               ok = false;
+            }
+            break;                    /* end of this session */
+         }
+         rec->last_VolSessionId = grp->last_VolSessionId;
+         rec->last_VolSessionTime = grp->last_VolSessionTime;
+         rec->last_FileIndex = grp->last_FileIndex;
+         /* The Volume of the record, for the references */
+         vol = jcr->read_dcr->CurrentVol;
+         if (rec->VolumeName) {
+            jcr->read_dcr->CurrentVol = find_read_volume(jcr, rec->VolumeName);
+         }
+         ok = record_cb(jcr->read_dcr, rec);
+         jcr->read_dcr->CurrentVol = vol;
+         grp->last_VolSessionId = rec->last_VolSessionId;
+         grp->last_VolSessionTime = rec->last_VolSessionTime;
+         grp->last_FileIndex = rec->last_FileIndex;
+         free_record(rec);
+      }
+   }
+   return ok;
+}
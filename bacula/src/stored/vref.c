@@ -0,0 +1,735 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+*/
+/*
+ * SD -- vref.c -- Extent references of a Virtual Full on disk Volumes
+ *
+ * When the write device of a Virtual Full has VirtualFullReferences = yes
+ *  and the Volumes are read on a simple disk device, the data records of
+ *  a file are not copied. They are replaced by a STREAM_EXTENT_REFERENCE
+ *  record that gives the session and the FileIndex of the file in the
+ *  original Job and the address ranges (extents) of the records on the
+ *  original Volumes. The attributes and the digests are written as usual,
+ *  so the Director sees a normal Full.
+ *
+ * A reference is expanded back to the original records when the Job is
+ *  restored, copied, migrated or consolidated without references.
+ *
+ * An empty JobMedia record (FirstIndex=LastIndex=0) is created for each
+ *  referenced Volume, the Volume is not pruned and recycled as long as
+ *  the Job is in the catalog, and the restore bootstraps ignore it.
+ */
+
+#include "bacula.h"
+#include "stored.h"
+
+static const int dbglvl = 150;
+
+#define VREF_VERSION 1
+#define VREF_MAX_EXTENTS 10000
+
+struct VREF_EXTENT {
+   char VolumeName[MAX_NAME_LENGTH];
+   uint64_t saddr;                    /* StartAddr of the first record */
+   uint64_t eaddr;                    /* Addr of the last record */
+};
+
+/* Content of a STREAM_EXTENT_REFERENCE record */
+struct VREF {
+   uint32_t VolSessionId;             /* session of the original Job */
+   uint32_t VolSessionTime;
+   int32_t  FileIndex;                /* FileIndex in the original Job */
+   uint64_t first_addr;               /* first record referenced */
+   uint32_t first_recnum;
+   uint32_t count;                    /* number of records referenced */
+   uint64_t bytes;                    /* size of the records referenced */
+   char MediaType[MAX_NAME_LENGTH];
+   int nextents;
+   int max_extents;
+   VREF_EXTENT *extents;
+};
+
+struct VREF_CTX {
+   JCR *jcr;
+   /* Writer, set for a Virtual Full with references */
+   bool writing;
+   bool pending;                      /* ref has records not yet written */
+   int32_t OutFileIndex;              /* FileIndex of ref in this Job */
+   VREF ref;
+   DEV_RECORD *wrec;
+   alist *volumes;                    /* names of the referenced Volumes */
+   uint64_t bytes;                    /* size of the referenced records */
+   /* Reader, to expand the references */
+   JCR *rjcr;
+   DEVRES *device;
+   DEVICE *dev;                       /* clone of device */
+   DCR *rdcr;
+   VREF xref;                         /* reference being expanded */
+   DCR *dcr;                          /* arguments of vref_expand() */
+   DEV_RECORD *orec;
+   bool (*record_cb)(DCR *dcr, DEV_RECORD *rec);
+   bool started;                      /* first record referenced seen */
+   bool cb_error;                     /* record_cb() failed */
+   uint32_t found;
+};
+
+static VREF_CTX *vref_get_ctx(JCR *jcr)
+{
+   VREF_CTX *ctx = (VREF_CTX *)jcr->vref;
+
+   if (!ctx) {
+      ctx = (VREF_CTX *)malloc(sizeof(VREF_CTX));
+      bmemzero(ctx, sizeof(VREF_CTX));
+      ctx->jcr = jcr;
+      jcr->vref = ctx;
+   }
+   return ctx;
+}
+
+/*
+ * The records sent to the Director and the references themselves
+ *  are always written, everything else can be referenced.
+ */
+static bool vref_inline_stream(DEV_RECORD *rec)
+{
+   return rec->maskedStream == STREAM_UNIX_ATTRIBUTES    ||
+          rec->maskedStream == STREAM_UNIX_ATTRIBUTES_EX ||
+          rec->maskedStream == STREAM_RESTORE_OBJECT     ||
+          rec->maskedStream == STREAM_PLUGIN_OBJECT      ||
+          rec->maskedStream == STREAM_PLUGIN_META_CATALOG ||
+          rec->maskedStream == STREAM_UNIX_ATTRIBUTE_UPDATE ||
+          rec->maskedStream == STREAM_EXTENT_REFERENCE   ||
+          crypto_digest_stream_type(rec->maskedStream) != CRYPTO_DIGEST_NONE;
+}
+
+static VREF_EXTENT *vref_add_extent(VREF *ref, const char *VolumeName)
+{
+   VREF_EXTENT *ext;
+
+   if (ref->nextents >= ref->max_extents) {
+      ref->max_extents = ref->max_extents ? ref->max_extents * 2 : 4;
+      ref->extents = (VREF_EXTENT *)realloc(ref->extents,
+                                            ref->max_extents * sizeof(VREF_EXTENT));
+   }
+   ext = &ref->extents[ref->nextents++];
+   bmemzero(ext, sizeof(VREF_EXTENT));
+   bstrncpy(ext->VolumeName, VolumeName, sizeof(ext->VolumeName));
+   return ext;
+}
+
+static uint32_t vref_serialize(VREF *ref, POOLMEM **buf)
+{
+   ser_declare;
+   VREF_EXTENT *ext;
+   int i;
+
+   *buf = check_pool_memory_size(*buf, 100 + MAX_NAME_LENGTH +
+                                 ref->nextents * (MAX_NAME_LENGTH + 16));
+   ser_begin(*buf, 0);
+   ser_uint32(VREF_VERSION);
+   ser_uint32(ref->VolSessionId);
+   ser_uint32(ref->VolSessionTime);
+   ser_int32(ref->FileIndex);
+   ser_uint64(ref->first_addr);
+   ser_uint32(ref->first_recnum);
+   ser_uint32(ref->count);
+   ser_uint64(ref->bytes);
+   ser_string(ref->MediaType);
+   ser_uint32(ref->nextents);
+   for (i=0; i < ref->nextents; i++) {
+      ext = &ref->extents[i];
+      ser_string(ext->VolumeName);
+      ser_uint64(ext->saddr);
+      ser_uint64(ext->eaddr);
+   }
+   return ser_length(*buf);
+}
+
+static bool vref_unserialize(VREF *ref, DEV_RECORD *rec)
+{
+   ser_declare;
+   VREF_EXTENT *ext;
+   uint32_t version, n, i;
+
+   if (rec->data_len < 48) {
+      return false;
+   }
+   unser_begin(rec->data, rec->data_len);
+   unser_uint32(version);
+   if (version != VREF_VERSION) {
+      return false;
+   }
+   unser_uint32(ref->VolSessionId);
+   unser_uint32(ref->VolSessionTime);
+   unser_int32(ref->FileIndex);
+   unser_uint64(ref->first_addr);
+   unser_uint32(ref->first_recnum);
+   unser_uint32(ref->count);
+   unser_uint64(ref->bytes);
+   unser_string(ref->MediaType);
+   unser_uint32(n);
+   if (n == 0 || n > VREF_MAX_EXTENTS || unser_length(rec->data) > rec->data_len) {
+      return false;
+   }
+   ref->nextents = 0;
+   for (i=0; i < n; i++) {
+      ext = vref_add_extent(ref, "");
+      unser_string(ext->VolumeName);
+      unser_uint64(ext->saddr);
+      unser_uint64(ext->eaddr);
+      if (unser_length(rec->data) > rec->data_len) {
+         return false;
+      }
+   }
+   return true;
+}
+
+static void vref_add_volume(VREF_CTX *ctx, const char *VolumeName)
+{
+   char *name;
+
+   foreach_alist(name, ctx->volumes) {
+      if (strcmp(name, VolumeName) == 0) {
+         return;
+      }
+   }
+   ctx->volumes->append(bstrdup(VolumeName));
+}
+
+/* The Volumes must stay on a disk that any device of the Media Type can open */
+static bool vref_disk_device(DCR *dcr)
+{
+   return dcr->dev->dev_type == B_FILE_DEV && !dcr->dev->requires_mount() &&
+          (!dcr->device->changer_command || dcr->is_virtual_autochanger());
+}
+
+/*
+ * Setup a Virtual Full to write references, if the write device
+ *  asks for it and the Volumes are read on a disk device.
+ */
+void vref_init_write(JCR *jcr)
+{
+   VREF_CTX *ctx;
+
+   if (!jcr->is_JobType(JT_BACKUP) || !jcr->dcr->device->vf_references) {
+      return;
+   }
+   if (!vref_disk_device(jcr->read_dcr)) {
+      Jmsg(jcr, M_INFO, 0, _("VirtualFullReferences ignored, the Volumes are not read on a disk device.\n"));
+      return;
+   }
+   ctx = vref_get_ctx(jcr);
+   ctx->writing = true;
+   ctx->wrec = new_record();
+   ctx->volumes = New(alist(10, owned_by_alist));
+   Jmsg(jcr, M_INFO, 0, _("Writing references to the data of the Volumes read.\n"));
+}
+
+/*
+ * Write the pending reference of a Virtual Full.
+ *  Must be called before writing any other record.
+ */
+bool vref_flush(JCR *jcr)
+{
+   VREF_CTX *ctx = (VREF_CTX *)jcr->vref;
+   DEV_RECORD *wrec;
+   VREF *ref;
+   char buf1[100];
+   int i;
+
+   if (!ctx || !ctx->pending) {
+      return true;
+   }
+   ctx->pending = false;
+   ref = &ctx->ref;
+   wrec = ctx->wrec;
+   wrec->data_len = vref_serialize(ref, &wrec->data);
+   wrec->FileIndex = ctx->OutFileIndex;
+   wrec->Stream = wrec->maskedStream = STREAM_EXTENT_REFERENCE;
+   wrec->VolSessionId = jcr->VolSessionId;
+   wrec->VolSessionTime = jcr->VolSessionTime;
+   wrec->state_bits = 0;
+   for (i=0; i < ref->nextents; i++) {
+      vref_add_volume(ctx, ref->extents[i].VolumeName);
+   }
+   Dmsg5(dbglvl, "Write reference FI=%s to SessId=%u FI=%d count=%u extents=%d\n",
+         FI_to_ascii(buf1, wrec->FileIndex), ref->VolSessionId, ref->FileIndex,
+         ref->count, ref->nextents);
+   if (!jcr->dcr->write_record(wrec)) {
+      Jmsg2(jcr, M_FATAL, 0, _("Fatal append error on device %s: ERR=%s\n"),
+            jcr->dcr->dev->print_name(), jcr->dcr->dev->bstrerror());
+      return false;
+   }
+   return true;
+}
+
+/*
+ * Called by a Virtual Full for each record of a file, once the FileIndex
+ *  of the record is renumbered. The original FileIndex is in last_FileIndex.
+ *   Returns:  1 if the record is referenced, it must not be written
+ *             0 if the record must be written
+ *            -1 on error
+ */
+int vref_fold_record(DCR *dcr, DEV_RECORD *rec)
+{
+   JCR *jcr = dcr->jcr;
+   VREF_CTX *ctx = (VREF_CTX *)jcr->vref;
+   VREF_EXTENT *ext;
+   VOL_LIST *vol;
+   VREF *ref;
+
+   if (!ctx || !ctx->writing) {
+      return 0;
+   }
+   if (rec->FileIndex <= 0) {
+      return vref_flush(jcr) ? 0 : -1;
+   }
+   /* A record that continues on the next Volume is simply copied */
+   vol = dcr->CurrentVol;
+   if (vref_inline_stream(rec) || !rec->VolumeName || !vol ||
+       strcmp(vol->VolumeName, rec->VolumeName) != 0 || !vref_disk_device(dcr)) {
+      return vref_flush(jcr) ? 0 : -1;
+   }
+   ref = &ctx->ref;
+   if (ctx->pending && (ref->VolSessionId != rec->VolSessionId ||
+                        ref->VolSessionTime != rec->VolSessionTime ||
+                        ref->FileIndex != rec->last_FileIndex ||
+                        strcmp(ref->MediaType, vol->MediaType) != 0)) {
+      if (!vref_flush(jcr)) {
+         return -1;
+      }
+   }
+   if (!ctx->pending) {
+      bstrncpy(ref->MediaType, vol->MediaType, sizeof(ref->MediaType));
+      ref->VolSessionId = rec->VolSessionId;
+      ref->VolSessionTime = rec->VolSessionTime;
+      ref->FileIndex = rec->last_FileIndex;
+      ref->first_addr = get_record_start_address(rec);
+      ref->first_recnum = rec->RecNum;
+      ref->count = 0;
+      ref->bytes = 0;
+      ref->nextents = 0;
+      ctx->OutFileIndex = rec->FileIndex;
+      ctx->pending = true;
+   }
+   ext = ref->nextents > 0 ? &ref->extents[ref->nextents - 1] : NULL;
+   if (!ext || strcmp(ext->VolumeName, rec->VolumeName) != 0) {
+      ext = vref_add_extent(ref, rec->VolumeName);
+      ext->saddr = get_record_start_address(rec);
+   }
+   ext->eaddr = get_record_address(rec);
+   ref->count++;
+   ref->bytes += rec->data_len;
+   ctx->bytes += rec->data_len;
+   return 1;
+}
+
+/*
+ * A Virtual Full with references copies the references of the Jobs
+ *  it reads, they still point to the original Volumes.
+ *   Returns: size of the records referenced
+ */
+uint64_t vref_copy_reference(JCR *jcr, DEV_RECORD *rec)
+{
+   VREF_CTX *ctx = (VREF_CTX *)jcr->vref;
+   VREF *ref;
+   int i;
+
+   if (!ctx || !ctx->writing) {
+      return 0;
+   }
+   ref = &ctx->xref;
+   if (!vref_unserialize(ref, rec)) {
+      Jmsg(jcr, M_WARNING, 0, _("Invalid extent reference record FileIndex=%d.\n"),
+           rec->FileIndex);
+      return 0;
+   }
+   for (i=0; i < ref->nextents; i++) {
+      vref_add_volume(ctx, ref->extents[i].VolumeName);
+   }
+   ctx->bytes += ref->bytes;
+   return ref->bytes;
+}
+
+/*
+ * At the end of a Virtual Full, record the referenced Volumes
+ *  in the catalog.
+ */
+bool vref_create_jobmedia(JCR *jcr)
+{
+   VREF_CTX *ctx = (VREF_CTX *)jcr->vref;
+   char *VolumeName;
+   char ed1[50];
+   DCR *dcr;
+   bool ok = true;
+
+   if (!ctx || !ctx->writing || ctx->volumes->size() == 0) {
+      return true;
+   }
+   dcr = new_dcr(jcr, NULL, NULL, SD_READ);
+   foreach_alist(VolumeName, ctx->volumes) {
+      if (!dir_get_volume_info(dcr, VolumeName, GET_VOL_INFO_FOR_READ)) {
+         Jmsg(jcr, M_FATAL, 0, _("Cannot reference Volume \"%s\": ERR=%s"),
+              VolumeName, jcr->errmsg);
+         ok = false;
+         break;
+      }
+      dcr->VolMediaId = dcr->VolCatInfo.VolMediaId;
+      if (!dir_create_jobmedia_record(dcr, true)) {
+         ok = false;
+         break;
+      }
+   }
+   free_dcr(dcr);
+   if (ok) {
+      Jmsg(jcr, M_INFO, 0, _("Referenced %s bytes of data on %d Volumes.\n"),
+           edit_uint64_with_commas(ctx->bytes, ed1), ctx->volumes->size());
+   }
+   return ok;
+}
+
+/*
+ * The reader JCR only owns its Volume list, the bsr is freed
+ *  after each reference.
+ */
+static void vref_free_jcr(JCR *jcr)
+{
+   free_restore_volume_list(jcr);
+}
+
+static void vref_close_reader(VREF_CTX *ctx)
+{
+   if (ctx->rdcr) {
+      if (ctx->dev->is_open()) {
+         ctx->dev->close(ctx->rdcr);
+      }
+      free_volume(ctx->dev);
+      free_dcr(ctx->rdcr);
+      ctx->rdcr = NULL;
+   }
+   if (ctx->rjcr) {
+      ctx->rjcr->vref = NULL;
+      free_jcr(ctx->rjcr);
+      ctx->rjcr = NULL;
+   }
+   if (ctx->dev) {
+      ctx->dev->term(NULL);
+      ctx->dev = NULL;
+   }
+   ctx->device = NULL;
+}
+
+/*
+ * The referenced Volumes are read on a clone of a disk device
+ *  with the Media Type of the reference, the one of the Job if possible.
+ */
+static bool vref_open_reader(VREF_CTX *ctx, const char *MediaType)
+{
+   JCR *jcr = ctx->jcr;
+   DEVRES *device = NULL, *d;
+
+   if (ctx->dev && strcmp(ctx->device->media_type, MediaType) == 0) {
+      return true;
+   }
+   vref_close_reader(ctx);
+   if (jcr->read_dcr && jcr->read_dcr->device->dev_type == B_FILE_DEV &&
+       strcmp(jcr->read_dcr->device->media_type, MediaType) == 0) {
+      device = jcr->read_dcr->device;
+   } else {
+      foreach_res(d, R_DEVICE) {
+         if (d->dev_type == B_FILE_DEV && !(d->cap_bits & CAP_REQMOUNT) &&
+             strcmp(d->media_type, MediaType) == 0) {
+            device = d;
+            break;
+         }
+      }
+   }
+   if (!device) {
+      Mmsg(jcr->errmsg, _("No disk device with Media Type \"%s\".\n"), MediaType);
+      return false;
+   }
+   ctx->rjcr = new_jcr(sizeof(JCR), vref_free_jcr);
+   bstrncpy(ctx->rjcr->Job, jcr->Job, sizeof(ctx->rjcr->Job));
+   ctx->rjcr->ignore_label_errors = jcr->ignore_label_errors;
+   ctx->rjcr->vref = ctx;
+   ctx->dev = init_dev(ctx->rjcr, device, false, NULL, true);
+   if (!ctx->dev) {
+      Mmsg(jcr->errmsg, _("Cannot init a clone of device \"%s\".\n"), device->hdr.name);
+      vref_close_reader(ctx);
+      return false;
+   }
+   ctx->device = device;
+   ctx->rdcr = new_dcr(ctx->rjcr, NULL, ctx->dev, SD_READ);
+   ctx->rjcr->read_dcr = ctx->rdcr;
+   ctx->rdcr->set_ameta();
+   Dmsg2(dbglvl, "Reader of references on a clone of %s MediaType=%s\n",
+         device->hdr.name, MediaType);
+   return true;
+}
+
+static void vref_set_volume(DCR *dcr, VOL_LIST *vol)
+{
+   bstrncpy(dcr->VolumeName, vol->VolumeName, sizeof(dcr->VolumeName));
+   dcr->setVolCatName(vol->VolumeName);
+   bstrncpy(dcr->media_type, vol->MediaType, sizeof(dcr->media_type));
+   dcr->CurrentVol = vol;
+}
+
+/*
+ * Mount callback of the reader, the Volumes are opened directly
+ *  on the cloned device.
+ */
+static bool vref_mount_next_volume(DCR *dcr)
+{
+   JCR *rjcr = dcr->jcr;
+   DEVICE *dev = dcr->dev;
+   VOL_LIST *vol;
+   int i;
+
+   if (rjcr->CurReadVolume >= rjcr->NumReadVolumes) {
+      return false;                   /* end of the reference */
+   }
+   rjcr->CurReadVolume++;
+   for (i=1, vol=rjcr->VolList; vol && i < rjcr->CurReadVolume; i++) {
+      vol = vol->next;
+   }
+   if (!vol) {
+      return false;
+   }
+   if (dev->is_open()) {
+      dev->close(dcr);
+   }
+   vref_set_volume(dcr, vol);
+   if (!dev->open_device(dcr, OPEN_READ_ONLY)) {
+      Mmsg4(rjcr->errmsg, _("Read open %s device %s Volume \"%s\" failed: ERR=%s\n"),
+            dev->print_type(), dev->print_name(), dcr->VolumeName, dev->bstrerror());
+      return false;
+   }
+   if (dev->read_dev_volume_label(dcr) != VOL_OK) {
+      if (!rjcr->errmsg[0]) {
+         Mmsg2(rjcr->errmsg, _("Cannot read the label of Volume \"%s\": ERR=%s\n"),
+               dcr->VolumeName, dev->bstrerror());
+      }
+      dev->close(dcr);
+      return false;
+   }
+   dev->clear_append();
+   dev->set_read();
+   Dmsg1(dbglvl, "Reader of references opened Volume \"%s\"\n", dcr->VolumeName);
+   return true;
+}
+
+/* One bsr per extent */
+static BSR *vref_new_bsr(VREF *ref)
+{
+   BSR *root = NULL, *prev = NULL, *bsr;
+   VREF_EXTENT *ext;
+   int i;
+
+   for (i=0; i < ref->nextents; i++) {
+      ext = &ref->extents[i];
+      bsr = new_bsr();
+      bsr->volume = (BSR_VOLUME *)malloc(sizeof(BSR_VOLUME));
+      bmemzero(bsr->volume, sizeof(BSR_VOLUME));
+      bstrncpy(bsr->volume->VolumeName, ext->VolumeName, sizeof(bsr->volume->VolumeName));
+      bstrncpy(bsr->volume->MediaType, ref->MediaType, sizeof(bsr->volume->MediaType));
+      bsr->sessid = (BSR_SESSID *)malloc(sizeof(BSR_SESSID));
+      bmemzero(bsr->sessid, sizeof(BSR_SESSID));
+      bsr->sessid->sessid = bsr->sessid->sessid2 = ref->VolSessionId;
+      bsr->sesstime = (BSR_SESSTIME *)malloc(sizeof(BSR_SESSTIME));
+      bmemzero(bsr->sesstime, sizeof(BSR_SESSTIME));
+      bsr->sesstime->sesstime = ref->VolSessionTime;
+      bsr->FileIndex = (BSR_FINDEX *)malloc(sizeof(BSR_FINDEX));
+      bmemzero(bsr->FileIndex, sizeof(BSR_FINDEX));
+      bsr->FileIndex->findex = bsr->FileIndex->findex2 = ref->FileIndex;
+      bsr->voladdr = (BSR_VOLADDR *)malloc(sizeof(BSR_VOLADDR));
+      bmemzero(bsr->voladdr, sizeof(BSR_VOLADDR));
+      bsr->voladdr->saddr = ext->saddr;
+      bsr->voladdr->eaddr = ext->eaddr;
+      if (prev) {
+         prev->next = bsr;
+         bsr->prev = prev;
+      } else {
+         root = bsr;
+      }
+      prev = bsr;
+   }
+   /* We position ourself on the first extent, a file rarely spans Volumes */
+   for (bsr=root; bsr; bsr=bsr->next) {
+      bsr->root = root;
+   }
+   root->use_fast_rejection = true;
+   root->use_positioning = false;
+   return root;
+}
+
+/*
+ * Record callback of the reader, pass the referenced records to
+ *  the caller of vref_expand() as if they were in place of the reference.
+ */
+static bool vref_expand_cb(DCR *rdcr, DEV_RECORD *rec)
+{
+   VREF_CTX *ctx = (VREF_CTX *)rdcr->jcr->vref;
+   VREF *ref = &ctx->xref;
+   DEV_RECORD *orec = ctx->orec;
+   uint32_t VolSessionId, VolSessionTime;
+   int32_t FileIndex;
+   bool ok;
+
+   if (rec->FileIndex < 0 || ctx->found >= ref->count) {
+      return true;
+   }
+   if (!ctx->started) {
+      if (get_record_start_address(rec) != ref->first_addr ||
+          rec->RecNum != ref->first_recnum) {
+         return true;                 /* other records of the file */
+      }
+      ctx->started = true;
+   }
+   if (vref_inline_stream(rec)) {
+      return true;
+   }
+   if (job_canceled(ctx->jcr)) {
+      ctx->cb_error = true;
+      return false;
+   }
+   VolSessionId = rec->VolSessionId;
+   VolSessionTime = rec->VolSessionTime;
+   FileIndex = rec->FileIndex;
+   rec->VolSessionId = orec->VolSessionId;
+   rec->VolSessionTime = orec->VolSessionTime;
+   rec->FileIndex = orec->FileIndex;
+   rec->last_VolSessionId = orec->last_VolSessionId;
+   rec->last_VolSessionTime = orec->last_VolSessionTime;
+   rec->last_FileIndex = orec->last_FileIndex;
+   rec->match_stat = orec->match_stat;
+
+   ok = ctx->record_cb(ctx->dcr, rec);
+
+   orec->last_VolSessionId = rec->last_VolSessionId;
+   orec->last_VolSessionTime = rec->last_VolSessionTime;
+   orec->last_FileIndex = rec->last_FileIndex;
+   rec->VolSessionId = VolSessionId;
+   rec->VolSessionTime = VolSessionTime;
+   rec->FileIndex = FileIndex;
+   ctx->found++;
+   if (!ok) {
+      ctx->cb_error = true;
+   }
+   return ok;
+}
+
+/*
+ * Read the records of a reference and pass them to record_cb() in
+ *  place of the reference record.
+ *   Returns: false on error
+ */
+bool vref_expand(DCR *dcr, DEV_RECORD *rec, bool record_cb(DCR *dcr, DEV_RECORD *rec))
+{
+   JCR *jcr = dcr->jcr;
+   VREF_CTX *ctx = vref_get_ctx(jcr);
+   VREF *ref = &ctx->xref;
+   JCR *rjcr;
+   DCR *rdcr;
+   DEVICE *dev;
+   bool ok = false;
+
+   if (!vref_unserialize(ref, rec)) {
+      Jmsg(jcr, M_FATAL, 0, _("Invalid extent reference record FileIndex=%d.\n"),
+           rec->FileIndex);
+      return false;
+   }
+   if (!vref_open_reader(ctx, ref->MediaType)) {
+      Jmsg(jcr, M_FATAL, 0, _("Cannot read the data referenced by FileIndex=%d: ERR=%s"),
+           rec->FileIndex, jcr->errmsg);
+      return false;
+   }
+   rjcr = ctx->rjcr;
+   rdcr = ctx->rdcr;
+   dev = ctx->dev;
+   free_restore_volume_list(rjcr);
+   rjcr->bsr = vref_new_bsr(ref);
+   create_restore_volume_list(rjcr, false);
+   *rjcr->errmsg = 0;
+
+   ctx->dcr = dcr;
+   ctx->orec = rec;
+   ctx->record_cb = record_cb;
+   ctx->started = false;
+   ctx->cb_error = false;
+   ctx->found = 0;
+
+   /* The Volume of the previous reference is often the one we need */
+   if (dev->is_open() && strcmp(dev->VolHdr.VolumeName, rjcr->VolList->VolumeName) == 0) {
+      rjcr->CurReadVolume = 1;
+      vref_set_volume(rdcr, rjcr->VolList);
+   } else {
+      rjcr->CurReadVolume = 0;
+      if (!vref_mount_next_volume(rdcr)) {
+         goto bail_out;
+      }
+   }
+   dev->clear_eof();
+   dev->clear_eot();
+   if (!dev->reposition(rdcr, ref->extents[0].saddr)) {
+      goto bail_out;
+   }
+   ok = read_records(rdcr, vref_expand_cb, vref_mount_next_volume);
+   if (ok && ctx->found != ref->count) {
+      Mmsg(rjcr->errmsg, _("Found %u of the %u records referenced.\n"),
+           ctx->found, ref->count);
+      ok = false;
+   }
+   if (dev->at_eot() && dev->is_open()) {
+      dev->close(rdcr);
+   }
+
+bail_out:
+   if (!ok && !ctx->cb_error) {
+      Jmsg(jcr, M_FATAL, 0, _("Cannot read the data referenced by FileIndex=%d on Volume \"%s\": ERR=%s"),
+           rec->FileIndex, ref->extents[0].VolumeName,
+           rjcr->errmsg[0] ? rjcr->errmsg : dev->bstrerror());
+   }
+   free_bsr(rjcr->bsr);
+   rjcr->bsr = NULL;
+   return ok;
+}
+
+void vref_free(JCR *jcr)
+{
+   VREF_CTX *ctx = (VREF_CTX *)jcr->vref;
+
+   if (!ctx) {
+      return;
+   }
+   vref_close_reader(ctx);
+   if (ctx->wrec) {
+      free_record(ctx->wrec);
+   }
+   if (ctx->volumes) {
+      delete ctx->volumes;
+   }
+   if (ctx->ref.extents) {
+      free(ctx->ref.extents);
+   }
+   if (ctx->xref.extents) {
+      free(ctx->xref.extents);
+   }
+   free(ctx);
+   jcr->vref = NULL;
+}
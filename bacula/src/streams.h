@@ -108,6 +108,7 @@
 
 #define STREAM_ADATA_BLOCK_HEADER             200    /* Adata block header */
 #define STREAM_ADATA_RECORD_HEADER            201    /* Adata record header */
+#define STREAM_EXTENT_REFERENCE               202    /* SD reference to records of an older session */
 
 /*
  * Additional Stream definitions. Once defined these must NEVER
@@ -85,7 +85,8 @@ void BackupService::onChange(const char *fpath)
     rec.name = bstrdup(fpath);
     POOLMEM *spoolFilename = get_pool_memory(PM_FNAME);
 
-    if (strcmp(fpath, _journal->_jPath) == 0) {
+    // The Journal and its temporary file used by the compaction
+    if (strncmp(fpath, _journal->_jPath, strlen(_journal->_jPath)) == 0) {
         Dmsg0(0, "Change on Journal File ignored.\n");
         goto bail_out;
     }
@@ -94,6 +95,13 @@ void BackupService::onChange(const char *fpath)
         goto bail_out;
     }
 
+    if (_last_mtime.find(fpath) == _last_mtime.end()) {
+        // Version saved before a restart of the client, found with the Journal index
+        FileRecord *last = _journal->findFileRecord(fpath);
+        _last_mtime[fpath] = last ? last->mtime : 0;
+        delete last;
+    }
+
     if (rec.mtime - _last_mtime[fpath] < 5) {
         Dmsg3(50, "File %s: current mtime: %d. Previous mtime: %d. Ignoring\n",
               rec.name,
@@ -0,0 +1,353 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+*/
+/*
+ * Benchmark of the FileSet Options{} matching done by accept_file()
+ *
+ *  The patterns are read from a file, one per line, prefixed by the
+ *  directive name (wild, wilddir, wildfile, wildbase, regex, regexdir,
+ *  regexfile) followed by a space. The file names are read from the
+ *  data file or from stdin (find / > data), a name ending with a / is
+ *  a directory.
+ *
+ *  The names are matched with accept_file() and with a simple loop
+ *  over all patterns as it was done before the compiled lists, the
+ *  results must be the same.
+ */
+
+#include "bacula.h"
+#include "findlib/find.h"
+
+/* Dummy functions */
+int generate_job_event(JCR *jcr, const char *event) { return 1; }
+void generate_plugin_event(JCR *jcr, bEventType eventType, void *value) { }
+
+static void usage()
+{
+   fprintf(stderr, _(
+"\n"
+"Usage: findbench [-d debug_level] [-e] [-i] [-w] [-n loops] -p <pattern-file> [data-file]\n"
+"       -d <nn>     set debug level to <nn>\n"
+"       -e          the Options{} excludes the matching files (Exclude=yes)\n"
+"       -i          use case insensitive match (IgnoreCase=yes)\n"
+"       -w          use enhanced wild cards (wildbase, FNM_PATHNAME)\n"
+"       -n <nn>     match the data <nn> times\n"
+"       -p          specify the file of patterns\n"
+"       -?          print this message.\n"
+"\n"));
+
+   exit(1);
+}
+
+/* Match all the patterns one by one, like accept_file() used to do */
+static bool linear_accept(findFOPTS *fo, const char *fname, bool isdir)
+{
+   int k;
+   int flags = (fo->flags & FO_IGNORECASE) ? FNM_CASEFOLD : 0;
+   const char *basename = fname;
+   bool exclude = (fo->flags & FO_EXCLUDE) != 0;
+
+   if (fo->flags & FO_ENHANCEDWILD) {
+      flags |= FNM_PATHNAME;
+      if ((basename = last_path_separator(fname)) != NULL) {
+         basename++;
+      } else {
+         basename = fname;
+      }
+   }
+   if (isdir) {
+      for (k=0; k<fo->wilddir.size(); k++) {
+         if (fnmatch((char *)fo->wilddir.get(k), fname, flags) == 0) {
+            return !exclude;
+         }
+      }
+   } else {
+      for (k=0; k<fo->wildfile.size(); k++) {
+         if (fnmatch((char *)fo->wildfile.get(k), fname, flags) == 0) {
+            return !exclude;
+         }
+      }
+      for (k=0; k<fo->wildbase.size(); k++) {
+         if (fnmatch((char *)fo->wildbase.get(k), basename, flags) == 0) {
+            return !exclude;
+         }
+      }
+   }
+   for (k=0; k<fo->wild.size(); k++) {
+      if (fnmatch((char *)fo->wild.get(k), fname, flags) == 0) {
+         return !exclude;
+      }
+   }
+   alist *regex = isdir ? &fo->regexdir : &fo->regexfile;
+   for (k=0; k<regex->size(); k++) {
+      if (regexec((regex_t *)regex->get(k), fname, 0, NULL, 0) == 0) {
+         return !exclude;
+      }
+   }
+   for (k=0; k<fo->regex.size(); k++) {
+      if (regexec((regex_t *)fo->regex.get(k), fname, 0, NULL, 0) == 0) {
+         return !exclude;
+      }
+   }
+   /* An empty Options{} with exclude rejects all files */
+   return !(exclude && fo->wild.size() == 0 && fo->wilddir.size() == 0 &&
+            fo->wildfile.size() == 0 && fo->wildbase.size() == 0 &&
+            fo->regex.size() == 0 && fo->regexdir.size() == 0 &&
+            fo->regexfile.size() == 0);
+}
+
+static bool add_pattern(findFOPTS *fo, char *line)
+{
+   char *p = strchr(line, ' ');
+   int rc;
+   regex_t *preg;
+   alist *list;
+
+   if (!p) {
+      return false;
+   }
+   *p++ = 0;
+   if (strcmp(line, "wild") == 0) {
+      fo->wild.append(bstrdup(p));
+   } else if (strcmp(line, "wilddir") == 0) {
+      fo->wilddir.append(bstrdup(p));
+   } else if (strcmp(line, "wildfile") == 0) {
+      fo->wildfile.append(bstrdup(p));
+   } else if (strcmp(line, "wildbase") == 0) {
+      fo->wildbase.append(bstrdup(p));
+   } else {
+      if (strcmp(line, "regex") == 0) {
+         list = &fo->regex;
+      } else if (strcmp(line, "regexdir") == 0) {
+         list = &fo->regexdir;
+      } else if (strcmp(line, "regexfile") == 0) {
+         list = &fo->regexfile;
+      } else {
+         return false;
+      }
+      preg = (regex_t *)bmalloc(sizeof(regex_t));
+      rc = regcomp(preg, p, REG_EXTENDED | ((fo->flags & FO_IGNORECASE) ? REG_ICASE : 0));
+      if (rc != 0) {
+         free(preg);
+         return false;
+      }
+      list->append(preg);
+   }
+   return true;
+}
+
+int main(int argc, char *const *argv)
+{
+   char *pattern_file = NULL;
+   char line[5000];
+   FILE *fd;
+   int ch, i, loops = 1, nb_patterns = 0, errors = 0;
+   uint64_t flags = 0, nb_names = 0, nb_accepted = 0;
+   btime_t start, compiled_time, linear_time;
+   alist names(1000, owned_by_alist);
+   char *name;
+
+   setlocale(LC_ALL, "");
+   bindtextdomain("bacula", LOCALEDIR);
+   textdomain("bacula");
+
+   while ((ch = getopt(argc, argv, "d:ein:p:w?")) != -1) {
+      switch (ch) {
+      case 'd':                       /* set debug level */
+         debug_level = atoi(optarg);
+         if (debug_level <= 0) {
+            debug_level = 1;
+         }
+         break;
+
+      case 'e':
+         flags |= FO_EXCLUDE;
+         break;
+
+      case 'i':
+         flags |= FO_IGNORECASE;
+         break;
+
+      case 'w':
+         flags |= FO_ENHANCEDWILD;
+         break;
+
+      case 'n':
+         loops = MAX(atoi(optarg), 1);
+         break;
+
+      case 'p':
+         pattern_file = optarg;
+         break;
+
+      case '?':
+      default:
+         usage();
+
+      }
+   }
+   argc -= optind;
+   argv += optind;
+
+   if (!pattern_file) {
+      printf("A pattern file must be specified.\n");
+      usage();
+   }
+
+   OSDependentInit();
+
+   FF_PKT *ff = init_find_files();
+   findFILESET *fileset = (findFILESET *)bmalloc(sizeof(findFILESET));
+   fileset->include_list.init(1, true);
+   fileset->exclude_list.init(1, true);
+   fileset->incexe = (findINCEXE *)bmalloc(sizeof(findINCEXE));
+   fileset->incexe->opts_list.init(1, true);
+   fileset->incexe->name_list.init();
+   fileset->include_list.append(fileset->incexe);
+
+   findFOPTS *fo = (findFOPTS *)bmalloc(sizeof(findFOPTS));
+   fo->regex.init(1, true);
+   fo->regexdir.init(1, true);
+   fo->regexfile.init(1, true);
+   fo->wild.init(1, true);
+   fo->wilddir.init(1, true);
+   fo->wildfile.init(1, true);
+   fo->wildbase.init(1, true);
+   fo->base.init(1, true);
+   fo->fstype.init(1, true);
+   fo->drivetype.init(1, true);
+   fo->flags = flags;
+   fileset->incexe->current_opts = fo;
+   fileset->incexe->opts_list.append(fo);
+   ff->fileset = fileset;
+
+   fd = bfopen(pattern_file, "r");
+   if (!fd) {
+      printf(_("Could not open pattern file: %s\n"), pattern_file);
+      exit(1);
+   }
+   while (fgets(line, sizeof(line)-1, fd)) {
+      strip_trailing_newline(line);
+      if (line[0] == 0 || line[0] == '#') {
+         continue;
+      }
+      if (!add_pattern(fo, line)) {
+         printf(_("Invalid pattern line: %s\n"), line);
+         exit(1);
+      }
+      nb_patterns++;
+   }
+   fclose(fd);
+
+   if (argc > 0) {
+      fd = bfopen(argv[0], "r");
+      if (!fd) {
+         printf(_("Could not open data file: %s\n"), argv[0]);
+         exit(1);
+      }
+   } else {
+      fd = stdin;
+   }
+   while (fgets(line, sizeof(line)-1, fd)) {
+      strip_trailing_newline(line);
+      names.append(bstrdup(line));
+   }
+   if (fd != stdin) {
+      fclose(fd);
+   }
+
+   start = get_current_btime();
+   for (i = 0; i < loops; i++) {
+      foreach_alist(name, &names) {
+         int len = strlen(name);
+         bool isdir = len > 1 && name[len-1] == '/';
+         ff->fname = name;
+         ff->flags = flags;
+         ff->statp.st_mode = isdir ? S_IFDIR : S_IFREG;
+         if (accept_file(ff)) {
+            nb_accepted++;
+         }
+         nb_names++;
+      }
+   }
+   compiled_time = get_current_btime() - start;
+
+   start = get_current_btime();
+   for (i = 0; i < loops; i++) {
+      foreach_alist(name, &names) {
+         int len = strlen(name);
+         linear_accept(fo, name, len > 1 && name[len-1] == '/');
+      }
+   }
+   linear_time = get_current_btime() - start;
+
+   /* Verify that both methods give the same answer */
+   foreach_alist(name, &names) {
+      int len = strlen(name);
+      bool isdir = len > 1 && name[len-1] == '/';
+      ff->fname = name;
+      ff->flags = flags;
+      ff->statp.st_mode = isdir ? S_IFDIR : S_IFREG;
+      if (accept_file(ff) != linear_accept(fo, name, isdir)) {
+         printf(_("Different result for: %s\n"), name);
+         errors++;
+      }
+   }
+
+   printf(_("Patterns: %d Names: %d Accepted: %lld\n"), nb_patterns,
+          names.size(), (long long)(nb_accepted / loops));
+   printf(_("Compiled: %.3f s %.0f files/sec\n"), compiled_time / 1000000.0,
+          nb_names * 1000000.0 / MAX(compiled_time, 1));
+   printf(_("Linear:   %.3f s %.0f files/sec\n"), linear_time / 1000000.0,
+          nb_names * 1000000.0 / MAX(linear_time, 1));
+   printf(_("Errors:   %d\n"), errors);
+
+   /* Clean up */
+   free_fileset_wild(fileset);
+   for (i=0; i<fo->regex.size(); i++) {
+      regfree((regex_t *)fo->regex.get(i));
+   }
+   for (i=0; i<fo->regexdir.size(); i++) {
+      regfree((regex_t *)fo->regexdir.get(i));
+   }
+   for (i=0; i<fo->regexfile.size(); i++) {
+      regfree((regex_t *)fo->regexfile.get(i));
+   }
+   fo->regex.destroy();
+   fo->regexdir.destroy();
+   fo->regexfile.destroy();
+   fo->wild.destroy();
+   fo->wilddir.destroy();
+   fo->wildfile.destroy();
+   fo->wildbase.destroy();
+   fo->base.destroy();
+   fo->fstype.destroy();
+   fo->drivetype.destroy();
+   fileset->incexe->opts_list.destroy();
+   fileset->incexe->name_list.destroy();
+   fileset->include_list.destroy();
+   fileset->exclude_list.destroy();
+   free(fileset);
+   ff->fileset = NULL;
+   ff->fname = NULL;
+   names.destroy();
+   term_find_files(ff);
+   close_memory_pool();
+   sm_dump(false);
+   exit(errors ? 1 : 0);
+}
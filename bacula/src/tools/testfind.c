@@ -173,6 +173,7 @@ main (int argc, char *const *argv)
 
    if (fileset) {
       int i, j, k;
+      free_fileset_wild(fileset);
       /* Delete FileSet Include lists */
       for (i=0; i<fileset->include_list.size(); i++) {
          findINCEXE *incexe = (findINCEXE *)fileset->include_list.get(i);
@@ -53,6 +53,7 @@ our @EXPORT = qw(update_some_files create_many_files check_multiple_copies
                   check_tls_traces println add_virtual_changer check_events check_events_json
                   create_many_hardlinks check_dot_status parse_fuse_trace generate_random_seek
                   check_storage_selection check_json get_perm
+                  create_bench_tree update_bench_tree setup_bench_collector bench_sample bench_report
 );
 
 
@@ -929,6 +930,278 @@ sub create_many_dirs
     print "\n";
 }
 
+# create a reproducible tree for the benchmarks, the content of the files
+# only depends on the arguments
+# Inputs: dest        destination directory
+#         nb_small    number of small files (0 to 16KB)
+#         nb_sparse   number of big sparse files
+#         sparse_size size of the sparse files
+#         depth       number of levels of the deep directory
+#         nb_links    number of hardlinks to the small files
+# Example:
+# perl -Mscripts::functions -e 'create_bench_tree("$cwd/files", 100000, 4, 1<<30, 200, 1000)'
+sub create_bench_tree
+{
+    my ($dest, $nb_small, $nb_sparse, $sparse_size, $depth, $nb_links) = @_;
+    my $dir;
+
+    # already done
+    if (-d "$dest/links") {
+        debug("Files already created\n");
+        return;
+    }
+    mkdir $dest;
+    mkdir "$dest/small";
+
+    # auto flush stdout for dots
+    $| = 1;
+    print "Create $nb_small small files into $dest\n";
+    for(my $i=0; $i < $nb_small; $i++) {
+        $dir = sprintf("$dest/small/%04d", $i / 1000);
+        mkdir $dir if (!($i % 1000));
+        my $size = ($i * 7919) % 16384;
+        open(FP, ">$dir/f$i") or die "$dir $!";
+        print FP substr("$i " x ($size / length("$i ") + 1), 0, $size);
+        close(FP);
+        print "." if (!($i % 10000));
+    }
+    print "\n";
+
+    print "Create $nb_sparse sparse files of $sparse_size bytes\n";
+    mkdir "$dest/sparse";
+    for(my $i=0; $i < $nb_sparse; $i++) {
+        open(FP, ">$dest/sparse/s$i") or die "$dest/sparse $!";
+        print FP "begin of $i\n";
+        seek(FP, $sparse_size / 2, 0);
+        print FP "middle of $i\n";
+        seek(FP, $sparse_size - 16, 0);
+        print FP sprintf("%15d\n", $i);
+        close(FP);
+    }
+
+    print "Create a directory of $depth levels\n";
+    $dir = "$dest/deep";
+    mkdir $dir;
+    for(my $i=0; $i < $depth; $i++) {
+        $dir = "$dir/d$i";
+        mkdir $dir or die "$dir $!";
+        open(FP, ">$dir/file") or die "$dir $!";
+        print FP "level $i\n";
+        close(FP);
+    }
+
+    print "Create $nb_links hardlinks\n";
+    mkdir "$dest/links";
+    for(my $i=0; $i < $nb_links && $nb_small; $i++) {
+        my $j = ($i * 7) % $nb_small;
+        $dir = sprintf("$dest/small/%04d", $j / 1000);
+        link("$dir/f$j", "$dest/links/l$i") or die "$dest/links $!";
+    }
+}
+
+# update a tree created with create_bench_tree() before an Incremental,
+# the same files are modified, deleted and added at each call
+# Inputs: dest   destination directory
+#         level  number of the update (1, 2, ...)
+#         every  one small file out of every is modified
+sub update_bench_tree
+{
+    my ($dest, $level, $every) = @_;
+    my ($nb, $nbdel, $nbnew) = (0, 0, 0);
+    $every = $every || 10;
+
+    print "Update files in $dest\n";
+    foreach my $dir (sort glob("$dest/small/*")) {
+        opendir(DIR, $dir) || die "$!";
+        foreach my $f (sort readdir(DIR)) {
+            next if ($f !~ /^f(\d+)$/);
+            my $i = $1;
+            next if (($i + $level) % $every);
+            if ((($i + $level) / $every) % 10 == 0) {
+                unlink("$dir/$f");
+                $nbdel++;
+                next;
+            }
+            open(FP, ">>$dir/$f") or die "$dir/$f $!";
+            print FP "update $level\n";
+            close(FP);
+            $nb++;
+        }
+        closedir DIR;
+        open(FP, ">$dir/new$level") or die "$dir $!";
+        print FP "new file $level\n";
+        close(FP);
+        $nbnew++;
+    }
+    print "$nb files updated, $nbdel deleted, $nbnew created\n";
+}
+
+use Time::HiRes;
+
+# The Director exports its latency histograms to this port
+sub get_bench_port
+{
+    return $BASEPORT + 20;
+}
+
+# add a Prometheus Statistics resource to the Director to get the time
+# spent to insert the attributes in the catalog
+sub setup_bench_collector
+{
+    my ($conf) = @_;
+    my $port = get_bench_port();
+    open(FP, ">>$conf") or die "Error: Unable to open $conf $@";
+    print FP "
+Statistics {
+  Name = BenchPrometheus
+  Type = Prometheus
+  Host = 127.0.0.1
+  Port = $port
+}
+";
+    close(FP);
+}
+
+# take a sample of the Director memory and catalog counters, the
+# benchmark report is computed from the samples
+# Inputs: name  name of the sample, i.e. full-start, full-end
+#         now   time of the sample (date +%s.%N), default is the current time
+sub bench_sample
+{
+    my ($name, $now) = @_;
+    my ($rss, $hwm, $ins_sum, $ins_count) = (0, 0, 0, 0);
+    $now = $now || Time::HiRes::time();
+
+    my ($pidfile) = glob("$working/bacula-dir.*.pid");
+    if ($pidfile && open(FP, $pidfile)) {
+        my $pid = <FP>;
+        close(FP);
+        chomp($pid);
+        if (open(FP, "/proc/$pid/status")) {
+            while (my $l = <FP>) {
+                $rss = $1 if ($l =~ /^VmRSS:\s+(\d+)/);
+                $hwm = $1 if ($l =~ /^VmHWM:\s+(\d+)/);
+            }
+            close(FP);
+        }
+    }
+
+    my $sock = IO::Socket::INET->new(PeerAddr => '127.0.0.1',
+                                     PeerPort => get_bench_port(),
+                                     Proto    => 'tcp',
+                                     Timeout  => 5);
+    if ($sock) {
+        print $sock "GET /metrics HTTP/1.0\r\n\r\n";
+        while (my $l = <$sock>) {
+            $ins_sum = $1 if ($l =~ /^bacula_dir_catalog_insert_seconds_sum (\S+)/);
+            $ins_count = $1 if ($l =~ /^bacula_dir_catalog_insert_seconds_count (\S+)/);
+        }
+        close($sock);
+    }
+    open(FP, ">>$tmp/bench-samples") or die "Can't open $tmp/bench-samples $!";
+    print FP "$name $now $rss $hwm $ins_sum $ins_count\n";
+    close(FP);
+}
+
+# compute the benchmark results from the samples and the job reports of
+# each phase ($tmp/bench-<phase>.out), write them in JSON and compare them
+# with a previous result file
+# Inputs: result     JSON file to write
+#         baseline   JSON file of a previous run, can be empty
+#         tolerance  percentage of slowdown accepted before failing
+# Exit with 1 when a phase is slower than the baseline
+sub bench_report
+{
+    my ($result, $baseline, $tolerance) = @_;
+    my (%samples, @phases, %res);
+    $tolerance = $tolerance || 20;
+
+    open(FP, "$tmp/bench-samples") or die "Can't open $tmp/bench-samples $!";
+    while (my $l = <FP>) {
+        chomp($l);
+        my ($name, @val) = split(/ /, $l);
+        $samples{$name} = \@val;
+        if ($name =~ /^(.+)-start$/) {
+            push @phases, $1;
+        }
+    }
+    close(FP);
+
+    foreach my $phase (@phases) {
+        my $s = $samples{"$phase-start"};
+        my $e = $samples{"$phase-end"};
+        next if (!$e);
+        my %r = (elapsed => $e->[0] - $s->[0],
+                 dir_rss_kb => $e->[1],
+                 dir_peak_rss_kb => $e->[2],
+                 catalog_insert_sec => $e->[3] - $s->[3],
+                 catalog_inserts => $e->[4] - $s->[4],
+                 files => 0, bytes => 0);
+        if (open(FP, "$tmp/bench-$phase.out")) {
+            while (my $l = <FP>) {
+                $l =~ s/(\d),(\d)/$1$2/g;
+                $r{files} += $1 if ($l =~ /^\s+(?:FD Files Written|Files Restored):\s+(\d+)/);
+                $r{bytes} += $1 if ($l =~ /^\s+(?:SD Bytes Written|Bytes Restored):\s+(\d+)/);
+                $r{tree_files} = $1 if ($l =~ /^(\d+) files inserted into the tree/);
+            }
+            close(FP);
+        }
+        my $elapsed = $r{elapsed} > 0 ? $r{elapsed} : 0.001;
+        $r{files_per_sec} = $r{files} / $elapsed;
+        $r{mb_per_sec} = $r{bytes} / $elapsed / 1000000;
+        if (defined $r{tree_files}) {
+            $r{tree_files_per_sec} = $r{tree_files} / $elapsed;
+        }
+        $res{$phase} = \%r;
+    }
+
+    open(FP, ">$result") or die "Can't open $result $!";
+    print FP "{\n";
+    print FP "  \"test\": \"$TestName\",\n";
+    print FP "  \"database\": \"$ENV{WHICHDB}\",\n";
+    print FP "  \"date\": \"", strftime('%F %T', localtime()), "\",\n";
+    print FP "  \"phases\": {\n";
+    for (my $i = 0; $i <= $#phases; $i++) {
+        my $r = $res{$phases[$i]};
+        next if (!$r);
+        print FP "    \"$phases[$i]\": {";
+        print FP join(",", map { sprintf("\n      \"%s\": %s", $_,
+                   /^(elapsed|catalog_insert_sec|.*_per_sec)$/ ? sprintf("%.3f", $r->{$_}) : $r->{$_}) }
+                   sort keys %$r);
+        print FP "\n    }", ($i < $#phases ? "," : ""), "\n";
+    }
+    print FP "  }\n}\n";
+    close(FP);
+
+    foreach my $phase (@phases) {
+        my $r = $res{$phase};
+        printf("%-22s %8.2fs %10.1f files/s %8.2f MB/s insert %7.2fs RSS %s KB\n",
+               $phase, $r->{elapsed},
+               $r->{tree_files_per_sec} || $r->{files_per_sec}, $r->{mb_per_sec},
+               $r->{catalog_insert_sec}, $r->{dir_peak_rss_kb});
+    }
+
+    return if (!$baseline);
+    open(FP, $baseline) or die "Can't open $baseline $!";
+    my $content = join("", <FP>);
+    close(FP);
+    foreach my $phase (@phases) {
+        next if ($content !~ /"\Q$phase\E": \{([^}]+)\}/);
+        my $prev = $1;
+        foreach my $k (qw/files_per_sec mb_per_sec tree_files_per_sec/) {
+            next if (!defined $res{$phase}->{$k} || $prev !~ /"$k": ([\d.]+)/);
+            my $old = $1;
+            next if ($old <= 0);
+            if ($res{$phase}->{$k} < $old * (100 - $tolerance) / 100) {
+                printf("ERROR: %s %s is %.1f, it was %.1f in %s\n", $phase, $k,
+                       $res{$phase}->{$k}, $old, $baseline);
+                $bstat = 1;
+            }
+        }
+    }
+    exit $bstat;
+}
+
 sub check_encoding
 {
     if (grep {/Wanted SQL_ASCII, got UTF8/} 
@@ -439,6 +439,14 @@ then
    bstat=1
 fi
 
+# the data of the first file goes through the bulk data channel
+BULK=$(grep -c "TEST5BulkData" ${cwd}/tmp/log1.out)
+if [ "$BULK" -ne 1 ]
+then
+   echo "log1 bulk" "$BULK"
+   bstat=$((bstat+1024))
+fi
+
 # test long fname
 ENDOFNAME=$(grep -c ENDOFNAME ${cwd}/tmp/log1.out)
 if [ "$ENDOFNAME" -lt 1 ]
@@ -552,6 +560,14 @@ then
    rstat=1
 fi
 
+# the restored data comes through the bulk data channel
+RBULK=$(grep -c "TEST5R - bulk data saved" ${cwd}/tmp/rlog1.out)
+if [ "$RBULK" -lt 1 ]
+then
+   echo "rlog1 bulk" "$RBULK"
+   rstat=7
+fi
+
 RET=$(grep "jobstatus:" ${cwd}/tmp/rlog2.out | tail -1 | awk '{print $2}')
 REND=$(grep -w -c "TESTEND" ${cwd}/tmp/rlog2.out)
 if [ "x$RET" != "xT" ] || [ "$REND" -ne 1 ]
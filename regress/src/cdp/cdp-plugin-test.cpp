@@ -204,32 +204,20 @@ public:
 
       const char *fc3 = "jaeaij";
       FileRecord r3 = makeTestFile("funny_meme.gif", fc3);
-      char *ojc = BTU::readFile(_jPath);
 
       _d.startTest(_pluginPath);
 
       this->sendBackupEvents();
 
-      POOLMEM *migratedJournal = get_pool_memory(PM_FNAME);
-      Mmsg(migratedJournal, "%s/%s_0.journal", _workingPath, _jobName);
-      char *mjc = BTU::readFile(migratedJournal);
-      BTU::verifyNotNull("Migrated Journal", mjc);
-      BTU::verifyStrings("Migrated Journal", ojc, mjc);
-
       this->simulateBackup(r1, fc1);
       this->simulateBackup(r2, fc2);
       this->simulateBackup(r3, fc3);
 
       _d.tryBackupStop();
       _d.endTest();
-
-      BTU::verifyFileDoesntExist(migratedJournal);
    }
 
    void plugin_should_handle_cancel_backup_event() {
-      POOLMEM *newJournal = get_pool_memory(PM_FNAME);
-      Mmsg(newJournal, "%s/%s_0.journal", _workingPath, _jobName);
-
       title("Plugin should handle cancel Backup event");
 
       const char *fc1 = "akfkaklfass";
@@ -252,7 +240,19 @@ public:
 
       _d.endTest();
 
-      BTU::verifyFileExists(newJournal);
+      // No Checkpoint, the next Job sends the records again
+      Journal journal;
+      journal.setJournalPath(_jPath);
+      if (!journal.openCursor(0)) {
+         printf("ERROR: could not open a cursor on %s\n", _jPath);
+         exit(-1);
+      }
+      FileRecord *rec = journal.nextFileRecord();
+      BTU::verifyNotNull("FileRecord of the canceled Job", rec);
+      BTU::verifyStrings("FileRecord of the canceled Job", r1.name, rec->name);
+      delete rec;
+      journal.closeCursor();
+
       BTU::rmDir(_workingPath);
       BTU::mkpath(_tmpDirPath, "working");
    }
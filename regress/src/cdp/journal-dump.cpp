@@ -0,0 +1,103 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+ */
+
+/*
+ * Print the records of a binary CDP Journal in the text format of the
+ *  version 1, so the regress scripts can grep them.
+ *
+ *  journal-dump <journal>           Settings, Folders and the File
+ *                                   records not yet backed up
+ *  journal-dump <journal> <path>    Last File record of path, the
+ *                                   exit status is 1 if not found
+ */
+
+#include "journal.h"
+
+static void dump_file_record(FileRecord *rec)
+{
+   printf("File {\n"
+          "name=%s\n"
+          "sname=%s\n"
+          "mtime=%lld\n"
+          "attrs=%s\n"
+          "}\n",
+          rec->name, rec->sname, (long long)rec->mtime, rec->fattrs);
+}
+
+int main(int argc, char *argv[])
+{
+   Journal journal;
+   SettingsRecord *settings;
+   FolderRecord *folder;
+   FileRecord *rec;
+   struct stat sp;
+
+   if (argc < 2 || argc > 3) {
+      fprintf(stderr, "Usage: %s <journal> [path]\n", argv[0]);
+      return 2;
+   }
+
+   lmgr_init_thread();
+
+   /* setJournalPath() would create a missing Journal */
+   if (stat(argv[1], &sp) != 0 || !journal.setJournalPath(argv[1])) {
+      fprintf(stderr, "Could not open Journal %s\n", argv[1]);
+      return 2;
+   }
+
+   if (argc == 3) {
+      rec = journal.findFileRecord(argv[2]);
+      if (!rec) {
+         return 1;
+      }
+      dump_file_record(rec);
+      delete rec;
+      return 0;
+   }
+
+   if (!journal.beginTransaction("r")) {
+      fprintf(stderr, "Could not read Journal %s\n", argv[1]);
+      return 2;
+   }
+   settings = journal.readSettings();
+   if (settings) {
+      printf("Settings {\n"
+             "spooldir=%s\n"
+             "heartbeat=%lld\n"
+             "jversion=%lld\n"
+             "}\n",
+             NPRT(settings->getSpoolDir()),
+             (long long)settings->heartbeat,
+             (long long)settings->journalVersion);
+      delete settings;
+   }
+   while ((folder = journal.readFolderRecord()) != NULL) {
+      printf("Folder {\n"
+             "path=%s\n"
+             "}\n",
+             folder->path);
+      delete folder;
+   }
+   while ((rec = journal.readFileRecord()) != NULL) {
+      dump_file_record(rec);
+      delete rec;
+   }
+   journal.endTransaction();
+   return 0;
+}
@@ -66,55 +66,101 @@ class JournalTest
 
    private:
 
-   void verifyFileContainsRecord(const char *fname, const FileRecord &rec) {
-      const int SANITY_CHECK = 10000;
-      char *fcontents = BTU::readFile(fname);
-      char expected[SANITY_CHECK];
-      bsnprintf(expected, SANITY_CHECK,
-            "File {" NL
-            "name=%s" NL
-            "sname=%s" NL
-            "mtime=%lld" NL
-            "attrs=%s" NL
-            "}" NL,
-            rec.name,
-            rec.sname,
-            rec.mtime,
-            rec.fattrs);
-      if (strstr(fcontents, expected) == NULL) {
-         printf("ERROR: FileRecord of file %s not found.\n"
-               "FCONTENTS:\n%s\n"
-               "EXPECTED:\n%s\n", rec.name, fcontents, expected);
+   /* The Journal is binary, the records are read back with the API */
+   void verifyFileContainsRecord(const FileRecord &rec) {
+      FileRecord *read = _journal->findFileRecord(rec.name);
+      if (read == NULL) {
+         printf("ERROR: FileRecord of file %s not found.\n", rec.name);
          exit(-1);
       }
+      BTU::verifyStrings("FileRecord name", rec.name, read->name);
+      BTU::verifyStrings("FileRecord sname", rec.sname, read->sname);
+      BTU::verifyInt64("FileRecord mtime", rec.mtime, read->mtime);
+      BTU::verifyStrings("FileRecord attrs", rec.fattrs, read->fattrs);
+      delete read;
    }
 
-   void verifyFolderNotContainsRecord(const char *fname, const FolderRecord &rec) {
-      const int SANITY_CHECK = 1000000;
-      char *fcontents = BTU::readFile(fname);
-      char expected[SANITY_CHECK];
-      bsnprintf(expected, SANITY_CHECK,
-            "Folder {" NL
-            "path=%s" NL
-            "}" NL,
-            rec.path);
-      if (strstr(fcontents, expected) != NULL) {
-         printf("ERROR: FolderRecord of folder %s not found.", rec.path);
+   bool journalContainsFolder(const char *path) {
+      FolderRecord *read;
+      bool found = false;
+
+      _journal->beginTransaction("r");
+      while ((read = _journal->readFolderRecord()) != NULL) {
+         if (strcmp(read->path, path) == 0) {
+            found = true;
+         }
+         delete read;
+      }
+      _journal->endTransaction();
+      return found;
+   }
+
+   void verifyFolderNotContainsRecord(const FolderRecord &rec) {
+      if (journalContainsFolder(rec.path)) {
+         printf("ERROR: FolderRecord of folder %s should be removed.\n", rec.path);
          exit(-1);
       }
    }
 
-   void verifyFolderContainsRecord(const char *fname, const FolderRecord &rec) {
-      const int SANITY_CHECK = 1000000;
-      char *fcontents = BTU::readFile(fname);
-      char expected[SANITY_CHECK];
-      bsnprintf(expected, SANITY_CHECK,
-            "Folder {" NL
-            "path=%s" NL
-            "}" NL,
-            rec.path);
-      if (strstr(fcontents, expected) == NULL) {
-         printf("ERROR: FolderRecord of folder %s not found.", rec.path);
+   void verifyFolderContainsRecord(const FolderRecord &rec) {
+      if (!journalContainsFolder(rec.path)) {
+         printf("ERROR: FolderRecord of folder %s not found.\n", rec.path);
+         exit(-1);
+      }
+   }
+
+   /* Read the FileRecords of the cursor, they must be the files of names */
+   void verifyCursorRecords(Journal *journal, const char **names) {
+      FileRecord *read;
+      char *fpath;
+      int i;
+
+      for (i = 0; names[i] != NULL; i++) {
+         read = journal->nextFileRecord();
+         fpath = BTU::concat3(_tmpDirPath, "/", names[i]);
+         BTU::verifyNotNull("Cursor FileRecord", read);
+         BTU::verifyStrings("Cursor File Path", fpath, read->name);
+         free(fpath);
+         delete read;
+      }
+      BTU::verifyNull("Cursor FileRecord", journal->nextFileRecord());
+   }
+
+   /* Generation number of the Journal header */
+   uint64_t journalGeneration(const char *jpath) {
+      uint8_t hdr[24];
+      uint64_t generation = 0;
+      FILE *fp = bfopen(jpath, "rb");
+
+      if (fp) {
+         if (fread(hdr, 1, sizeof(hdr), fp) == sizeof(hdr)) {
+            for (int i = 16; i < 24; i++) {
+               generation = (generation << 8) | hdr[i];
+            }
+         }
+         fclose(fp);
+      }
+      return generation;
+   }
+
+   int64_t fileSize(const char *fname) {
+      struct stat sp;
+      if (stat(fname, &sp) != 0) {
+         return -1;
+      }
+      return sp.st_size;
+   }
+
+   void writeTestRecord(Journal *journal, const char *fname) {
+      FileRecord rec;
+      rec.name = BTU::concat3(_tmpDirPath, "/", fname);
+      char *tmp = BTU::concat("12345_", fname);
+      rec.sname = BTU::concat3(_tmpDirPath, "/", tmp);
+      free(tmp);
+      BTU::mkfile(rec.name);
+
+      if (!rec.encode_attrs() || !journal->writeFileRecord(rec)) {
+         printf("ERROR: could not write FileRecord: %s\n", rec.name);
          exit(-1);
       }
    }
@@ -149,7 +195,7 @@ class JournalTest
          printf("ERROR: could not write FileRecord: %s", rec.name);
          exit(-1);     
       }
-      verifyFileContainsRecord(_jPath, rec);
+      verifyFileContainsRecord(rec);
    }
 
    void do_write_folder_test(const char* fname) {
@@ -159,7 +205,7 @@ class JournalTest
          printf("ERROR: could not write FolderRecord: %s", fname);
          exit(-1); 
       }
-      verifyFolderContainsRecord(_jPath, rec);
+      verifyFolderContainsRecord(rec);
    }
 
    void do_read_file_test(const char* fname) {
@@ -201,7 +247,7 @@ class JournalTest
          exit(-1); 
       }
 
-      verifyFolderNotContainsRecord(_jPath, rec);
+      verifyFolderNotContainsRecord(rec);
    }
 
    public:
@@ -331,48 +377,270 @@ class JournalTest
       BTU::cpFile(oldJournal, _jPath);
    }
 
-   void journal_should_migrate_to_new_path() {
-      title("Journal should migrate to New Path");
+   void journal_should_convert_text_journal() {
+      title("Journal should convert a version 1 text Journal");
+
+      char *v1Path = BTU::concat(_tmpDirPath, "/v1.journal");
+      char *spoolDir = BTU::concat(_tmpDirPath, "/v1-spool");
+      char *folder = BTU::concat(_tmpDirPath, "/v1-folder");
+      char *file1 = BTU::concat(_tmpDirPath, "/v1_file1.txt");
+      char *file2 = BTU::concat(_tmpDirPath, "/v1_file2.txt");
+      char magic[8];
+
+      FILE *fp = bfopen(v1Path, "w");
+      BTU::verifyNotNull("Text Journal", fp);
+      fprintf(fp,
+            "Settings {" NL
+            "spooldir=%s" NL
+            "heartbeat=%d" NL
+            "jversion=%d" NL
+            "}" NL
+            "Folder {" NL
+            "path=%s" NL
+            "}" NL
+            "File {" NL
+            "name=%s" NL
+            "sname=%s/1000_v1_file1.txt" NL
+            "mtime=%d" NL
+            "attrs=%s" NL
+            "}" NL
+            "File {" NL
+            "name=%s" NL
+            "sname=%s/2000_v1_file2.txt" NL
+            "mtime=%d" NL
+            "attrs=%s" NL
+            "}" NL,
+            spoolDir, 30, 1, folder,
+            file1, spoolDir, 1000, "A B C",
+            file2, spoolDir, 2000, "D E F");
+      fclose(fp);
+
+      Journal journal;
+      if (!journal.setJournalPath(v1Path)) {
+         printf("ERROR: could not convert Journal %s\n", v1Path);
+         exit(-1);
+      }
+
+      fp = bfopen(v1Path, "rb");
+      BTU::verifyNotNull("Converted Journal", fp);
+      BTU::verifyInt64("Journal magic", 8, fread(magic, 1, 8, fp));
+      BTU::verifyInt64("Journal magic", 0, memcmp(magic, "BCDPJRNL", 8));
+      fclose(fp);
+
+      subtitle("Settings and Folders should be kept");
+      SettingsRecord *settings = journal.readSettings();
+      BTU::verifyNotNull("SettingsRecord", settings);
+      BTU::verifyInt64("jversion", JOURNAL_VERSION, settings->journalVersion);
+      BTU::verifyInt64("heartbeat", 30, settings->heartbeat);
+      BTU::verifyStrings("spooldir", spoolDir, settings->getSpoolDir());
+      delete settings;
+
+      journal.beginTransaction("r");
+      FolderRecord *fr = journal.readFolderRecord();
+      BTU::verifyNotNull("FolderRecord", fr);
+      BTU::verifyStrings("Folder Path", folder, fr->path);
+      delete fr;
+      BTU::verifyNull("FolderRecord", journal.readFolderRecord());
+      journal.endTransaction();
+
+      subtitle("File Records should be sent by the next Job");
+      FileRecord *rec = journal.findFileRecord(file2);
+      BTU::verifyNotNull("FileRecord", rec);
+      BTU::verifyInt64("mtime", 2000, rec->mtime);
+      BTU::verifyStrings("attrs", "D E F", rec->fattrs);
+      delete rec;
+
+      const char *names[] = { "v1_file1.txt", "v1_file2.txt", NULL };
+      if (!journal.openCursor(0)) {
+         printf("ERROR: could not open a cursor on %s\n", v1Path);
+         exit(-1);
+      }
+      verifyCursorRecords(&journal, names);
+      journal.closeCursor();
+
+      free(v1Path);
+      free(spoolDir);
+      free(folder);
+      free(file1);
+      free(file2);
+   }
+
+   void journal_should_truncate_torn_record() {
+      title("Journal should discard a record torn by a crash");
+
+      char *tornPath = BTU::concat(_tmpDirPath, "/torn.journal");
+      Journal *journal = new Journal();
+      int64_t size;
 
-      char *f1 = BTU::readFile(_jPath);
-      char *newPath = BTU::concat(_tmpDirPath, "/migrated.journal");
+      journal->setJournalPath(tornPath);
+      writeTestRecord(journal, "torn_file1.txt");
+      writeTestRecord(journal, "torn_file2.txt");
+      size = fileSize(tornPath);
+      writeTestRecord(journal, "torn_file3.txt");
+      delete journal;
 
-      if (!_journal->migrateTo(newPath)) {
-         printf("ERROR: could not migrate Journal to %s", newPath);
-         exit(-1);    
+      subtitle("Record cut in the middle");
+      if (truncate(tornPath, fileSize(tornPath) - 5) != 0) {
+         printf("ERROR: could not truncate %s\n", tornPath);
+         exit(-1);
       }
+      journal = new Journal();
+      journal->setJournalPath(tornPath);
+      const char *names1[] = { "torn_file1.txt", "torn_file2.txt", NULL };
+      journal->openCursor(0);
+      verifyCursorRecords(journal, names1);
+      journal->closeCursor();
+      BTU::verifyInt64("Journal size", size, fileSize(tornPath));
+
+      subtitle("Record appended after the truncation");
+      writeTestRecord(journal, "torn_file3.txt");
+      size = fileSize(tornPath);
+      delete journal;
+
+      subtitle("Garbage at the end of the Journal");
+      FILE *fp = bfopen(tornPath, "ab");
+      BTU::verifyNotNull("Torn Journal", fp);
+      fwrite("JREC garbage", 1, 12, fp);
+      fclose(fp);
+
+      journal = new Journal();
+      journal->setJournalPath(tornPath);
+      const char *names2[] = { "torn_file1.txt", "torn_file2.txt", "torn_file3.txt", NULL };
+      journal->openCursor(0);
+      verifyCursorRecords(journal, names2);
+      journal->closeCursor();
+      BTU::verifyInt64("Journal size", size, fileSize(tornPath));
+      delete journal;
+      free(tornPath);
+   }
 
-      // Verify that the migrated Journal has the same contents
-      // as the old one
-      char *f2 = BTU::readFile(newPath);
-      BTU::verifyNotNull("Migrated Journal", f2);
-      BTU::verifyStrings("Migrated Journal", f1, f2);
-      free(f1);
-      free(f2);
-
-      // Verify that the old Journal now only have:
-      // 1-) SettingsRecord
-      // 2-) FolderRecords
-      _journal = new Journal();
-      _journal->setJournalPath(_jPath);
+   void journal_cursor_should_send_again_records_of_failed_job() {
+      title("Journal cursor should send again the records of a failed Job");
+
+      char *curPath = BTU::concat(_tmpDirPath, "/cursor.journal");
+      Journal journal;
+      journal.setJournalPath(curPath);
+      writeTestRecord(&journal, "cur_file1.txt");
+      writeTestRecord(&journal, "cur_file2.txt");
+
+      subtitle("Job 1 fails, no Checkpoint is written");
+      const char *names1[] = { "cur_file1.txt", "cur_file2.txt", NULL };
+      journal.openCursor(0);
+      verifyCursorRecords(&journal, names1);
+      journal.closeCursor();
+
+      subtitle("Job 2 gets the same records");
+      journal.openCursor(0);
+      verifyCursorRecords(&journal, names1);
+      if (!journal.commitCursor(2)) {
+         printf("ERROR: could not write the Checkpoint of JobId 2\n");
+         exit(-1);
+      }
 
-      SettingsRecord *rec = _journal->readSettings();
-      BTU::verifyNotNull("SettingsRecord", rec);
-      BTU::verifyInt64("jversion", 1, rec->journalVersion);
-      BTU::verifyInt64("heartbeat", -1, rec->heartbeat);
+      subtitle("Job 3 gets only the new records");
+      writeTestRecord(&journal, "cur_file3.txt");
+      const char *names3[] = { "cur_file3.txt", NULL };
+      journal.openCursor(0);
+      /* Written while the Job runs, for the next Job */
+      writeTestRecord(&journal, "cur_file4.txt");
+      verifyCursorRecords(&journal, names3);
+      journal.commitCursor(3);
+
+      subtitle("Job 4 gets the records written during Job 3");
+      const char *names4[] = { "cur_file4.txt", NULL };
+      journal.openCursor(0);
+      verifyCursorRecords(&journal, names4);
+      journal.closeCursor();
+
+      subtitle("Cursor after the Checkpoint of a given Job");
+      const char *names2[] = { "cur_file3.txt", "cur_file4.txt", NULL };
+      journal.openCursor(2);
+      verifyCursorRecords(&journal, names2);
+      journal.closeCursor();
+      free(curPath);
+   }
 
-      _journal->beginTransaction("r");
-      do_read_folder_test("folder1");
-      do_read_folder_test("folder2");
-      do_read_folder_test("folder3");
-      do_read_folder_test("folder4");
-      do_read_folder_test("folder5");
-      do_read_folder_test(NULL);
-      _journal->endTransaction();
+   void journal_should_compact_into_new_generation() {
+      title("Journal should compact the backed up records into a new generation");
+
+      char *cmpPath = BTU::concat(_tmpDirPath, "/compact.journal");
+      char *file1 = BTU::concat(_tmpDirPath, "/cmp_file1.txt");
+      char *file3 = BTU::concat(_tmpDirPath, "/cmp_file3.txt");
+      uint64_t generation;
+      int64_t size;
+      FileRecord *rec;
+      Journal journal;
+
+      journal.setJournalPath(cmpPath, "/cmp/spool");
+      FolderRecord folder;
+      folder.path = BTU::concat(_tmpDirPath, "/cmp-folder");
+      journal.writeFolderRecord(folder);
+      writeTestRecord(&journal, "cmp_file1.txt");
+      writeTestRecord(&journal, "cmp_file2.txt");
+      journal.openCursor(0);
+      while ((rec = journal.nextFileRecord()) != NULL) {
+         delete rec;
+      }
+      journal.commitCursor(1);
+      writeTestRecord(&journal, "cmp_file3.txt");
 
-      _journal->beginTransaction("r");
-      do_read_file_test(NULL);
-      _journal->endTransaction();
+      generation = journalGeneration(cmpPath);
+      size = fileSize(cmpPath);
+      if (!journal.compact()) {
+         printf("ERROR: could not compact Journal %s\n", cmpPath);
+         exit(-1);
+      }
+      BTU::verifyInt64("Journal generation", generation + 1, journalGeneration(cmpPath));
+      if (fileSize(cmpPath) >= size) {
+         printf("ERROR: Journal was not compacted. %lld >= %lld bytes\n",
+               (long long)fileSize(cmpPath), (long long)size);
+         exit(-1);
+      }
+
+      subtitle("Settings, Folders and pending records should be kept");
+      SettingsRecord *settings = journal.readSettings();
+      BTU::verifyNotNull("SettingsRecord", settings);
+      BTU::verifyStrings("spooldir", "/cmp/spool", settings->getSpoolDir());
+      delete settings;
+
+      journal.beginTransaction("r");
+      FolderRecord *fr = journal.readFolderRecord();
+      BTU::verifyNotNull("FolderRecord", fr);
+      BTU::verifyStrings("Folder Path", folder.path, fr->path);
+      delete fr;
+      journal.endTransaction();
+
+      BTU::verifyNull("Backed up FileRecord", journal.findFileRecord(file1));
+      rec = journal.findFileRecord(file3);
+      BTU::verifyNotNull("Pending FileRecord", rec);
+      delete rec;
+
+      const char *names3[] = { "cmp_file3.txt", NULL };
+      journal.openCursor(0);
+      verifyCursorRecords(&journal, names3);
+      journal.closeCursor();
+
+      subtitle("Checkpoint of a cursor opened before the compaction");
+      Journal job;
+      job.setJournalPath(cmpPath);
+      job.openCursor(0);
+      writeTestRecord(&journal, "cmp_file4.txt");
+      if (!journal.compact()) {
+         printf("ERROR: could not compact Journal %s\n", cmpPath);
+         exit(-1);
+      }
+      BTU::verifyInt64("Journal generation", generation + 2, journalGeneration(cmpPath));
+      verifyCursorRecords(&job, names3);
+      job.commitCursor(2);
+
+      const char *names4[] = { "cmp_file4.txt", NULL };
+      journal.openCursor(0);
+      verifyCursorRecords(&journal, names4);
+      journal.closeCursor();
+
+      free(cmpPath);
+      free(file1);
+      free(file3);
    }
 
    void journal_should_handle_errors_on_reading() {
@@ -502,7 +770,13 @@ int main(int argc, char *argv[])
    printf("OK\n");
    test.journal_should_remove_folder_records();
    printf("OK\n");
-   test.journal_should_migrate_to_new_path();
+   test.journal_should_convert_text_journal();
+   printf("OK\n");
+   test.journal_should_truncate_torn_record();
+   printf("OK\n");
+   test.journal_cursor_should_send_again_records_of_failed_job();
+   printf("OK\n");
+   test.journal_should_compact_into_new_generation();
    printf("OK\n");
    test.journal_should_handle_errors_on_reading();
    printf("OK\n");
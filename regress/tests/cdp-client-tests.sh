@@ -9,10 +9,12 @@ CdpClientPath=$Path/build/src/tools/cdp-client/cdp-client
 TmpDir="$Path/tmp"
 SpoolDir=$TmpDir/"spool-dir"
 JournalFile=$TmpDir/".bcdp-cli.journal"
+JournalDump=$unitsrc/cdp/bin/journal-dump
 WatchedDir1=$TmpDir/"folder1"
 WatchedDir2=$TmpDir/"folder2"
 
 make -C $Path/build/src/tools/cdp-client/ install > /dev/null
+make -C $unitsrc/cdp journal-dump > /dev/null
 
 start_test
 
@@ -75,7 +77,7 @@ fi
 verify_journal_contains_record()
 {
 print_debug "Verifying if Journal File contains File Record"
-JournalHasFile=$(cat $JournalFile | grep "name=$1" | wc -l)
+JournalHasFile=$($JournalDump $JournalFile $1 | grep "^name=$1\$" | wc -l)
 if [ "$JournalHasFile" -eq "1" ]; then
    print_debug "OK"
 else